@@ -0,0 +1,1196 @@
+/*bench.c*/
+
+/**
+  * @brief Benchmarks for nuPython's memory unit
+  *
+  * Usage: ./bench.out [name ...]
+  *
+  * Runs the named benchmarks, or all of them if no names are
+  * given. Build with "make bench".
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <stdint.h>  // uint64_t
+#include <unistd.h>  // close, dup, dup2
+#include <fcntl.h>   // open
+#include <signal.h>  // signal, SIGPIPE
+#include <sys/socket.h>  // socketpair
+#include <sys/wait.h>    // waitpid
+
+#include "ram.h"
+#include "ram_trace.h"
+#include "ram_array.h"
+#include "ram_wal.h"
+#include "ram_core.h"
+#include "ram_dump.h"
+#include "ram_alloc.h"
+#include "ram_bulk.h"
+#include "ram_parallel.h"
+#include "ram_repl.h"
+#include "ram_hash.h"
+#include "ram_bigint.h"
+
+
+//
+// private helper functions:
+//
+
+static double now_seconds(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec + ts.tv_nsec / 1e9;
+}
+
+
+//
+// arena_scaling: many short interpreters on a thread pool, each
+// with its own memory, using malloc vs a per-memory arena.
+//
+struct SCRIPT_ARGS
+{
+  bool use_arena;  // ram_init_arena() instead of ram_init()
+  int scripts;     // # of scripts this thread runs
+};
+
+/**
+ * @brief script_body:
+ *
+ * simulates one short nuPython script on memory: creates
+ * variables, then repeatedly reads and overwrites them, then
+ * destroys memory
+ */
+static void script_body(struct RAM* memory)
+{
+  char name[16];
+  char text[32];
+  struct RAM_VALUE v;
+
+  for (int i = 0; i < 32; i++) {
+    snprintf(name, sizeof(name), "var%d", i);
+    snprintf(text, sizeof(text), "value number %d", i);
+    v.value_type = (i % 2 == 0) ? RAM_TYPE_STR : RAM_TYPE_INT;
+    if (v.value_type == RAM_TYPE_STR)
+      v.types.s = text;
+    else
+      v.types.i = i;
+    ram_write_cell_by_name(memory, v, name);
+  }
+
+  for (int step = 0; step < 200; step++) {
+    int addr = step % 32;
+    struct RAM_VALUE* value = ram_read_cell_by_addr(memory, addr);
+
+    if (value->value_type == RAM_TYPE_STR) {
+      snprintf(text, sizeof(text), "%s!", step % 8 == 0 ? "reset" : value->types.s);
+      v.value_type = RAM_TYPE_STR;
+      v.types.s = text;
+    }
+    else {
+      v.value_type = RAM_TYPE_INT;
+      v.types.i = value->types.i + 1;
+    }
+    ram_write_cell_by_addr(memory, v, addr);
+
+    ram_free_value(value);
+  }
+
+  ram_destroy(memory);
+}
+
+static void run_script(bool use_arena)
+{
+  script_body(use_arena ? ram_init_arena(0) : ram_init());
+}
+
+static void* script_thread(void* arg)
+{
+  struct SCRIPT_ARGS* args = (struct SCRIPT_ARGS*) arg;
+
+  for (int i = 0; i < args->scripts; i++) {
+    run_script(args->use_arena);
+  }
+
+  return NULL;
+}
+
+static void bench_arena_scaling(void)
+{
+  printf("arena_scaling: scripts/sec with one memory per script\n");
+  printf("%-8s %8s %14s %9s\n", "mode", "threads", "scripts/sec", "speedup");
+
+  int scripts_per_thread = 2000;
+  int thread_counts[] = {1, 2, 4, 8};
+
+  for (int mode = 0; mode < 2; mode++) {
+    bool use_arena = (mode == 1);
+    double base = 0.0;
+
+    for (int t = 0; t < 4; t++) {
+      int num_threads = thread_counts[t];
+      pthread_t threads[8];
+      struct SCRIPT_ARGS args;
+      args.use_arena = use_arena;
+      args.scripts = scripts_per_thread;
+
+      double start = now_seconds();
+      for (int i = 0; i < num_threads; i++)
+        pthread_create(&threads[i], NULL, script_thread, &args);
+      for (int i = 0; i < num_threads; i++)
+        pthread_join(threads[i], NULL);
+      double elapsed = now_seconds() - start;
+
+      double rate = num_threads * scripts_per_thread / elapsed;
+      if (t == 0)
+        base = rate;
+
+      printf("%-8s %8d %14.0f %8.2fx\n", use_arena ? "arena" : "malloc", num_threads, rate, rate / base);
+    }
+  }
+  printf("\n");
+}
+
+
+//
+// trace_overhead: cost of recording an event per operation.
+//
+static double time_reads_writes(struct RAM* memory, int ops)
+{
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+
+  double start = now_seconds();
+  for (int i = 0; i < ops; i++) {
+    v.types.i = i;
+    ram_write_cell_by_addr(memory, v, i % 64);
+    struct RAM_VALUE* value = ram_read_cell_by_addr(memory, (i + 1) % 64);
+    ram_free_value(value);
+  }
+  return now_seconds() - start;
+}
+
+static void bench_trace_overhead(void)
+{
+  printf("trace_overhead: ns per read+write, with and without a trace\n");
+
+  struct RAM* memory = ram_init();
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 0;
+  char name[16];
+  for (int i = 0; i < 64; i++) {
+    snprintf(name, sizeof(name), "var%d", i);
+    ram_write_cell_by_name(memory, v, name);
+  }
+
+  int ops = 2000000;
+  double plain = time_reads_writes(memory, ops);
+
+  struct RAM_TRACE* trace = ram_trace_create(1 << 16);
+  ram_trace_attach(memory, trace);
+  double traced = time_reads_writes(memory, ops);
+  ram_trace_attach(memory, NULL);
+
+  printf("%-10s %10.1f\n", "off", plain * 1e9 / ops);
+  printf("%-10s %10.1f\n", "on", traced * 1e9 / ops);
+  printf("%-10s %10.1f ns per event\n\n", "overhead", (traced - plain) * 1e9 / (2.0 * ops));
+
+  ram_trace_destroy(trace);
+  ram_destroy(memory);
+}
+
+
+//
+// wal_overhead: cost of logging writes with group commit.
+//
+static void bench_wal_overhead(void)
+{
+  printf("wal_overhead: ns per read+write, with and without a write-ahead log\n");
+
+  struct RAM* memory = ram_init();
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 0;
+  char name[16];
+  for (int i = 0; i < 64; i++) {
+    snprintf(name, sizeof(name), "var%d", i);
+    ram_write_cell_by_name(memory, v, name);
+  }
+
+  int ops = 1000000;
+  double plain = time_reads_writes(memory, ops);
+
+  char path[] = "/tmp/ram_bench_walXXXXXX";
+  int fd = mkstemp(path);
+  close(fd);
+
+  struct RAM_WAL* wal = ram_wal_open(path, 10, 4096, 0);
+  ram_wal_attach(memory, wal);
+  double start = now_seconds();
+  time_reads_writes(memory, ops);
+  ram_wal_sync(wal);  // count the last group commit too
+  double synced = now_seconds() - start;
+  ram_wal_attach(memory, NULL);
+  ram_wal_close(wal);
+  remove(path);
+
+  printf("%-10s %10.1f\n", "off", plain * 1e9 / ops);
+  printf("%-10s %10.1f\n", "on", synced * 1e9 / ops);
+  printf("%-10s %10.1f ns per write\n\n", "overhead", (synced - plain) * 1e9 / ops);
+
+  ram_destroy(memory);
+}
+
+
+//
+// str_append: building a string of n pieces with s = s + piece
+// through read and write, versus ram_append_str_by_name.
+//
+static double concat_by_copy(struct RAM* memory, int pieces)
+{
+  ram_write_str_by_name(memory, "", 0, (char*) "s");
+
+  double start = now_seconds();
+  for (int i = 0; i < pieces; i++) {
+    struct RAM_VALUE* value = ram_read_cell_by_name(memory, (char*) "s");
+    int len = ram_str_len(value);
+    char* joined = (char*) malloc(len + 16 + 1);
+    memcpy(joined, value->types.s, len);
+    memcpy(joined + len, "0123456789abcdef", 16);
+    joined[len + 16] = '\0';
+    ram_free_value(value);
+
+    ram_write_str_by_name(memory, joined, len + 16, (char*) "s");
+    free(joined);
+  }
+  return now_seconds() - start;
+}
+
+static double concat_by_append(struct RAM* memory, int pieces)
+{
+  ram_write_str_by_name(memory, "", 0, (char*) "s");
+
+  double start = now_seconds();
+  for (int i = 0; i < pieces; i++) {
+    ram_append_str_by_name(memory, "0123456789abcdef", 16, (char*) "s");
+  }
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, (char*) "s");  // flattens
+  double elapsed = now_seconds() - start;
+
+  ram_free_value(value);
+  return elapsed;
+}
+
+static void bench_str_append(void)
+{
+  printf("str_append: ms to build a string from n 16-char pieces\n");
+  printf("%-10s %12s %12s\n", "pieces", "read+write", "append");
+
+  for (int pieces = 1000; pieces <= 16000; pieces *= 2) {
+    struct RAM* memory = ram_init();
+    double copied = concat_by_copy(memory, pieces);
+    double appended = concat_by_append(memory, pieces);
+    ram_destroy(memory);
+
+    printf("%-10d %12.2f %12.2f\n", pieces, copied * 1e3, appended * 1e3);
+  }
+  printf("\n");
+}
+
+
+//
+// core_variants: specializations of BasicRam (see ram_core.h)
+// side by side with the C API, creating n variables in scrambled
+// order, then looking each one up.
+//
+struct CORE_TIMES
+{
+  double create;  // seconds
+  double lookup;
+  long   found;   // keeps the lookups from being optimized away
+};
+
+template <class CORE>
+static struct CORE_TIMES core_run(char** names, int n)
+{
+  struct CORE_TIMES t;
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+
+  CORE* core = new CORE();
+
+  double start = now_seconds();
+  for (int i = 0; i < n; i++) {
+    v.types.i = i;
+    core->write_by_name(v, names[i]);
+  }
+  t.create = now_seconds() - start;
+
+  t.found = 0;
+  start = now_seconds();
+  for (int i = 0; i < n; i++)
+    t.found += core->get_addr(names[(i * 31L) % n]);
+  t.lookup = now_seconds() - start;
+
+  delete core;
+  return t;
+}
+
+static struct CORE_TIMES c_api_run(char** names, int n)
+{
+  struct CORE_TIMES t;
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+
+  struct RAM* memory = ram_init();
+
+  double start = now_seconds();
+  for (int i = 0; i < n; i++) {
+    v.types.i = i;
+    ram_write_cell_by_name(memory, v, names[i]);
+  }
+  t.create = now_seconds() - start;
+
+  t.found = 0;
+  start = now_seconds();
+  for (int i = 0; i < n; i++)
+    t.found += ram_get_addr(memory, names[(i * 31L) % n]);
+  t.lookup = now_seconds() - start;
+
+  ram_destroy(memory);
+  return t;
+}
+
+static void bench_core_variants(void)
+{
+  printf("core_variants: ns per op, n variables created in scrambled order\n");
+  printf("%-8s %-24s %10s %10s\n", "n", "variant", "create", "lookup");
+
+  for (int n = 1000; n <= 64000; n *= 4) {
+    char** names = (char**) malloc(n * sizeof(char*));
+    for (int i = 0; i < n; i++) {
+      names[i] = (char*) malloc(16);
+      snprintf(names[i], 16, "var%06d", (int) ((i * 7919L) % n));
+    }
+
+    struct { const char* variant; struct CORE_TIMES t; } rows[] = {
+      {"c api", c_api_run(names, n)},
+      {"sorted array", core_run<BasicRam<SortedArrayIndex, DoublingGrowth>>(names, n)},
+      {"hash", core_run<BasicRam<HashIndex, DoublingGrowth>>(names, n)},
+      {"btree", core_run<BasicRam<BTreeIndex, DoublingGrowth>>(names, n)},
+      {"hash, 1.5x growth, arena", core_run<BasicRam<HashIndex, HalfAgainGrowth, ArenaAllocator>>(names, n)},
+    };
+
+    for (auto& row : rows) {
+      printf("%-8d %-24s %10.1f %10.1f\n", n, row.variant, row.t.create * 1e9 / n, row.t.lookup * 1e9 / n);
+    }
+
+    for (int i = 0; i < n; i++)
+      free(names[i]);
+    free(names);
+  }
+  printf("\n");
+}
+
+
+//
+// HDR histogram of latencies in ns: exact below 1024ns, then 512
+// sub-buckets per power of 2, so any value is recorded within
+// 0.2% of its true value, up to 2^63ns.
+//
+#define HDR_SUB_BITS  10
+#define HDR_HALF      (1 << (HDR_SUB_BITS - 1))
+#define HDR_BUCKETS   ((64 - HDR_SUB_BITS + 2) * HDR_HALF)
+
+struct HDR_HISTOGRAM
+{
+  uint64_t counts[HDR_BUCKETS];
+  uint64_t total;
+  uint64_t max;
+};
+
+static void hdr_reset(struct HDR_HISTOGRAM* h)
+{
+  memset(h, 0, sizeof(struct HDR_HISTOGRAM));
+}
+
+static int hdr_index(uint64_t value)
+{
+  if (value < 2 * HDR_HALF)
+    return (int) value;
+
+  int msb = 63 - __builtin_clzll(value);
+  int e = msb - HDR_SUB_BITS + 1;
+  return e * HDR_HALF + (int) (value >> e);
+}
+
+//
+// highest value recorded in the same bucket as index:
+//
+static uint64_t hdr_value(int index)
+{
+  if (index < 2 * HDR_HALF)
+    return index;
+
+  int e = index / HDR_HALF - 1;
+  uint64_t sub = index - e * HDR_HALF;
+  return ((sub + 1) << e) - 1;
+}
+
+static void hdr_record(struct HDR_HISTOGRAM* h, uint64_t value)
+{
+  h->counts[hdr_index(value)]++;
+  h->total++;
+  if (value > h->max)
+    h->max = value;
+}
+
+//
+// value at the given percentile (0..100):
+//
+static uint64_t hdr_percentile(struct HDR_HISTOGRAM* h, double percentile)
+{
+  uint64_t rank = (uint64_t) (percentile / 100.0 * h->total + 0.5);
+  if (rank < 1)
+    rank = 1;
+
+  uint64_t seen = 0;
+  for (int i = 0; i < HDR_BUCKETS; i++) {
+    seen += h->counts[i];
+    if (seen >= rank)
+      return (hdr_value(i) < h->max) ? hdr_value(i) : h->max;
+  }
+  return h->max;
+}
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+
+//
+// tail_latency: per-call latency percentiles of creating,
+// looking up, reading and overwriting variables, for names
+// created in different orders and for different value types.
+//
+enum NAME_ORDERS { ASCENDING, DESCENDING, SCRAMBLED };
+
+static const char* order_names[] = {"ascending", "descending", "scrambled"};
+
+static void print_latency(const char* scenario, const char* op, struct HDR_HISTOGRAM* h)
+{
+  printf("%-28s %-10s %8llu %8llu %8llu %8llu %10llu\n", scenario, op,
+         (unsigned long long) h->total,
+         (unsigned long long) hdr_percentile(h, 50.0),
+         (unsigned long long) hdr_percentile(h, 99.0),
+         (unsigned long long) hdr_percentile(h, 99.9),
+         (unsigned long long) h->max);
+}
+
+static void latency_scenario(int order, int value_type, bool btree, struct HDR_HISTOGRAM* h)
+{
+  int n = 20000;
+  struct RAM* memory = ram_init();
+  if (btree)
+    ram_map_btree_enable(memory);
+
+  // the value written to every variable:
+  char text[256];
+  memset(text, 'x', sizeof(text) - 1);
+  text[sizeof(text) - 1] = '\0';
+  struct RAM_ARRAY* array = ram_array_new(RAM_TYPE_INT, 1000);
+
+  struct RAM_VALUE v;
+  v.value_type = value_type;
+  if (value_type == RAM_TYPE_STR)
+    v.types.s = text;
+  else if (value_type == RAM_TYPE_INT_ARRAY)
+    v.types.a = array;
+  else
+    v.types.i = 42;
+
+  char** names = (char**) malloc(n * sizeof(char*));
+  for (int i = 0; i < n; i++) {
+    int k = i;
+    if (order == DESCENDING)
+      k = n - 1 - i;
+    else if (order == SCRAMBLED)
+      k = (int) ((i * 7919L) % n);
+    names[i] = (char*) malloc(16);
+    snprintf(names[i], 16, "var%06d", k);
+  }
+
+  const char* ops[] = {"create", "get_addr", "read", "overwrite"};
+  char scenario[64];
+  snprintf(scenario, sizeof(scenario), "%s %s%s", order_names[order],
+           (value_type == RAM_TYPE_STR) ? "str" : (value_type == RAM_TYPE_INT_ARRAY) ? "int array" : "int",
+           btree ? " btree" : "");
+
+  for (int op = 0; op < 4; op++) {
+    hdr_reset(h);
+
+    for (int i = 0; i < n; i++) {
+      uint64_t start = now_ns();
+
+      if (op == 0 || op == 3) {
+        ram_write_cell_by_name(memory, v, names[i]);
+      }
+      else if (op == 1) {
+        ram_get_addr(memory, names[i]);
+      }
+      else {
+        struct RAM_VALUE* value = ram_read_cell_by_name(memory, names[i]);
+        ram_free_value(value);
+      }
+
+      hdr_record(h, now_ns() - start);
+    }
+
+    print_latency(scenario, ops[op], h);
+  }
+
+  for (int i = 0; i < n; i++)
+    free(names[i]);
+  free(names);
+  ram_array_free(array);
+  ram_destroy(memory);
+}
+
+static void bench_tail_latency(void)
+{
+  // each sample includes one clock read:
+  uint64_t overhead = UINT64_MAX;
+  for (int i = 0; i < 1000; i++) {
+    uint64_t start = now_ns();
+    uint64_t elapsed = now_ns() - start;
+    if (elapsed < overhead)
+      overhead = elapsed;
+  }
+
+  printf("tail_latency: ns per call, 20000 vars per scenario (includes ~%llu ns timer overhead)\n",
+         (unsigned long long) overhead);
+  printf("%-28s %-10s %8s %8s %8s %8s %10s\n", "scenario", "op", "calls", "p50", "p99", "p99.9", "max");
+
+  struct HDR_HISTOGRAM* h = (struct HDR_HISTOGRAM*) malloc(sizeof(struct HDR_HISTOGRAM));
+
+  for (int order = ASCENDING; order <= SCRAMBLED; order++)
+    latency_scenario(order, RAM_TYPE_INT, false, h);
+  latency_scenario(DESCENDING, RAM_TYPE_INT, true, h);
+  latency_scenario(SCRAMBLED, RAM_TYPE_STR, false, h);
+  latency_scenario(SCRAMBLED, RAM_TYPE_INT_ARRAY, false, h);
+
+  free(h);
+  printf("\n");
+}
+
+
+//
+// dump: ram_print() vs ram_dump() in each format, to /dev/null,
+// and the longest step of a dump written 1000 variables at a time.
+//
+static void bench_dump(void)
+{
+  const int n = 200000;
+  struct RAM* memory = ram_init();
+
+  char name[16];
+  char text[32];
+  struct RAM_VALUE v;
+  for (int i = 0; i < n; i++) {
+    snprintf(name, sizeof(name), "var%07d", i);
+    if (i % 2 == 0) {
+      snprintf(text, sizeof(text), "value number %d", i);
+      ram_write_str_by_name(memory, text, strlen(text), name);
+    }
+    else {
+      v.value_type = RAM_TYPE_INT;
+      v.types.i = i;
+      ram_write_cell_by_name(memory, v, name);
+    }
+  }
+
+  int null_fd = open("/dev/null", O_WRONLY);
+
+  printf("dump: ms to write %d variables (half str, half int) to /dev/null\n", n);
+
+  fflush(stdout);
+  int saved = dup(STDOUT_FILENO);
+  dup2(null_fd, STDOUT_FILENO);
+  double start = now_seconds();
+  ram_print(memory);
+  fflush(stdout);
+  double printed = now_seconds() - start;
+  dup2(saved, STDOUT_FILENO);
+  close(saved);
+  printf("%-22s %10.1f\n", "ram_print", printed * 1e3);
+
+  const char* formats[] = {"ram_dump text", "ram_dump json", "ram_dump binary"};
+  for (int format = RAM_DUMP_TEXT; format <= RAM_DUMP_BINARY; format++) {
+    start = now_seconds();
+    ram_dump(memory, null_fd, format);
+    printf("%-22s %10.1f\n", formats[format], (now_seconds() - start) * 1e3);
+  }
+
+  double longest = 0;
+  struct RAM_DUMP* dump = ram_dump_begin(memory, null_fd, RAM_DUMP_TEXT);
+  for (;;) {
+    start = now_seconds();
+    int written = ram_dump_step(dump, 1000);
+    double elapsed = now_seconds() - start;
+    if (elapsed > longest)
+      longest = elapsed;
+    if (written <= 0)
+      break;
+  }
+  ram_dump_end(dump);
+  printf("%-22s %10.3f\n\n", "longest 1000-var step", longest * 1e3);
+
+  close(null_fd);
+  ram_destroy(memory);
+}
+
+//
+// allocators: the scripts of arena_scaling on one thread, with
+// libc malloc, an arena, custom hooks over libc, and custom
+// hooks over a bump allocator reset after each script.
+//
+struct BUMP_REGION
+{
+  char*  base;
+  size_t used;
+  size_t size;
+};
+
+static void* bump_alloc(void* context, size_t bytes)
+{
+  struct BUMP_REGION* region = (struct BUMP_REGION*) context;
+  bytes = (bytes + 15) & ~(size_t) 15;
+  if (region->used + bytes > region->size)
+    return NULL;  // 1MB is plenty for one script
+  void* p = region->base + region->used;
+  region->used += bytes;
+  return p;
+}
+
+static void* libc_alloc(void* context, size_t bytes)
+{
+  return malloc(bytes);
+}
+
+static void* libc_realloc(void* context, void* ptr, size_t old_bytes, size_t bytes)
+{
+  return realloc(ptr, bytes);
+}
+
+static void libc_free(void* context, void* ptr, size_t bytes)
+{
+  free(ptr);
+}
+
+static void bench_allocators(void)
+{
+  const int scripts = 20000;
+  const char* modes[] = {"libc", "arena", "hooks: libc", "hooks: bump"};
+
+  struct BUMP_REGION region;
+  region.size = 1 << 20;
+  region.base = (char*) aligned_alloc(16, region.size);
+  region.used = 0;
+
+  struct RAM_ALLOCATOR libc_hooks = {libc_alloc, libc_realloc, libc_free, NULL};
+  struct RAM_ALLOCATOR bump_hooks = {bump_alloc, NULL, NULL, &region};
+
+  printf("allocators: scripts/sec on one thread, one memory per script\n");
+  printf("%-12s %14s\n", "allocator", "scripts/sec");
+
+  for (int mode = 0; mode < 4; mode++) {
+    double start = now_seconds();
+    for (int i = 0; i < scripts; i++) {
+      struct RAM* memory;
+      if (mode == 0)
+        memory = ram_init();
+      else if (mode == 1)
+        memory = ram_init_arena(0);
+      else if (mode == 2)
+        memory = ram_init_with_allocator(&libc_hooks);
+      else
+        memory = ram_init_with_allocator(&bump_hooks);
+
+      script_body(memory);
+      region.used = 0;
+    }
+    double elapsed = now_seconds() - start;
+
+    printf("%-12s %14.0f\n", modes[mode], scripts / elapsed);
+  }
+  printf("\n");
+
+  free(region.base);
+}
+
+//
+// table of benchmarks:
+//
+struct BENCHMARK
+{
+  const char* name;
+  void (*run)(void);
+};
+
+//
+// bulk_load: one-by-one writes vs ram_bulk_load(), names in
+// random order so the sorted map can't just append
+//
+static void bench_bulk_load(void)
+{
+  const int sizes[] = {10000, 40000};
+  struct RAM_WORKERS* workers = ram_workers_init(3);
+
+  printf("bulk_load: ms to load n new int variables, names in random order\n");
+  printf("%8s %12s %12s %12s\n", "n", "one by one", "bulk", "bulk, 4 thr");
+
+  for (int s = 0; s < 2; s++) {
+    int n = sizes[s];
+    char** names = (char**) malloc(n * sizeof(char*));
+    struct RAM_VALUE* values = (struct RAM_VALUE*) malloc(n * sizeof(struct RAM_VALUE));
+
+    srand(46);
+    for (int i = 0; i < n; i++) {
+      names[i] = (char*) malloc(16);
+      snprintf(names[i], 16, "v%08d", rand());
+      values[i].value_type = RAM_TYPE_INT;
+      values[i].types.i = i;
+    }
+
+    double ms[3];
+    for (int mode = 0; mode < 3; mode++) {
+      struct RAM* memory = ram_init();
+      double start = now_seconds();
+      if (mode == 0) {
+        for (int i = 0; i < n; i++)
+          ram_write_cell_by_name(memory, values[i], names[i]);
+      }
+      else {
+        ram_bulk_load(memory, names, values, n, (mode == 2) ? workers : NULL);
+      }
+      ms[mode] = (now_seconds() - start) * 1000.0;
+      ram_destroy(memory);
+    }
+
+    printf("%8d %12.2f %12.2f %12.2f\n", n, ms[0], ms[1], ms[2]);
+
+    for (int i = 0; i < n; i++)
+      free(names[i]);
+    free(names);
+    free(values);
+  }
+  printf("\n");
+
+  ram_workers_destroy(workers);
+}
+
+
+//
+// replication: a primary process writing while a standby process
+// applies its deltas over a Unix domain socket; the standby
+// reports how far behind each batch arrived
+//
+static void repl_script(struct RAM* memory, int writes)
+{
+  char name[16];
+  char text[32];
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+
+  for (int i = 0; i < writes; i++) {
+    snprintf(name, sizeof(name), "var%ld", (i * 7919L) % 10000);
+    if (i % 4 == 0) {
+      int len = snprintf(text, sizeof(text), "value %d", i);
+      ram_write_str_by_name(memory, text, len, name);
+    }
+    else {
+      v.types.i = i;
+      ram_write_cell_by_name(memory, v, name);
+    }
+  }
+}
+
+static void run_standby(int fd)
+{
+  struct RAM* memory = ram_init();
+  struct HDR_HISTOGRAM* lag = (struct HDR_HISTOGRAM*) malloc(sizeof(struct HDR_HISTOGRAM));
+  hdr_reset(lag);
+
+  long deltas = 0;
+  uint64_t logged_ns;
+  uint64_t first = 0;
+  int applied;
+
+  while ((applied = ram_repl_receive(memory, fd, &logged_ns)) > 0) {
+    uint64_t now = now_ns();
+    if (first == 0)
+      first = logged_ns;
+    hdr_record(lag, now - logged_ns);
+    deltas += applied;
+  }
+
+  double seconds = (now_ns() - first) / 1e9;
+  printf("%-22s %12.0f %8llu %8llu %8llu %8llu\n", "  standby",
+         deltas / seconds, (unsigned long long) lag->total,
+         (unsigned long long) hdr_percentile(lag, 50.0) / 1000,
+         (unsigned long long) hdr_percentile(lag, 99.0) / 1000,
+         (unsigned long long) lag->max / 1000);
+  fflush(stdout);
+
+  free(lag);
+  ram_destroy(memory);
+}
+
+static void bench_replication(void)
+{
+  const int writes = 500000;
+  const int configs[][2] = {{100, 64 * 1024}, {1000, 256 * 1024}};
+
+  signal(SIGPIPE, SIG_IGN);
+
+  printf("replication: %d writes by name (1 in 4 a string) to 10000 vars,\n", writes);
+  printf("primary and standby processes over a Unix domain socket\n");
+  printf("%-22s %12s %8s %8s %8s %8s\n", "", "writes/sec", "batches", "p50 us", "p99 us", "max us");
+
+  struct RAM* memory = ram_init();
+  double start = now_seconds();
+  repl_script(memory, writes);
+  printf("%-22s %12.0f\n", "no standby", writes / (now_seconds() - start));
+  ram_destroy(memory);
+
+  for (int c = 0; c < 2; c++) {
+    int fds[2];
+    if (socketpair(AF_UNIX, SOCK_STREAM, 0, fds) != 0)
+      return;
+
+    printf("batch %d us, %d KB\n", configs[c][0], configs[c][1] / 1024);
+    fflush(stdout);
+
+    pid_t pid = fork();
+    if (pid == 0) {
+      close(fds[1]);
+      run_standby(fds[0]);
+      _exit(0);
+    }
+    close(fds[0]);
+
+    memory = ram_init();
+    struct RAM_REPL* repl = ram_repl_open(fds[1], configs[c][0], configs[c][1]);
+    ram_repl_attach(memory, repl);
+
+    start = now_seconds();
+    repl_script(memory, writes);
+    ram_repl_flush(repl);
+    double elapsed = now_seconds() - start;
+
+    struct RAM_REPL_STATS stats;
+    ram_repl_stats(repl, &stats);
+    ram_repl_attach(memory, NULL);
+    ram_repl_close(repl);
+    close(fds[1]);
+    waitpid(pid, NULL, 0);
+
+    printf("%-22s %12.0f %8ld   %.1f bytes/delta\n", "  primary", writes / elapsed,
+           stats.batches, (double) stats.bytes / stats.deltas);
+    ram_destroy(memory);
+  }
+  printf("\n");
+}
+
+
+//
+// compare: checking two memories for equal contents by reading
+// every variable by name vs ram_equal() / ram_diff()
+//
+static void fill_compare(struct RAM* memory, int n)
+{
+  char name[16];
+  char text[32];
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+
+  for (int i = 0; i < n; i++) {
+    snprintf(name, sizeof(name), "var%07d", i);
+    if (i % 2 == 0) {
+      int len = snprintf(text, sizeof(text), "value number %d", i);
+      ram_write_str_by_name(memory, text, len, name);
+    }
+    else {
+      v.types.i = i;
+      ram_write_cell_by_name(memory, v, name);
+    }
+  }
+}
+
+static int compare_by_reading(struct RAM* memory1, struct RAM* memory2, int n)
+{
+  char name[16];
+  int differ = 0;
+
+  for (int i = 0; i < n; i++) {
+    snprintf(name, sizeof(name), "var%07d", i);
+    struct RAM_VALUE* v1 = ram_read_cell_by_name(memory1, name);
+    struct RAM_VALUE* v2 = ram_read_cell_by_name(memory2, name);
+
+    if (v1->value_type != v2->value_type)
+      differ++;
+    else if (v1->value_type == RAM_TYPE_STR)
+      differ += (strcmp(v1->types.s, v2->types.s) != 0);
+    else
+      differ += (v1->types.i != v2->types.i);
+
+    ram_free_value(v1);
+    ram_free_value(v2);
+  }
+  return differ;
+}
+
+static void bench_compare(void)
+{
+  const int n = 200000;
+  const int changes = 10;
+
+  struct RAM* memory1 = ram_init();
+  struct RAM* memory2 = ram_init();
+
+  double start = now_seconds();
+  fill_compare(memory1, n);
+  double plain = now_seconds() - start;
+
+  ram_hash_enable(memory2);
+  start = now_seconds();
+  fill_compare(memory2, n);
+  double hashed = now_seconds() - start;
+
+  printf("compare: two memories of %d variables (half str, half int)\n", n);
+  printf("  fill, ms: %.1f without hash, %.1f with hash\n", plain * 1000, hashed * 1000);
+
+  ram_equal(memory1, memory2);  // first hash of memory1
+
+  for (int round = 0; round < 2; round++) {
+    int differ;
+    start = now_seconds();
+    differ = compare_by_reading(memory1, memory2, n);
+    double reading = now_seconds() - start;
+
+    start = now_seconds();
+    bool equal = ram_equal(memory1, memory2);
+    double equal_time = now_seconds() - start;
+
+    start = now_seconds();
+    int diffs = ram_diff(memory1, memory2, NULL, NULL);
+    double diff_time = now_seconds() - start;
+
+    printf("  %2d changed: read all %8.2f ms (%d)  ram_equal %8.4f ms (%s)  ram_diff %8.4f ms (%d)\n",
+           round * changes, reading * 1000, differ, equal_time * 1000,
+           equal ? "equal" : "differ", diff_time * 1000, diffs);
+
+    struct RAM_VALUE v;
+    v.value_type = RAM_TYPE_INT;
+    v.types.i = -1;
+    char name[16];
+    for (int i = 0; i < changes; i++) {
+      snprintf(name, sizeof(name), "var%07d", (i * 7919) % n);
+      ram_write_cell_by_name(memory2, v, name);
+    }
+  }
+  printf("\n");
+
+  ram_destroy(memory1);
+  ram_destroy(memory2);
+}
+
+
+//
+// bigint: summing and incrementing a counter that fits in 62 bits
+// (unboxed, no allocation) vs one that doesn't (a RAM_BIGNUM per
+// result)
+//
+static double sum_ints(RAM_INT start, int n, RAM_INT* result)
+{
+  RAM_INT sum = ram_int_copy(start);
+
+  double t = now_seconds();
+  for (int i = 0; i < n; i++) {
+    RAM_INT next = ram_int_add(sum, ram_int_from_i64(i));
+    ram_int_free(sum);
+    sum = next;
+  }
+  double elapsed = now_seconds() - t;
+
+  *result = sum;
+  return elapsed;
+}
+
+static double increment_cell(RAM_INT start, int n)
+{
+  struct RAM* memory = ram_init();
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_BIGINT;
+  v.types.n = start;
+  ram_write_cell_by_name(memory, v, "counter");
+
+  RAM_INT one = ram_int_from_i64(1);
+  double t = now_seconds();
+  for (int i = 0; i < n; i++) {
+    struct RAM_VALUE* counter = ram_read_cell_by_addr(memory, 0);
+    v.types.n = ram_int_add(counter->types.n, one);
+    ram_write_cell_by_addr(memory, v, 0);
+    ram_int_free(v.types.n);
+    ram_free_value(counter);
+  }
+  double elapsed = now_seconds() - t;
+
+  ram_destroy(memory);
+  return elapsed;
+}
+
+static void bench_bigint(void)
+{
+  const int n = 5000000;
+
+  RAM_INT big;
+  ram_int_parse("1180591620717411303424", &big);  // 2^70
+  RAM_INT starts[2] = {ram_int_from_i64(0), big};
+  const char* labels[2] = {"small (62-bit)", "boxed (2^70 + ...)"};
+
+  printf("bigint: %d adds, ns per op\n", n);
+  printf("%-22s %12s %16s\n", "start", "ram_int_add", "read+add+write");
+  for (int k = 0; k < 2; k++) {
+    RAM_INT sum;
+    double add = sum_ints(starts[k], n, &sum);
+    double cell = increment_cell(starts[k], n);
+
+    char* digits = ram_int_to_str(sum);
+    printf("%-22s %12.1f %16.1f   (sum %s)\n", labels[k], add * 1e9 / n, cell * 1e9 / n, digits);
+    free(digits);
+    ram_int_free(sum);
+  }
+  printf("\n");
+
+  ram_int_free(big);
+}
+
+
+//
+// tiny_scripts: a whole run of a script with a handful of
+// variables, in a memory from ram_init() (one allocation) vs
+// ram_init_at() on the stack (none)
+//
+static void tiny_script(struct RAM* memory, int vars)
+{
+  static const char* names[] = {"a", "b", "c", "d", "e", "f", "g", "h",
+                                "i", "j", "k", "l", "m", "n", "o", "p"};
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+
+  for (int i = 0; i < vars; i++) {
+    v.types.i = i;
+    ram_write_cell_by_name(memory, v, (char*) names[i]);
+  }
+  for (int i = 0; i < vars; i++) {
+    struct RAM_VALUE* value = ram_read_cell_by_name(memory, (char*) names[i]);
+    ram_free_value(value);
+  }
+}
+
+static void bench_tiny_scripts(void)
+{
+  const int runs = 1000000;
+  int sizes[] = {0, 4, 16};
+
+  printf("tiny_scripts: %d runs, ns per run\n", runs);
+  printf("%-22s %12s %12s\n", "variables", "ram_init", "ram_init_at");
+  for (int s = 0; s < 3; s++) {
+    double start = now_seconds();
+    for (int r = 0; r < runs; r++) {
+      struct RAM* memory = ram_init();
+      tiny_script(memory, sizes[s]);
+      ram_destroy(memory);
+    }
+    double heap = now_seconds() - start;
+
+    start = now_seconds();
+    for (int r = 0; r < runs; r++) {
+      struct RAM storage;
+      struct RAM* memory = ram_init_at(&storage);
+      tiny_script(memory, sizes[s]);
+      ram_destroy(memory);
+    }
+    double stack = now_seconds() - start;
+
+    printf("%-22d %12.1f %12.1f\n", sizes[s], heap * 1e9 / runs, stack * 1e9 / runs);
+  }
+  printf("\n");
+}
+
+
+static struct BENCHMARK benchmarks[] = {
+  {"arena_scaling", bench_arena_scaling},
+  {"trace_overhead", bench_trace_overhead},
+  {"tail_latency", bench_tail_latency},
+  {"wal_overhead", bench_wal_overhead},
+  {"str_append", bench_str_append},
+  {"core_variants", bench_core_variants},
+  {"dump", bench_dump},
+  {"allocators", bench_allocators},
+  {"bulk_load", bench_bulk_load},
+  {"replication", bench_replication},
+  {"compare", bench_compare},
+  {"bigint", bench_bigint},
+  {"tiny_scripts", bench_tiny_scripts},
+};
+
+
+/**
+  * @brief main()
+  *
+  * runs the benchmarks named on the command line, or all of them
+  *
+  * @return 0 => success, 1 => unknown benchmark name
+  */
+int main(int argc, char* argv[])
+{
+  int num_benchmarks = sizeof(benchmarks) / sizeof(benchmarks[0]);
+
+  if (argc == 1) {
+    for (int b = 0; b < num_benchmarks; b++) {
+      benchmarks[b].run();
+    }
+    return 0;
+  }
+
+  for (int a = 1; a < argc; a++) {
+    bool found = false;
+    for (int b = 0; b < num_benchmarks; b++) {
+      if (strcmp(argv[a], benchmarks[b].name) == 0) {
+        benchmarks[b].run();
+        found = true;
+      }
+    }
+    if (!found) {
+      printf("unknown benchmark '%s', choices are:\n", argv[a]);
+      for (int b = 0; b < num_benchmarks; b++) {
+        printf("  %s\n", benchmarks[b].name);
+      }
+      return 1;
+    }
+  }
+
+  return 0;
+}
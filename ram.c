@@ -17,439 +17,3722 @@
 #include <stdbool.h> // true, false
 #include <string.h>
 #include <assert.h>
+#include <stddef.h> // offsetof
+#include <stdint.h> // uint64_t
 
 #include "ram.h"
+#include "ram_array.h"
+#include "ram_bigint.h"
+#include "ram_alloc.h"
+#include "ram_btree.h"
+#include "ram_trace.h"
+#include "ram_wal.h"
+#include "ram_repl.h"
+#include "ram_hash.h"
+#include "ram_spill.h"
+#include "ram_shm.h"
+#include "ram_bulk.h"
+#include "ram_parallel.h"
+#include "ram_core.h"
+
+//
+// Policies shared with BasicRam (see ram_core.h): names are found
+// and placed in the map with SortedArrayIndex::search() and
+// lower_bound(), and cells grow by RAM_GROWTH.
+//
+typedef DoublingGrowth RAM_GROWTH;
+
+//
+// Tracing: operations take trace_start() on entry and report
+// trace_event() on exit; both are no-ops unless a trace is
+// attached.
+//
+static uint64_t trace_start(struct RAM* memory)
+{
+  return (memory->trace != NULL) ? ram_trace_clock() : 0;
+}
+
+static void trace_event(struct RAM* memory, int op, int address, const char* varname, uint64_t start)
+{
+  if (memory->trace != NULL)
+    ram_trace_record(memory->trace, op, address, (varname != NULL) ? ram_trace_name_id(varname) : 0, start);
+}
+
+//
+// Write-ahead log: changes are logged once they have been made,
+// and a checkpoint is taken when the log asks for one. The same
+// changes go to the replication stream.
+//
+static void wal_event(struct RAM* memory, int kind, int address, const char* varname, struct RAM_VALUE* value)
+{
+  if (memory->repl != NULL)
+    ram_repl_log(memory->repl, kind, address, varname, value, memory->size);
+
+  if (memory->wal != NULL && ram_wal_log(memory->wal, kind, address, varname, value))
+    ram_wal_checkpoint(memory);
+}
+
+static void wal_append_event(struct RAM* memory, int address, const char* s, int len)
+{
+  if (memory->repl != NULL)
+    ram_repl_log_append(memory->repl, address, s, len);
+
+  if (memory->wal != NULL && ram_wal_log_append(memory->wal, address, s, len))
+    ram_wal_checkpoint(memory);
+}
+
+//
+// Content hash (see ram_hash.h): changes are only marked here,
+// and hashed the next time a hash is asked for.
+//
+static void hash_insert(struct RAM* memory, int address, const char* varname)
+{
+  if (memory->hash != NULL)
+    ram_hash_insert(memory->hash, address, varname);
+}
+
+static void hash_touch(struct RAM* memory, int address)
+{
+  if (memory->hash != NULL)
+    ram_hash_touch(memory->hash, address);
+}
+
+// a visitor may have changed any cell in place:
+static void hash_touch_all(struct RAM* memory)
+{
+  if (memory->hash != NULL)
+    ram_hash_touch_all(memory->hash);
+}
 
 /**
- * @brief double_memory:
- * 
- * when size >= capacity, doubles capcity of RAM
- * 
+ * @brief grow_inline:
+ *
+ * grows memory's cells or map to memory->capacity elements; while
+ * they fit in the inline array inside struct RAM nothing moves,
+ * and the first growth past it copies them to the heap
+ *
  * @param memory
- * 
+ * @param array memory->cells or memory->map
+ * @param inline_array the matching inline array
+ * @param elem size of an element
+ * @param old_capacity # of elements in use so far
+ *
+ * @return the grown array
+ */
+static void* grow_inline(struct RAM* memory, void* array, void* inline_array, size_t elem, int old_capacity)
+{
+  if (array != inline_array)
+    return ram_mem_realloc(memory->arena, array, memory->capacity * elem);
+  if (memory->capacity <= RAM_INLINE_CELLS)
+    return array;
+
+  void* heap = ram_mem_alloc(memory->arena, memory->capacity * elem);
+  memcpy(heap, array, old_capacity * elem);
+  return heap;
+}
+
+/**
+ * @brief grow_memory:
+ *
+ * grows capacity of RAM to exactly capacity cells
+ *
+ * @param memory
+ * @param capacity new capacity, > memory->capacity
+ *
  * @return void
  */
-static void double_memory(struct RAM* memory) 
+static void grow_memory(struct RAM* memory, int capacity)
 {
+  uint64_t start = trace_start(memory);
   int old_capacity = memory->capacity;
-  memory->capacity = memory->capacity * 2;
+  memory->capacity = capacity;
 
-  memory->cells = (struct RAM_VALUE*) realloc(memory->cells, memory->capacity * sizeof(struct RAM_VALUE));
-  memory->map = (struct RAM_MAP*) realloc(memory->map, memory->capacity * sizeof(struct RAM_MAP));
+  memory->cells = (struct RAM_VALUE*) grow_inline(memory, memory->cells, memory->inline_cells, sizeof(struct RAM_VALUE), old_capacity);
+  memory->map = (struct RAM_MAP*) grow_inline(memory, memory->map, memory->inline_map, sizeof(struct RAM_MAP), old_capacity);
 
   for(int i = old_capacity; i < memory->capacity; i++) {
     memory->map[i].varname = NULL;
     memory->cells[i].value_type = RAM_TYPE_NONE;
   }
 
+  // new addresses are past the re-laid-out range, so only the
+  // access counters need to grow:
+  if (memory->hits != NULL) {
+    memory->hits = (unsigned int*) ram_mem_realloc(memory->arena, memory->hits, memory->capacity * sizeof(unsigned int));
+    memset(memory->hits + old_capacity, 0, (memory->capacity - old_capacity) * sizeof(unsigned int));
+  }
+  if (memory->ropes != NULL) {
+    memory->ropes = (struct RAM_ROPE**) ram_mem_realloc(memory->arena, memory->ropes, memory->capacity * sizeof(struct RAM_ROPE*));
+    memset(memory->ropes + old_capacity, 0, (memory->capacity - old_capacity) * sizeof(struct RAM_ROPE*));
+  }
+  if (memory->spill != NULL)
+    ram_spill_resize(memory->spill, memory->capacity);
+
+  trace_event(memory, RAM_TRACE_GROW, memory->capacity, NULL, start);
   return;
 }
 
+/**
+ * @brief double_memory:
+ * 
+ * when size >= capacity, grows capacity of RAM by RAM_GROWTH
+ * 
+ * @param memory
+ * 
+ * @return void
+ */
+static void double_memory(struct RAM* memory) 
+{
+  grow_memory(memory, RAM_GROWTH::next_capacity(memory->capacity));
+}
+
 //
-// Public functions:
+// Cell layout:
+//
+// Normally address i is stored in cells[i]. After
+// ram_optimize_layout(), addresses 0..num-1 are permuted so the
+// most accessed cells sit next to each other at the front of
+// cells[]; slot_of and addr_of translate between the two.
+// Addresses >= num are never moved.
+//
+struct RAM_LAYOUT
+{
+  int* slot_of;  // cells[] index holding each address
+  int* addr_of;  // address held in each cells[] index
+  int  num;      // # of addresses covered by the tables
+};
+
+static struct RAM_VALUE* cell_ptr(struct RAM* memory, int address)
+{
+  struct RAM_LAYOUT* layout = memory->layout;
+
+  if (layout != NULL && address < layout->num)
+    return &memory->cells[layout->slot_of[address]];
+
+  return &memory->cells[address];
+}
+
+static int slot_addr(struct RAM* memory, int slot)
+{
+  struct RAM_LAYOUT* layout = memory->layout;
+
+  if (layout != NULL && slot < layout->num)
+    return layout->addr_of[slot];
+
+  return slot;
+}
+
+static void count_access(struct RAM* memory, int address)
+{
+  if (memory->hits != NULL)
+    memory->hits[address]++;
+}
+
+static void free_layout(struct RAM* memory)
+{
+  if (memory->layout == NULL)
+    return;
+
+  ram_mem_free(memory->arena, memory->layout->slot_of);
+  ram_mem_free(memory->arena, memory->layout->addr_of);
+  ram_mem_free(memory->arena, memory->layout);
+  memory->layout = NULL;
+}
+
+//
+// Name index:
+//
+// ram_get_addr() binary searches the map, which costs a cache
+// miss on map[mid] plus another on its varname at every level.
+// Once memory holds enough vars, lookups use a copy of the map in
+// Eytzinger (BFS) order instead: the root is keys[1] and the
+// children of keys[k] are keys[2k] and keys[2k+1], so the next
+// few levels can be prefetched while the current one is compared.
+// Each key holds the first 8 chars of the name as a big-endian
+// integer, so most comparisons never touch the string.
+//
+// The map stays the sorted source of truth (for ram_print and
+// friends); the index is rebuilt from it lazily after the map
+// changes, once lookups outnumber inserts.
+//
+#define RAM_INDEX_MIN_SIZE  32   // smaller memories just use the map
+#define RAM_INDEX_REBUILD   8    // lookups on a stale index before rebuild
+
+struct RAM_NAME_KEY
+{
+  uint64_t prefix;  // first 8 chars, big-endian, '\0' padded
+  int      len;     // strlen(varname)
+  int      pos;     // index of the name in memory->map
+};
+
+struct RAM_INDEX
+{
+  void*                block;     // allocation holding keys
+  struct RAM_NAME_KEY* keys;      // keys[1..num], cache line aligned
+  int                  capacity;  // # of keys block has room for
+  int                  num;       // # of keys, 0 if out of date
+  int                  stale;     // lookups since the map changed
+};
+
+static uint64_t name_prefix(const char* name, int len)
+{
+  uint64_t prefix = 0;
+
+  for (int i = 0; i < 8; i++) {
+    prefix <<= 8;
+    if (i < len)
+      prefix |= (unsigned char) name[i];
+  }
+
+  return prefix;
+}
+
+//
+// compares name to the name of key, like strcmp():
+//
+static int key_compare(struct RAM* memory, const char* name, uint64_t prefix, int len, struct RAM_NAME_KEY* key)
+{
+  if (prefix != key->prefix)
+    return (prefix < key->prefix) ? -1 : 1;
+
+  // same first 8 chars; if either is shorter than that, so is
+  // the other, and they are the same name:
+  if (len < 8 || key->len < 8)
+    return 0;
+
+  return strcmp(name + 8, memory->map[key->pos].varname + 8);
+}
+
+//
+// fills keys[k] and its subtree, in order, from map[pos...];
+// returns the next map position
+//
+static int index_fill(struct RAM* memory, struct RAM_NAME_KEY* keys, int k, int pos)
+{
+  if (k > memory->size)
+    return pos;
+
+  pos = index_fill(memory, keys, 2 * k, pos);
+
+  char* name = memory->map[pos].varname;
+  keys[k].len = (int) strlen(name);
+  keys[k].prefix = name_prefix(name, keys[k].len);
+  keys[k].pos = pos;
+  pos++;
+
+  return index_fill(memory, keys, 2 * k + 1, pos);
+}
+
+static void index_rebuild(struct RAM* memory)
+{
+  struct RAM_INDEX* index = memory->index;
+  int n = memory->size;
+
+  if (index->capacity < n) {
+    // keys[0] is unused, plus slack to align keys to 64 bytes:
+    ram_mem_free(memory->arena, index->block);
+    index->capacity = (n > 2 * index->capacity) ? n : 2 * index->capacity;
+    index->block = ram_mem_alloc(memory->arena, (index->capacity + 1) * sizeof(struct RAM_NAME_KEY) + 64);
+
+    uintptr_t aligned = ((uintptr_t) index->block + 63) & ~(uintptr_t) 63;
+    index->keys = (struct RAM_NAME_KEY*) aligned;
+  }
+
+  index_fill(memory, index->keys, 1, 0);
+  index->num = n;
+  index->stale = 0;
+}
+
+static void index_invalidate(struct RAM* memory)
+{
+  if (memory->index != NULL) {
+    memory->index->num = 0;
+    memory->index->stale = 0;
+  }
+}
+
+static void free_index(struct RAM* memory)
+{
+  if (memory->index == NULL)
+    return;
+
+  ram_mem_free(memory->arena, memory->index->block);
+  ram_mem_free(memory->arena, memory->index);
+  memory->index = NULL;
+}
+
 //
+// returns the index to search, building or rebuilding it if it
+// is worth it, or NULL to search the map instead
+//
+static struct RAM_INDEX* index_for_lookup(struct RAM* memory)
+{
+  if (memory->size < RAM_INDEX_MIN_SIZE || memory->btree != NULL)
+    return NULL;
+
+  struct RAM_INDEX* index = memory->index;
+
+  if (index == NULL) {
+    index = (struct RAM_INDEX*) ram_mem_alloc(memory->arena, sizeof(struct RAM_INDEX));
+    index->block = NULL;
+    index->keys = NULL;
+    index->capacity = 0;
+    index->num = 0;
+    index->stale = RAM_INDEX_REBUILD;
+    memory->index = index;
+  }
+
+  if (index->num == 0) {
+    if (index->stale < RAM_INDEX_REBUILD) {
+      index->stale++;
+      return NULL;
+    }
+    index_rebuild(memory);
+  }
+
+  return index;
+}
+
+static int index_search(struct RAM* memory, struct RAM_INDEX* index, char* varname)
+{
+  struct RAM_NAME_KEY* keys = index->keys;
+  int n = index->num;
+  int len = (int) strlen(varname);
+  uint64_t prefix = name_prefix(varname, len);
+
+  // descend to a leaf, remembering each turn in the bits of k;
+  // keys[4k..4k+3] are the grandchildren of keys[k] and share a
+  // cache line, so fetch them while keys[k] is compared:
+  int k = 1;
+  while (k <= n) {
+    __builtin_prefetch(keys + 4 * k);
+    k = 2 * k + (key_compare(memory, varname, prefix, len, &keys[k]) > 0);
+  }
+
+  // the last left turn was at the first key >= varname:
+  k >>= __builtin_ffs(~k);
+  if (k == 0 || key_compare(memory, varname, prefix, len, &keys[k]) != 0)
+    return -1;
+
+  return memory->map[keys[k].pos].cell;
+}
+
+//
+// Heap footprint counters, kept up to date on every allocation
+// and free so ram_memory_usage() is O(1). Relaxed atomics let a
+// monitoring thread poll them while the interpreter runs.
+//
+static void count_bytes(long* counter, long delta)
+{
+  __atomic_fetch_add(counter, delta, __ATOMIC_RELAXED);
+}
+
+static int str_bucket(long len)
+{
+  if (len < 16)
+    return 0;
+  else if (len < 64)
+    return 1;
+  else if (len < 256)
+    return 2;
+  else if (len < 4096)
+    return 3;
+  else
+    return 4;
+}
 
 /**
-  * @brief ram_init: initialize memory unit
-  *
-  * Returns a pointer to a dynamically-allocated memory
-  * for storing nuPython variables and their values. All
-  * memory cells are initialized to the value None. You
-  * take ownership of the returned memory and must call
-  * ram_destroy() when you are done.
-  *
-  * @return pointer to struct denoting memory unit
-  */
-struct RAM* ram_init(void)
+ * @brief count_str:
+ *
+ * records a string value buffer being allocated (sign = 1) or
+ * freed (sign = -1)
+ *
+ * @param memory
+ * @param len length of the string
+ * @param bytes size of the buffer holding it
+ * @param sign 1 or -1
+ *
+ * @return void
+ */
+static void count_str(struct RAM* memory, long len, long bytes, int sign)
 {
-  struct RAM* memory = (struct RAM*) malloc(sizeof(struct RAM));
-  memory->size = 0;
-  memory->capacity = 4;
-  memory->cells = (struct RAM_VALUE*) malloc(memory->capacity * sizeof(struct RAM_VALUE));
-  memory->map = (struct RAM_MAP*) malloc(memory->capacity * sizeof(RAM_MAP));
+  int b = str_bucket(len);
+  count_bytes(&memory->footprint.str_count[b], sign);
+  count_bytes(&memory->footprint.str_bytes[b], sign * bytes);
+}
 
-  for (int i = 0; i < memory->capacity; i++) {
-    memory->map[i].varname = NULL;
-    memory->cells[i].value_type = RAM_TYPE_NONE;
+static long array_bytes(struct RAM_ARRAY* array)
+{
+  long elem = (array->elem_type == RAM_TYPE_INT) ? sizeof(int) : sizeof(double);
+  return (long) sizeof(struct RAM_ARRAY) + array->length * elem;
+}
+
+//
+// String values:
+//
+// Every string memory hands out or stores in a cell is preceded
+// by a RAM_STR header with its length and the # of chars its
+// buffer can hold, so its length never needs strlen and it may
+// contain '\0' chars. A cell's own buffer is sized in 16-byte
+// steps, so overwriting a string with one of about the same
+// length reuses the buffer in place. The chars are always
+// followed by a '\0' for callers that treat them as C strings.
+//
+struct RAM_STR
+{
+  int capacity;  // # of chars the buffer can hold, not counting the '\0'
+  int len;       // # of chars in the string
+};
+
+static struct RAM_STR* str_header(const char* s)
+{
+  return ((struct RAM_STR*) s) - 1;
+}
+
+static long str_buffer_bytes(int capacity)
+{
+  return (long) sizeof(struct RAM_STR) + capacity + 1;
+}
+
+/**
+ * @brief str_alloc:
+ *
+ * allocates a string buffer holding a copy of s[0..len)
+ *
+ * @param arena where to allocate
+ * @param s chars to copy
+ * @param len # of chars
+ * @param capacity # of chars the buffer should hold, >= len
+ *
+ * @return the chars of the new buffer
+ */
+static char* str_alloc(struct RAM_ARENA* arena, const char* s, int len, int capacity)
+{
+  struct RAM_STR* header = (struct RAM_STR*) ram_mem_alloc(arena, str_buffer_bytes(capacity));
+  header->capacity = capacity;
+  header->len = len;
+
+  char* chars = (char*) (header + 1);
+  memcpy(chars, s, len);
+  chars[len] = '\0';
+
+  return chars;
+}
+
+//
+// a cell's buffer for len chars, rounded up to a multiple of 16
+// bytes:
+//
+static int str_capacity(int len)
+{
+  long bytes = (str_buffer_bytes(len) + 15) & ~15L;
+  return (int) (bytes - sizeof(struct RAM_STR) - 1);
+}
+
+//
+// whether a cell's buffer can take len chars in place, without
+// keeping a large buffer alive for a much shorter string:
+//
+static bool str_fits(const char* s, int len)
+{
+  int capacity = str_header(s)->capacity;
+  return len <= capacity && capacity <= 2 * len + 32;
+}
+
+//
+// String interning:
+//
+// When interning is enabled, every string value stored in a cell
+// points into a refcounted RAM_ISTR buffer owned by the intern
+// table, so equal strings share one copy. The header lives right
+// before the characters, so the cell still holds a plain char*.
+//
+struct RAM_ISTR
+{
+  struct RAM_ISTR* next;  // next entry in the same hash bucket
+  unsigned int hash;      // hash of the characters
+  int refs;               // # of cells pointing at this string
+  struct RAM_STR str;     // length, right before the characters
+};
+
+struct RAM_INTERN
+{
+  struct RAM_ARENA* arena;    // where entries are allocated
+  struct RAM_ISTR** buckets;  // hash table of chains
+  int num_buckets;            // always a power of 2
+  int num_strings;            // # of distinct strings in the table
+  long lookups;               // # of strings stored through the table
+  long hits;                  // # of stores that found an equal string
+  long bytes_saved;           // bytes not allocated thanks to hits
+};
+
+static char* istr_chars(struct RAM_ISTR* entry)
+{
+  return (char*) (entry + 1);
+}
+
+static struct RAM_ISTR* istr_header(char* s)
+{
+  return ((struct RAM_ISTR*) s) - 1;
+}
+
+/**
+ * @brief str_hash:
+ *
+ * FNV-1a hash of a string
+ *
+ * @param s string to hash
+ * @param len # of chars in s
+ *
+ * @return hash value
+ */
+static unsigned int str_hash(const char* s, int len)
+{
+  unsigned int h = 2166136261u;
+
+  for (int i = 0; i < len; i++) {
+    h = (h ^ (unsigned char) s[i]) * 16777619u;
   }
 
-  return memory;
+  return h;
 }
 
+/**
+ * @brief intern_grow:
+ *
+ * doubles the # of buckets once the table is full
+ *
+ * @param table
+ *
+ * @return void
+ */
+static void intern_grow(struct RAM_INTERN* table)
+{
+  int num_buckets = table->num_buckets * 2;
+  struct RAM_ISTR** buckets = (struct RAM_ISTR**) ram_mem_alloc(table->arena, num_buckets * sizeof(struct RAM_ISTR*));
+  memset(buckets, 0, num_buckets * sizeof(struct RAM_ISTR*));
+
+  for (int b = 0; b < table->num_buckets; b++) {
+    struct RAM_ISTR* entry = table->buckets[b];
+    while (entry != NULL) {
+      struct RAM_ISTR* next = entry->next;
+      int slot = entry->hash & (num_buckets - 1);
+      entry->next = buckets[slot];
+      buckets[slot] = entry;
+      entry = next;
+    }
+  }
+
+  ram_mem_free(table->arena, table->buckets);
+  table->buckets = buckets;
+  table->num_buckets = num_buckets;
+
+  return;
+}
 
 /**
-  * @brief ram_destroy: frees memory associated with memory unit
-  * 
-  * Frees the dynamically-allocated memory associated with
-  * the given memory. After the call returns, you cannot
-  * use the memory.
-  *
-  * @return void
-  */
-void ram_destroy(struct RAM* memory)
+ * @brief intern_acquire:
+ *
+ * returns the shared copy of s, adding it to the table if needed
+ *
+ * @param table
+ * @param s string to intern
+ * @param len # of chars in s
+ * @param added returns true if a new entry was allocated
+ *
+ * @return shared string, owned by the table
+ */
+static char* intern_acquire(struct RAM_INTERN* table, const char* s, int len, bool* added)
 {
-  for(int i=0; i < memory->size; i++) {
-    if(memory->cells[i].value_type == RAM_TYPE_STR && memory->cells[i].types.s != NULL) {
-      free(memory->cells[i].types.s);
+  unsigned int hash = str_hash(s, len);
+
+  table->lookups++;
+
+  int slot = hash & (table->num_buckets - 1);
+  for (struct RAM_ISTR* entry = table->buckets[slot]; entry != NULL; entry = entry->next) {
+    if (entry->hash == hash && entry->str.len == len && memcmp(istr_chars(entry), s, len) == 0) {
+      entry->refs++;
+      table->hits++;
+      table->bytes_saved += len + 1;
+      *added = false;
+      return istr_chars(entry);
     }
-    free(memory->map[i].varname);
   }
-  free(memory->cells);
-  free(memory->map);
-  free(memory);
 
-  return;
+  if (table->num_strings >= table->num_buckets) {
+    intern_grow(table);
+    slot = hash & (table->num_buckets - 1);
+  }
+
+  struct RAM_ISTR* entry = (struct RAM_ISTR*) ram_mem_alloc(table->arena, sizeof(struct RAM_ISTR) + len + 1);
+  entry->hash = hash;
+  entry->refs = 1;
+  entry->str.capacity = len;
+  entry->str.len = len;
+  memcpy(istr_chars(entry), s, len);
+  istr_chars(entry)[len] = '\0';
+
+  entry->next = table->buckets[slot];
+  table->buckets[slot] = entry;
+  table->num_strings++;
+
+  *added = true;
+  return istr_chars(entry);
+}
+
+/**
+ * @brief intern_release:
+ *
+ * drops one reference to a shared string, freeing it at 0
+ *
+ * @param table
+ * @param s string previously returned by intern_acquire
+ *
+ * @return length of the string if its entry was freed, -1 if not
+ */
+static int intern_release(struct RAM_INTERN* table, char* s)
+{
+  struct RAM_ISTR* entry = istr_header(s);
+
+  entry->refs--;
+  if (entry->refs > 0)
+    return -1;
+
+  struct RAM_ISTR** prev = &table->buckets[entry->hash & (table->num_buckets - 1)];
+  while (*prev != entry) {
+    prev = &(*prev)->next;
+  }
+  *prev = entry->next;
+  table->num_strings--;
+
+  int len = entry->str.len;
+  ram_mem_free(table->arena, entry);
+
+  return len;
+}
+
+/**
+ * @brief store_str:
+ *
+ * makes the copy of a string value that a cell will own
+ *
+ * @param memory
+ * @param s string being written
+ * @param len # of chars in s
+ *
+ * @return string to store in the cell
+ */
+static char* store_str(struct RAM* memory, const char* s, int len)
+{
+  if (memory->intern != NULL) {
+    bool added;
+    char* shared = intern_acquire(memory->intern, s, len, &added);
+    if (added)
+      count_str(memory, len, sizeof(struct RAM_ISTR) + len + 1, 1);
+    return shared;
+  }
+
+  int capacity = str_capacity(len);
+  count_str(memory, len, str_buffer_bytes(capacity), 1);
+
+  return str_alloc(memory->arena, s, len, capacity);
+}
+
+/**
+ * @brief free_value:
+ *
+ * releases whatever a value stored by memory owns and sets it
+ * to None
+ *
+ * @param memory
+ * @param cell a cell, or a value moved out of one
+ *
+ * @return void
+ */
+static void free_value(struct RAM* memory, struct RAM_VALUE* cell)
+{
+  if (cell->value_type == RAM_TYPE_STR && cell->types.s != NULL) {
+    if (memory->intern != NULL) {
+      long len = intern_release(memory->intern, cell->types.s);
+      if (len >= 0)
+        count_str(memory, len, sizeof(struct RAM_ISTR) + len + 1, -1);
+    }
+    else {
+      struct RAM_STR* header = str_header(cell->types.s);
+      count_str(memory, header->len, str_buffer_bytes(header->capacity), -1);
+      ram_mem_free(memory->arena, header);
+    }
+  }
+  else if (cell->value_type == RAM_TYPE_INT_ARRAY || cell->value_type == RAM_TYPE_REAL_ARRAY) {
+    count_bytes(&memory->footprint.array_bytes, -array_bytes(cell->types.a));
+    ram_mem_free(memory->arena, cell->types.a);
+  }
+  else if (cell->value_type == RAM_TYPE_BIGINT && ram_int_box(cell->types.n) != NULL) {
+    struct RAM_BIGNUM* b = ram_int_box(cell->types.n);
+    count_bytes(&memory->footprint.bigint_bytes, -ram_bignum_bytes(b));
+    ram_mem_free(memory->arena, b);
+  }
+  cell->value_type = RAM_TYPE_NONE;
+
+  return;
+}
+
+//
+// Appends:
+//
+// ram_append_str functions add to a cell's string in place while
+// its buffer has room. After that, new chars go into a rope of
+// chunks hung off memory->ropes[address]; each new chunk is at
+// least as big as the whole string so far, so building a string
+// of n chars by appends copies O(n) chars. The rope is flattened
+// back into one buffer when a contiguous string is needed: when
+// the string is read, compared, visited, interned or saved by a
+// transaction. Until then memory->cells holds only the chars
+// before the rope.
+//
+struct RAM_CHUNK
+{
+  struct RAM_CHUNK* next;  // next chunk, NULL at the tail
+  int len;                 // # of chars in use
+  int capacity;            // # of chars that fit, chars follow
+};
+
+struct RAM_ROPE
+{
+  struct RAM_CHUNK* head;  // oldest chunk
+  struct RAM_CHUNK* tail;  // chunk being appended to
+  int len;                 // # of chars in all chunks
+};
+
+static char* chunk_chars(struct RAM_CHUNK* chunk)
+{
+  return (char*) (chunk + 1);
+}
+
+static long chunk_bytes(int capacity)
+{
+  return (long) sizeof(struct RAM_CHUNK) + capacity;
+}
+
+static struct RAM_ROPE* rope_at(struct RAM* memory, int address)
+{
+  return (memory->ropes != NULL) ? memory->ropes[address] : NULL;
+}
+
+/**
+ * @brief free_rope:
+ *
+ * drops the chars appended to the cell at address since it was
+ * last flattened
+ *
+ * @param memory
+ * @param address
+ *
+ * @return void
+ */
+static void free_rope(struct RAM* memory, int address)
+{
+  struct RAM_ROPE* rope = rope_at(memory, address);
+  if (rope == NULL)
+    return;
+
+  struct RAM_CHUNK* chunk = rope->head;
+  while (chunk != NULL) {
+    struct RAM_CHUNK* next = chunk->next;
+    count_str(memory, chunk->capacity, chunk_bytes(chunk->capacity), -1);
+    ram_mem_free(memory->arena, chunk);
+    chunk = next;
+  }
+
+  ram_mem_free(memory->arena, rope);
+  memory->ropes[address] = NULL;
+
+  return;
+}
+
+/**
+ * @brief rope_copy:
+ *
+ * copies the whole string in the cell at address, rope and all,
+ * to dest, which must have room for rope_len() chars
+ *
+ * @param memory
+ * @param address cell holding a string
+ * @param dest
+ *
+ * @return # of chars copied
+ */
+static int rope_copy(struct RAM* memory, int address, char* dest)
+{
+  char* base = cell_ptr(memory, address)->types.s;
+  int len = str_header(base)->len;
+  memcpy(dest, base, len);
+
+  struct RAM_ROPE* rope = rope_at(memory, address);
+  for (struct RAM_CHUNK* chunk = (rope != NULL) ? rope->head : NULL; chunk != NULL; chunk = chunk->next) {
+    memcpy(dest + len, chunk_chars(chunk), chunk->len);
+    len += chunk->len;
+  }
+
+  return len;
+}
+
+static int rope_len(struct RAM* memory, int address)
+{
+  struct RAM_ROPE* rope = rope_at(memory, address);
+  int len = str_header(cell_ptr(memory, address)->types.s)->len;
+
+  return (rope != NULL) ? len + rope->len : len;
+}
+
+/**
+ * @brief flatten:
+ *
+ * moves the string in the cell at address, and any chars
+ * appended to it, into one buffer
+ *
+ * @param memory
+ * @param address
+ *
+ * @return void
+ */
+static void flatten(struct RAM* memory, int address)
+{
+  if (rope_at(memory, address) == NULL)
+    return;
+
+  int len = rope_len(memory, address);
+  int capacity = str_capacity(len);
+
+  struct RAM_STR* header = (struct RAM_STR*) ram_mem_alloc(memory->arena, str_buffer_bytes(capacity));
+  header->capacity = capacity;
+  header->len = len;
+  char* s = (char*) (header + 1);
+  rope_copy(memory, address, s);
+  s[len] = '\0';
+  count_str(memory, len, str_buffer_bytes(capacity), 1);
+
+  struct RAM_VALUE* cell = cell_ptr(memory, address);
+  free_value(memory, cell);
+  free_rope(memory, address);
+  cell->value_type = RAM_TYPE_STR;
+  cell->types.s = s;
+
+  return;
+}
+
+/**
+ * @brief rope_append:
+ *
+ * appends s[0..len) to the string in the cell at address, in
+ * place or into its rope
+ *
+ * @param memory
+ * @param address cell holding a string memory owns outright
+ * @param s chars to append
+ * @param len # of chars
+ *
+ * @return void
+ */
+static void rope_append(struct RAM* memory, int address, const char* s, int len)
+{
+  char* base = cell_ptr(memory, address)->types.s;
+  struct RAM_STR* header = str_header(base);
+  struct RAM_ROPE* rope = rope_at(memory, address);
+
+  if (rope == NULL && header->len + len <= header->capacity) {
+    count_str(memory, header->len, str_buffer_bytes(header->capacity), -1);
+    memcpy(base + header->len, s, len);
+    header->len += len;
+    base[header->len] = '\0';
+    count_str(memory, header->len, str_buffer_bytes(header->capacity), 1);
+    return;
+  }
+
+  if (memory->ropes == NULL) {
+    memory->ropes = (struct RAM_ROPE**) ram_mem_alloc(memory->arena, memory->capacity * sizeof(struct RAM_ROPE*));
+    memset(memory->ropes, 0, memory->capacity * sizeof(struct RAM_ROPE*));
+  }
+  if (rope == NULL) {
+    rope = (struct RAM_ROPE*) ram_mem_alloc(memory->arena, sizeof(struct RAM_ROPE));
+    rope->head = NULL;
+    rope->tail = NULL;
+    rope->len = 0;
+    memory->ropes[address] = rope;
+  }
+
+  struct RAM_CHUNK* tail = rope->tail;
+  if (tail == NULL || tail->len + len > tail->capacity) {
+    // double the string's room:
+    int capacity = header->len + rope->len;
+    if (capacity < len)
+      capacity = len;
+    if (capacity < 64)
+      capacity = 64;
+
+    tail = (struct RAM_CHUNK*) ram_mem_alloc(memory->arena, chunk_bytes(capacity));
+    tail->next = NULL;
+    tail->len = 0;
+    tail->capacity = capacity;
+    count_str(memory, capacity, chunk_bytes(capacity), 1);
+
+    if (rope->tail != NULL)
+      rope->tail->next = tail;
+    else
+      rope->head = tail;
+    rope->tail = tail;
+  }
+
+  memcpy(chunk_chars(tail) + tail->len, s, len);
+  tail->len += len;
+  rope->len += len;
+
+  return;
+}
+
+//
+// Spilling:
+//
+// With a spill file (see ram_spill.h), every cell holding a
+// string in the heap is on the file's LRU list: writes, appends
+// and reads of a string move it to the front, and after each of
+// them spill_enforce() moves strings from the back out to the
+// file until memory is within budget. A spilled cell is a
+// RAM_TYPE_STR with types.s NULL; fault_in() brings it back
+// wherever the old code needs the chars.
+//
+static void spill_touch(struct RAM* memory, int address)
+{
+  if (memory->spill != NULL)
+    ram_spill_touch(memory->spill, address);
+}
+
+static void spill_forget(struct RAM* memory, int address)
+{
+  if (memory->spill != NULL)
+    ram_spill_forget(memory->spill, address);
+}
+
+//
+// true if the string of the cell at address is in the spill file:
+//
+static bool is_spilled(struct RAM* memory, int address)
+{
+  return memory->spill != NULL && ram_spill_len(memory->spill, address) >= 0;
+}
+
+/**
+ * @brief fault_in:
+ *
+ * reads the string of the cell at address back from the spill
+ * file, if it is there; on an I/O error the string stays in the
+ * file, and the cell spilled
+ *
+ * @param memory
+ * @param address
+ *
+ * @return true if the cell's string is in the heap now (or it
+ *         holds no string), false on an I/O error
+ */
+static bool fault_in(struct RAM* memory, int address)
+{
+  struct RAM_SPILL* spill = memory->spill;
+  if (spill == NULL)
+    return true;
+
+  int len = ram_spill_len(spill, address);
+  if (len < 0)
+    return true;
+
+  int capacity = str_capacity(len);
+  struct RAM_STR* header = (struct RAM_STR*) ram_mem_alloc(memory->arena, str_buffer_bytes(capacity));
+  header->capacity = capacity;
+  char* s = (char*) (header + 1);
+
+  if (!ram_spill_in(spill, address, s)) {
+    ram_mem_free(memory->arena, header);
+    return false;
+  }
+  header->len = len;
+  s[len] = '\0';
+  count_str(memory, len, str_buffer_bytes(capacity), 1);
+
+  cell_ptr(memory, address)->types.s = s;
+
+  return true;
+}
+
+//
+// makes every string contiguous and in the heap; false if a
+// spilled string could not be read back:
+//
+static bool flatten_all(struct RAM* memory)
+{
+  if (memory->ropes == NULL && memory->spill == NULL)
+    return true;
+
+  bool ok = true;
+  for (int address = 0; address < memory->capacity; address++) {
+    flatten(memory, address);
+    ok = fault_in(memory, address) && ok;
+  }
+  return ok;
+}
+
+/**
+ * @brief spill_enforce:
+ *
+ * spills the least recently used strings until memory is within
+ * its budget, or only the string at keep is left
+ *
+ * @param memory
+ * @param keep address just used, -1 if none
+ *
+ * @return void
+ */
+static void spill_enforce(struct RAM* memory, int keep)
+{
+  struct RAM_SPILL* spill = memory->spill;
+  if (spill == NULL || memory->intern != NULL)
+    return;
+
+  struct RAM_MEMORY_USAGE usage;
+  ram_memory_usage(memory, &usage);
+  long over = usage.total_bytes - ram_spill_budget(spill, -1);
+
+  while (over > 0) {
+    int address = ram_spill_coldest(spill);
+    if (address < 0 || address == keep)
+      break;
+
+    struct RAM_VALUE* cell = cell_ptr(memory, address);
+    if (cell->value_type != RAM_TYPE_STR || cell->types.s == NULL) {
+      ram_spill_forget(spill, address);  // moved into an undo log
+      continue;
+    }
+
+    flatten(memory, address);
+    struct RAM_STR* header = str_header(cell->types.s);
+    long bytes = str_buffer_bytes(header->capacity);
+    if (!ram_spill_out(spill, address, cell->types.s, header->len))
+      break;
+
+    free_value(memory, cell);
+    cell->value_type = RAM_TYPE_STR;
+    cell->types.s = NULL;
+    over -= bytes;
+  }
+
+  return;
+}
+
+//
+// ram_for_each and ram_for_each_sorted read a spilled string back
+// only for its visit, and spill again right after, so a walk
+// never takes memory over its budget:
+//
+static void visit_cell(struct RAM* memory, int address, char* varname, RAM_VISITOR visit, void* arg)
+{
+  bool spilled = is_spilled(memory, address);
+
+  flatten(memory, address);
+  if (!fault_in(memory, address))
+    return;  // skipped, see ram_spill_stats()
+  visit(cell_ptr(memory, address), address, varname, arg);
+
+  if (spilled)
+    spill_enforce(memory, -1);
+}
+
+/**
+ * @brief free_cell:
+ *
+ * releases whatever the cell at address owns and sets it to None
+ *
+ * @param memory
+ * @param address
+ *
+ * @return void
+ */
+static void free_cell(struct RAM* memory, int address)
+{
+  free_rope(memory, address);
+  spill_forget(memory, address);
+  free_value(memory, cell_ptr(memory, address));
+}
+
+//
+// Values returned by the read functions remember the arena they
+// were allocated from, since ram_free_value() is not given the
+// memory they came from.
+//
+struct RAM_VALUE_BOX
+{
+  struct RAM_ARENA* arena;  // arena of the value and its string/array
+  struct RAM_VALUE value;   // the copy handed to the caller
+};
+
+static struct RAM_VALUE_BOX* value_box(struct RAM_VALUE* value)
+{
+  return (struct RAM_VALUE_BOX*) (((char*) value) - offsetof(struct RAM_VALUE_BOX, value));
+}
+
+/**
+ * @brief copy_array:
+ *
+ * duplicates an array into memory's arena
+ *
+ * @param memory
+ * @param array
+ *
+ * @return copy, allocated from memory's arena
+ */
+static struct RAM_ARRAY* copy_array(struct RAM* memory, struct RAM_ARRAY* array)
+{
+  long bytes = array_bytes(array);
+  struct RAM_ARRAY* copy = (struct RAM_ARRAY*) ram_mem_alloc(memory->arena, bytes);
+
+  copy->elem_type = array->elem_type;
+  copy->length = array->length;
+  copy->elems.i = (int*) (copy + 1);
+  memcpy(copy->elems.i, array->elems.i, bytes - sizeof(struct RAM_ARRAY));
+
+  return copy;
+}
+
+/**
+ * @brief copy_bignum:
+ *
+ * duplicates a big int's RAM_BIGNUM into memory's arena; a small
+ * int needs no copy
+ *
+ * @param memory
+ * @param n
+ *
+ * @return copy, allocated from memory's arena if not small
+ */
+static RAM_INT copy_bignum(struct RAM* memory, RAM_INT n)
+{
+  struct RAM_BIGNUM* b = ram_int_box(n);
+  if (b == NULL)
+    return n;
+
+  struct RAM_BIGNUM* copy = (struct RAM_BIGNUM*) ram_mem_alloc(memory->arena, ram_bignum_bytes(b));
+  memcpy(copy, b, ram_bignum_bytes(b));
+
+  return (RAM_INT) (intptr_t) copy;
+}
+
+/**
+ * @brief copy_value:
+ *
+ * allocates a copy of the value in the cell at address, as
+ * returned by the read functions
+ *
+ * @param memory
+ * @param address valid address
+ *
+ * @return pointer to copy, caller frees with ram_free_value; NULL
+ *         if its string can't be read back from the spill file
+ */
+static struct RAM_VALUE* copy_value(struct RAM* memory, int address)
+{
+  flatten(memory, address);
+  if (!fault_in(memory, address))
+    return NULL;
+  struct RAM_VALUE* cell = cell_ptr(memory, address);
+  count_access(memory, address);
+
+  struct RAM_VALUE_BOX* box = (struct RAM_VALUE_BOX*) ram_mem_alloc(memory->arena, sizeof(struct RAM_VALUE_BOX));
+  box->arena = memory->arena;
+
+  struct RAM_VALUE* copy = &box->value;
+
+  copy->value_type = cell->value_type;
+
+  if (cell->value_type == RAM_TYPE_STR) {
+    int len = str_header(cell->types.s)->len;
+    copy->types.s = str_alloc(memory->arena, cell->types.s, len, len);
+    spill_touch(memory, address);
+    spill_enforce(memory, address);
+  }
+  else if (cell->value_type == RAM_TYPE_REAL) {
+    copy->types.d = cell->types.d;
+  }
+  else if (cell->value_type == RAM_TYPE_INT_ARRAY || cell->value_type == RAM_TYPE_REAL_ARRAY) {
+    copy->types.a = copy_array(memory, cell->types.a);
+  }
+  else if (cell->value_type == RAM_TYPE_BIGINT) {
+    copy->types.n = copy_bignum(memory, cell->types.n);
+  }
+  else {
+    copy->types.i = cell->types.i;
+  }
+
+  return copy;
+}
+
+//
+// Shared constants (see ram_shm.h): names memory lacks fall
+// through to memory->shared.
+//
+
+/**
+ * @brief copy_shared:
+ *
+ * like copy_value, for the constant named varname
+ *
+ * @return the copy, NULL if there is no such constant
+ */
+static struct RAM_VALUE* copy_shared(struct RAM* memory, const char* varname)
+{
+  struct RAM_SHM_CELL shared;
+  if (memory->shared == NULL || !ram_shm_find(memory->shared, varname, &shared))
+    return NULL;
+
+  struct RAM_VALUE_BOX* box = (struct RAM_VALUE_BOX*) ram_mem_alloc(memory->arena, sizeof(struct RAM_VALUE_BOX));
+  box->arena = memory->arena;
+
+  struct RAM_VALUE* copy = &box->value;
+  *copy = shared.value;
+
+  if (shared.value.value_type == RAM_TYPE_STR)
+    copy->types.s = str_alloc(memory->arena, shared.value.types.s, shared.len, shared.len);
+  else if (shared.value.value_type == RAM_TYPE_INT_ARRAY || shared.value.value_type == RAM_TYPE_REAL_ARRAY)
+    copy->types.a = copy_array(memory, shared.value.types.a);
+  else if (shared.value.value_type == RAM_TYPE_BIGINT)
+    copy->types.n = copy_bignum(memory, shared.value.types.n);
+
+  return copy;
+}
+
+//
+// Transactions:
+//
+// While a transaction is open, the first write to a cell moves
+// the cell's old value (and whatever it owns) into the undo log
+// instead of freeing it, and each new variable adds an insert
+// record. Rollback replays the log backwards; commit frees the
+// saved values. A cell counts as touched when its stamp equals
+// the current epoch, and every begin starts a new epoch so nested
+// transactions save their own prior values.
+//
+enum RAM_UNDO_KINDS
+{
+  UNDO_WRITE = 0,  // cell at address held prior
+  UNDO_INSERT      // variable at map index was created at address
+};
+
+struct RAM_UNDO
+{
+  int kind;                // enum RAM_UNDO_KINDS
+  int address;             // cell address
+  int index;               // map index (UNDO_INSERT)
+  struct RAM_VALUE prior;  // old value (UNDO_WRITE), owned by the log
+};
+
+struct RAM_TXN
+{
+  struct RAM_UNDO* log;  // undo records, oldest first
+  int count;             // # of records in log
+  int capacity;          // # of records log can hold
+  int* marks;            // log count at each open begin
+  int depth;             // # of open transactions
+  int marks_capacity;    // # of marks that fit
+  unsigned int* stamps;  // epoch at which each cell was last saved
+  int num_stamps;        // # of cells with a stamp
+  unsigned int epoch;    // current epoch, never 0
+};
+
+/**
+ * @brief txn_append:
+ *
+ * adds a record to the undo log
+ *
+ * @param memory
+ * @param record
+ *
+ * @return void
+ */
+static void txn_append(struct RAM* memory, struct RAM_UNDO record)
+{
+  struct RAM_TXN* txn = memory->txn;
+
+  if (txn->count >= txn->capacity) {
+    txn->capacity = txn->capacity * 2;
+    txn->log = (struct RAM_UNDO*) ram_mem_realloc(memory->arena, txn->log, txn->capacity * sizeof(struct RAM_UNDO));
+  }
+
+  txn->log[txn->count] = record;
+  txn->count++;
+
+  return;
+}
+
+/**
+ * @brief txn_save_cell:
+ *
+ * called before a cell is overwritten; if a transaction is open
+ * and the cell has not been saved in this epoch, moves its value
+ * into the undo log and sets the cell to None
+ *
+ * @param memory
+ * @param address
+ *
+ * @return false if its spilled string could not be read back to
+ *         be saved, true otherwise
+ */
+static bool txn_save_cell(struct RAM* memory, int address)
+{
+  struct RAM_TXN* txn = memory->txn;
+
+  if (txn == NULL || txn->depth == 0)
+    return true;
+
+  if (address >= txn->num_stamps) {
+    int num_stamps = memory->capacity;
+    txn->stamps = (unsigned int*) ram_mem_realloc(memory->arena, txn->stamps, num_stamps * sizeof(unsigned int));
+    for (int i = txn->num_stamps; i < num_stamps; i++) {
+      txn->stamps[i] = 0;
+    }
+    txn->num_stamps = num_stamps;
+  }
+
+  if (txn->stamps[address] == txn->epoch)
+    return true;
+
+  flatten(memory, address);
+  if (!fault_in(memory, address))
+    return false;
+  txn->stamps[address] = txn->epoch;
+
+  struct RAM_UNDO record;
+  record.kind = UNDO_WRITE;
+  record.address = address;
+  record.index = -1;
+  record.prior = *cell_ptr(memory, address);
+  txn_append(memory, record);
+
+  cell_ptr(memory, address)->value_type = RAM_TYPE_NONE;
+
+  return true;
+}
+
+/**
+ * @brief txn_log_insert:
+ *
+ * records that a new variable was created, if a transaction is open
+ *
+ * @param memory
+ * @param index map index of the new variable
+ * @param address cell of the new variable
+ *
+ * @return void
+ */
+static void txn_log_insert(struct RAM* memory, int index, int address)
+{
+  struct RAM_TXN* txn = memory->txn;
+
+  if (txn == NULL || txn->depth == 0)
+    return;
+
+  struct RAM_UNDO record;
+  record.kind = UNDO_INSERT;
+  record.address = address;
+  record.index = index;
+  record.prior.value_type = RAM_TYPE_NONE;
+  txn_append(memory, record);
+
+  return;
+}
+
+/**
+ * @brief txn_undo:
+ *
+ * undoes the log records from the end back to position mark
+ *
+ * @param memory
+ * @param mark log position to roll back to
+ *
+ * @return void
+ */
+static void txn_undo(struct RAM* memory, int mark)
+{
+  struct RAM_TXN* txn = memory->txn;
+
+  while (txn->count > mark) {
+    txn->count--;
+    struct RAM_UNDO* record = &txn->log[txn->count];
+
+    if (record->kind == UNDO_WRITE) {
+      free_cell(memory, record->address);
+      *cell_ptr(memory, record->address) = record->prior;
+      hash_touch(memory, record->address);
+    }
+    else {
+      // later inserts are already undone, so the map looks just
+      // like it did right after this insert:
+      free_cell(memory, record->address);
+      if (memory->hash != NULL)
+        ram_hash_remove(memory->hash, record->address);
+
+      index_invalidate(memory);
+      if (memory->btree != NULL)
+        ram_btree_remove(memory->btree, memory->map[record->index].varname);
+      count_bytes(&memory->footprint.name_bytes, -(long) (strlen(memory->map[record->index].varname) + 1));
+      ram_mem_free(memory->arena, memory->map[record->index].varname);
+
+      for (int i = record->index; i < memory->size - 1; i++) {
+        memory->map[i] = memory->map[i + 1];
+      }
+      memory->size--;
+      memory->map[memory->size].varname = NULL;
+    }
+  }
+
+  return;
+}
+
+/**
+ * @brief txn_discard:
+ *
+ * frees the saved values in the log from position mark to the
+ * end, and drops those records
+ *
+ * @param memory
+ * @param mark log position to keep
+ *
+ * @return void
+ */
+static void txn_discard(struct RAM* memory, int mark)
+{
+  struct RAM_TXN* txn = memory->txn;
+
+  for (int i = mark; i < txn->count; i++) {
+    if (txn->log[i].kind == UNDO_WRITE)
+      free_value(memory, &txn->log[i].prior);
+  }
+  txn->count = mark;
+
+  return;
+}
+
+/**
+ * @brief init_memory:
+ *
+ * initializes a memory unit whose allocations all come from arena
+ * (NULL => malloc), in the given storage or, if NULL, in one
+ * allocation from arena
+ *
+ * @param arena
+ * @param storage
+ *
+ * @return pointer to struct denoting memory unit
+ */
+static struct RAM* init_memory(struct RAM_ARENA* arena, struct RAM* storage)
+{
+  struct RAM* memory = storage;
+  if (memory == NULL)
+    memory = (struct RAM*) ram_mem_alloc(arena, sizeof(struct RAM));
+  memory->placed = (storage != NULL);
+  memory->arena = arena;
+  memory->size = 0;
+  memory->capacity = RAM_GROWTH::initial;
+  memory->cells = memory->inline_cells;
+  memory->map = memory->inline_map;
+  memory->intern = NULL;
+  memory->txn = NULL;
+  memory->layout = NULL;
+  memory->hits = NULL;
+  memory->ropes = NULL;
+  memory->spill = NULL;
+  memory->shared = NULL;
+  memory->index = NULL;
+  memory->btree = NULL;
+  memory->trace = NULL;
+  memory->wal = NULL;
+  memory->repl = NULL;
+  memory->hash = NULL;
+  memset(&memory->footprint, 0, sizeof(struct RAM_FOOTPRINT));
+
+  for (int i = 0; i < memory->capacity; i++) {
+    memory->map[i].varname = NULL;
+    memory->cells[i].value_type = RAM_TYPE_NONE;
+  }
+
+  return memory;
+}
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_init: initialize memory unit
+  *
+  * Returns a pointer to a dynamically-allocated memory
+  * for storing nuPython variables and their values. All
+  * memory cells are initialized to the value None. You
+  * take ownership of the returned memory and must call
+  * ram_destroy() when you are done.
+  *
+  * @return pointer to struct denoting memory unit
+  */
+struct RAM* ram_init(void)
+{
+  return init_memory(NULL, NULL);
+}
+
+
+/**
+  * @brief ram_init_arena: initialize memory unit with its own arena
+  *
+  * Same as ram_init(), but the memory and everything it allocates
+  * (names, values, and the copies returned by the read functions)
+  * come from a private arena instead of the global malloc. This
+  * avoids allocator contention when many interpreters run on
+  * different threads. The arena is freed once the memory is
+  * destroyed and every value read from it has been freed.
+  *
+  * @param chunk_bytes arena chunk size, or 0 for the default
+  * @return pointer to struct denoting memory unit
+  */
+struct RAM* ram_init_arena(size_t chunk_bytes)
+{
+  return init_memory(ram_arena_create(chunk_bytes), NULL);
+}
+
+
+/**
+  * @brief ram_init_with_allocator: initialize memory unit over a custom allocator
+  *
+  * Objects created on their own and attached to the memory (logs,
+  * traces, replication streams, ...) still use malloc; see ram.h.
+  *
+  * @param allocator hooks to use; copied
+  * @return pointer to struct denoting memory unit
+  */
+struct RAM* ram_init_with_allocator(const struct RAM_ALLOCATOR* allocator)
+{
+  if (allocator == NULL || allocator->alloc == NULL)
+    return NULL;
+
+  return init_memory(ram_arena_create_custom(allocator), NULL);
+}
+
+
+/**
+  * @brief ram_init_at: initialize memory unit in storage you provide
+  *
+  * @param storage where to place the memory
+  * @return storage, as a pointer to struct denoting memory unit
+  */
+struct RAM* ram_init_at(struct RAM* storage)
+{
+  if (storage == NULL)
+    return NULL;
+
+  return init_memory(NULL, storage);
+}
+
+
+/**
+  * @brief ram_destroy: frees memory associated with memory unit
+  * 
+  * Frees the dynamically-allocated memory associated with
+  * the given memory. After the call returns, you cannot
+  * use the memory.
+  *
+  * @return void
+  */
+void ram_destroy(struct RAM* memory)
+{
+  if (memory->txn != NULL) {
+    txn_discard(memory, 0);
+    ram_mem_free(memory->arena, memory->txn->log);
+    ram_mem_free(memory->arena, memory->txn->marks);
+    ram_mem_free(memory->arena, memory->txn->stamps);
+    ram_mem_free(memory->arena, memory->txn);
+  }
+
+  for(int i=0; i < memory->capacity; i++) {
+    free_cell(memory, i);
+  }
+  for(int i=0; i < memory->size; i++) {
+    ram_mem_free(memory->arena, memory->map[i].varname);
+  }
+  if (memory->intern != NULL) {
+    ram_mem_free(memory->arena, memory->intern->buckets);
+    ram_mem_free(memory->arena, memory->intern);
+  }
+  free_layout(memory);
+  free_index(memory);
+  if (memory->btree != NULL) {
+    ram_btree_clear(memory->btree);
+    ram_mem_free(memory->arena, memory->btree);
+  }
+  ram_mem_free(memory->arena, memory->hits);
+  ram_mem_free(memory->arena, memory->ropes);
+  ram_spill_destroy(memory->spill);
+  ram_hash_destroy(memory->hash);
+  if (memory->cells != memory->inline_cells)
+    ram_mem_free(memory->arena, memory->cells);
+  if (memory->map != memory->inline_map)
+    ram_mem_free(memory->arena, memory->map);
+
+  // the arena lives on until values read from memory are freed:
+  struct RAM_ARENA* arena = memory->arena;
+  if (!memory->placed)
+    ram_mem_free(arena, memory);
+  ram_arena_release(arena);
+
+  return;
+}
+
+
+/**
+  * @brief ram_reset: clears memory unit but keeps its capacity
+  *
+  * Frees the variable names and string values stored in the
+  * given memory, and resets every cell to the value None. The
+  * cells and map arrays are kept, so the memory can be reused
+  * for another program without any new allocations until it
+  * grows beyond its current capacity. Whatever is attached or
+  * enabled (log, trace, interning, spilling, ...) stays so, and is
+  * told of the reset; ram_recycle() also turns them off.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_reset(struct RAM* memory)
+{
+  if (memory == NULL)
+    return;
+
+  uint64_t start = trace_start(memory);
+
+  // open transactions are dropped, keeping the log's buffers:
+  if (memory->txn != NULL) {
+    txn_discard(memory, 0);
+    memory->txn->depth = 0;
+  }
+
+  // cells past size can still hold values written by address,
+  // so clear the whole capacity:
+  for (int i = 0; i < memory->capacity; i++) {
+    free_cell(memory, i);
+
+    if (i < memory->size) {
+      ram_mem_free(memory->arena, memory->map[i].varname);
+      memory->map[i].varname = NULL;
+    }
+  }
+  memory->size = 0;
+  count_bytes(&memory->footprint.name_bytes, -memory->footprint.name_bytes);
+  index_invalidate(memory);
+  if (memory->btree != NULL)
+    ram_btree_clear(memory->btree);
+  if (memory->hash != NULL)
+    ram_hash_clear(memory->hash);
+
+  // every cell is None now, so any permutation is the identity:
+  free_layout(memory);
+  if (memory->hits != NULL)
+    memset(memory->hits, 0, memory->capacity * sizeof(unsigned int));
+
+  wal_event(memory, RAM_WAL_RESET, -1, NULL, NULL);
+  trace_event(memory, RAM_TRACE_RESET, -1, NULL, start);
+  return;
+}
+
+
+/**
+  * @brief ram_recycle: clears memory unit for a new owner
+  *
+  * Detaches the trace, write-ahead log, replication stream and
+  * shared constants without telling them about it, clears memory
+  * like ram_reset(), then turns off interning, spilling (removing
+  * the spill file), content hashing, profiling and the B-tree map.
+  * What is left is a memory like a new one from ram_init(), but
+  * with the capacity of its cells, map and undo log kept.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_recycle(struct RAM* memory)
+{
+  if (memory == NULL)
+    return;
+
+  // the old owner's sinks may already be closed:
+  memory->trace = NULL;
+  memory->wal = NULL;
+  memory->repl = NULL;
+  memory->shared = NULL;
+
+  ram_reset(memory);
+
+  // every string was released, so the table is empty:
+  if (memory->intern != NULL) {
+    ram_mem_free(memory->arena, memory->intern->buckets);
+    ram_mem_free(memory->arena, memory->intern);
+    memory->intern = NULL;
+  }
+  if (memory->btree != NULL) {
+    ram_btree_clear(memory->btree);
+    ram_mem_free(memory->arena, memory->btree);
+    memory->btree = NULL;
+  }
+  ram_spill_destroy(memory->spill);
+  memory->spill = NULL;
+  ram_hash_destroy(memory->hash);
+  memory->hash = NULL;
+  ram_mem_free(memory->arena, memory->hits);
+  memory->hits = NULL;
+
+  return;
+}
+
+
+/**
+  * @brief ram_size: # of vars in memory
+  *
+  * Returns the # of variables currently stored in memory.
+  *
+  * @return # of vars in memory
+  */
+int ram_size(struct RAM* memory)
+{
+  return memory->size;
+}
+
+
+/**
+  * @brief ram_capacity: # of cells available in memory
+  *
+  * Returns the # of cells currently available in memory.
+  *
+  * @return # of cells available in memory
+  */
+int ram_capacity(struct RAM* memory)
+{
+  return memory->capacity;
+}
+
+
+/**
+  * @brief ram_get_addr: address of memory cell occupied by variable
+  *
+  * If the given variable (e.g. "x") has been written to 
+  * memory, returns the address of this variable --- an integer
+  * in the range 0..N-1 where N is the number of vars currently 
+  * stored in memory. Returns -1 if no such variable exists 
+  * in memory. 
+  *
+  * NOTE: a variable has to be written to memory before you can
+  * get its address. Once a variable is written to memory, its
+  * address never changes. 
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param varname variable name
+  * @return address of variable or -1 if doesn't exist
+  */
+int ram_get_addr(struct RAM* memory, char* varname)
+{
+  if (memory == NULL || varname == NULL)
+    return -1;
+  
+  if (memory->btree != NULL)
+    return ram_btree_find(memory->btree, varname);
+
+  struct RAM_INDEX* index = index_for_lookup(memory);
+  if (index != NULL)
+    return index_search(memory, index, varname);
+
+  //binary search over the sorted map
+  return SortedArrayIndex::search(memory->map, memory->size, varname);
+}
+
+
+/**
+  * @brief ram_read_cell_by_addr: returns value in memory cell at this address
+  *
+  * Given a memory address (an integer in the range 0..N-1), 
+  * returns a COPY of the value contained in that memory cell.
+  * Returns NULL if the address is not valid, or if its string
+  * can't be read back from the spill file (see ram_spill.h).
+  * 
+  * NOTE: this function allocates memory for the value that
+  * is returned. The caller takes ownership of the copy and 
+  * must eventually free this memory via ram_free_value().
+  *
+  * NOTE: a variable has to be written to memory before its
+  * address becomes valid. Once a variable is written to memory,
+  * its address never changes.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param address memory cell address
+  * @return pointer to struct containing value or NULL if doesn't exist
+  */
+struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address)
+{
+  if (memory == NULL)
+    return NULL;
+
+  uint64_t start = trace_start(memory);
+  struct RAM_VALUE* value = NULL;
+    
+  if(address < memory->size && address >= 0) {
+    value = copy_value(memory, address);
+  }
+
+  trace_event(memory, RAM_TRACE_READ_ADDR, address, NULL, start);
+  return value;
+}
+
+
+/**
+  * @brief ram_read_cell_by_name: returns value in memory cell for this variable
+  *
+  * If the given variable (e.g. "x") has been written to 
+  * memory, returns a COPY of the value contained in memory.
+  * Returns NULL if no such name exists in memory, or if its
+  * string can't be read back from the spill file.
+  *
+  * NOTE: this function allocates memory for the value that
+  * is returned. The caller takes ownership of the copy and 
+  * must eventually free this memory via ram_free_value().
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param varname variable name
+  * @return pointer to struct containing value or NULL if doesn't exist
+  */
+struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* varname)
+{
+  if (memory == NULL)
+    return NULL;
+
+  uint64_t start = trace_start(memory);
+  struct RAM_VALUE* value = NULL;
+
+  int address = ram_get_addr(memory, varname);
+  if (address != -1)
+    value = copy_value(memory, address);
+  else if (memory->shared != NULL)
+    value = copy_shared(memory, varname);
+
+  trace_event(memory, RAM_TRACE_READ_NAME, address, varname, start);
+  return value;
+}
+
+
+/**
+  * @brief ram_free_value: free value returned by read_cell() functions
+  *
+  * Frees the memory value returned by ram_read_cell_by_name and
+  * ram_read_cell_by_addr.
+  *
+  * @param value Pointer to struct containing value
+  * @return void
+  */
+void ram_free_value(struct RAM_VALUE* value)
+{
+  if(value == NULL){
+    return;
+  }
+  struct RAM_VALUE_BOX* box = value_box(value);
+
+  if(value->value_type == RAM_TYPE_STR) {
+    ram_mem_free(box->arena, str_header(value->types.s));
+  }
+  else if (value->value_type == RAM_TYPE_INT_ARRAY || value->value_type == RAM_TYPE_REAL_ARRAY) {
+    ram_mem_free(box->arena, value->types.a);
+  }
+  else if (value->value_type == RAM_TYPE_BIGINT) {
+    ram_mem_free(box->arena, ram_int_box(value->types.n));
+  }
+  ram_mem_free(box->arena, box);
+  return;
+}
+
+
+//
+// ram_write_cell_by_addr without tracing, also used by the other
+// write functions; len is the # of chars of a string value:
+//
+static bool write_by_addr(struct RAM* memory, struct RAM_VALUE value, int len, int address)
+{
+  // if overwriting a string, free the old one
+  if (address < memory->capacity && address >= 0) {
+    if (!txn_save_cell(memory, address))
+      return false;
+    hash_touch(memory, address);
+    free_rope(memory, address);
+    spill_forget(memory, address);
+
+    // a string that fits in the cell's own buffer is copied over
+    // the old one (memmove, value may point into that buffer):
+    struct RAM_VALUE* old = cell_ptr(memory, address);
+    if (value.value_type == RAM_TYPE_STR && old->value_type == RAM_TYPE_STR && old->types.s != NULL
+        && memory->intern == NULL && str_fits(old->types.s, len)) {
+      struct RAM_STR* header = str_header(old->types.s);
+      count_str(memory, header->len, str_buffer_bytes(header->capacity), -1);
+      count_str(memory, len, str_buffer_bytes(header->capacity), 1);
+
+      memmove(old->types.s, value.types.s, len);
+      old->types.s[len] = '\0';
+      header->len = len;
+
+      count_access(memory, address);
+      spill_touch(memory, address);
+      spill_enforce(memory, address);
+      return true;
+    }
+
+    // copy first, value may point at this same cell's string:
+    char* s = NULL;
+    struct RAM_ARRAY* a = NULL;
+    if (value.value_type == RAM_TYPE_STR)
+      s = store_str(memory, value.types.s, len);
+    else if (value.value_type == RAM_TYPE_INT_ARRAY || value.value_type == RAM_TYPE_REAL_ARRAY) {
+      a = copy_array(memory, value.types.a);
+      count_bytes(&memory->footprint.array_bytes, array_bytes(a));
+    }
+    else if (value.value_type == RAM_TYPE_BIGINT) {
+      value.types.n = copy_bignum(memory, value.types.n);
+      if (ram_int_box(value.types.n) != NULL)
+        count_bytes(&memory->footprint.bigint_bytes, ram_bignum_bytes(ram_int_box(value.types.n)));
+    }
+
+    free_cell(memory, address);
+    count_access(memory, address);
+
+    struct RAM_VALUE* cell = cell_ptr(memory, address);
+    cell->value_type = value.value_type;
+
+    if(cell->value_type == RAM_TYPE_STR) {
+      cell->types.s = s;
+      spill_touch(memory, address);
+    }
+    else if (cell->value_type == RAM_TYPE_REAL) {
+      cell->types.d = value.types.d;
+    }
+    else if (a != NULL) {
+      cell->types.a = a;
+    }
+    else if (cell->value_type == RAM_TYPE_BIGINT) {
+      cell->types.n = value.types.n;
+    }
+    else {
+      cell->types.i = value.types.i;
+    }
+
+    spill_enforce(memory, address);
+    return true;
+  }
+  else {
+    return false;
+  }
+}
+
+//
+// ram_write_cell_by_addr, given the length of a string value:
+//
+static bool write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int len, int address)
+{
+  uint64_t start = trace_start(memory);
+  bool success = write_by_addr(memory, value, len, address);
+  if (success)
+    wal_event(memory, RAM_WAL_WRITE_ADDR, address, NULL, cell_ptr(memory, address));
+
+  trace_event(memory, RAM_TRACE_WRITE_ADDR, address, NULL, start);
+  return success;
+}
+
+static int value_len(struct RAM_VALUE* value)
+{
+  return (value->value_type == RAM_TYPE_STR) ? (int) strlen(value->types.s) : 0;
+}
+
+
+/**
+  * @brief ram_write_cell_by_addr: writes a value to memory cell at this address
+  *
+  * Writes the given value to the memory cell at the given 
+  * address. If a value already exists at this address, that
+  * value is overwritten by this new value. Returns true if 
+  * the value was successfully written, false if not (which 
+  * implies the memory address is invalid).
+  *
+  * NOTE: if the value being written is a string or an
+  * array, it will be duplicated and stored.
+  * 
+  * NOTE: a variable has to be written to memory before its
+  * address becomes valid. Once a variable is written to memory,
+  * its address never changes.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param value value to be written to memory
+  * @param address memory cell address
+  * @return true if successful, false if not (invalid address, or
+  *         an open transaction has to save the old value, a string
+  *         in the spill file, and it can't be read back)
+  */
+bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address)
+{
+  if (memory == NULL)
+    return false;
+
+  return write_cell_by_addr(memory, value, value_len(&value), address);
+}
+
+
+//
+// ram_write_cell_by_name, given the length of a string value:
+//
+static bool write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, int len, char* varname)
+{
+  uint64_t start = trace_start(memory);
+
+  // check if var already exists
+  int address = ram_get_addr(memory, varname);
+  if (address != -1) {
+    bool success = write_by_addr(memory, value, len, address);
+    if (success)
+      wal_event(memory, RAM_WAL_WRITE_NAME, address, varname, cell_ptr(memory, address));
+    trace_event(memory, RAM_TRACE_WRITE_NAME, address, varname, start);
+    return success;
+  }
+
+  // Double memory if capacity = size
+  if (memory->size >= memory->capacity) 
+    double_memory(memory);
+
+  int index;
+
+  if (memory->btree != NULL) {
+    // the tree keeps the order, the map is in address order:
+    index = memory->size;
+  }
+  else {
+    // Store var alphabetically, binary search for the spot
+    index = SortedArrayIndex::lower_bound(memory->map, memory->size, varname);
+
+    memmove(&memory->map[index + 1], &memory->map[index], (memory->size - index) * sizeof(struct RAM_MAP));
+  }
+
+  index_invalidate(memory);
+
+  memory->map[index].varname = ram_mem_strdup(memory->arena, varname);
+  count_bytes(&memory->footprint.name_bytes, strlen(varname) + 1);
+  memory->map[index].cell = memory->size;
+
+  if (memory->btree != NULL)
+    ram_btree_insert(memory->btree, memory->map[index].varname, memory->size);
+  hash_insert(memory, memory->size, memory->map[index].varname);
+
+  write_by_addr(memory, value, len, memory->size);
+
+  memory->size++;
+
+  txn_log_insert(memory, index, memory->size - 1);
+
+  wal_event(memory, RAM_WAL_WRITE_NAME, memory->size - 1, varname, cell_ptr(memory, memory->size - 1));
+  trace_event(memory, RAM_TRACE_WRITE_NAME, memory->size - 1, varname, start);
+  return true;
+
+}
+
+/**
+ * @brief private_addr:
+ *
+ * address of varname, first copying it in from the shared
+ * constants if only there, so it can be changed in place
+ *
+ * @return address, -1 if varname is in neither
+ */
+static int private_addr(struct RAM* memory, char* varname)
+{
+  int address = ram_get_addr(memory, varname);
+  if (address != -1 || memory->shared == NULL)
+    return address;
+
+  struct RAM_SHM_CELL shared;
+  if (!ram_shm_find(memory->shared, varname, &shared))
+    return -1;
+
+  write_cell_by_name(memory, shared.value, shared.len, varname);
+  return ram_get_addr(memory, varname);
+}
+
+
+/**
+  * ram_write_cell_by_name
+  *
+  * Writes the given value to a memory cell named by the given
+  * variable. If a memory cell already exists with this name,
+  * the existing value is overwritten by this new value. Returns
+  * true unless an open transaction has to save the old value, a
+  * string in the spill file, and it can't be read back.
+  *
+  * NOTE: if the value being written is a string or an
+  * array, it will be duplicated and stored.
+  *
+  * NOTE: a variable has to be written to memory before its
+  * address becomes valid. Once a variable is written to memory,
+  * its address never changes.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param value value to be written to memory
+  * @param varname variable name
+  * @return true if successful, false if not (see above)
+  */
+bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* varname)
+{
+  return write_cell_by_name(memory, value, value_len(&value), varname);
+}
+
+
+/**
+  * @brief ram_write_str_by_addr: writes a string of given length at this address
+  *
+  * Same as ram_write_cell_by_addr() with a string value, but the
+  * length is given rather than found with strlen, so the string
+  * may contain '\0' chars.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param s chars of the string
+  * @param len # of chars
+  * @param address memory cell address
+  * @return true if successful, false if not (invalid address)
+  */
+bool ram_write_str_by_addr(struct RAM* memory, const char* s, int len, int address)
+{
+  if (memory == NULL || s == NULL || len < 0)
+    return false;
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_STR;
+  value.types.s = (char*) s;
+
+  return write_cell_by_addr(memory, value, len, address);
+}
+
+
+/**
+  * @brief ram_write_str_by_name: writes a string of given length to a variable
+  *
+  * Same as ram_write_cell_by_name() with a string value, but the
+  * length is given rather than found with strlen, so the string
+  * may contain '\0' chars.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param s chars of the string
+  * @param len # of chars
+  * @param varname variable name
+  * @return true if successful, false if not (bad arguments)
+  */
+bool ram_write_str_by_name(struct RAM* memory, const char* s, int len, char* varname)
+{
+  if (memory == NULL || s == NULL || len < 0)
+    return false;
+
+  struct RAM_VALUE value;
+  value.value_type = RAM_TYPE_STR;
+  value.types.s = (char*) s;
+
+  return write_cell_by_name(memory, value, len, varname);
+}
+
+/**
+  * @brief ram_bulk_load: writes many variables at once
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param names array of n variable names
+  * @param values array of n values
+  * @param n # of variables
+  * @param workers Pointer to pool for the sort, or NULL
+  * @return # of variables created, -1 if bad arguments
+  */
+int ram_bulk_load(struct RAM* memory, char** names, struct RAM_VALUE* values, int n, struct RAM_WORKERS* workers)
+{
+  if (memory == NULL || n < 0 || (n > 0 && (names == NULL || values == NULL)))
+    return -1;
+
+  int old_size = memory->size;
+
+  // an open transaction logs each write for undo:
+  if (ram_txn_depth(memory) > 0) {
+    for (int i = 0; i < n; i++)
+      write_cell_by_name(memory, values[i], value_len(&values[i]), names[i]);
+    return memory->size - old_size;
+  }
+
+  if (n == 0)
+    return 0;
+
+  const int NOT_FIRST = -1;  // address[i] when names[i] appeared before i
+  const int NEW = -2;        // address[i] while a new name awaits its cell
+
+  int* order = (int*) ram_mem_alloc(memory->arena, n * sizeof(int));
+  int* address = (int*) ram_mem_alloc(memory->arena, n * sizeof(int));
+  int* keep = (int*) ram_mem_alloc(memory->arena, n * sizeof(int));
+
+  ram_parallel_sort_names(workers, names, n, order);
+
+  // the sort is stable, so a run of equal names starts with the
+  // name's first occurrence and ends with its last; keep the
+  // first of each run at the front of order[], and the last as
+  // the value to write, same as writing them one by one:
+  int num_unique = 0;
+  int num_new = 0;
+
+  for (int i = 0; i < n; i++)
+    address[i] = NOT_FIRST;
+
+  for (int i = 0; i < n; ) {
+    int j = i + 1;
+    while (j < n && strcmp(names[order[j]], names[order[i]]) == 0)
+      j++;
+
+    int first = order[i];
+    keep[first] = order[j - 1];
+    address[first] = ram_get_addr(memory, names[first]);
+    if (address[first] == -1) {
+      address[first] = NEW;
+      num_new++;
+    }
+
+    order[num_unique++] = first;
+    i = j;
+  }
+
+  // one allocation for every new cell:
+  if (old_size + num_new > memory->capacity)
+    grow_memory(memory, old_size + num_new);
+
+  // new names get addresses in order of first occurrence:
+  int next = old_size;
+  for (int i = 0; i < n; i++) {
+    if (address[i] == NEW) {
+      address[i] = next++;
+
+      if (memory->btree != NULL) {
+        // the map is in address order, the tree keeps the order:
+        memory->map[address[i]].varname = ram_mem_strdup(memory->arena, names[i]);
+        memory->map[address[i]].cell = address[i];
+        ram_btree_insert(memory->btree, memory->map[address[i]].varname, address[i]);
+        hash_insert(memory, address[i], memory->map[address[i]].varname);
+        count_bytes(&memory->footprint.name_bytes, strlen(names[i]) + 1);
+      }
+    }
+  }
+
+  if (memory->btree == NULL) {
+    // merge the new names, already sorted, into the map from the
+    // back, so every entry moves at most once:
+    int m = old_size - 1;
+    int u = num_unique - 1;
+
+    for (int k = old_size + num_new - 1; k >= 0 && u >= 0; k--) {
+      while (u >= 0 && address[order[u]] < old_size)
+        u--;  // already in memory
+      if (u < 0)
+        break;
+
+      char* name = names[order[u]];
+      if (m >= 0 && strcmp(memory->map[m].varname, name) > 0) {
+        memory->map[k] = memory->map[m--];
+      }
+      else {
+        memory->map[k].varname = ram_mem_strdup(memory->arena, name);
+        memory->map[k].cell = address[order[u]];
+        hash_insert(memory, address[order[u]], memory->map[k].varname);
+        count_bytes(&memory->footprint.name_bytes, strlen(name) + 1);
+        u--;
+      }
+    }
+  }
+
+  memory->size = old_size + num_new;
+  index_invalidate(memory);
+
+  for (int i = 0; i < n; i++) {
+    if (address[i] == NOT_FIRST)
+      continue;
+
+    uint64_t start = trace_start(memory);
+    struct RAM_VALUE* value = &values[keep[i]];
+    if (!write_by_addr(memory, *value, value_len(value), address[i]))
+      continue;  // its old value can't be saved for a rollback
+
+    wal_event(memory, RAM_WAL_WRITE_NAME, address[i], names[i], cell_ptr(memory, address[i]));
+    trace_event(memory, RAM_TRACE_WRITE_NAME, address[i], names[i], start);
+  }
+
+  ram_mem_free(memory->arena, order);
+  ram_mem_free(memory->arena, address);
+  ram_mem_free(memory->arena, keep);
+
+  return num_new;
+}
+
+
+
+//
+// ram_append_str_by_addr without tracing; false if the cell does
+// not hold a string:
+//
+static bool append_by_addr(struct RAM* memory, const char* s, int len, int address)
+{
+  if (address < 0 || address >= memory->capacity)
+    return false;
+
+  struct RAM_VALUE* cell = cell_ptr(memory, address);
+  if (cell->value_type != RAM_TYPE_STR)
+    return false;
+
+  if (!fault_in(memory, address))
+    return false;
+
+  struct RAM_TXN* txn = memory->txn;
+  bool unsaved = (txn != NULL && txn->depth > 0
+                  && (address >= txn->num_stamps || txn->stamps[address] != txn->epoch));
+
+  // a shared string, or one the open transaction has yet to save,
+  // is replaced by a new string as a whole:
+  if (memory->intern != NULL || unsaved) {
+    int old_len = rope_len(memory, address);
+    char* joined = (char*) ram_mem_alloc(memory->arena, old_len + len + 1);
+    rope_copy(memory, address, joined);
+    memcpy(joined + old_len, s, len);
+
+    struct RAM_VALUE value;
+    value.value_type = RAM_TYPE_STR;
+    value.types.s = joined;
+    write_by_addr(memory, value, old_len + len, address);
+    wal_append_event(memory, address, joined + old_len, len);
+
+    ram_mem_free(memory->arena, joined);
+    return true;
+  }
+
+  count_access(memory, address);
+  hash_touch(memory, address);
+  rope_append(memory, address, s, len);
+  wal_append_event(memory, address, s, len);
+
+  spill_touch(memory, address);
+  spill_enforce(memory, address);
+
+  return true;
+}
+
+
+/**
+  * @brief ram_append_str_by_addr: appends chars to the string at this address
+  *
+  * Adds s[0..len) to the end of the string in the cell at the
+  * given address, without copying the string: the chars go into
+  * spare room in its buffer, or into a rope of chunks that is
+  * flattened the next time the string is read. Building a string
+  * of n chars by appends takes O(n) time overall.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param s chars to append
+  * @param len # of chars
+  * @param address memory cell address
+  * @return true if successful, false if not (invalid address, the
+  *         cell does not hold a string, or its string can't be
+  *         read back from the spill file)
+  */
+bool ram_append_str_by_addr(struct RAM* memory, const char* s, int len, int address)
+{
+  if (memory == NULL || s == NULL || len < 0)
+    return false;
+
+  uint64_t start = trace_start(memory);
+  bool success = append_by_addr(memory, s, len, address);
+
+  trace_event(memory, RAM_TRACE_APPEND, address, NULL, start);
+  return success;
+}
+
+
+/**
+  * @brief ram_append_str_by_name: appends chars to a string variable
+  *
+  * Same as ram_append_str_by_addr(), for the cell of the given
+  * variable.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param s chars to append
+  * @param len # of chars
+  * @param varname variable name
+  * @return true if successful, false if not (no such variable, or
+  *         it does not hold a string)
+  */
+bool ram_append_str_by_name(struct RAM* memory, const char* s, int len, char* varname)
+{
+  if (memory == NULL || s == NULL || len < 0)
+    return false;
+
+  uint64_t start = trace_start(memory);
+  int address = private_addr(memory, varname);
+  bool success = (address != -1) && append_by_addr(memory, s, len, address);
+
+  trace_event(memory, RAM_TRACE_APPEND, address, varname, start);
+  return success;
+}
+
+
+/**
+  * @brief ram_str_flatten: the string at this address, as one buffer
+  *
+  * Moves any chars appended to the string in the cell at the
+  * given address into its buffer, and reads the string back in if
+  * it was spilled, so memory->cells holds the whole string. The
+  * read functions do this themselves.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param address memory cell address
+  * @return the cell's chars, owned by memory, or NULL if the
+  *         address is invalid, the cell does not hold a string, or
+  *         its string can't be read back from the spill file
+  */
+char* ram_str_flatten(struct RAM* memory, int address)
+{
+  if (memory == NULL || address < 0 || address >= memory->capacity)
+    return NULL;
+
+  struct RAM_VALUE* cell = cell_ptr(memory, address);
+  if (cell->value_type != RAM_TYPE_STR)
+    return NULL;
+
+  flatten(memory, address);
+  if (!fault_in(memory, address))
+    return NULL;
+  return cell->types.s;
+}
+
+
+/**
+  * @brief ram_str_flatten_all: flatten every string with pending appends
+  *
+  * Also reads back every spilled string, which can take memory
+  * over its spill budget; call ram_spill_enforce() once the cells
+  * are no longer in use. One that can't be read back stays
+  * spilled, and ram_for_each_range() skips its cell.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return true if successful, false if a string can't be read
+  *         back from the spill file
+  */
+bool ram_str_flatten_all(struct RAM* memory)
+{
+  if (memory == NULL)
+    return false;
+
+  return flatten_all(memory);
+}
+
+
+/**
+  * @brief ram_str_len: length of a string value
+  *
+  * O(1), and counts any '\0' chars inside the string.
+  *
+  * @param value a value returned by the read functions, or one
+  *        of memory->cells
+  * @return # of chars, or -1 if value is not a string
+  */
+int ram_str_len(struct RAM_VALUE* value)
+{
+  if (value == NULL || value->value_type != RAM_TYPE_STR || value->types.s == NULL)
+    return -1;
+
+  return str_header(value->types.s)->len;
+}
+
+
+
+//
+// prints one variable for ram_print():
+//
+static void print_visitor(struct RAM_VALUE* cell, int address, char* varname, void* arg)
+{
+   printf(" %s: ", varname);
+
+   if (cell->value_type == RAM_TYPE_INT) {
+    printf("int, %d", cell->types.i);
+   }
+   else if (cell->value_type == RAM_TYPE_REAL) {
+    printf("real, %lf", cell->types.d);
+   }
+   else if (cell->value_type == RAM_TYPE_STR) {
+    printf("str, '");
+    fwrite(cell->types.s, 1, str_header(cell->types.s)->len, stdout);
+    printf("'");
+   }
+   else if (cell->value_type == RAM_TYPE_PTR) {
+    printf("ptr, %d", cell->types.i);
+   }
+   else if(cell->value_type == RAM_TYPE_BOOLEAN) {
+    if (cell->types.i == 0)
+      printf("boolean, False");
+    else
+      printf("boolean, True");
+   }
+   else if (cell->value_type == RAM_TYPE_INT_ARRAY) {
+    printf("int array, length %d", cell->types.a->length);
+   }
+   else if (cell->value_type == RAM_TYPE_REAL_ARRAY) {
+    printf("real array, length %d", cell->types.a->length);
+   }
+   else if (cell->value_type == RAM_TYPE_BIGINT) {
+    char* digits = ram_int_to_str(cell->types.n);
+    printf("bigint, %s", digits);
+    free(digits);
+   }
+   else {
+   printf("none, None");
+   }
+  
+   printf("\n");
+}
+
+
+/**
+  * @brief ram_print: prints the contents of memory
+  *
+  * Prints the contents of RAM to the console, for debugging.
+  * RAM is printed in alphabetical order by variable name.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_print(struct RAM* memory)
+{
+  printf("**MEMORY PRINT**\n");
+
+  printf("Size: %d\n", memory->size);
+  printf("Capacity: %d\n", memory->capacity);
+  printf("Contents:\n");
+
+  ram_for_each_sorted(memory, print_visitor, NULL);
+
+  printf("**END PRINT**\n");
+}
+
+
+/**
+  * @brief ram_print_map: prints the contents of memory map
+  *
+  * Prints contents of RAM map to the console, for debugging.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_print_map(struct RAM* memory)
+{
+  printf("**MEMORY MAP PRINT**\n");
+
+  for (int i = 0; i < memory->size; i++)
+  {
+   printf(" %s: %d\n", memory->map[i].varname, memory->map[i].cell);
+  }
+
+  printf("**END PRINT**\n");
+}
+
+
+/**
+  * @brief ram_intern_enable: share storage between equal strings
+  *
+  * Turns on string interning for the given memory. From now on,
+  * string values written to memory are stored once in a
+  * refcounted intern table, and cells holding equal strings point
+  * to the same buffer. Strings already in memory are moved into
+  * the table. Returns false if a transaction is open, since the
+  * strings saved for a rollback can't be moved. Calling this on a
+  * memory that already interns strings has no effect.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return true if successful, false if a transaction is open or a
+  *         string can't be read back from the spill file
+  */
+bool ram_intern_enable(struct RAM* memory)
+{
+  if (memory == NULL)
+    return false;
+  if (memory->intern != NULL)
+    return true;
+  if (memory->txn != NULL && memory->txn->depth > 0)
+    return false;
+  if (!flatten_all(memory))
+    return false;
+
+  struct RAM_INTERN* table = (struct RAM_INTERN*) ram_mem_alloc(memory->arena, sizeof(struct RAM_INTERN));
+  table->arena = memory->arena;
+  table->num_buckets = 16;
+  table->buckets = (struct RAM_ISTR**) ram_mem_alloc(table->arena, table->num_buckets * sizeof(struct RAM_ISTR*));
+  memset(table->buckets, 0, table->num_buckets * sizeof(struct RAM_ISTR*));
+  table->num_strings = 0;
+  table->lookups = 0;
+  table->hits = 0;
+  table->bytes_saved = 0;
+
+  for (int i = 0; i < memory->capacity; i++) {
+    struct RAM_VALUE* cell = &memory->cells[i];
+    if (cell->value_type == RAM_TYPE_STR && cell->types.s != NULL) {
+      struct RAM_STR* header = str_header(cell->types.s);
+      int len = header->len;
+
+      bool added;
+      char* shared = intern_acquire(table, cell->types.s, len, &added);
+
+      count_str(memory, len, str_buffer_bytes(header->capacity), -1);
+      if (added)
+        count_str(memory, len, sizeof(struct RAM_ISTR) + len + 1, 1);
+
+      ram_mem_free(memory->arena, header);
+      cell->types.s = shared;
+    }
+  }
+
+  __atomic_store_n(&memory->intern, table, __ATOMIC_RELEASE);
+
+  return true;
+}
+
+
+/**
+  * @brief ram_intern_stats: statistics of the string intern table
+  *
+  * Fills in stats for the given memory. Returns false (and leaves
+  * stats untouched) if interning is not enabled.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param stats Pointer to struct to fill in
+  * @return true if interning is enabled, false if not
+  */
+bool ram_intern_stats(struct RAM* memory, struct RAM_INTERN_STATS* stats)
+{
+  if (memory == NULL || memory->intern == NULL || stats == NULL)
+    return false;
+
+  stats->lookups = memory->intern->lookups;
+  stats->hits = memory->intern->hits;
+  stats->unique_strings = memory->intern->num_strings;
+  stats->bytes_saved = memory->intern->bytes_saved;
+
+  if (stats->lookups > 0)
+    stats->hit_rate = (double) stats->hits / (double) stats->lookups;
+  else
+    stats->hit_rate = 0.0;
+
+  return true;
+}
+
+
+//
+// ram_cells_equal compares two cells already flattened and in the
+// heap:
+//
+static bool values_equal(struct RAM* memory, struct RAM_VALUE* c1, struct RAM_VALUE* c2)
+{
+  if (c1->value_type != c2->value_type)
+    return false;
+
+  if (c1->value_type == RAM_TYPE_STR) {
+    if (memory->intern != NULL)
+      return c1->types.s == c2->types.s;
+    int len = str_header(c1->types.s)->len;
+    return str_header(c2->types.s)->len == len && memcmp(c1->types.s, c2->types.s, len) == 0;
+  }
+  else if (c1->value_type == RAM_TYPE_REAL) {
+    return c1->types.d == c2->types.d;
+  }
+  else if (c1->value_type == RAM_TYPE_NONE) {
+    return true;
+  }
+  else if (c1->value_type == RAM_TYPE_INT_ARRAY || c1->value_type == RAM_TYPE_REAL_ARRAY) {
+    struct RAM_ARRAY* a1 = c1->types.a;
+    struct RAM_ARRAY* a2 = c2->types.a;
+    size_t elem = (c1->value_type == RAM_TYPE_INT_ARRAY) ? sizeof(int) : sizeof(double);
+    return a1->length == a2->length && memcmp(a1->elems.i, a2->elems.i, a1->length * elem) == 0;
+  }
+  else if (c1->value_type == RAM_TYPE_BIGINT) {
+    return ram_int_cmp(c1->types.n, c2->types.n) == 0;
+  }
+  else {
+    return c1->types.i == c2->types.i;
+  }
+}
+
+
+/**
+  * @brief ram_cells_equal: compares the values in two memory cells
+  *
+  * Returns true if the cells at the two addresses hold the same
+  * type and value. When interning is enabled, strings are
+  * compared by pointer. Returns false if either address is
+  * invalid.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param addr1 first memory cell address
+  * @param addr2 second memory cell address
+  * @return true if equal, false if not
+  */
+bool ram_cells_equal(struct RAM* memory, int addr1, int addr2)
+{
+  if (memory == NULL)
+    return false;
+  if (addr1 < 0 || addr1 >= memory->capacity || addr2 < 0 || addr2 >= memory->capacity)
+    return false;
+
+  // strings read back only for the compare are spilled again:
+  bool spilled = is_spilled(memory, addr1) || is_spilled(memory, addr2);
+  flatten(memory, addr1);
+  flatten(memory, addr2);
+  bool readable = fault_in(memory, addr1) && fault_in(memory, addr2);
+
+  bool equal = readable && values_equal(memory, cell_ptr(memory, addr1), cell_ptr(memory, addr2));
+
+  if (spilled)
+    spill_enforce(memory, -1);
+  return equal;
+}
+
+
+/**
+  * @brief ram_get_array: array stored in memory for this variable
+  *
+  * If the given variable holds an int or real array, returns a
+  * pointer to the array stored in memory (NOT a copy), so the
+  * ram_array kernels can work on it in place. Returns NULL if no
+  * such variable exists or it does not hold an array.
+  *
+  * NOTE: the pointer is owned by memory and becomes invalid
+  * once the variable is overwritten or memory is destroyed.
+  *
+  * NOTE: changes made through the pointer are not logged or
+  * replicated until ram_array_changed() is called. In a
+  * transaction, the first call saves the array so a rollback
+  * puts it back; changes through a pointer from before the
+  * transaction began are not undone.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param varname variable name
+  * @return pointer to array in memory, or NULL
+  */
+struct RAM_ARRAY* ram_get_array(struct RAM* memory, char* varname)
+{
+  int address = private_addr(memory, varname);
+  if (address == -1)
+    return NULL;
+
+  struct RAM_VALUE* cell = cell_ptr(memory, address);
+  if (cell->value_type != RAM_TYPE_INT_ARRAY && cell->value_type != RAM_TYPE_REAL_ARRAY)
+    return NULL;
+
+  count_access(memory, address);
+  if (memory->hash != NULL)
+    ram_hash_expose(memory->hash, address);  // the caller may change it in place
+
+  // in a transaction, the first time: the array moves into the
+  // undo log, and the caller changes a copy
+  struct RAM_ARRAY* array = cell->types.a;
+  int type = cell->value_type;
+  if (txn_save_cell(memory, address) && cell->value_type == RAM_TYPE_NONE) {
+    cell->value_type = type;
+    cell->types.a = copy_array(memory, array);
+    count_bytes(&memory->footprint.array_bytes, array_bytes(cell->types.a));
+  }
+
+  return cell->types.a;
+}
+
+
+/**
+  * @brief ram_array_changed: log a change made to an array in place
+  *
+  * Logs the variable's whole value to the write-ahead log and the
+  * replication stream (see ram_wal.h, ram_repl.h), as if it had
+  * been written. Call it once done changing an array returned by
+  * ram_get_array(), or, once the walk is over, for a cell a
+  * ram_for_each() visitor changed.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param varname variable name
+  * @return true if successful, false if no such variable exists,
+  *         or its string can't be read back from the spill file
+  */
+bool ram_array_changed(struct RAM* memory, char* varname)
+{
+  if (memory == NULL)
+    return false;
+
+  int address = ram_get_addr(memory, varname);
+  if (address == -1)
+    return false;
+
+  bool spilled = is_spilled(memory, address);
+  flatten(memory, address);
+  if (!fault_in(memory, address))
+    return false;
+
+  hash_touch(memory, address);
+  wal_event(memory, RAM_WAL_WRITE_ADDR, address, NULL, cell_ptr(memory, address));
+
+  if (spilled)
+    spill_enforce(memory, -1);
+  return true;
+}
+
+
+/**
+  * @brief ram_for_each: visit every variable's cell in storage order
+  *
+  * Calls visit(cell, address, NULL, arg) once for each of the N
+  * vars in memory, in the order their cells are stored: address
+  * order, unless ram_optimize_layout() has moved them. This is the
+  * cheapest way to scan all values since cells are contiguous.
+  * The visitor may modify cell values in place but must not write
+  * variables through the ram_write functions. Such changes are
+  * not logged, replicated or undone by a rollback; see
+  * ram_array_changed(). A spilled string is read back only for
+  * its visit and may be spilled again after, so the cell is valid
+  * only until visit returns.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param visit function to call for each cell
+  * @param arg passed through to visit
+  * @return void
+  */
+void ram_for_each(struct RAM* memory, RAM_VISITOR visit, void* arg)
+{
+  if (memory == NULL || visit == NULL)
+    return;
+
+  for (int i = 0; i < memory->size; i++) {
+    visit_cell(memory, slot_addr(memory, i), NULL, visit, arg);
+  }
+  hash_touch_all(memory);
+
+  return;
+}
+
+
+/**
+  * @brief ram_for_each_range: visit the cells stored in cells[begin..end)
+  *
+  * Calls visit(cell, address, NULL, arg) for each variable whose
+  * cell is stored at an index in begin..end-1 of memory->cells,
+  * in storage order. Splitting 0..N-1 into ranges and visiting
+  * each range once visits every variable exactly once, which is
+  * how parallel passes divide the work. Same restrictions as
+  * ram_for_each(). Strings with pending appends are not flattened
+  * here, since ranges may be visited by several threads at once;
+  * call ram_str_flatten_all() before splitting the work. Cells
+  * whose string it couldn't read back are skipped.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param begin first index to visit
+  * @param end one past the last index to visit
+  * @param visit function to call for each cell
+  * @param arg passed through to visit
+  * @return void
+  */
+void ram_for_each_range(struct RAM* memory, int begin, int end, RAM_VISITOR visit, void* arg)
+{
+  if (memory == NULL || visit == NULL)
+    return;
+
+  if (begin < 0)
+    begin = 0;
+  if (end > memory->size)
+    end = memory->size;
+
+  for (int i = begin; i < end; i++) {
+    struct RAM_VALUE* cell = &memory->cells[i];
+    if (cell->value_type == RAM_TYPE_STR && cell->types.s == NULL)
+      continue;  // still spilled, see ram_str_flatten_all()
+    visit(cell, slot_addr(memory, i), NULL, arg);
+  }
+  hash_touch_all(memory);
+
+  return;
+}
+
+
+//
+// ram_for_each_sorted walks the B-tree with this visitor:
+//
+struct SORTED_VISIT
+{
+  struct RAM* memory;
+  RAM_VISITOR visit;
+  void* arg;
+};
+
+static void sorted_visitor(char* name, int cell, void* arg)
+{
+  struct SORTED_VISIT* sorted = (struct SORTED_VISIT*) arg;
+
+  visit_cell(sorted->memory, cell, name, sorted->visit, sorted->arg);
+}
+
+
+/**
+  * @brief ram_for_each_sorted: visit every variable in alphabetical order
+  *
+  * Calls visit(cell, address, varname, arg) for each variable in
+  * memory, in alphabetical order by name (the order of ram_print).
+  * Same restrictions as ram_for_each().
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param visit function to call for each variable
+  * @param arg passed through to visit
+  * @return void
+  */
+void ram_for_each_sorted(struct RAM* memory, RAM_VISITOR visit, void* arg)
+{
+  if (memory == NULL || visit == NULL)
+    return;
+
+  hash_touch_all(memory);
+
+  if (memory->btree != NULL) {
+    struct SORTED_VISIT sorted = {memory, visit, arg};
+    ram_btree_for_each(memory->btree, sorted_visitor, &sorted);
+    return;
+  }
+
+  for (int i = 0; i < memory->size; i++) {
+    visit_cell(memory, memory->map[i].cell, memory->map[i].varname, visit, arg);
+  }
+
+  return;
+}
+
+
+//
+// ram_next_sorted without reading a spilled string back:
+//
+static struct RAM_VALUE* next_sorted(struct RAM* memory, const char* after, int* hint, char** varname, int* address)
+{
+  if (memory->btree != NULL) {
+    if (!ram_btree_next(memory->btree, after, varname, address))
+      return NULL;
+  }
+  else {
+    int i = 0;
+    if (after != NULL) {
+      // the hint saves the search when nothing moved since:
+      if (*hint >= 0 && *hint < memory->size && strcmp(memory->map[*hint].varname, after) == 0)
+        i = *hint;
+      else
+        i = SortedArrayIndex::lower_bound(memory->map, memory->size, after);
+
+      if (i < memory->size && strcmp(memory->map[i].varname, after) == 0)
+        i++;
+    }
+    if (i >= memory->size)
+      return NULL;
+
+    *hint = i;
+    *varname = memory->map[i].varname;
+    *address = memory->map[i].cell;
+  }
+
+  return cell_ptr(memory, *address);
+}
+
+
+/**
+  * @brief ram_next_sorted: the variable that comes after a name
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param after name to start after, or NULL for the first variable
+  * @param hint where after was, as returned by the last call, or
+  *        -1; set to where this variable is
+  * @param varname set to the variable's name, owned by memory
+  * @param address set to the variable's address
+  * @return pointer to the variable's cell, or NULL if no variable
+  *         comes after. A variable whose string can't be read back
+  *         from the spill file is skipped.
+  */
+struct RAM_VALUE* ram_next_sorted(struct RAM* memory, const char* after, int* hint, char** varname, int* address)
+{
+  if (memory == NULL || hint == NULL || varname == NULL || address == NULL)
+    return NULL;
+
+  while (true) {
+    struct RAM_VALUE* cell = next_sorted(memory, after, hint, varname, address);
+    if (cell == NULL || cell->value_type != RAM_TYPE_STR)
+      return cell;
+
+    flatten(memory, *address);
+    if (fault_in(memory, *address)) {
+      spill_touch(memory, *address);
+      spill_enforce(memory, *address);
+      return cell;
+    }
+    after = *varname;  // skipped, see ram_spill_stats()
+  }
+}
+
+
+/**
+  * @brief ram_memory_usage: heap bytes used by memory, by category
+  *
+  * Fills in usage with the exact # of bytes requested from the
+  * heap by the given memory (not counting the allocator's own
+  * overhead), broken down by category. The counts are kept up to
+  * date as memory changes, so this call is O(1) and may be made
+  * from another thread while memory is in use; in that case the
+  * categories may be momentarily out of step with each other.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param usage Pointer to struct to fill in
+  * @return void
+  */
+void ram_memory_usage(struct RAM* memory, struct RAM_MEMORY_USAGE* usage)
+{
+  if (memory == NULL || usage == NULL)
+    return;
+
+  long size = __atomic_load_n(&memory->size, __ATOMIC_RELAXED);
+  long capacity = __atomic_load_n(&memory->capacity, __ATOMIC_RELAXED);
+
+  // inline cells and map entries in use are counted with the rest:
+  usage->ram_bytes = sizeof(struct RAM);
+  if (memory->cells == memory->inline_cells)
+    usage->ram_bytes -= capacity * sizeof(struct RAM_VALUE);
+  if (memory->map == memory->inline_map)
+    usage->ram_bytes -= capacity * sizeof(struct RAM_MAP);
+  usage->cell_bytes = size * sizeof(struct RAM_VALUE);
+  usage->map_bytes = size * sizeof(struct RAM_MAP);
+  usage->unused_bytes = (capacity - size) * (sizeof(struct RAM_VALUE) + sizeof(struct RAM_MAP));
+  usage->name_bytes = __atomic_load_n(&memory->footprint.name_bytes, __ATOMIC_RELAXED);
+  usage->array_bytes = __atomic_load_n(&memory->footprint.array_bytes, __ATOMIC_RELAXED);
+  usage->bigint_bytes = __atomic_load_n(&memory->footprint.bigint_bytes, __ATOMIC_RELAXED);
+
+  usage->string_bytes = 0;
+  for (int b = 0; b < RAM_STR_BUCKETS; b++) {
+    usage->str_count[b] = __atomic_load_n(&memory->footprint.str_count[b], __ATOMIC_RELAXED);
+    usage->str_bytes[b] = __atomic_load_n(&memory->footprint.str_bytes[b], __ATOMIC_RELAXED);
+    usage->string_bytes += usage->str_bytes[b];
+  }
+
+  // the intern table's own structure; the strings are counted above:
+  struct RAM_INTERN* table = __atomic_load_n(&memory->intern, __ATOMIC_ACQUIRE);
+  if (table != NULL)
+    usage->intern_bytes = sizeof(struct RAM_INTERN) + __atomic_load_n(&table->num_buckets, __ATOMIC_RELAXED) * sizeof(struct RAM_ISTR*);
+  else
+    usage->intern_bytes = 0;
+
+  // the name index, once ram_get_addr() has built it:
+  struct RAM_INDEX* index = __atomic_load_n(&memory->index, __ATOMIC_ACQUIRE);
+  if (index != NULL)
+    usage->index_bytes = sizeof(struct RAM_INDEX) + (__atomic_load_n(&index->capacity, __ATOMIC_RELAXED) + 1) * sizeof(struct RAM_NAME_KEY) + 64;
+  else
+    usage->index_bytes = 0;
+
+  struct RAM_BTREE* btree = __atomic_load_n(&memory->btree, __ATOMIC_ACQUIRE);
+  if (btree != NULL)
+    usage->index_bytes += sizeof(struct RAM_BTREE) + ram_btree_bytes(btree);
+
+  usage->total_bytes = usage->ram_bytes + usage->cell_bytes + usage->map_bytes + usage->unused_bytes
+    + usage->name_bytes + usage->string_bytes + usage->array_bytes + usage->bigint_bytes + usage->intern_bytes
+    + usage->index_bytes;
+
+  return;
+}
+
+
+/**
+  * @brief ram_txn_begin: start a transaction
+  *
+  * From now on, writes to memory can be undone by
+  * ram_txn_rollback(). Transactions nest: each begin must be
+  * matched by a commit or a rollback, which applies to the
+  * innermost open transaction.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_txn_begin(struct RAM* memory)
+{
+  if (memory == NULL)
+    return;
+
+  if (memory->txn == NULL) {
+    struct RAM_TXN* txn = (struct RAM_TXN*) ram_mem_alloc(memory->arena, sizeof(struct RAM_TXN));
+    txn->capacity = 16;
+    txn->log = (struct RAM_UNDO*) ram_mem_alloc(memory->arena, txn->capacity * sizeof(struct RAM_UNDO));
+    txn->count = 0;
+    txn->marks_capacity = 4;
+    txn->marks = (int*) ram_mem_alloc(memory->arena, txn->marks_capacity * sizeof(int));
+    txn->depth = 0;
+    txn->stamps = NULL;
+    txn->num_stamps = 0;
+    txn->epoch = 0;
+    memory->txn = txn;
+  }
+
+  struct RAM_TXN* txn = memory->txn;
+
+  if (txn->depth >= txn->marks_capacity) {
+    txn->marks_capacity = txn->marks_capacity * 2;
+    txn->marks = (int*) ram_mem_realloc(memory->arena, txn->marks, txn->marks_capacity * sizeof(int));
+  }
+  txn->marks[txn->depth] = txn->count;
+  txn->depth++;
+
+  // new epoch => every cell counts as untouched; on wrap-around
+  // clear the stamps so an old stamp can't match by accident:
+  txn->epoch++;
+  if (txn->epoch == 0) {
+    for (int i = 0; i < txn->num_stamps; i++) {
+      txn->stamps[i] = 0;
+    }
+    txn->epoch = 1;
+  }
+
+  wal_event(memory, RAM_WAL_TXN_BEGIN, -1, NULL, NULL);
+  return;
+}
+
+
+/**
+  * @brief ram_txn_commit: keep the writes of the current transaction
+  *
+  * Closes the innermost open transaction. If it is the outermost
+  * one, the saved prior values are freed; otherwise its writes
+  * become part of the enclosing transaction and can still be
+  * rolled back by it. Returns false if no transaction is open.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return true if successful, false if no transaction is open
+  */
+bool ram_txn_commit(struct RAM* memory)
+{
+  if (memory == NULL || memory->txn == NULL || memory->txn->depth == 0)
+    return false;
+
+  struct RAM_TXN* txn = memory->txn;
+
+  txn->depth--;
+  if (txn->depth == 0)
+    txn_discard(memory, 0);
+
+  wal_event(memory, RAM_WAL_TXN_COMMIT, -1, NULL, NULL);
+
+  return true;
+}
+
+
+/**
+  * @brief ram_txn_rollback: undo the writes of the current transaction
+  *
+  * Restores every cell written since the innermost open
+  * ram_txn_begin() to its prior value and removes the variables
+  * created since then, then closes that transaction. The cost is
+  * proportional to the # of writes made, not the size of memory.
+  * Returns false if no transaction is open.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return true if successful, false if no transaction is open
+  */
+bool ram_txn_rollback(struct RAM* memory)
+{
+  if (memory == NULL || memory->txn == NULL || memory->txn->depth == 0)
+    return false;
+
+  struct RAM_TXN* txn = memory->txn;
+
+  txn->depth--;
+  txn_undo(memory, txn->marks[txn->depth]);
+
+  // cells restored here may be written again by the enclosing
+  // transaction and must be saved again:
+  txn->epoch++;
+  if (txn->epoch == 0) {
+    for (int i = 0; i < txn->num_stamps; i++) {
+      txn->stamps[i] = 0;
+    }
+    txn->epoch = 1;
+  }
+
+  wal_event(memory, RAM_WAL_TXN_ROLLBACK, -1, NULL, NULL);
+  return true;
+}
+
+
+/**
+  * @brief ram_txn_depth: # of open transactions
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return # of open transactions, 0 if none
+  */
+int ram_txn_depth(struct RAM* memory)
+{
+  if (memory == NULL || memory->txn == NULL)
+    return 0;
+
+  return memory->txn->depth;
+}
+
+
+/**
+  * @brief ram_profile_enable: start counting accesses per cell
+  *
+  * From now on, each read or write of a cell (through the
+  * ram_read, ram_write and ram_get_array functions) increments
+  * that cell's access counter. The counters guide
+  * ram_optimize_layout(). Calling this again has no effect.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_profile_enable(struct RAM* memory)
+{
+  if (memory == NULL || memory->hits != NULL)
+    return;
+
+  memory->hits = (unsigned int*) ram_mem_alloc(memory->arena, memory->capacity * sizeof(unsigned int));
+  memset(memory->hits, 0, memory->capacity * sizeof(unsigned int));
+
+  return;
+}
+
+
+/**
+  * @brief ram_access_count: # of accesses counted for a cell
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param address memory cell address
+  * @return access count, or 0 if profiling is off or the address is invalid
+  */
+unsigned int ram_access_count(struct RAM* memory, int address)
+{
+  if (memory == NULL || memory->hits == NULL || address < 0 || address >= memory->capacity)
+    return 0;
+
+  return memory->hits[address];
+}
+
+
+//
+// ram_optimize_layout sorts (hits, address) pairs:
+//
+struct HOT_CELL
+{
+  unsigned int hits;
+  int address;
+};
+
+static int hotter_first(const void* a, const void* b)
+{
+  const struct HOT_CELL* x = (const struct HOT_CELL*) a;
+  const struct HOT_CELL* y = (const struct HOT_CELL*) b;
+
+  if (x->hits != y->hits)
+    return (x->hits > y->hits) ? -1 : 1;
+  return x->address - y->address;
+}
+
+
+/**
+  * @brief ram_optimize_layout: pack the most accessed cells together
+  *
+  * Reorders the cells of the variables in memory by their access
+  * counts, most accessed first, so hot variables share cache
+  * lines instead of being scattered among cold ones. Addresses do
+  * not change: ram_get_addr() and the ram_read / ram_write
+  * functions go through an indirection table. The counters are
+  * then halved, so later passes follow changes in the workload.
+  * Returns false if profiling is not enabled.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return true if successful, false if profiling is off
+  */
+bool ram_optimize_layout(struct RAM* memory)
+{
+  if (memory == NULL || memory->hits == NULL)
+    return false;
+
+  int n = memory->size;
+  if (n == 0)
+    return true;
+
+  struct HOT_CELL* order = (struct HOT_CELL*) ram_mem_alloc(memory->arena, n * sizeof(struct HOT_CELL));
+  for (int i = 0; i < n; i++) {
+    order[i].hits = memory->hits[i];
+    order[i].address = i;
+  }
+  qsort(order, n, sizeof(struct HOT_CELL), hotter_first);
+
+  // gather the cells in their new order, then store them back:
+  struct RAM_VALUE* packed = (struct RAM_VALUE*) ram_mem_alloc(memory->arena, n * sizeof(struct RAM_VALUE));
+  for (int k = 0; k < n; k++) {
+    packed[k] = *cell_ptr(memory, order[k].address);
+  }
+  memcpy(memory->cells, packed, n * sizeof(struct RAM_VALUE));
+  ram_mem_free(memory->arena, packed);
+
+  // cells past the old tables are still in place, so the new
+  // tables can simply replace the old ones:
+  free_layout(memory);
+  struct RAM_LAYOUT* layout = (struct RAM_LAYOUT*) ram_mem_alloc(memory->arena, sizeof(struct RAM_LAYOUT));
+  layout->slot_of = (int*) ram_mem_alloc(memory->arena, n * sizeof(int));
+  layout->addr_of = (int*) ram_mem_alloc(memory->arena, n * sizeof(int));
+  layout->num = n;
+
+  for (int k = 0; k < n; k++) {
+    layout->slot_of[order[k].address] = k;
+    layout->addr_of[k] = order[k].address;
+  }
+  memory->layout = layout;
+
+  ram_mem_free(memory->arena, order);
+
+  for (int i = 0; i < memory->capacity; i++) {
+    memory->hits[i] = memory->hits[i] / 2;
+  }
+
+  return true;
 }
 
 
 /**
-  * @brief ram_size: # of vars in memory
+  * @brief ram_map_btree_enable: keep variable names in a B-tree
   *
-  * Returns the # of variables currently stored in memory.
+  * From now on, names are kept in alphabetical order by a B-tree,
+  * so creating a variable is O(log n) instead of shifting the map,
+  * and ram_get_addr() searches the tree. memory->map then lists
+  * the vars in address order (map[i].cell == i) rather than in
+  * alphabetical order; ram_print and ram_for_each_sorted still
+  * visit them alphabetically. Returns false if a transaction is
+  * open. Calling this again has no effect.
   *
-  * @return # of vars in memory
+  * @param memory Pointer to struct denoting memory unit
+  * @return true if successful, false if a transaction is open
   */
-int ram_size(struct RAM* memory)
+bool ram_map_btree_enable(struct RAM* memory)
 {
-  return memory->size;
+  if (memory == NULL)
+    return false;
+  if (memory->btree != NULL)
+    return true;
+  if (memory->txn != NULL && memory->txn->depth > 0)
+    return false;
+
+  struct RAM_BTREE* btree = (struct RAM_BTREE*) ram_mem_alloc(memory->arena, sizeof(struct RAM_BTREE));
+  ram_btree_init(btree, memory->arena);
+
+  // addresses are 0..size-1, so each entry moves to map[cell]:
+  struct RAM_MAP* by_addr = (struct RAM_MAP*) ram_mem_alloc(memory->arena, memory->capacity * sizeof(struct RAM_MAP));
+  for (int i = 0; i < memory->capacity; i++) {
+    by_addr[i].varname = NULL;
+  }
+  for (int i = 0; i < memory->size; i++) {
+    by_addr[memory->map[i].cell] = memory->map[i];
+    ram_btree_insert(btree, memory->map[i].varname, memory->map[i].cell);
+  }
+
+  if (memory->map == memory->inline_map) {
+    memcpy(memory->inline_map, by_addr, memory->capacity * sizeof(struct RAM_MAP));
+    ram_mem_free(memory->arena, by_addr);
+  }
+  else {
+    ram_mem_free(memory->arena, memory->map);
+    memory->map = by_addr;
+  }
+
+  free_index(memory);
+  memory->btree = btree;
+
+  return true;
 }
 
 
 /**
-  * @brief ram_capacity: # of cells available in memory
+  * @brief ram_trace_attach: record a memory's operations into a trace
   *
-  * Returns the # of cells currently available in memory.
+  * From now on, reads, writes, resets and doublings of memory are
+  * recorded as events in the given trace. Pass NULL to stop
+  * tracing. See ram_trace.h.
   *
-  * @return # of cells available in memory
+  * @param memory Pointer to struct denoting memory unit
+  * @param trace Pointer to trace, or NULL
+  * @return void
   */
-int ram_capacity(struct RAM* memory)
+void ram_trace_attach(struct RAM* memory, struct RAM_TRACE* trace)
 {
-  return memory->capacity;
+  if (memory == NULL)
+    return;
+
+  memory->trace = trace;
+
+  return;
 }
 
 
 /**
-  * @brief ram_get_addr: address of memory cell occupied by variable
-  *
-  * If the given variable (e.g. "x") has been written to 
-  * memory, returns the address of this variable --- an integer
-  * in the range 0..N-1 where N is the number of vars currently 
-  * stored in memory. Returns -1 if no such variable exists 
-  * in memory. 
+  * @brief ram_wal_attach: log a memory's writes
   *
-  * NOTE: a variable has to be written to memory before you can
-  * get its address. Once a variable is written to memory, its
-  * address never changes. 
+  * From now on, writes, resets and transactions on memory are
+  * appended to the given write-ahead log. Pass NULL to stop
+  * logging. See ram_wal.h.
   *
   * @param memory Pointer to struct denoting memory unit
-  * @param varname variable name
-  * @return address of variable or -1 if doesn't exist
+  * @param wal Pointer to log, or NULL
+  * @return void
   */
-int ram_get_addr(struct RAM* memory, char* varname)
+void ram_wal_attach(struct RAM* memory, struct RAM_WAL* wal)
 {
-  if (memory == NULL || varname == NULL)
-    return -1;
-  
-  //binary seacrh over the sorted map 
-  int left = 0;
-  int right = memory->size - 1;
-  int c;
-
-  while (left <= right) {
-    int mid = (left + right) / 2;
-    c = strcmp(varname, memory->map[mid].varname);    
-    
-    if (c == 0)
-      return memory->map[mid].cell;
-    else if (c < 0)
-      right = mid - 1; //search left half
-    else 
-      left = mid + 1; //search right half
-  }
-  
-  return -1;
+  if (memory == NULL)
+    return;
+
+  memory->wal = wal;
+
+  return;
 }
 
 
 /**
-  * @brief ram_read_cell_by_addr: returns value in memory cell at this address
-  *
-  * Given a memory address (an integer in the range 0..N-1), 
-  * returns a COPY of the value contained in that memory cell.
-  * Returns NULL if the address is not valid.
-  * 
-  * NOTE: this function allocates memory for the value that
-  * is returned. The caller takes ownership of the copy and 
-  * must eventually free this memory via ram_free_value().
+  * @brief ram_repl_attach: send a memory's changes to a standby
   *
-  * NOTE: a variable has to be written to memory before its
-  * address becomes valid. Once a variable is written to memory,
-  * its address never changes.
+  * Sends a reset and then every variable, in address order, so
+  * the standby starts from memory's current state; from then on
+  * the changes logged to a write-ahead log are sent as well. Pass
+  * NULL to stop sending. See ram_repl.h.
   *
   * @param memory Pointer to struct denoting memory unit
-  * @param address memory cell address
-  * @return pointer to struct containing value or NULL if doesn't exist
+  * @param repl Pointer to stream, or NULL
+  * @return true if successful, false (and nothing is sent) if a
+  *         string can't be read back from the spill file
   */
-struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address)
+bool ram_repl_attach(struct RAM* memory, struct RAM_REPL* repl)
 {
   if (memory == NULL)
-    return NULL;
-    
-  if(address < memory->size && address >= 0) {
-    struct RAM_VALUE* copy = (struct RAM_VALUE*) malloc (sizeof(struct RAM_VALUE));
-    copy->types.s = strdup(memory->cells[address].types.s);
-    //copy->value_type = memory->cells[address].value_type;
-    if (memory->cells[address].value_type == RAM_TYPE_STR) {
-      copy->types.s = strdup(memory->cells[address].types.s);
-    }
-    else if (memory->cells[address].value_type == RAM_TYPE_REAL){
-        copy->types.d = memory->cells[address].types.d;
-    }
-    else {
-      copy->types.i = memory->cells[address].types.i;
-    }
-    return copy;
+    return false;
+
+  memory->repl = NULL;
+  if (repl == NULL)
+    return true;
+
+  // a snapshot with a variable missing would be a wrong one:
+  if (!flatten_all(memory))
+    return false;
+
+  memory->repl = repl;
+  ram_repl_log(repl, RAM_WAL_RESET, -1, NULL, NULL, 0);
+
+  char** names = (char**) ram_mem_alloc(memory->arena, (memory->size > 0 ? memory->size : 1) * sizeof(char*));
+  for (int i = 0; i < memory->size; i++) {
+    names[memory->map[i].cell] = memory->map[i].varname;
   }
-  else {
-    return NULL;
+
+  for (int address = 0; address < memory->size; address++) {
+    ram_repl_log(repl, RAM_WAL_WRITE_NAME, address, names[address], cell_ptr(memory, address), memory->size);
   }
+
+  ram_mem_free(memory->arena, names);
+  spill_enforce(memory, -1);
+  return true;
 }
 
 
 /**
-  * @brief ram_read_cell_by_name: returns value in memory cell for this variable
-  *
-  * If the given variable (e.g. "x") has been written to 
-  * memory, returns a COPY of the value contained in memory.
-  * Returns NULL if no such name exists in memory.
-  *
-  * NOTE: this function allocates memory for the value that
-  * is returned. The caller takes ownership of the copy and 
-  * must eventually free this memory via ram_free_value().
+  * @brief ram_spill_enable: keep memory under a budget by spilling strings
   *
   * @param memory Pointer to struct denoting memory unit
-  * @param varname variable name
-  * @return pointer to struct containing value or NULL if doesn't exist
+  * @param budget bytes of heap memory may use
+  * @param path spill file, or NULL for a temporary file in /tmp
+  * @return true if successful, false if the file can't be created
   */
-struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* varname)
+bool ram_spill_enable(struct RAM* memory, long budget, const char* path)
 {
-  for(int i=0; i < memory->size; i++) {
-    if (strcmp(varname, memory->map[i].varname) == 0) {
-      struct RAM_VALUE* copy = (struct RAM_VALUE*) malloc(sizeof(struct RAM_VALUE));
-      int address = memory->map[i].cell;
-      copy->value_type = memory->cells[address].value_type;
-
-      if(memory->cells[address].value_type == RAM_TYPE_STR){
-        copy->types.s = strdup(memory->cells[address].types.s);
-        //copy->types.s = memory->cells[i].types.s;
-      }
-      else if (memory->cells[address].value_type == RAM_TYPE_REAL){
-        copy->types.d = memory->cells[address].types.d;
-      }
-      else {
-        copy->types.i = memory->cells[address].types.i;
-      }
-      return copy;
-    }
+  if (memory == NULL)
+    return false;
+
+  if (memory->spill != NULL) {
+    ram_spill_budget(memory->spill, budget);
+    spill_enforce(memory, -1);
+    return true;
+  }
+
+  struct RAM_SPILL* spill = ram_spill_create(path, budget, memory->arena);
+  if (spill == NULL)
+    return false;
+  ram_spill_resize(spill, memory->capacity);
+  memory->spill = spill;
+
+  // strings already in memory count as used in address order:
+  for (int address = 0; address < memory->capacity; address++) {
+    struct RAM_VALUE* cell = cell_ptr(memory, address);
+    if (cell->value_type == RAM_TYPE_STR && cell->types.s != NULL)
+      ram_spill_touch(spill, address);
   }
-  return NULL;
+
+  spill_enforce(memory, -1);
+  return true;
 }
 
 
 /**
-  * @brief ram_free_value: free value returned by read_cell() functions
-  *
-  * Frees the memory value returned by ram_read_cell_by_name and
-  * ram_read_cell_by_addr.
+  * @brief ram_spill_enforce: spill strings again until memory is within budget
   *
-  * @param value Pointer to struct containing value
+  * @param memory Pointer to struct denoting memory unit
   * @return void
   */
-void ram_free_value(struct RAM_VALUE* value)
+void ram_spill_enforce(struct RAM* memory)
 {
-  if(value == NULL){
+  if (memory == NULL)
     return;
-  }
-  if(value->value_type == RAM_TYPE_STR) {
-    free(value->types.s);
-  }
-  free(value);
-  return;
+
+  spill_enforce(memory, -1);
 }
 
 
 /**
-  * @brief ram_write_cell_by_addr: writes a value to memory cell at this address
-  *
-  * Writes the given value to the memory cell at the given 
-  * address. If a value already exists at this address, that
-  * value is overwritten by this new value. Returns true if 
-  * the value was successfully written, false if not (which 
-  * implies the memory address is invalid).
-  *
-  * NOTE: if the value being written is a string, it will
-  * be duplicated and stored.
-  * 
-  * NOTE: a variable has to be written to memory before its
-  * address becomes valid. Once a variable is written to memory,
-  * its address never changes.
+  * @brief ram_shm_use: fall through to a segment for names memory lacks
   *
   * @param memory Pointer to struct denoting memory unit
-  * @param value value to be written to memory
-  * @param address memory cell address
-  * @return true if successful, false if not (invalid address)
+  * @param shm Pointer to segment, or NULL to stop
+  * @return void
   */
-bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address)
+void ram_shm_use(struct RAM* memory, struct RAM_SHM* shm)
 {
   if (memory == NULL)
-    return false;
-  // if overwriting a string, free the old one
-  if (address < memory->capacity && address >= 0) {
-    if (memory->cells[address].value_type == RAM_TYPE_STR && memory->cells[address].types.s != NULL) {
-      free(memory->cells[address].types.s);
-    }
-
-    memory->cells[address].value_type = value.value_type;
+    return;
 
-    if(memory->cells[address].value_type == RAM_TYPE_STR) {
-      memory->cells[address].types.s = strdup(value.types.s);
-    }
-    else if (memory->cells[address].value_type == RAM_TYPE_REAL) {
-      memory->cells[address].types.d = value.types.d;
-    }
-    else {
-      memory->cells[address].types.i = value.types.i;
-    }
-    return true;
-  }
-  else {
-    return false;
-  }
+  memory->shared = shm;
 }
 
 
 /**
-  * ram_write_cell_by_name
-  *
-  * Writes the given value to a memory cell named by the given
-  * variable. If a memory cell already exists with this name,
-  * the existing value is overwritten by this new value. Returns
-  * true since this operation always succeeds.
-  *
-  * NOTE: if the value being written is a string, it will
-  * be duplicated and stored.
-  *
-  * NOTE: a variable has to be written to memory before its
-  * address becomes valid. Once a variable is written to memory,
-  * its address never changes.
+  * @brief ram_hash_enable: keep a content hash of memory
   *
   * @param memory Pointer to struct denoting memory unit
-  * @param value value to be written to memory
-  * @param varname variable name
-  * @return true (always successful)
+  * @return void
   */
-bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* varname)
+void ram_hash_enable(struct RAM* memory)
 {
-  // check if var already exists
-  int address = ram_get_addr(memory, varname);
-  if (address != -1) {
-    ram_write_cell_by_addr(memory, value, address);
-    return true;
-  }
+  if (memory == NULL || memory->hash != NULL)
+    return;
 
-  // Double memory if capacity = size
-  if (memory->size >= memory->capacity) 
-    double_memory(memory);
+  memory->hash = ram_hash_create(memory->arena);
 
-  // Store var alphabetically
-  int index = 0;
-  while (index < memory->size && strcmp(varname, memory->map[index].varname) > 0) {
-    index++;
-  }
+  for (int i = 0; i < memory->size; i++) {
+    int address = memory->map[i].cell;
+    ram_hash_insert(memory->hash, address, memory->map[i].varname);
 
-  for (int i= memory->size; i > index; i--) {
-    memory->map[i] = memory->map[i - 1];
+    // ram_get_array() may have handed it out already:
+    int type = cell_ptr(memory, address)->value_type;
+    if (type == RAM_TYPE_INT_ARRAY || type == RAM_TYPE_REAL_ARRAY)
+      ram_hash_expose(memory->hash, address);
   }
+}
 
-  memory->map[index].varname = strdup(varname);
-  memory->map[index].cell = memory->size;
-
-  ram_write_cell_by_addr(memory, value, memory->size);
+//
+// hashes the values changed since memory's hash was last asked for;
+// false if a spilled string could not be read back, in which case
+// the next call tries again:
+//
+static bool hash_refresh(struct RAM* memory)
+{
+  ram_hash_enable(memory);
+  ram_hash_touch_exposed(memory->hash);
 
-  memory->size++;
+  bool ok = true;
+  int address;
+  while ((address = ram_hash_next_changed(memory->hash)) != -1) {
+    bool spilled = is_spilled(memory, address);
+    flatten(memory, address);
+    if (!fault_in(memory, address)) {
+      ok = false;
+      continue;
+    }
+    ram_hash_set(memory->hash, address, cell_ptr(memory, address));
 
-  return true;
+    if (spilled)
+      spill_enforce(memory, -1);
+  }
 
+  if (!ok)
+    ram_hash_touch_all(memory->hash);
+  return ok;
 }
 
 
-
 /**
-  * @brief ram_print: prints the contents of memory
-  *
-  * Prints the contents of RAM to the console, for debugging.
-  * RAM is printed in alphabetical order by variable name.
+  * @brief ram_equal: do two memories hold the same variables and values?
   *
-  * @param memory Pointer to struct denoting memory unit
-  * @return void
+  * @param memory1 Pointer to a memory unit
+  * @param memory2 Pointer to another memory unit
+  * @return true if every name has the same type and value in both,
+  *         false if not or a string can't be read back from the
+  *         spill file
   */
-void ram_print(struct RAM* memory)
+bool ram_equal(struct RAM* memory1, struct RAM* memory2)
 {
-  printf("**MEMORY PRINT**\n");
+  if (memory1 == NULL || memory2 == NULL)
+    return false;
 
-  printf("Size: %d\n", memory->size);
-  printf("Capacity: %d\n", memory->capacity);
-  printf("Contents:\n");
+  bool ok1 = hash_refresh(memory1);
+  bool ok2 = hash_refresh(memory2);
+  if (!ok1 || !ok2)
+    return false;
 
-  for (int i = 0; i < memory->size; i++)
-  {
-   printf(" %s: ", memory->map[i].varname);
+  return ram_hash_root(memory1->hash) == ram_hash_root(memory2->hash);
+}
 
-   if (memory->cells[i].value_type == RAM_TYPE_INT) {
-    printf("int, %d", memory->cells[i].types.i);
-   }
-   else if (memory->cells[i].value_type == RAM_TYPE_REAL) {
-    printf("real, %lf", memory->cells[i].types.d);
-   }
-   else if (memory->cells[i].value_type == RAM_TYPE_STR) {
-    printf("str, '%s'", memory->cells[i].types.s);
-   }
-   else if (memory->cells[i].value_type == RAM_TYPE_PTR) {
-    printf("ptr, %d", memory->cells[i].types.i);
-   }
-   else if(memory->cells[i].value_type == RAM_TYPE_BOOLEAN) {
-    if (memory->cells[i].types.i == 0)
-      printf("boolean, False");
-    else
-      printf("boolean, True");
-   }
-   else {
-   printf("none, None");
-   }
-  
-   printf("\n");
-  }
 
-  printf("**END PRINT**\n");
+/**
+  * @brief ram_diff: visit the variables two memories disagree on
+  *
+  * @param memory1 Pointer to a memory unit
+  * @param memory2 Pointer to another memory unit
+  * @param visit function to call for each variable that differs,
+  *        or NULL to just count them
+  * @param arg passed through to visit
+  * @return # of variables that differ, or -1 (and nothing is
+  *         visited) if a string can't be read back from the spill
+  *         file
+  */
+int ram_diff(struct RAM* memory1, struct RAM* memory2, RAM_DIFF_VISITOR visit, void* arg)
+{
+  if (memory1 == NULL || memory2 == NULL)
+    return 0;
+
+  bool ok1 = hash_refresh(memory1);
+  bool ok2 = hash_refresh(memory2);
+  if (!ok1 || !ok2)
+    return -1;
+
+  return ram_hash_diff(memory1->hash, memory2->hash, visit, arg);
 }
 
 
 /**
-  * @brief ram_print_map: prints the contents of memory map
-  *
-  * Prints contents of RAM map to the console, for debugging.
+  * @brief ram_content_hash: hash of every variable's name and value
   *
   * @param memory Pointer to struct denoting memory unit
-  * @return void
+  * @return root hash, or 0 if a string can't be read back from the
+  *         spill file
   */
-void ram_print_map(struct RAM* memory)
+uint64_t ram_content_hash(struct RAM* memory)
 {
-  printf("**MEMORY MAP PRINT**\n");
+  if (memory == NULL)
+    return 0;
 
-  for (int i = 0; i < memory->size; i++)
-  {
-   printf(" %s: %d\n", memory->map[i].varname, memory->map[i].cell);
-  }
+  if (!hash_refresh(memory))
+    return 0;
 
-  printf("**END PRINT**\n");
+  return ram_hash_root(memory->hash);
 }
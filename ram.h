@@ -12,7 +12,9 @@
 
 #pragma once
 
+#include <stddef.h>   // size_t
 #include <stdbool.h>  // true, false
+#include <stdint.h>   // int64_t
 
 
 //
@@ -25,7 +27,22 @@ enum RAM_VALUE_TYPES
   RAM_TYPE_STR,
   RAM_TYPE_PTR,
   RAM_TYPE_BOOLEAN,
-  RAM_TYPE_NONE
+  RAM_TYPE_NONE,
+  RAM_TYPE_INT_ARRAY,
+  RAM_TYPE_REAL_ARRAY,
+  RAM_TYPE_BIGINT
+};
+
+struct RAM_ARRAY
+{
+  int elem_type;  // RAM_TYPE_INT or RAM_TYPE_REAL
+  int length;     // # of elements
+
+  union
+  {
+    int*    i;  // INT elements
+    double* d;  // REAL elements
+  } elems;
 };
 
 struct RAM_VALUE
@@ -43,6 +60,8 @@ struct RAM_VALUE
     int    i; // INT, PTR, BOOLEAN
     double d; // REAL
     char*  s; // STR 
+    struct RAM_ARRAY* a; // INT_ARRAY, REAL_ARRAY (see ram_array.h)
+    int64_t n;           // BIGINT, a RAM_INT (see ram_bigint.h)
   } types;
 };
 
@@ -52,12 +71,104 @@ struct RAM_MAP
   int   cell;     // memory cell assigned to variable
 };
 
+struct RAM_INTERN;  // string intern table, private to ram.c
+struct RAM_TXN;     // undo log of open transactions, private to ram.c
+struct RAM_LAYOUT;  // cell order set by ram_optimize_layout, private to ram.c
+struct RAM_ROPE;    // chars appended to a string, private to ram.c
+struct RAM_INDEX;   // search tree over the map's names, private to ram.c
+struct RAM_BTREE;   // B-tree of names, see ram_btree.h
+struct RAM_TRACE;   // event buffer, see ram_trace.h
+struct RAM_WAL;     // write-ahead log, see ram_wal.h
+struct RAM_SPILL;   // spill file for cold strings, see ram_spill.h
+struct RAM_SHM;     // shared constants, see ram_shm.h
+struct RAM_REPL;    // replication stream, see ram_repl.h
+struct RAM_HASH;    // content hash tree, see ram_hash.h
+struct RAM_ARENA;   // allocation arena, see ram_alloc.h
+struct RAM_ALLOCATOR;  // custom allocator hooks, see ram_alloc.h
+
+//
+// String values are counted in buckets by length:
+// < 16, < 64, < 256, < 4096, and >= 4096 chars.
+//
+#define RAM_STR_BUCKETS 5
+
+//
+// The first RAM_INLINE_CELLS cells and map entries live inside
+// struct RAM itself; cells and map point there until capacity
+// grows past them, so a small program's memory is one allocation.
+// A struct RAM must therefore never be copied.
+//
+#define RAM_INLINE_CELLS 16
+
+struct RAM_FOOTPRINT
+{
+  long name_bytes;                   // variable names, incl. '\0'
+  long array_bytes;                  // array values
+  long bigint_bytes;                 // big ints too large for the cell
+  long str_count[RAM_STR_BUCKETS];   // # of string buffers per bucket
+  long str_bytes[RAM_STR_BUCKETS];   // bytes of string buffers per bucket
+};
+
 struct RAM
 {
   struct RAM_VALUE* cells;  // array of memory cells
   struct RAM_MAP*   map;    // ordered array to map vars to memory cells
+                            // (address order if btree != NULL)
   int size;                 // # of vars currently in memory
   int capacity;             // total # of cells available in memory
+
+  struct RAM_ARENA*  arena;   // where allocations come from, NULL => malloc
+  struct RAM_INTERN* intern;  // shared string values, NULL if not enabled
+  struct RAM_TXN*    txn;     // undo log, NULL until first ram_txn_begin()
+  struct RAM_LAYOUT* layout;  // address => cell index, NULL if cells[i] is address i
+  unsigned int*      hits;    // accesses per address, NULL unless profiling
+  struct RAM_ROPE**  ropes;   // pending appends per address, NULL until first append
+  struct RAM_INDEX*  index;   // built by ram_get_addr() once memory is large
+  struct RAM_BTREE*  btree;   // names in order, NULL unless ram_map_btree_enable()
+  struct RAM_TRACE*  trace;   // where operations are recorded, NULL if not tracing
+  struct RAM_WAL*    wal;     // where writes are logged, NULL if not logging
+  struct RAM_REPL*   repl;    // where changes are sent, NULL if not replicating
+  struct RAM_SPILL*  spill;   // where cold strings go, NULL unless ram_spill_enable()
+  struct RAM_SHM*    shared;  // constants names fall through to, NULL unless ram_shm_use()
+  struct RAM_HASH*   hash;    // content hash tree, NULL unless ram_hash_enable()
+
+  struct RAM_FOOTPRINT footprint;  // heap bytes, see ram_memory_usage()
+
+  struct RAM_VALUE inline_cells[RAM_INLINE_CELLS];  // cells, while capacity fits
+  struct RAM_MAP   inline_map[RAM_INLINE_CELLS];    // map, while capacity fits
+  bool             placed;  // in caller's storage (ram_init_at()), not freed by ram_destroy()
+};
+
+struct RAM_MEMORY_USAGE
+{
+  long ram_bytes;     // struct RAM itself
+  long cell_bytes;    // cells in use
+  long map_bytes;     // map entries in use
+  long unused_bytes;  // cells and map entries allocated but not in use
+  long name_bytes;    // variable names
+  long string_bytes;  // string values, sum of str_bytes[]
+  long str_count[RAM_STR_BUCKETS];  // # of string buffers by length bucket
+  long str_bytes[RAM_STR_BUCKETS];  // bytes of string buffers by length bucket
+  long array_bytes;   // array values
+  long bigint_bytes;  // big ints too large for the cell
+  long intern_bytes;  // intern table structure (not the strings)
+  long index_bytes;   // name index or B-tree used by ram_get_addr()
+  long total_bytes;   // sum of all of the above
+};
+
+//
+// Function called for each cell by ram_for_each() and friends.
+// varname is NULL when cells are visited in address order.
+//
+typedef void (*RAM_VISITOR)(struct RAM_VALUE* cell, int address, char* varname, void* arg);
+
+struct RAM_INTERN_STATS
+{
+  long   lookups;         // # of strings written through the table
+  long   hits;            // # of writes that reused an existing string
+  double hit_rate;        // hits / lookups
+  int    unique_strings;  // # of distinct strings currently stored
+  long   bytes_saved;     // bytes not allocated thanks to hits
 };
 
 
@@ -78,6 +189,66 @@ struct RAM
   */
 struct RAM* ram_init(void);
 
+/**
+  * @brief ram_init_arena: initialize memory unit with its own arena
+  *
+  * Same as ram_init(), but the memory and everything it allocates
+  * (names, values, and the copies returned by the read functions)
+  * come from a private arena instead of the global malloc. This
+  * avoids allocator contention when many interpreters run on
+  * different threads. The arena is freed once the memory is
+  * destroyed and every value read from it has been freed.
+  *
+  * NOTE: like the memory itself, the arena is not thread-safe.
+  * Values read from this memory must be freed by the thread
+  * using the memory.
+  *
+  * @param chunk_bytes arena chunk size, or 0 for the default (64KB)
+  * @return pointer to struct denoting memory unit
+  */
+struct RAM* ram_init_arena(size_t chunk_bytes);
+
+/**
+  * @brief ram_init_with_allocator: initialize memory unit over a custom allocator
+  *
+  * Same as ram_init_arena(), but the memory and everything it
+  * allocates, including the copies returned by the read functions
+  * (and freed by ram_free_value()), come from the given
+  * allocator's hooks. The hooks are used until the memory is
+  * destroyed and every value read from it has been freed. That
+  * includes its spill state, hash tree and dump cursors, but not
+  * objects created on their own and then attached to it (logs,
+  * traces, replication streams, worker pools, shared segments),
+  * nor the arrays and big ints of ram_array.h and ram_bigint.h,
+  * the scratch space of a parallel sort or checkpoint, or the
+  * digits ram_print() formats a big int into: these use malloc.
+  *
+  * @param allocator hooks to use; copied
+  * @return pointer to struct denoting memory unit
+  */
+struct RAM* ram_init_with_allocator(const struct RAM_ALLOCATOR* allocator);
+
+/**
+  * @brief ram_init_at: initialize memory unit in storage you provide
+  *
+  * Same as ram_init(), but the memory is placed in the given
+  * storage, typically a local variable, so initializing it takes
+  * no allocation at all:
+  *
+  *   struct RAM storage;
+  *   struct RAM* memory = ram_init_at(&storage);
+  *   ...
+  *   ram_destroy(memory);
+  *
+  * ram_destroy() frees whatever the memory allocated since (names,
+  * values, cells past RAM_INLINE_CELLS) but not the storage, which
+  * must outlive the memory and must not be moved.
+  *
+  * @param storage where to place the memory
+  * @return storage, as a pointer to struct denoting memory unit
+  */
+struct RAM* ram_init_at(struct RAM* storage);
+
 /**
   * @brief ram_destroy: frees memory associated with memory unit
   * 
@@ -89,6 +260,37 @@ struct RAM* ram_init(void);
   */
 void ram_destroy(struct RAM* memory);
 
+/**
+  * @brief ram_reset: clears memory unit but keeps its capacity
+  *
+  * Frees the variable names and string values stored in the
+  * given memory, and resets every cell to the value None. The
+  * cells and map arrays are kept, so the memory can be reused
+  * for another program without any new allocations until it
+  * grows beyond its current capacity. Whatever is attached or
+  * enabled (log, trace, interning, spilling, ...) stays so, and is
+  * told of the reset; ram_recycle() also turns them off.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_reset(struct RAM* memory);
+
+/**
+  * @brief ram_recycle: clears memory unit for a new owner
+  *
+  * Detaches the trace, write-ahead log, replication stream and
+  * shared constants without telling them about it, clears memory
+  * like ram_reset(), then turns off interning, spilling (removing
+  * the spill file), content hashing, profiling and the B-tree map.
+  * What is left is a memory like a new one from ram_init(), but
+  * with the capacity of its cells, map and undo log kept.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_recycle(struct RAM* memory);
+
 /**
   * @brief ram_size: # of vars in memory
   *
@@ -131,7 +333,8 @@ int ram_get_addr(struct RAM* memory, char* varname);
   *
   * Given a memory address (an integer in the range 0..N-1), 
   * returns a COPY of the value contained in that memory cell.
-  * Returns NULL if the address is not valid.
+  * Returns NULL if the address is not valid, or if its string
+  * can't be read back from the spill file (see ram_spill.h).
   * 
   * NOTE: this function allocates memory for the value that
   * is returned. The caller takes ownership of the copy and 
@@ -152,7 +355,10 @@ struct RAM_VALUE* ram_read_cell_by_addr(struct RAM* memory, int address);
   *
   * If the given variable (e.g. "x") has been written to 
   * memory, returns a COPY of the value contained in memory.
-  * Returns NULL if no such name exists in memory.
+  * Returns NULL if no such name exists in memory, or if its
+  * string can't be read back from the spill file.
+  * Names not in memory fall through to its shared constants,
+  * if any (see ram_shm.h).
   *
   * NOTE: this function allocates memory for the value that
   * is returned. The caller takes ownership of the copy and 
@@ -168,7 +374,9 @@ struct RAM_VALUE* ram_read_cell_by_name(struct RAM* memory, char* varname);
   * @brief ram_free_value: free value returned by read_cell() functions
   *
   * Frees the memory value returned by ram_read_cell_by_name and
-  * ram_read_cell_by_addr.
+  * ram_read_cell_by_addr. Only such values may be passed: the
+  * copy is preceded by a header saying where it came from, which
+  * a RAM_VALUE you built yourself lacks.
   *
   * @param value Pointer to struct containing value
   * @return void
@@ -184,8 +392,8 @@ void ram_free_value(struct RAM_VALUE* value);
   * the value was successfully written, false if not (which 
   * implies the memory address is invalid).
   *
-  * NOTE: if the value being written is a string, it will
-  * be duplicated and stored.
+  * NOTE: if the value being written is a string or an
+  * array, it will be duplicated and stored.
   * 
   * NOTE: a variable has to be written to memory before its
   * address becomes valid. Once a variable is written to memory,
@@ -194,7 +402,9 @@ void ram_free_value(struct RAM_VALUE* value);
   * @param memory Pointer to struct denoting memory unit
   * @param value value to be written to memory
   * @param address memory cell address
-  * @return true if successful, false if not (invalid address)
+  * @return true if successful, false if not (invalid address, or
+  *         an open transaction has to save the old value, a string
+  *         in the spill file, and it can't be read back)
   */
 bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int address);
 
@@ -204,10 +414,11 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
   * Writes the given value to a memory cell named by the given
   * variable. If a memory cell already exists with this name,
   * the existing value is overwritten by this new value. Returns
-  * true since this operation always succeeds.
+  * true unless an open transaction has to save the old value, a
+  * string in the spill file, and it can't be read back.
   *
-  * NOTE: if the value being written is a string, it will
-  * be duplicated and stored.
+  * NOTE: if the value being written is a string or an
+  * array, it will be duplicated and stored.
   *
   * NOTE: a variable has to be written to memory before its
   * address becomes valid. Once a variable is written to memory,
@@ -216,10 +427,125 @@ bool ram_write_cell_by_addr(struct RAM* memory, struct RAM_VALUE value, int addr
   * @param memory Pointer to struct denoting memory unit
   * @param value value to be written to memory
   * @param varname variable name
-  * @return true (always successful)
+  * @return true if successful, false if not (see above)
   */
 bool ram_write_cell_by_name(struct RAM* memory, struct RAM_VALUE value, char* varname);
 
+/**
+  * @brief ram_write_str_by_addr: writes a string of given length at this address
+  *
+  * Same as ram_write_cell_by_addr() with a string value, but the
+  * length is given rather than found with strlen, so the string
+  * may contain '\0' chars. If the cell already holds a string
+  * whose buffer is big enough, the buffer is reused in place.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param s chars of the string
+  * @param len # of chars
+  * @param address memory cell address
+  * @return true if successful, false if not (invalid address)
+  */
+bool ram_write_str_by_addr(struct RAM* memory, const char* s, int len, int address);
+
+/**
+  * @brief ram_write_str_by_name: writes a string of given length to a variable
+  *
+  * Same as ram_write_cell_by_name() with a string value, but the
+  * length is given rather than found with strlen, so the string
+  * may contain '\0' chars.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param s chars of the string
+  * @param len # of chars
+  * @param varname variable name
+  * @return true if successful, false if not (bad arguments)
+  */
+bool ram_write_str_by_name(struct RAM* memory, const char* s, int len, char* varname);
+
+/**
+  * @brief ram_append_str_by_addr: appends chars to the string at this address
+  *
+  * Adds s[0..len) to the end of the string in the cell at the
+  * given address, without copying the string: the chars go into
+  * spare room in its buffer, or into a rope of chunks that is
+  * flattened the next time the string is read, compared or
+  * visited. Building a string of n chars by appends takes O(n)
+  * time overall, where s = s + piece through the read and write
+  * functions takes O(n^2).
+  *
+  * NOTE: until the string is flattened, memory->cells holds only
+  * the chars before the pending appends; see ram_str_flatten().
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param s chars to append
+  * @param len # of chars
+  * @param address memory cell address
+  * @return true if successful, false if not (invalid address, the
+  *         cell does not hold a string, or its string can't be
+  *         read back from the spill file)
+  */
+bool ram_append_str_by_addr(struct RAM* memory, const char* s, int len, int address);
+
+/**
+  * @brief ram_append_str_by_name: appends chars to a string variable
+  *
+  * Same as ram_append_str_by_addr(), for the cell of the given
+  * variable.
+  * A shared constant (see ram_shm.h) is first copied into
+  * memory.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param s chars to append
+  * @param len # of chars
+  * @param varname variable name
+  * @return true if successful, false if not (no such variable, or
+  *         it does not hold a string)
+  */
+bool ram_append_str_by_name(struct RAM* memory, const char* s, int len, char* varname);
+
+/**
+  * @brief ram_str_flatten: the string at this address, as one buffer
+  *
+  * Moves any chars appended to the string in the cell at the
+  * given address into its buffer, and reads the string back in if
+  * it was spilled (see ram_spill.h), so memory->cells holds the
+  * whole string. The read functions, ram_cells_equal(),
+  * ram_for_each() and ram_for_each_sorted() do this themselves.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param address memory cell address
+  * @return the cell's chars, owned by memory, or NULL if the
+  *         address is invalid, the cell does not hold a string, or
+  *         its string can't be read back from the spill file
+  */
+char* ram_str_flatten(struct RAM* memory, int address);
+
+/**
+  * @brief ram_str_flatten_all: flatten every string with pending appends
+  *
+  * Also reads back every spilled string, which can take memory
+  * over its spill budget; call ram_spill_enforce() once the cells
+  * are no longer in use. One that can't be read back stays
+  * spilled, and ram_for_each_range() skips its cell.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return true if successful, false if a string can't be read
+  *         back from the spill file
+  */
+bool ram_str_flatten_all(struct RAM* memory);
+
+/**
+  * @brief ram_str_len: length of a string value
+  *
+  * String values kept by memory carry their length, so this is
+  * O(1) and counts any '\0' chars inside the string.
+  *
+  * @param value a value returned by the read functions, or one
+  *        of memory->cells (see ram_str_flatten())
+  * @return # of chars, or -1 if value is not a string
+  */
+int ram_str_len(struct RAM_VALUE* value);
+
 /**
   * @brief ram_print: prints the contents of memory
   *
@@ -240,3 +566,295 @@ void ram_print(struct RAM* memory);
   * @return void
   */
 void ram_print_map(struct RAM* memory);
+
+/**
+  * @brief ram_intern_enable: share storage between equal strings
+  *
+  * Turns on string interning for the given memory. From now on,
+  * string values written to memory are stored once in a
+  * refcounted intern table, and cells holding equal strings point
+  * to the same buffer. Strings already in memory are moved into
+  * the table. Returns false if a transaction is open, since the
+  * strings saved for a rollback can't be moved. Calling this on a
+  * memory that already interns strings has no effect.
+  *
+  * NOTE: interned strings are shared, never modify a string
+  * through memory->cells; ram_read_cell functions still return
+  * private copies.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return true if successful, false if a transaction is open or a
+  *         string can't be read back from the spill file
+  */
+bool ram_intern_enable(struct RAM* memory);
+
+/**
+  * @brief ram_intern_stats: statistics of the string intern table
+  *
+  * Fills in stats for the given memory. Returns false (and leaves
+  * stats untouched) if interning is not enabled.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param stats Pointer to struct to fill in
+  * @return true if interning is enabled, false if not
+  */
+bool ram_intern_stats(struct RAM* memory, struct RAM_INTERN_STATS* stats);
+
+/**
+  * @brief ram_cells_equal: compares the values in two memory cells
+  *
+  * Returns true if the cells at the two addresses hold the same
+  * type and value. When interning is enabled, strings are
+  * compared by pointer. Returns false if either address is
+  * invalid.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param addr1 first memory cell address
+  * @param addr2 second memory cell address
+  * @return true if equal, false if not
+  */
+bool ram_cells_equal(struct RAM* memory, int addr1, int addr2);
+
+/**
+  * @brief ram_get_array: array stored in memory for this variable
+  *
+  * If the given variable holds an int or real array, returns a
+  * pointer to the array stored in memory (NOT a copy), so the
+  * ram_array kernels can work on it in place. Returns NULL if no
+  * such variable exists or it does not hold an array.
+  *
+  * NOTE: the pointer is owned by memory and becomes invalid
+  * once the variable is overwritten or memory is destroyed.
+  *
+  * NOTE: a shared constant (see ram_shm.h) is first copied into
+  * memory, so changes to the array stay private.
+  *
+  * NOTE: changes made through the pointer are not logged or
+  * replicated until ram_array_changed() is called. In a
+  * transaction, the first call saves the array so a rollback
+  * puts it back; changes through a pointer from before the
+  * transaction began are not undone.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param varname variable name
+  * @return pointer to array in memory, or NULL
+  */
+struct RAM_ARRAY* ram_get_array(struct RAM* memory, char* varname);
+
+/**
+  * @brief ram_array_changed: log a change made to an array in place
+  *
+  * Logs the variable's whole value to the write-ahead log and the
+  * replication stream (see ram_wal.h, ram_repl.h), as if it had
+  * been written. Call it once done changing an array returned by
+  * ram_get_array(), or, once the walk is over, for a cell a
+  * ram_for_each() visitor changed.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param varname variable name
+  * @return true if successful, false if no such variable exists,
+  *         or its string can't be read back from the spill file
+  */
+bool ram_array_changed(struct RAM* memory, char* varname);
+
+/**
+  * @brief ram_for_each: visit every variable's cell in storage order
+  *
+  * Calls visit(cell, address, NULL, arg) once for each of the N
+  * vars in memory, in the order their cells are stored: address
+  * order, unless ram_optimize_layout() has moved them. This is the
+  * cheapest way to scan all values since cells are contiguous.
+  * The visitor may modify cell values in place but must not write
+  * variables through the ram_write functions. Such changes are
+  * not logged, replicated or undone by a rollback; see
+  * ram_array_changed(). A spilled string is read back only for
+  * its visit and may be spilled again after, so the cell is valid
+  * only until visit returns.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param visit function to call for each cell
+  * @param arg passed through to visit
+  * @return void
+  */
+void ram_for_each(struct RAM* memory, RAM_VISITOR visit, void* arg);
+
+/**
+  * @brief ram_for_each_range: visit the cells stored in cells[begin..end)
+  *
+  * Like ram_for_each(), but only for cells stored at indices
+  * begin..end-1 of memory->cells. Visiting a set of ranges that
+  * cover 0..N-1 visits every variable exactly once. Unlike
+  * ram_for_each(), it does not flatten strings with pending
+  * appends; call ram_str_flatten_all() before splitting the work.
+  * Cells whose string it couldn't read back are skipped.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param begin first index to visit
+  * @param end one past the last index to visit
+  * @param visit function to call for each cell
+  * @param arg passed through to visit
+  * @return void
+  */
+void ram_for_each_range(struct RAM* memory, int begin, int end, RAM_VISITOR visit, void* arg);
+
+/**
+  * @brief ram_for_each_sorted: visit every variable in alphabetical order
+  *
+  * Calls visit(cell, address, varname, arg) for each variable in
+  * memory, in alphabetical order by name (the order of ram_print).
+  * Same restrictions as ram_for_each().
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param visit function to call for each variable
+  * @param arg passed through to visit
+  * @return void
+  */
+void ram_for_each_sorted(struct RAM* memory, RAM_VISITOR visit, void* arg);
+
+/**
+  * @brief ram_next_sorted: the variable that comes after a name
+  *
+  * Walks the variables in alphabetical order a step at a time,
+  * e.g. across interpreter steps: pass the name last returned to
+  * get the next one. Memory may change between calls; variables
+  * created since then are returned if they sort after it. A string
+  * value is flattened (and read back in if spilled) first; a
+  * variable whose string can't be read back is skipped.
+  *
+  * NOTE: the cell is not a copy, and only stays valid until
+  * memory is next changed.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param after name to start after, or NULL for the first variable
+  * @param hint where after was, as returned by the last call, or
+  *        -1; set to where this variable is. A wrong hint only
+  *        costs a search.
+  * @param varname set to the variable's name, owned by memory
+  * @param address set to the variable's address
+  * @return pointer to the variable's cell, or NULL if no variable
+  *         comes after
+  */
+struct RAM_VALUE* ram_next_sorted(struct RAM* memory, const char* after, int* hint, char** varname, int* address);
+
+/**
+  * @brief ram_memory_usage: heap bytes used by memory, by category
+  *
+  * Fills in usage with the exact # of bytes requested from the
+  * heap by the given memory (not counting the allocator's own
+  * overhead), broken down by category. The counts are kept up to
+  * date as memory changes, so this call is O(1) and may be made
+  * from another thread while memory is in use; in that case the
+  * categories may be momentarily out of step with each other.
+  *
+  * NOTE: with interning enabled, a shared string is counted once,
+  * including its refcount header. Values returned by the read
+  * functions belong to the caller and are not counted.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param usage Pointer to struct to fill in
+  * @return void
+  */
+void ram_memory_usage(struct RAM* memory, struct RAM_MEMORY_USAGE* usage);
+
+/**
+  * @brief ram_txn_begin: start a transaction
+  *
+  * From now on, writes to memory can be undone by
+  * ram_txn_rollback(). Transactions nest: each begin must be
+  * matched by a commit or a rollback, which applies to the
+  * innermost open transaction.
+  *
+  * NOTE: only writes made through ram_write_cell_by_addr and
+  * ram_write_cell_by_name are logged. Changes made in place
+  * (e.g. by a ram_for_each visitor) are not undone. ram_reset
+  * drops all open transactions.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_txn_begin(struct RAM* memory);
+
+/**
+  * @brief ram_txn_commit: keep the writes of the current transaction
+  *
+  * Closes the innermost open transaction. If it is the outermost
+  * one, the saved prior values are freed; otherwise its writes
+  * become part of the enclosing transaction and can still be
+  * rolled back by it. Returns false if no transaction is open.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return true if successful, false if no transaction is open
+  */
+bool ram_txn_commit(struct RAM* memory);
+
+/**
+  * @brief ram_txn_rollback: undo the writes of the current transaction
+  *
+  * Restores every cell written since the innermost open
+  * ram_txn_begin() to its prior value and removes the variables
+  * created since then, then closes that transaction. The cost is
+  * proportional to the # of writes made, not the size of memory.
+  * Returns false if no transaction is open.
+  *
+  * NOTE: capacity is not shrunk, and addresses handed out for
+  * variables removed by the rollback become invalid.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return true if successful, false if no transaction is open
+  */
+bool ram_txn_rollback(struct RAM* memory);
+
+/**
+  * @brief ram_txn_depth: # of open transactions
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return # of open transactions, 0 if none
+  */
+int ram_txn_depth(struct RAM* memory);
+
+/**
+  * @brief ram_profile_enable: start counting accesses per cell
+  *
+  * Each read or write of a cell through the ram_read, ram_write
+  * and ram_get_array functions increments that cell's counter.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_profile_enable(struct RAM* memory);
+
+/**
+  * @brief ram_access_count: # of accesses counted for a cell
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param address memory cell address
+  * @return access count, or 0 if profiling is off or the address is invalid
+  */
+unsigned int ram_access_count(struct RAM* memory, int address);
+
+/**
+  * @brief ram_optimize_layout: pack the most accessed cells together
+  *
+  * Stores the cells of the variables in memory in order of their
+  * access counts, most accessed first, then halves the counts.
+  * Addresses do not change, but afterwards memory->cells[i] is no
+  * longer the cell at address i: use the ram_read / ram_write
+  * functions or ram_for_each() to get at cells.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return true if successful, false if profiling is not enabled
+  */
+bool ram_optimize_layout(struct RAM* memory);
+
+/**
+  * @brief ram_map_btree_enable: keep variable names in a B-tree
+  *
+  * Creating a variable becomes O(log n) instead of shifting the
+  * map. memory->map then lists the vars in address order, not in
+  * alphabetical order; ram_print and ram_for_each_sorted still
+  * visit them alphabetically.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return true if successful, false if a transaction is open
+  */
+bool ram_map_btree_enable(struct RAM* memory);
@@ -0,0 +1,432 @@
+/*ram_alloc.c*/
+
+/**
+  * @brief Heap allocation for nuPython's memory unit
+  *
+  * Every allocation made by the RAM module goes through these
+  * functions, passing the memory's arena, or NULL for plain
+  * malloc. A block must be freed with the same arena it was
+  * allocated from.
+  *
+  * An arena gives one memory unit its own region: small blocks
+  * are carved out of large chunks and recycled through per-size
+  * free lists, so interpreters running on different threads don't
+  * contend on the global malloc. A custom arena keeps the block
+  * header, so its hooks are told each block's size, but leaves
+  * the rest to them.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+
+#include "ram_alloc.h"
+
+
+//
+// Header in front of every arena block (plain malloc blocks have
+// none). Its 16 bytes keep the block 16-byte aligned.
+//
+struct RAM_BLOCK
+{
+  size_t capacity;  // usable bytes after the header
+  size_t padding;
+};
+
+struct RAM_ARENA_CHUNK
+{
+  struct RAM_ARENA_CHUNK* next;  // next chunk of the same arena
+  size_t padding;                // keeps the data 16-byte aligned
+};
+
+#define MIN_CLASS_BYTES 32
+
+static size_t class_bytes(int size_class)
+{
+  return (size_t) MIN_CLASS_BYTES << size_class;
+}
+
+/**
+ * @brief size_class:
+ *
+ * smallest class whose blocks hold bytes plus the header
+ *
+ * @param bytes
+ *
+ * @return class index, or -1 if too big for the arena
+ */
+static int size_class(size_t bytes)
+{
+  size_t total = bytes + sizeof(struct RAM_BLOCK);
+
+  for (int c = 0; c < RAM_ARENA_CLASSES; c++) {
+    if (total <= class_bytes(c))
+      return c;
+  }
+  return -1;
+}
+
+static void* block_data(struct RAM_BLOCK* block)
+{
+  return (void*) (block + 1);
+}
+
+static struct RAM_BLOCK* block_header(void* ptr)
+{
+  return ((struct RAM_BLOCK*) ptr) - 1;
+}
+
+/**
+ * @brief arena_destroy:
+ *
+ * frees every chunk of the arena and the arena itself
+ *
+ * @param arena
+ *
+ * @return void
+ */
+static void arena_destroy(struct RAM_ARENA* arena)
+{
+  if (arena->custom) {
+    if (arena->allocator.free != NULL)
+      arena->allocator.free(arena->allocator.context, arena, sizeof(struct RAM_ARENA));
+    return;
+  }
+
+  struct RAM_ARENA_CHUNK* chunk = arena->chunks;
+  while (chunk != NULL) {
+    struct RAM_ARENA_CHUNK* next = chunk->next;
+    free(chunk);
+    chunk = next;
+  }
+  free(arena);
+
+  return;
+}
+
+/**
+ * @brief arena_carve:
+ *
+ * returns a new block of the given class, from a free list or
+ * from the current chunk
+ *
+ * @param arena
+ * @param c size class
+ *
+ * @return block header
+ */
+static struct RAM_BLOCK* arena_carve(struct RAM_ARENA* arena, int c)
+{
+  size_t bytes = class_bytes(c);
+
+  // free blocks are linked through their first word:
+  if (arena->free_lists[c] != NULL) {
+    struct RAM_BLOCK* block = (struct RAM_BLOCK*) arena->free_lists[c];
+    arena->free_lists[c] = *(void**) block;
+    arena->reused++;
+    return block;
+  }
+
+  if (arena->bump + bytes > arena->bump_end) {
+    // the rest of the current chunk is given up; blocks are at
+    // most 4KB so at most that much is wasted per chunk:
+    size_t chunk_bytes = arena->chunk_bytes;
+    if (chunk_bytes < sizeof(struct RAM_ARENA_CHUNK) + bytes)
+      chunk_bytes = sizeof(struct RAM_ARENA_CHUNK) + bytes;
+
+    struct RAM_ARENA_CHUNK* chunk = (struct RAM_ARENA_CHUNK*) malloc(chunk_bytes);
+    chunk->next = arena->chunks;
+    arena->chunks = chunk;
+    arena->num_chunks++;
+
+    arena->bump = (char*) (chunk + 1);
+    arena->bump_end = ((char*) chunk) + chunk_bytes;
+  }
+
+  struct RAM_BLOCK* block = (struct RAM_BLOCK*) arena->bump;
+  arena->bump += bytes;
+
+  return block;
+}
+
+
+//
+// blocks of a custom arena, header included:
+//
+static struct RAM_BLOCK* custom_alloc(struct RAM_ARENA* arena, size_t bytes)
+{
+  struct RAM_BLOCK* block = (struct RAM_BLOCK*) arena->allocator.alloc(arena->allocator.context, sizeof(struct RAM_BLOCK) + bytes);
+  block->capacity = bytes;
+  return block;
+}
+
+static void custom_free(struct RAM_ARENA* arena, struct RAM_BLOCK* block)
+{
+  if (arena->allocator.free != NULL)
+    arena->allocator.free(arena->allocator.context, block, sizeof(struct RAM_BLOCK) + block->capacity);
+}
+
+static struct RAM_BLOCK* custom_realloc(struct RAM_ARENA* arena, struct RAM_BLOCK* block, size_t bytes)
+{
+  if (arena->allocator.realloc != NULL) {
+    block = (struct RAM_BLOCK*) arena->allocator.realloc(arena->allocator.context, block,
+                                                         sizeof(struct RAM_BLOCK) + block->capacity,
+                                                         sizeof(struct RAM_BLOCK) + bytes);
+    block->capacity = bytes;
+    return block;
+  }
+
+  struct RAM_BLOCK* bigger = custom_alloc(arena, bytes);
+  memcpy(block_data(bigger), block_data(block), block->capacity);
+  custom_free(arena, block);
+  return bigger;
+}
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_arena_create: create an allocation arena
+  *
+  * Returns an empty arena that grabs memory from malloc in chunks
+  * of chunk_bytes (0 => 64KB). The arena is freed by
+  * ram_arena_release() once all its blocks are freed.
+  *
+  * @param chunk_bytes size of each chunk, or 0 for the default
+  * @return pointer to arena
+  */
+struct RAM_ARENA* ram_arena_create(size_t chunk_bytes)
+{
+  struct RAM_ARENA* arena = (struct RAM_ARENA*) malloc(sizeof(struct RAM_ARENA));
+
+  arena->chunk_bytes = (chunk_bytes == 0) ? 64 * 1024 : chunk_bytes;
+  arena->chunks = NULL;
+  arena->bump = NULL;
+  arena->bump_end = NULL;
+  for (int c = 0; c < RAM_ARENA_CLASSES; c++) {
+    arena->free_lists[c] = NULL;
+  }
+  arena->live = 0;
+  arena->released = false;
+  arena->custom = false;
+  memset(&arena->allocator, 0, sizeof(struct RAM_ALLOCATOR));
+  arena->allocs = 0;
+  arena->reused = 0;
+  arena->large_allocs = 0;
+  arena->num_chunks = 0;
+
+  return arena;
+}
+
+
+/**
+  * @brief ram_arena_create_custom: create an arena over custom hooks
+  *
+  * @param allocator hooks to use; copied
+  * @return pointer to arena
+  */
+struct RAM_ARENA* ram_arena_create_custom(const struct RAM_ALLOCATOR* allocator)
+{
+  struct RAM_ARENA* arena = (struct RAM_ARENA*) allocator->alloc(allocator->context, sizeof(struct RAM_ARENA));
+  memset(arena, 0, sizeof(struct RAM_ARENA));
+
+  arena->custom = true;
+  arena->allocator = *allocator;
+
+  return arena;
+}
+
+
+/**
+  * @brief ram_arena_release: give up ownership of an arena
+  *
+  * The arena is freed as soon as no block allocated from it is
+  * still in use, which may be right away or at a later
+  * ram_mem_free(). This lets values read from a memory outlive
+  * the memory, as they could without an arena.
+  *
+  * @param arena Pointer to arena
+  * @return void
+  */
+void ram_arena_release(struct RAM_ARENA* arena)
+{
+  if (arena == NULL)
+    return;
+
+  arena->released = true;
+  if (arena->live == 0)
+    arena_destroy(arena);
+
+  return;
+}
+
+
+/**
+  * @brief ram_arena_stats: statistics of an arena
+  *
+  * @param arena Pointer to arena
+  * @param stats Pointer to struct to fill in
+  * @return void
+  */
+void ram_arena_stats(struct RAM_ARENA* arena, struct RAM_ARENA_STATS* stats)
+{
+  stats->allocs = arena->allocs;
+  stats->reused = arena->reused;
+  stats->large_allocs = arena->large_allocs;
+  stats->live = arena->live;
+  stats->num_chunks = arena->num_chunks;
+
+  stats->reserved_bytes = 0;
+  for (struct RAM_ARENA_CHUNK* chunk = arena->chunks; chunk != NULL; chunk = chunk->next) {
+    stats->reserved_bytes += arena->chunk_bytes;
+  }
+
+  return;
+}
+
+
+/**
+  * @brief ram_mem_alloc: allocate a block
+  *
+  * Allocates bytes from the given arena, or from malloc if arena
+  * is NULL. Free it with ram_mem_free() and the same arena.
+  *
+  * @param arena Pointer to arena, or NULL
+  * @param bytes # of bytes needed
+  * @return pointer to block
+  */
+void* ram_mem_alloc(struct RAM_ARENA* arena, size_t bytes)
+{
+  if (arena == NULL)
+    return malloc(bytes);
+
+  struct RAM_BLOCK* block;
+  int c = size_class(bytes);
+
+  if (arena->custom) {
+    block = custom_alloc(arena, bytes);
+    arena->allocs++;
+  }
+  else if (c < 0) {
+    block = (struct RAM_BLOCK*) malloc(sizeof(struct RAM_BLOCK) + bytes);
+    block->capacity = bytes;
+    arena->large_allocs++;
+  }
+  else {
+    block = arena_carve(arena, c);
+    block->capacity = class_bytes(c) - sizeof(struct RAM_BLOCK);
+    arena->allocs++;
+  }
+
+  arena->live++;
+
+  return block_data(block);
+}
+
+
+/**
+  * @brief ram_mem_realloc: resize a block
+  *
+  * Like realloc: returns a block of the new size holding the old
+  * contents, which may be the same block. If ptr is NULL this is
+  * ram_mem_alloc(arena, bytes).
+  *
+  * @param arena arena ptr came from, or NULL
+  * @param ptr block to resize, or NULL
+  * @param bytes # of bytes needed
+  * @return pointer to block
+  */
+void* ram_mem_realloc(struct RAM_ARENA* arena, void* ptr, size_t bytes)
+{
+  if (arena == NULL)
+    return realloc(ptr, bytes);
+
+  if (ptr == NULL)
+    return ram_mem_alloc(arena, bytes);
+
+  struct RAM_BLOCK* block = block_header(ptr);
+
+  if (bytes <= block->capacity)
+    return ptr;
+
+  if (arena->custom)
+    return block_data(custom_realloc(arena, block, bytes));
+
+  // a block too big for the arena can grow in place:
+  if (size_class(block->capacity) < 0) {
+    block = (struct RAM_BLOCK*) realloc(block, sizeof(struct RAM_BLOCK) + bytes);
+    block->capacity = bytes;
+    return block_data(block);
+  }
+
+  void* bigger = ram_mem_alloc(arena, bytes);
+  memcpy(bigger, ptr, block->capacity);
+  ram_mem_free(arena, ptr);
+
+  return bigger;
+}
+
+
+/**
+  * @brief ram_mem_free: free a block
+  *
+  * Frees a block from ram_mem_alloc(), ram_mem_realloc() or
+  * ram_mem_strdup().
+  *
+  * @param arena arena ptr came from, or NULL
+  * @param ptr block to free, or NULL
+  * @return void
+  */
+void ram_mem_free(struct RAM_ARENA* arena, void* ptr)
+{
+  if (ptr == NULL)
+    return;
+
+  if (arena == NULL) {
+    free(ptr);
+    return;
+  }
+
+  struct RAM_BLOCK* block = block_header(ptr);
+  int c = size_class(block->capacity);
+
+  if (arena->custom) {
+    custom_free(arena, block);
+  }
+  else if (c < 0) {
+    free(block);
+  }
+  else {
+    // link into the free list through the block's first word:
+    *(void**) block = arena->free_lists[c];
+    arena->free_lists[c] = block;
+  }
+
+  arena->live--;
+  if (arena->released && arena->live == 0)
+    arena_destroy(arena);
+
+  return;
+}
+
+
+/**
+  * @brief ram_mem_strdup: duplicate a string
+  *
+  * @param arena Pointer to arena, or NULL
+  * @param s string to copy
+  * @return copy of s, free with ram_mem_free()
+  */
+char* ram_mem_strdup(struct RAM_ARENA* arena, const char* s)
+{
+  size_t len = strlen(s);
+  char* copy = (char*) ram_mem_alloc(arena, len + 1);
+  memcpy(copy, s, len + 1);
+
+  return copy;
+}
@@ -0,0 +1,177 @@
+/*ram_alloc.h*/
+
+/**
+  * @brief Heap allocation for nuPython's memory unit
+  *
+  * Every allocation made by the RAM module goes through these
+  * functions, passing the memory's arena, or NULL for plain
+  * malloc. A block must be freed with the same arena it was
+  * allocated from.
+  *
+  * An arena gives one memory unit its own region: small blocks
+  * are carved out of large chunks and recycled through per-size
+  * free lists, so interpreters running on different threads don't
+  * contend on the global malloc. An arena is not thread-safe; it
+  * must only be used by the thread using its memory unit.
+  *
+  * An arena can instead pass every block on to a custom allocator
+  * (see struct RAM_ALLOCATOR), so a memory unit can be routed to a
+  * tuned allocator or a per-request region.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <stddef.h>   // size_t
+#include <stdbool.h>  // true, false
+
+
+//
+// Blocks are rounded up to a power of 2 from 32 to 4096 bytes
+// (header included); bigger blocks go straight to malloc.
+//
+#define RAM_ARENA_CLASSES 8
+
+struct RAM_ARENA_CHUNK;  // chunk of arena memory, private to ram_alloc.c
+
+//
+// Custom allocator hooks, for ram_arena_create_custom(). Each
+// hook is passed context. Blocks handed out must be 16-byte
+// aligned. realloc may be NULL (alloc, copy and free are used
+// instead), and so may free (blocks are never freed, as with a
+// bump allocator that is reset as a whole).
+//
+struct RAM_ALLOCATOR
+{
+  void* (*alloc)(void* context, size_t bytes);
+  void* (*realloc)(void* context, void* ptr, size_t old_bytes, size_t bytes);
+  void  (*free)(void* context, void* ptr, size_t bytes);
+  void* context;
+};
+
+struct RAM_ARENA
+{
+  size_t chunk_bytes;                  // size of each chunk
+  struct RAM_ARENA_CHUNK* chunks;      // all chunks, freed with the arena
+  char* bump;                          // next unused byte in current chunk
+  char* bump_end;                      // end of current chunk
+  void* free_lists[RAM_ARENA_CLASSES]; // recycled blocks per size class
+  long live;                           // # of blocks allocated and not freed
+  bool released;                       // owner is done, free at live == 0
+  bool custom;                         // blocks come from allocator
+  struct RAM_ALLOCATOR allocator;      // hooks, if custom
+
+  long allocs;        // # of blocks handed out
+  long reused;        // # of blocks taken from a free list
+  long large_allocs;  // # of blocks too big for the arena
+  long num_chunks;    // # of chunks allocated
+};
+
+struct RAM_ARENA_STATS
+{
+  long allocs;         // # of blocks handed out by the arena
+  long reused;         // # of those taken from a free list
+  long large_allocs;   // # of blocks passed on to malloc
+  long live;           // # of arena blocks not yet freed
+  long num_chunks;     // # of chunks allocated
+  long reserved_bytes; // bytes in all chunks
+};
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_arena_create: create an allocation arena
+  *
+  * Returns an empty arena that grabs memory from malloc in chunks
+  * of chunk_bytes (0 => 64KB). The arena is freed by
+  * ram_arena_release() once all its blocks are freed.
+  *
+  * @param chunk_bytes size of each chunk, or 0 for the default
+  * @return pointer to arena
+  */
+struct RAM_ARENA* ram_arena_create(size_t chunk_bytes);
+
+/**
+  * @brief ram_arena_create_custom: create an arena over custom hooks
+  *
+  * Returns an arena that passes every block, and the arena itself,
+  * on to the given allocator rather than carving chunks. Released
+  * like any arena.
+  *
+  * @param allocator hooks to use; copied
+  * @return pointer to arena
+  */
+struct RAM_ARENA* ram_arena_create_custom(const struct RAM_ALLOCATOR* allocator);
+
+/**
+  * @brief ram_arena_release: give up ownership of an arena
+  *
+  * The arena is freed as soon as no block allocated from it is
+  * still in use, which may be right away or at a later
+  * ram_mem_free(). This lets values read from a memory outlive
+  * the memory, as they could without an arena.
+  *
+  * @param arena Pointer to arena
+  * @return void
+  */
+void ram_arena_release(struct RAM_ARENA* arena);
+
+/**
+  * @brief ram_arena_stats: statistics of an arena
+  *
+  * @param arena Pointer to arena
+  * @param stats Pointer to struct to fill in
+  * @return void
+  */
+void ram_arena_stats(struct RAM_ARENA* arena, struct RAM_ARENA_STATS* stats);
+
+/**
+  * @brief ram_mem_alloc: allocate a block
+  *
+  * Allocates bytes from the given arena, or from malloc if arena
+  * is NULL. Free it with ram_mem_free() and the same arena.
+  *
+  * @param arena Pointer to arena, or NULL
+  * @param bytes # of bytes needed
+  * @return pointer to block
+  */
+void* ram_mem_alloc(struct RAM_ARENA* arena, size_t bytes);
+
+/**
+  * @brief ram_mem_realloc: resize a block
+  *
+  * Like realloc: returns a block of the new size holding the old
+  * contents, which may be the same block. If ptr is NULL this is
+  * ram_mem_alloc(arena, bytes).
+  *
+  * @param arena arena ptr came from, or NULL
+  * @param ptr block to resize, or NULL
+  * @param bytes # of bytes needed
+  * @return pointer to block
+  */
+void* ram_mem_realloc(struct RAM_ARENA* arena, void* ptr, size_t bytes);
+
+/**
+  * @brief ram_mem_free: free a block
+  *
+  * Frees a block from ram_mem_alloc(), ram_mem_realloc() or
+  * ram_mem_strdup().
+  *
+  * @param arena arena ptr came from, or NULL
+  * @param ptr block to free, or NULL
+  * @return void
+  */
+void ram_mem_free(struct RAM_ARENA* arena, void* ptr);
+
+/**
+  * @brief ram_mem_strdup: duplicate a string
+  *
+  * @param arena Pointer to arena, or NULL
+  * @param s string to copy
+  * @return copy of s, free with ram_mem_free()
+  */
+char* ram_mem_strdup(struct RAM_ARENA* arena, const char* s);
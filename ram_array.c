@@ -0,0 +1,840 @@
+/*ram_array.c*/
+
+/**
+  * @brief Numeric array values for nuPython's memory unit
+  *
+  * A RAM_ARRAY is a contiguous array of ints or reals that can be
+  * stored in a single memory cell (value types RAM_TYPE_INT_ARRAY
+  * and RAM_TYPE_REAL_ARRAY), so numeric loops avoid boxing every
+  * element in its own RAM_VALUE. The kernels below use AVX2 or
+  * SSE2 when the CPU supports them, and plain loops otherwise.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#define RAM_ARRAY_X86 1
+#define AVX2 __attribute__((target("avx2")))
+#endif
+
+#include "ram.h"
+#include "ram_array.h"
+
+
+/**
+ * @brief detect_simd:
+ *
+ * best instruction set the CPU supports for the kernels
+ *
+ * @return RAM_SIMD_AVX2, RAM_SIMD_SSE2 or RAM_SIMD_SCALAR
+ */
+static int detect_simd(void)
+{
+#ifdef RAM_ARRAY_X86
+  __builtin_cpu_init();
+  if (__builtin_cpu_supports("avx2"))
+    return RAM_SIMD_AVX2;
+  return RAM_SIMD_SSE2;  // always present on x86-64
+#else
+  return RAM_SIMD_SCALAR;
+#endif
+}
+
+static const int cpu_simd = detect_simd();
+static int simd_level = cpu_simd;
+
+static int elem_size(int elem_type)
+{
+  return elem_type == RAM_TYPE_INT ? (int) sizeof(int) : (int) sizeof(double);
+}
+
+static bool same_shape(struct RAM_ARRAY* a, struct RAM_ARRAY* b)
+{
+  return a != NULL && b != NULL && a->elem_type == b->elem_type && a->length == b->length;
+}
+
+
+//
+// Scalar kernels, used when no SIMD is available and for the tail
+// elements that don't fill a whole vector. Int arithmetic is done
+// unsigned so overflow wraps instead of being undefined.
+//
+static long long sum_int_scalar(const int* x, int n)
+{
+  long long sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += x[i];
+  return sum;
+}
+
+static double sum_real_scalar(const double* x, int n)
+{
+  double sum = 0.0;
+  for (int i = 0; i < n; i++)
+    sum += x[i];
+  return sum;
+}
+
+static void minmax_int_scalar(const int* x, int n, int* min, int* max)
+{
+  for (int i = 0; i < n; i++) {
+    if (x[i] < *min) *min = x[i];
+    if (x[i] > *max) *max = x[i];
+  }
+}
+
+static void minmax_real_scalar(const double* x, int n, double* min, double* max)
+{
+  for (int i = 0; i < n; i++) {
+    if (x[i] < *min) *min = x[i];
+    if (x[i] > *max) *max = x[i];
+  }
+}
+
+static void add_int_scalar(int* dst, const int* a, const int* b, int n)
+{
+  for (int i = 0; i < n; i++)
+    dst[i] = (int) ((unsigned int) a[i] + (unsigned int) b[i]);
+}
+
+static void mul_int_scalar(int* dst, const int* a, const int* b, int n)
+{
+  for (int i = 0; i < n; i++)
+    dst[i] = (int) ((unsigned int) a[i] * (unsigned int) b[i]);
+}
+
+static void scale_int_scalar(int* x, int k, int n)
+{
+  for (int i = 0; i < n; i++)
+    x[i] = (int) ((unsigned int) x[i] * (unsigned int) k);
+}
+
+static void add_real_scalar(double* dst, const double* a, const double* b, int n)
+{
+  for (int i = 0; i < n; i++)
+    dst[i] = a[i] + b[i];
+}
+
+static void mul_real_scalar(double* dst, const double* a, const double* b, int n)
+{
+  for (int i = 0; i < n; i++)
+    dst[i] = a[i] * b[i];
+}
+
+static void scale_real_scalar(double* x, double k, int n)
+{
+  for (int i = 0; i < n; i++)
+    x[i] = x[i] * k;
+}
+
+static long long dot_int_scalar(const int* a, const int* b, int n)
+{
+  long long sum = 0;
+  for (int i = 0; i < n; i++)
+    sum += (long long) a[i] * b[i];
+  return sum;
+}
+
+static double dot_real_scalar(const double* a, const double* b, int n)
+{
+  double sum = 0.0;
+  for (int i = 0; i < n; i++)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+
+#ifdef RAM_ARRAY_X86
+//
+// SSE2 kernels (reals only, the int kernels need SSE4.1):
+//
+static double sum_real_sse2(const double* x, int n)
+{
+  __m128d acc0 = _mm_setzero_pd();
+  __m128d acc1 = _mm_setzero_pd();
+  int i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    acc0 = _mm_add_pd(acc0, _mm_loadu_pd(x + i));
+    acc1 = _mm_add_pd(acc1, _mm_loadu_pd(x + i + 2));
+  }
+  acc0 = _mm_add_pd(acc0, acc1);
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc0);
+  return lanes[0] + lanes[1] + sum_real_scalar(x + i, n - i);
+}
+
+static void minmax_real_sse2(const double* x, int n, double* min, double* max)
+{
+  __m128d vmin = _mm_set1_pd(*min);
+  __m128d vmax = _mm_set1_pd(*max);
+  int i = 0;
+
+  for (; i + 2 <= n; i += 2) {
+    __m128d v = _mm_loadu_pd(x + i);
+    vmin = _mm_min_pd(vmin, v);
+    vmax = _mm_max_pd(vmax, v);
+  }
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, vmin);
+  *min = lanes[0] < lanes[1] ? lanes[0] : lanes[1];
+  _mm_storeu_pd(lanes, vmax);
+  *max = lanes[0] > lanes[1] ? lanes[0] : lanes[1];
+
+  minmax_real_scalar(x + i, n - i, min, max);
+}
+
+static void add_real_sse2(double* dst, const double* a, const double* b, int n)
+{
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(dst + i, _mm_add_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+  add_real_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static void mul_real_sse2(double* dst, const double* a, const double* b, int n)
+{
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(dst + i, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+  mul_real_scalar(dst + i, a + i, b + i, n - i);
+}
+
+static void scale_real_sse2(double* x, double k, int n)
+{
+  __m128d vk = _mm_set1_pd(k);
+  int i = 0;
+  for (; i + 2 <= n; i += 2)
+    _mm_storeu_pd(x + i, _mm_mul_pd(_mm_loadu_pd(x + i), vk));
+  scale_real_scalar(x + i, k, n - i);
+}
+
+static double dot_real_sse2(const double* a, const double* b, int n)
+{
+  __m128d acc0 = _mm_setzero_pd();
+  __m128d acc1 = _mm_setzero_pd();
+  int i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    acc0 = _mm_add_pd(acc0, _mm_mul_pd(_mm_loadu_pd(a + i), _mm_loadu_pd(b + i)));
+    acc1 = _mm_add_pd(acc1, _mm_mul_pd(_mm_loadu_pd(a + i + 2), _mm_loadu_pd(b + i + 2)));
+  }
+  acc0 = _mm_add_pd(acc0, acc1);
+
+  double lanes[2];
+  _mm_storeu_pd(lanes, acc0);
+  return lanes[0] + lanes[1] + dot_real_scalar(a + i, b + i, n - i);
+}
+
+
+//
+// AVX2 kernels, compiled for AVX2 but only called after checking
+// the CPU supports it:
+//
+AVX2 static long long sum_int_avx2(const int* x, int n)
+{
+  __m256i acc = _mm256_setzero_si256();
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*) (x + i));
+    acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(v)));
+    acc = _mm256_add_epi64(acc, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(v, 1)));
+  }
+
+  long long lanes[4];
+  _mm256_storeu_si256((__m256i*) lanes, acc);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_int_scalar(x + i, n - i);
+}
+
+AVX2 static double sum_real_avx2(const double* x, int n)
+{
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_add_pd(acc0, _mm256_loadu_pd(x + i));
+    acc1 = _mm256_add_pd(acc1, _mm256_loadu_pd(x + i + 4));
+  }
+  acc0 = _mm256_add_pd(acc0, acc1);
+
+  double lanes[4];
+  _mm256_storeu_pd(lanes, acc0);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + sum_real_scalar(x + i, n - i);
+}
+
+AVX2 static void minmax_int_avx2(const int* x, int n, int* min, int* max)
+{
+  __m256i vmin = _mm256_set1_epi32(*min);
+  __m256i vmax = _mm256_set1_epi32(*max);
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*) (x + i));
+    vmin = _mm256_min_epi32(vmin, v);
+    vmax = _mm256_max_epi32(vmax, v);
+  }
+
+  int lanes[8];
+  _mm256_storeu_si256((__m256i*) lanes, vmin);
+  minmax_int_scalar(lanes, 8, min, max);
+  _mm256_storeu_si256((__m256i*) lanes, vmax);
+  minmax_int_scalar(lanes, 8, min, max);
+
+  minmax_int_scalar(x + i, n - i, min, max);
+}
+
+AVX2 static void minmax_real_avx2(const double* x, int n, double* min, double* max)
+{
+  __m256d vmin = _mm256_set1_pd(*min);
+  __m256d vmax = _mm256_set1_pd(*max);
+  int i = 0;
+
+  for (; i + 4 <= n; i += 4) {
+    __m256d v = _mm256_loadu_pd(x + i);
+    vmin = _mm256_min_pd(vmin, v);
+    vmax = _mm256_max_pd(vmax, v);
+  }
+
+  double lanes[4];
+  _mm256_storeu_pd(lanes, vmin);
+  minmax_real_scalar(lanes, 4, min, max);
+  _mm256_storeu_pd(lanes, vmax);
+  minmax_real_scalar(lanes, 4, min, max);
+
+  minmax_real_scalar(x + i, n - i, min, max);
+}
+
+AVX2 static void add_int_avx2(int* dst, const int* a, const int* b, int n)
+{
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i va = _mm256_loadu_si256((const __m256i*) (a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i*) (b + i));
+    _mm256_storeu_si256((__m256i*) (dst + i), _mm256_add_epi32(va, vb));
+  }
+  add_int_scalar(dst + i, a + i, b + i, n - i);
+}
+
+AVX2 static void mul_int_avx2(int* dst, const int* a, const int* b, int n)
+{
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i va = _mm256_loadu_si256((const __m256i*) (a + i));
+    __m256i vb = _mm256_loadu_si256((const __m256i*) (b + i));
+    _mm256_storeu_si256((__m256i*) (dst + i), _mm256_mullo_epi32(va, vb));
+  }
+  mul_int_scalar(dst + i, a + i, b + i, n - i);
+}
+
+AVX2 static void scale_int_avx2(int* x, int k, int n)
+{
+  __m256i vk = _mm256_set1_epi32(k);
+  int i = 0;
+  for (; i + 8 <= n; i += 8) {
+    __m256i v = _mm256_loadu_si256((const __m256i*) (x + i));
+    _mm256_storeu_si256((__m256i*) (x + i), _mm256_mullo_epi32(v, vk));
+  }
+  scale_int_scalar(x + i, k, n - i);
+}
+
+AVX2 static void add_real_avx2(double* dst, const double* a, const double* b, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(dst + i, _mm256_add_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+  add_real_scalar(dst + i, a + i, b + i, n - i);
+}
+
+AVX2 static void mul_real_avx2(double* dst, const double* a, const double* b, int n)
+{
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(dst + i, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+  mul_real_scalar(dst + i, a + i, b + i, n - i);
+}
+
+AVX2 static void scale_real_avx2(double* x, double k, int n)
+{
+  __m256d vk = _mm256_set1_pd(k);
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    _mm256_storeu_pd(x + i, _mm256_mul_pd(_mm256_loadu_pd(x + i), vk));
+  scale_real_scalar(x + i, k, n - i);
+}
+
+AVX2 static long long dot_int_avx2(const int* a, const int* b, int n)
+{
+  __m256i acc = _mm256_setzero_si256();
+  int i = 0;
+
+  // widen to 64-bit lanes first, _mm256_mul_epi32 then gives
+  // exact 64-bit products:
+  for (; i + 4 <= n; i += 4) {
+    __m256i va = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*) (a + i)));
+    __m256i vb = _mm256_cvtepi32_epi64(_mm_loadu_si128((const __m128i*) (b + i)));
+    acc = _mm256_add_epi64(acc, _mm256_mul_epi32(va, vb));
+  }
+
+  long long lanes[4];
+  _mm256_storeu_si256((__m256i*) lanes, acc);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + dot_int_scalar(a + i, b + i, n - i);
+}
+
+AVX2 static double dot_real_avx2(const double* a, const double* b, int n)
+{
+  __m256d acc0 = _mm256_setzero_pd();
+  __m256d acc1 = _mm256_setzero_pd();
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8) {
+    acc0 = _mm256_add_pd(acc0, _mm256_mul_pd(_mm256_loadu_pd(a + i), _mm256_loadu_pd(b + i)));
+    acc1 = _mm256_add_pd(acc1, _mm256_mul_pd(_mm256_loadu_pd(a + i + 4), _mm256_loadu_pd(b + i + 4)));
+  }
+  acc0 = _mm256_add_pd(acc0, acc1);
+
+  double lanes[4];
+  _mm256_storeu_pd(lanes, acc0);
+  return lanes[0] + lanes[1] + lanes[2] + lanes[3] + dot_real_scalar(a + i, b + i, n - i);
+}
+#endif
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_array_set_simd: choose the instruction set for the kernels
+  *
+  * Requests RAM_SIMD_SCALAR, RAM_SIMD_SSE2 or RAM_SIMD_AVX2. The
+  * request is lowered to the best level the CPU supports. By
+  * default the best supported level is used. Meant for tests and
+  * benchmarks; call it before starting threads.
+  *
+  * @param level requested level
+  * @return level now in effect
+  */
+int ram_array_set_simd(int level)
+{
+  if (level > cpu_simd)
+    level = cpu_simd;
+  if (level < RAM_SIMD_SCALAR)
+    level = RAM_SIMD_SCALAR;
+
+  simd_level = level;
+
+  return simd_level;
+}
+
+
+/**
+  * @brief ram_array_new: allocate a numeric array
+  *
+  * Returns a dynamically-allocated array of the given length with
+  * all elements set to 0. elem_type must be RAM_TYPE_INT or
+  * RAM_TYPE_REAL. You take ownership of the returned array and
+  * must call ram_array_free() when you are done (unless you hand
+  * it to ram_free_value as part of a RAM_VALUE).
+  *
+  * @param elem_type RAM_TYPE_INT or RAM_TYPE_REAL
+  * @param length # of elements (>= 0)
+  * @return pointer to array, or NULL if the arguments are invalid
+  */
+struct RAM_ARRAY* ram_array_new(int elem_type, int length)
+{
+  if (elem_type != RAM_TYPE_INT && elem_type != RAM_TYPE_REAL)
+    return NULL;
+  if (length < 0)
+    return NULL;
+
+  // header and elements in one block, elements right after the header:
+  size_t bytes = (size_t) length * elem_size(elem_type);
+  struct RAM_ARRAY* array = (struct RAM_ARRAY*) malloc(sizeof(struct RAM_ARRAY) + bytes);
+
+  array->elem_type = elem_type;
+  array->length = length;
+  array->elems.i = (int*) (array + 1);
+  memset(array + 1, 0, bytes);
+
+  return array;
+}
+
+
+/**
+  * @brief ram_array_copy: duplicate a numeric array
+  *
+  * @param array array to copy
+  * @return pointer to a new array with the same contents
+  */
+struct RAM_ARRAY* ram_array_copy(struct RAM_ARRAY* array)
+{
+  if (array == NULL)
+    return NULL;
+
+  struct RAM_ARRAY* copy = ram_array_new(array->elem_type, array->length);
+  memcpy(copy->elems.i, array->elems.i, (size_t) array->length * elem_size(array->elem_type));
+
+  return copy;
+}
+
+
+/**
+  * @brief ram_array_free: free a numeric array
+  *
+  * @param array array to free (may be NULL)
+  * @return void
+  */
+void ram_array_free(struct RAM_ARRAY* array)
+{
+  free(array);
+  return;
+}
+
+
+/**
+  * @brief ram_array_value_type: cell type for storing an array
+  *
+  * Returns RAM_TYPE_INT_ARRAY or RAM_TYPE_REAL_ARRAY, the value
+  * type to use when writing this array to memory.
+  *
+  * @param array the array
+  * @return value type for a RAM_VALUE holding the array
+  */
+int ram_array_value_type(struct RAM_ARRAY* array)
+{
+  return array->elem_type == RAM_TYPE_INT ? RAM_TYPE_INT_ARRAY : RAM_TYPE_REAL_ARRAY;
+}
+
+
+/**
+  * @brief ram_array_sum_int: sum of an int array
+  *
+  * Sums in 64 bits, so the result does not overflow for arrays of
+  * fewer than 2^32 elements. Returns 0 for a real array.
+  *
+  * @param array int array
+  * @return sum of the elements
+  */
+long long ram_array_sum_int(struct RAM_ARRAY* array)
+{
+  if (array == NULL || array->elem_type != RAM_TYPE_INT)
+    return 0;
+
+#ifdef RAM_ARRAY_X86
+  if (simd_level >= RAM_SIMD_AVX2)
+    return sum_int_avx2(array->elems.i, array->length);
+#endif
+  return sum_int_scalar(array->elems.i, array->length);
+}
+
+
+/**
+  * @brief ram_array_sum_real: sum of a real array
+  *
+  * The vectorized kernels add in a different order than a plain
+  * loop, so the result can differ in the last bits. Returns 0.0
+  * for an int array.
+  *
+  * @param array real array
+  * @return sum of the elements
+  */
+double ram_array_sum_real(struct RAM_ARRAY* array)
+{
+  if (array == NULL || array->elem_type != RAM_TYPE_REAL)
+    return 0.0;
+
+#ifdef RAM_ARRAY_X86
+  if (simd_level >= RAM_SIMD_AVX2)
+    return sum_real_avx2(array->elems.d, array->length);
+  if (simd_level >= RAM_SIMD_SSE2)
+    return sum_real_sse2(array->elems.d, array->length);
+#endif
+  return sum_real_scalar(array->elems.d, array->length);
+}
+
+
+/**
+ * @brief array_minmax:
+ *
+ * computes the smallest and largest element of a non-empty array
+ *
+ * @param array
+ * @param min returns smallest element
+ * @param max returns largest element
+ *
+ * @return void
+ */
+static void array_minmax(struct RAM_ARRAY* array, struct RAM_VALUE* min, struct RAM_VALUE* max)
+{
+  min->value_type = array->elem_type;
+  max->value_type = array->elem_type;
+
+  if (array->elem_type == RAM_TYPE_INT) {
+    const int* x = array->elems.i;
+    int lo = x[0];
+    int hi = x[0];
+#ifdef RAM_ARRAY_X86
+    if (simd_level >= RAM_SIMD_AVX2)
+      minmax_int_avx2(x, array->length, &lo, &hi);
+    else
+#endif
+      minmax_int_scalar(x, array->length, &lo, &hi);
+    min->types.i = lo;
+    max->types.i = hi;
+  }
+  else {
+    const double* x = array->elems.d;
+    double lo = x[0];
+    double hi = x[0];
+#ifdef RAM_ARRAY_X86
+    if (simd_level >= RAM_SIMD_AVX2)
+      minmax_real_avx2(x, array->length, &lo, &hi);
+    else if (simd_level >= RAM_SIMD_SSE2)
+      minmax_real_sse2(x, array->length, &lo, &hi);
+    else
+#endif
+      minmax_real_scalar(x, array->length, &lo, &hi);
+    min->types.d = lo;
+    max->types.d = hi;
+  }
+
+  return;
+}
+
+
+/**
+  * @brief ram_array_min: smallest element of an array
+  *
+  * Stores the smallest element in result, as a RAM_TYPE_INT or
+  * RAM_TYPE_REAL value. Returns false if the array is empty.
+  *
+  * @param array the array
+  * @param result where to store the smallest element
+  * @return true if successful, false if the array is empty
+  */
+bool ram_array_min(struct RAM_ARRAY* array, struct RAM_VALUE* result)
+{
+  if (array == NULL || array->length == 0 || result == NULL)
+    return false;
+
+  struct RAM_VALUE max;
+  array_minmax(array, result, &max);
+
+  return true;
+}
+
+
+/**
+  * @brief ram_array_max: largest element of an array
+  *
+  * Stores the largest element in result, as a RAM_TYPE_INT or
+  * RAM_TYPE_REAL value. Returns false if the array is empty.
+  *
+  * @param array the array
+  * @param result where to store the largest element
+  * @return true if successful, false if the array is empty
+  */
+bool ram_array_max(struct RAM_ARRAY* array, struct RAM_VALUE* result)
+{
+  if (array == NULL || array->length == 0 || result == NULL)
+    return false;
+
+  struct RAM_VALUE min;
+  array_minmax(array, &min, result);
+
+  return true;
+}
+
+
+/**
+  * @brief ram_array_add: elementwise dst = a + b
+  *
+  * All three arrays must have the same element type and length;
+  * dst may be the same array as a or b. Int elements wrap around
+  * on overflow.
+  *
+  * @param dst array receiving the result
+  * @param a left operand
+  * @param b right operand
+  * @return true if successful, false if types or lengths differ
+  */
+bool ram_array_add(struct RAM_ARRAY* dst, struct RAM_ARRAY* a, struct RAM_ARRAY* b)
+{
+  if (!same_shape(dst, a) || !same_shape(a, b))
+    return false;
+
+  int n = dst->length;
+
+  if (dst->elem_type == RAM_TYPE_INT) {
+#ifdef RAM_ARRAY_X86
+    if (simd_level >= RAM_SIMD_AVX2) {
+      add_int_avx2(dst->elems.i, a->elems.i, b->elems.i, n);
+      return true;
+    }
+#endif
+    add_int_scalar(dst->elems.i, a->elems.i, b->elems.i, n);
+  }
+  else {
+#ifdef RAM_ARRAY_X86
+    if (simd_level >= RAM_SIMD_AVX2) {
+      add_real_avx2(dst->elems.d, a->elems.d, b->elems.d, n);
+      return true;
+    }
+    if (simd_level >= RAM_SIMD_SSE2) {
+      add_real_sse2(dst->elems.d, a->elems.d, b->elems.d, n);
+      return true;
+    }
+#endif
+    add_real_scalar(dst->elems.d, a->elems.d, b->elems.d, n);
+  }
+
+  return true;
+}
+
+
+/**
+  * @brief ram_array_mul: elementwise dst = a * b
+  *
+  * All three arrays must have the same element type and length;
+  * dst may be the same array as a or b. Int elements wrap around
+  * on overflow.
+  *
+  * @param dst array receiving the result
+  * @param a left operand
+  * @param b right operand
+  * @return true if successful, false if types or lengths differ
+  */
+bool ram_array_mul(struct RAM_ARRAY* dst, struct RAM_ARRAY* a, struct RAM_ARRAY* b)
+{
+  if (!same_shape(dst, a) || !same_shape(a, b))
+    return false;
+
+  int n = dst->length;
+
+  if (dst->elem_type == RAM_TYPE_INT) {
+#ifdef RAM_ARRAY_X86
+    if (simd_level >= RAM_SIMD_AVX2) {
+      mul_int_avx2(dst->elems.i, a->elems.i, b->elems.i, n);
+      return true;
+    }
+#endif
+    mul_int_scalar(dst->elems.i, a->elems.i, b->elems.i, n);
+  }
+  else {
+#ifdef RAM_ARRAY_X86
+    if (simd_level >= RAM_SIMD_AVX2) {
+      mul_real_avx2(dst->elems.d, a->elems.d, b->elems.d, n);
+      return true;
+    }
+    if (simd_level >= RAM_SIMD_SSE2) {
+      mul_real_sse2(dst->elems.d, a->elems.d, b->elems.d, n);
+      return true;
+    }
+#endif
+    mul_real_scalar(dst->elems.d, a->elems.d, b->elems.d, n);
+  }
+
+  return true;
+}
+
+
+/**
+  * @brief ram_array_scale: multiplies every element by a factor
+  *
+  * The factor must have the array's element type (RAM_TYPE_INT
+  * for int arrays, RAM_TYPE_REAL for real arrays).
+  *
+  * @param array array to scale in place
+  * @param factor value to multiply by
+  * @return true if successful, false if the factor has the wrong type
+  */
+bool ram_array_scale(struct RAM_ARRAY* array, struct RAM_VALUE factor)
+{
+  if (array == NULL || factor.value_type != array->elem_type)
+    return false;
+
+  int n = array->length;
+
+  if (array->elem_type == RAM_TYPE_INT) {
+#ifdef RAM_ARRAY_X86
+    if (simd_level >= RAM_SIMD_AVX2) {
+      scale_int_avx2(array->elems.i, factor.types.i, n);
+      return true;
+    }
+#endif
+    scale_int_scalar(array->elems.i, factor.types.i, n);
+  }
+  else {
+#ifdef RAM_ARRAY_X86
+    if (simd_level >= RAM_SIMD_AVX2) {
+      scale_real_avx2(array->elems.d, factor.types.d, n);
+      return true;
+    }
+    if (simd_level >= RAM_SIMD_SSE2) {
+      scale_real_sse2(array->elems.d, factor.types.d, n);
+      return true;
+    }
+#endif
+    scale_real_scalar(array->elems.d, factor.types.d, n);
+  }
+
+  return true;
+}
+
+
+/**
+  * @brief ram_array_dot_int: dot product of two int arrays
+  *
+  * Multiplies and sums in 64 bits. Returns 0 if the arrays are not
+  * both int arrays of the same length.
+  *
+  * @param a left operand
+  * @param b right operand
+  * @return sum of a[i] * b[i]
+  */
+long long ram_array_dot_int(struct RAM_ARRAY* a, struct RAM_ARRAY* b)
+{
+  if (!same_shape(a, b) || a->elem_type != RAM_TYPE_INT)
+    return 0;
+
+#ifdef RAM_ARRAY_X86
+  if (simd_level >= RAM_SIMD_AVX2)
+    return dot_int_avx2(a->elems.i, b->elems.i, a->length);
+#endif
+  return dot_int_scalar(a->elems.i, b->elems.i, a->length);
+}
+
+
+/**
+  * @brief ram_array_dot_real: dot product of two real arrays
+  *
+  * Returns 0.0 if the arrays are not both real arrays of the same
+  * length.
+  *
+  * @param a left operand
+  * @param b right operand
+  * @return sum of a[i] * b[i]
+  */
+double ram_array_dot_real(struct RAM_ARRAY* a, struct RAM_ARRAY* b)
+{
+  if (!same_shape(a, b) || a->elem_type != RAM_TYPE_REAL)
+    return 0.0;
+
+#ifdef RAM_ARRAY_X86
+  if (simd_level >= RAM_SIMD_AVX2)
+    return dot_real_avx2(a->elems.d, b->elems.d, a->length);
+  if (simd_level >= RAM_SIMD_SSE2)
+    return dot_real_sse2(a->elems.d, b->elems.d, a->length);
+#endif
+  return dot_real_scalar(a->elems.d, b->elems.d, a->length);
+}
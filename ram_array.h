@@ -0,0 +1,200 @@
+/*ram_array.h*/
+
+/**
+  * @brief Numeric array values for nuPython's memory unit
+  *
+  * A RAM_ARRAY is a contiguous array of ints or reals that can be
+  * stored in a single memory cell (value types RAM_TYPE_INT_ARRAY
+  * and RAM_TYPE_REAL_ARRAY), so numeric loops avoid boxing every
+  * element in its own RAM_VALUE. The kernels below use AVX2 or
+  * SSE2 when the CPU supports them, and plain loops otherwise.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "ram.h"
+
+
+enum RAM_SIMD_LEVELS
+{
+  RAM_SIMD_SCALAR = 0,
+  RAM_SIMD_SSE2,
+  RAM_SIMD_AVX2
+};
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_array_set_simd: choose the instruction set for the kernels
+  *
+  * Requests RAM_SIMD_SCALAR, RAM_SIMD_SSE2 or RAM_SIMD_AVX2. The
+  * request is lowered to the best level the CPU supports. By
+  * default the best supported level is used. Meant for tests and
+  * benchmarks; call it before starting threads.
+  *
+  * @param level requested level
+  * @return level now in effect
+  */
+int ram_array_set_simd(int level);
+
+/**
+  * @brief ram_array_new: allocate a numeric array
+  *
+  * Returns a dynamically-allocated array of the given length with
+  * all elements set to 0. elem_type must be RAM_TYPE_INT or
+  * RAM_TYPE_REAL. You take ownership of the returned array and
+  * must call ram_array_free() when you are done; writing it to
+  * memory stores a copy. Don't pass a RAM_VALUE you built around
+  * it to ram_free_value(), which only accepts values returned by
+  * the read functions.
+  *
+  * @param elem_type RAM_TYPE_INT or RAM_TYPE_REAL
+  * @param length # of elements (>= 0)
+  * @return pointer to array, or NULL if the arguments are invalid
+  */
+struct RAM_ARRAY* ram_array_new(int elem_type, int length);
+
+/**
+  * @brief ram_array_copy: duplicate a numeric array
+  *
+  * @param array array to copy
+  * @return pointer to a new array with the same contents
+  */
+struct RAM_ARRAY* ram_array_copy(struct RAM_ARRAY* array);
+
+/**
+  * @brief ram_array_free: free a numeric array
+  *
+  * @param array array to free (may be NULL)
+  * @return void
+  */
+void ram_array_free(struct RAM_ARRAY* array);
+
+/**
+  * @brief ram_array_value_type: cell type for storing an array
+  *
+  * Returns RAM_TYPE_INT_ARRAY or RAM_TYPE_REAL_ARRAY, the value
+  * type to use when writing this array to memory.
+  *
+  * @param array the array
+  * @return value type for a RAM_VALUE holding the array
+  */
+int ram_array_value_type(struct RAM_ARRAY* array);
+
+/**
+  * @brief ram_array_sum_int: sum of an int array
+  *
+  * Sums in 64 bits, so the result does not overflow for arrays of
+  * fewer than 2^32 elements. Returns 0 for a real array.
+  *
+  * @param array int array
+  * @return sum of the elements
+  */
+long long ram_array_sum_int(struct RAM_ARRAY* array);
+
+/**
+  * @brief ram_array_sum_real: sum of a real array
+  *
+  * The vectorized kernels add in a different order than a plain
+  * loop, so the result can differ in the last bits. Returns 0.0
+  * for an int array.
+  *
+  * @param array real array
+  * @return sum of the elements
+  */
+double ram_array_sum_real(struct RAM_ARRAY* array);
+
+/**
+  * @brief ram_array_min: smallest element of an array
+  *
+  * Stores the smallest element in result, as a RAM_TYPE_INT or
+  * RAM_TYPE_REAL value. Returns false if the array is empty.
+  *
+  * @param array the array
+  * @param result where to store the smallest element
+  * @return true if successful, false if the array is empty
+  */
+bool ram_array_min(struct RAM_ARRAY* array, struct RAM_VALUE* result);
+
+/**
+  * @brief ram_array_max: largest element of an array
+  *
+  * Stores the largest element in result, as a RAM_TYPE_INT or
+  * RAM_TYPE_REAL value. Returns false if the array is empty.
+  *
+  * @param array the array
+  * @param result where to store the largest element
+  * @return true if successful, false if the array is empty
+  */
+bool ram_array_max(struct RAM_ARRAY* array, struct RAM_VALUE* result);
+
+/**
+  * @brief ram_array_add: elementwise dst = a + b
+  *
+  * All three arrays must have the same element type and length;
+  * dst may be the same array as a or b. Int elements wrap around
+  * on overflow.
+  *
+  * @param dst array receiving the result
+  * @param a left operand
+  * @param b right operand
+  * @return true if successful, false if types or lengths differ
+  */
+bool ram_array_add(struct RAM_ARRAY* dst, struct RAM_ARRAY* a, struct RAM_ARRAY* b);
+
+/**
+  * @brief ram_array_mul: elementwise dst = a * b
+  *
+  * All three arrays must have the same element type and length;
+  * dst may be the same array as a or b. Int elements wrap around
+  * on overflow.
+  *
+  * @param dst array receiving the result
+  * @param a left operand
+  * @param b right operand
+  * @return true if successful, false if types or lengths differ
+  */
+bool ram_array_mul(struct RAM_ARRAY* dst, struct RAM_ARRAY* a, struct RAM_ARRAY* b);
+
+/**
+  * @brief ram_array_scale: multiplies every element by a factor
+  *
+  * The factor must have the array's element type (RAM_TYPE_INT
+  * for int arrays, RAM_TYPE_REAL for real arrays).
+  *
+  * @param array array to scale in place
+  * @param factor value to multiply by
+  * @return true if successful, false if the factor has the wrong type
+  */
+bool ram_array_scale(struct RAM_ARRAY* array, struct RAM_VALUE factor);
+
+/**
+  * @brief ram_array_dot_int: dot product of two int arrays
+  *
+  * Multiplies and sums in 64 bits. Returns 0 if the arrays are not
+  * both int arrays of the same length.
+  *
+  * @param a left operand
+  * @param b right operand
+  * @return sum of a[i] * b[i]
+  */
+long long ram_array_dot_int(struct RAM_ARRAY* a, struct RAM_ARRAY* b);
+
+/**
+  * @brief ram_array_dot_real: dot product of two real arrays
+  *
+  * Returns 0.0 if the arrays are not both real arrays of the same
+  * length.
+  *
+  * @param a left operand
+  * @param b right operand
+  * @return sum of a[i] * b[i]
+  */
+double ram_array_dot_real(struct RAM_ARRAY* a, struct RAM_ARRAY* b);
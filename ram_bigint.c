@@ -0,0 +1,543 @@
+/*ram_bigint.c*/
+
+/**
+  * @brief Arbitrary-precision integers for nuPython's memory unit
+  *
+  * Each helper first checks whether its operands are small ints
+  * and, if so, works on int64_t values; 62-bit operands can't
+  * overflow an add or subtract, and a multiply is checked with
+  * __builtin_mul_overflow. Otherwise the operands are viewed as
+  * sign and magnitude (a small int as 1 or 2 limbs), and the
+  * magnitudes are added, subtracted or multiplied (schoolbook) 32
+  * bits at a time with 64-bit carries.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <stdint.h>  // int64_t, uint32_t, uint64_t
+
+#include "ram_bigint.h"
+
+#define SCRATCH_LIMBS 64  // results up to this many limbs are built on the stack
+
+//
+// an operand as sign and magnitude; a small int's limbs are in
+// small[], so a view must not be copied:
+//
+struct VIEW
+{
+  int sign;               // 1 or -1
+  int length;             // # of limbs, 0 for zero
+  const uint32_t* limbs;
+  uint32_t small[2];
+};
+
+static bool is_small(RAM_INT n)
+{
+  return (n & 1) != 0;
+}
+
+static int64_t small_value(RAM_INT n)
+{
+  return n >> 1;
+}
+
+static RAM_INT make_small(int64_t v)
+{
+  return (RAM_INT) (((uint64_t) v << 1) | 1);
+}
+
+static void view_of(RAM_INT n, struct VIEW* v)
+{
+  struct RAM_BIGNUM* b = ram_int_box(n);
+  if (b != NULL) {
+    v->sign = b->sign;
+    v->length = b->length;
+    v->limbs = ram_bignum_limbs(b);
+    return;
+  }
+
+  int64_t x = small_value(n);
+  uint64_t m = (x < 0) ? -(uint64_t) x : (uint64_t) x;
+
+  v->sign = (x < 0) ? -1 : 1;
+  v->small[0] = (uint32_t) m;
+  v->small[1] = (uint32_t) (m >> 32);
+  v->length = (v->small[1] != 0) ? 2 : (v->small[0] != 0) ? 1 : 0;
+  v->limbs = v->small;
+}
+
+
+//
+// magnitudes:
+//
+static int mag_cmp(const uint32_t* a, int la, const uint32_t* b, int lb)
+{
+  if (la != lb)
+    return (la < lb) ? -1 : 1;
+
+  for (int i = la - 1; i >= 0; i--) {
+    if (a[i] != b[i])
+      return (a[i] < b[i]) ? -1 : 1;
+  }
+  return 0;
+}
+
+//
+// out = a + b, out has room for max(la, lb) + 1 limbs; returns
+// the # of limbs used:
+//
+static int mag_add(const uint32_t* a, int la, const uint32_t* b, int lb, uint32_t* out)
+{
+  if (la < lb) {
+    const uint32_t* t = a; a = b; b = t;
+    int tl = la; la = lb; lb = tl;
+  }
+
+  uint64_t carry = 0;
+  for (int i = 0; i < la; i++) {
+    uint64_t sum = (uint64_t) a[i] + (i < lb ? b[i] : 0) + carry;
+    out[i] = (uint32_t) sum;
+    carry = sum >> 32;
+  }
+  out[la] = (uint32_t) carry;
+
+  return la + 1;
+}
+
+//
+// out = a - b, for a >= b; out has room for la limbs:
+//
+static int mag_sub(const uint32_t* a, int la, const uint32_t* b, int lb, uint32_t* out)
+{
+  int64_t borrow = 0;
+  for (int i = 0; i < la; i++) {
+    int64_t diff = (int64_t) a[i] - (i < lb ? b[i] : 0) - borrow;
+    borrow = (diff < 0) ? 1 : 0;
+    out[i] = (uint32_t) (diff + (borrow << 32));
+  }
+
+  return la;
+}
+
+//
+// out = a * b, out has room for la + lb limbs:
+//
+static int mag_mul(const uint32_t* a, int la, const uint32_t* b, int lb, uint32_t* out)
+{
+  memset(out, 0, (la + lb) * sizeof(uint32_t));
+
+  for (int i = 0; i < la; i++) {
+    uint64_t carry = 0;
+    for (int j = 0; j < lb; j++) {
+      uint64_t t = (uint64_t) a[i] * b[j] + out[i + j] + carry;
+      out[i + j] = (uint32_t) t;
+      carry = t >> 32;
+    }
+    out[i + lb] = (uint32_t) carry;
+  }
+
+  return la + lb;
+}
+
+//
+// room for a result of n limbs: scratch if it fits, else malloc:
+//
+static uint32_t* result_buffer(uint32_t* scratch, int n)
+{
+  return (n <= SCRATCH_LIMBS) ? scratch : (uint32_t*) malloc(n * sizeof(uint32_t));
+}
+
+static RAM_INT finish(int sign, uint32_t* limbs, int length, uint32_t* scratch)
+{
+  RAM_INT n = ram_int_from_limbs(sign, limbs, length);
+  if (limbs != scratch)
+    free(limbs);
+  return n;
+}
+
+//
+// a + b, with b's sign flipped if negate_b:
+//
+static RAM_INT add_views(struct VIEW* a, struct VIEW* b, bool negate_b)
+{
+  int b_sign = negate_b ? -b->sign : b->sign;
+  uint32_t scratch[SCRATCH_LIMBS];
+  int room = ((a->length > b->length) ? a->length : b->length) + 1;
+  uint32_t* out = result_buffer(scratch, room);
+
+  if (a->sign == b_sign || a->length == 0 || b->length == 0) {
+    if (a->length == 0) {
+      int length = mag_add(b->limbs, b->length, NULL, 0, out);
+      return finish(b_sign, out, length, scratch);
+    }
+    int length = mag_add(a->limbs, a->length, b->limbs, b->length, out);
+    return finish(a->sign, out, length, scratch);
+  }
+
+  int c = mag_cmp(a->limbs, a->length, b->limbs, b->length);
+  if (c >= 0) {
+    int length = mag_sub(a->limbs, a->length, b->limbs, b->length, out);
+    return finish(a->sign, out, length, scratch);
+  }
+  else {
+    int length = mag_sub(b->limbs, b->length, a->limbs, a->length, out);
+    return finish(b_sign, out, length, scratch);
+  }
+}
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_int_from_i64: a RAM_INT with the given value
+  *
+  * @param v value
+  * @return small int, or a new big int if v doesn't fit in 62 bits
+  */
+RAM_INT ram_int_from_i64(int64_t v)
+{
+  if (v >= RAM_INT_SMALL_MIN && v <= RAM_INT_SMALL_MAX)
+    return make_small(v);
+
+  uint64_t m = (v < 0) ? -(uint64_t) v : (uint64_t) v;
+  uint32_t limbs[2] = {(uint32_t) m, (uint32_t) (m >> 32)};
+
+  return ram_int_from_limbs((v < 0) ? -1 : 1, limbs, 2);
+}
+
+
+/**
+  * @brief ram_int_to_i64: the value of a RAM_INT, if it fits
+  *
+  * @param n RAM_INT
+  * @param v set to the value, if it fits in 64 bits
+  * @return true if it fits
+  */
+bool ram_int_to_i64(RAM_INT n, int64_t* v)
+{
+  if (is_small(n)) {
+    *v = small_value(n);
+    return true;
+  }
+
+  struct RAM_BIGNUM* b = ram_int_box(n);
+  if (b->length > 2)
+    return false;
+
+  uint32_t* limbs = ram_bignum_limbs(b);
+  uint64_t m = limbs[0] | ((b->length > 1) ? (uint64_t) limbs[1] << 32 : 0);
+
+  if (b->sign > 0 && m <= (uint64_t) INT64_MAX) {
+    *v = (int64_t) m;
+    return true;
+  }
+  if (b->sign < 0 && m <= (uint64_t) INT64_MAX + 1) {
+    *v = (int64_t) (0 - m);
+    return true;
+  }
+  return false;
+}
+
+
+/**
+  * @brief ram_int_box: the RAM_BIGNUM of a RAM_INT
+  *
+  * @param n RAM_INT
+  * @return pointer to its RAM_BIGNUM, or NULL if n is a small int
+  */
+struct RAM_BIGNUM* ram_int_box(RAM_INT n)
+{
+  return is_small(n) ? NULL : (struct RAM_BIGNUM*) (intptr_t) n;
+}
+
+
+/**
+  * @brief ram_bignum_limbs: the limbs after a RAM_BIGNUM
+  *
+  * @param b Pointer to big int
+  * @return pointer to b->length limbs
+  */
+uint32_t* ram_bignum_limbs(struct RAM_BIGNUM* b)
+{
+  return (uint32_t*) (b + 1);
+}
+
+
+/**
+  * @brief ram_bignum_bytes: size of a RAM_BIGNUM, limbs included
+  *
+  * @param b Pointer to big int
+  * @return # of bytes
+  */
+long ram_bignum_bytes(struct RAM_BIGNUM* b)
+{
+  return sizeof(struct RAM_BIGNUM) + b->length * sizeof(uint32_t);
+}
+
+
+/**
+  * @brief ram_int_from_limbs: a RAM_INT from a sign and magnitude
+  *
+  * @param sign 1 or -1
+  * @param limbs magnitude, least significant limb first
+  * @param length # of limbs
+  * @return RAM_INT
+  */
+RAM_INT ram_int_from_limbs(int sign, const uint32_t* limbs, int length)
+{
+  while (length > 0 && limbs[length - 1] == 0)
+    length--;
+
+  if (length <= 2) {
+    uint64_t m = (length > 0 ? limbs[0] : 0) | ((length > 1) ? (uint64_t) limbs[1] << 32 : 0);
+    if (sign > 0 && m <= (uint64_t) RAM_INT_SMALL_MAX)
+      return make_small((int64_t) m);
+    if (sign < 0 && m <= (uint64_t) RAM_INT_SMALL_MAX + 1)
+      return make_small((int64_t) (0 - m));
+  }
+
+  struct RAM_BIGNUM* b = (struct RAM_BIGNUM*) malloc(sizeof(struct RAM_BIGNUM) + length * sizeof(uint32_t));
+  b->sign = (sign < 0) ? -1 : 1;
+  b->length = length;
+  memcpy(ram_bignum_limbs(b), limbs, length * sizeof(uint32_t));
+
+  return (RAM_INT) (intptr_t) b;
+}
+
+
+/**
+  * @brief ram_int_free: free a RAM_INT from one of these helpers
+  *
+  * @param n RAM_INT; nothing happens if it is a small int
+  * @return void
+  */
+void ram_int_free(RAM_INT n)
+{
+  if (!is_small(n))
+    free(ram_int_box(n));
+}
+
+
+/**
+  * @brief ram_int_copy: a copy of a RAM_INT
+  *
+  * @param n RAM_INT
+  * @return n if it is a small int, else a new big int
+  */
+RAM_INT ram_int_copy(RAM_INT n)
+{
+  struct RAM_BIGNUM* b = ram_int_box(n);
+  if (b == NULL)
+    return n;
+
+  struct RAM_BIGNUM* copy = (struct RAM_BIGNUM*) malloc(ram_bignum_bytes(b));
+  memcpy(copy, b, ram_bignum_bytes(b));
+  return (RAM_INT) (intptr_t) copy;
+}
+
+
+/**
+  * @brief ram_int_add: a + b
+  *
+  * @return RAM_INT, allocated only if not small
+  */
+RAM_INT ram_int_add(RAM_INT a, RAM_INT b)
+{
+  if (is_small(a) && is_small(b))
+    return ram_int_from_i64(small_value(a) + small_value(b));
+
+  struct VIEW va, vb;
+  view_of(a, &va);
+  view_of(b, &vb);
+  return add_views(&va, &vb, false);
+}
+
+
+/**
+  * @brief ram_int_sub: a - b
+  *
+  * @return RAM_INT, allocated only if not small
+  */
+RAM_INT ram_int_sub(RAM_INT a, RAM_INT b)
+{
+  if (is_small(a) && is_small(b))
+    return ram_int_from_i64(small_value(a) - small_value(b));
+
+  struct VIEW va, vb;
+  view_of(a, &va);
+  view_of(b, &vb);
+  return add_views(&va, &vb, true);
+}
+
+
+/**
+  * @brief ram_int_mul: a * b
+  *
+  * @return RAM_INT, allocated only if not small
+  */
+RAM_INT ram_int_mul(RAM_INT a, RAM_INT b)
+{
+  int64_t product;
+  if (is_small(a) && is_small(b) && !__builtin_mul_overflow(small_value(a), small_value(b), &product))
+    return ram_int_from_i64(product);
+
+  struct VIEW va, vb;
+  view_of(a, &va);
+  view_of(b, &vb);
+  if (va.length == 0 || vb.length == 0)
+    return make_small(0);
+
+  uint32_t scratch[SCRATCH_LIMBS];
+  uint32_t* out = result_buffer(scratch, va.length + vb.length);
+  int length = mag_mul(va.limbs, va.length, vb.limbs, vb.length, out);
+
+  return finish(va.sign * vb.sign, out, length, scratch);
+}
+
+
+/**
+  * @brief ram_int_neg: -a
+  *
+  * @return RAM_INT, allocated only if not small
+  */
+RAM_INT ram_int_neg(RAM_INT a)
+{
+  if (is_small(a))
+    return ram_int_from_i64(-small_value(a));
+
+  struct RAM_BIGNUM* b = ram_int_box(a);
+  return ram_int_from_limbs(-b->sign, ram_bignum_limbs(b), b->length);
+}
+
+
+/**
+  * @brief ram_int_cmp: compare two RAM_INTs
+  *
+  * @return < 0 if a < b, 0 if a == b, > 0 if a > b
+  */
+int ram_int_cmp(RAM_INT a, RAM_INT b)
+{
+  // 2v + 1 grows with v:
+  if (is_small(a) && is_small(b))
+    return (a < b) ? -1 : (a > b) ? 1 : 0;
+
+  struct VIEW va, vb;
+  view_of(a, &va);
+  view_of(b, &vb);
+
+  int sa = (va.length == 0) ? 0 : va.sign;
+  int sb = (vb.length == 0) ? 0 : vb.sign;
+  if (sa != sb)
+    return (sa < sb) ? -1 : 1;
+
+  return sa * mag_cmp(va.limbs, va.length, vb.limbs, vb.length);
+}
+
+
+/**
+  * @brief ram_int_parse: a RAM_INT from decimal digits
+  *
+  * @param s optional sign, then one or more digits, then '\0'
+  * @param n set to the value if s is well formed
+  * @return true if s is well formed
+  */
+bool ram_int_parse(const char* s, RAM_INT* n)
+{
+  int sign = 1;
+  if (*s == '-' || *s == '+') {
+    sign = (*s == '-') ? -1 : 1;
+    s++;
+  }
+
+  int digits = (int) strlen(s);
+  if (digits == 0)
+    return false;
+  for (int i = 0; i < digits; i++) {
+    if (s[i] < '0' || s[i] > '9')
+      return false;
+  }
+
+  // 9 digits at a time, most significant first: m = m * 10^9 + chunk
+  uint32_t* limbs = (uint32_t*) calloc(digits / 9 + 2, sizeof(uint32_t));
+  int length = 0;
+  int chunk_len = (digits % 9 == 0) ? 9 : digits % 9;
+
+  for (int pos = 0; pos < digits; pos += chunk_len, chunk_len = 9) {
+    uint64_t carry = 0;
+    for (int i = 0; i < chunk_len; i++) {
+      carry = carry * 10 + (s[pos + i] - '0');
+    }
+
+    for (int i = 0; i < length; i++) {
+      uint64_t t = (uint64_t) limbs[i] * 1000000000u + carry;
+      limbs[i] = (uint32_t) t;
+      carry = t >> 32;
+    }
+    if (carry != 0)
+      limbs[length++] = (uint32_t) carry;
+  }
+
+  *n = ram_int_from_limbs(sign, limbs, length);
+  free(limbs);
+  return true;
+}
+
+
+/**
+  * @brief ram_int_to_str: decimal digits of a RAM_INT
+  *
+  * @param n RAM_INT
+  * @return '\0'-terminated string, with a '-' if negative
+  */
+char* ram_int_to_str(RAM_INT n)
+{
+  if (is_small(n)) {
+    char* s = (char*) malloc(24);
+    snprintf(s, 24, "%lld", (long long) small_value(n));
+    return s;
+  }
+
+  struct RAM_BIGNUM* b = ram_int_box(n);
+  int length = b->length;
+
+  uint32_t* limbs = (uint32_t*) malloc(length * sizeof(uint32_t));
+  memcpy(limbs, ram_bignum_limbs(b), length * sizeof(uint32_t));
+
+  // 9 digits at a time, least significant first: chunk = m % 10^9, m /= 10^9
+  uint32_t* chunks = (uint32_t*) malloc((length * 10 / 9 + 2) * sizeof(uint32_t));
+  int num_chunks = 0;
+
+  // a big int has at least one limb:
+  do {
+    uint64_t rem = 0;
+    for (int i = length - 1; i >= 0; i--) {
+      uint64_t t = (rem << 32) | limbs[i];
+      limbs[i] = (uint32_t) (t / 1000000000u);
+      rem = t % 1000000000u;
+    }
+    chunks[num_chunks++] = (uint32_t) rem;
+
+    while (length > 0 && limbs[length - 1] == 0)
+      length--;
+  } while (length > 0);
+
+  char* s = (char*) malloc(num_chunks * 9 + 2);
+  int len = 0;
+  if (b->sign < 0)
+    s[len++] = '-';
+  len += sprintf(s + len, "%u", chunks[num_chunks - 1]);
+  for (int i = num_chunks - 2; i >= 0; i--) {
+    len += sprintf(s + len, "%09u", chunks[i]);
+  }
+
+  free(limbs);
+  free(chunks);
+  return s;
+}
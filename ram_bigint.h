@@ -0,0 +1,179 @@
+/*ram_bigint.h*/
+
+/**
+  * @brief Arbitrary-precision integers for nuPython's memory unit
+  *
+  * Python ints are unbounded, so RAM_TYPE_BIGINT cells hold a
+  * RAM_INT (in types.n): a 64-bit word that is either a small int
+  * stored right in the word, or a pointer to a RAM_BIGNUM holding
+  * the digits. A small int v is stored as 2v + 1; the odd word
+  * tells it apart from a pointer, which is always even.
+  *
+  * Small ints have 62 bits, -2^61 ... 2^61 - 1, so the sum or
+  * difference of two of them can't overflow 64 bits, and the
+  * helpers below work on them with no allocation; only a result
+  * outside that range is promoted to a RAM_BIGNUM. A RAM_BIGNUM
+  * always holds a value outside the range, so each value has one
+  * representation and small ints compare by word.
+  *
+  * A RAM_INT returned by the helpers below that is not small was
+  * allocated with malloc; free it with ram_int_free() (freeing a
+  * small int does nothing). Writing a RAM_TYPE_BIGINT value to
+  * memory copies its RAM_BIGNUM, as strings and arrays are copied,
+  * and reading one gives a copy that ram_free_value() frees.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include <stdint.h>   // int64_t, uint32_t
+
+#include "ram.h"
+
+
+typedef int64_t RAM_INT;  // small int 2v + 1, or struct RAM_BIGNUM*
+
+#define RAM_INT_SMALL_MIN  (-((int64_t) 1 << 61))
+#define RAM_INT_SMALL_MAX  (((int64_t) 1 << 61) - 1)
+
+//
+// A big int's sign and magnitude; the magnitude's 32-bit limbs,
+// least significant first, follow the struct (see
+// ram_bignum_limbs()). The most significant limb is never 0.
+//
+struct RAM_BIGNUM
+{
+  int sign;    // 1 or -1
+  int length;  // # of limbs
+};
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_int_from_i64: a RAM_INT with the given value
+  *
+  * @param v value
+  * @return small int, or a new big int if v doesn't fit in 62 bits
+  */
+RAM_INT ram_int_from_i64(int64_t v);
+
+/**
+  * @brief ram_int_to_i64: the value of a RAM_INT, if it fits
+  *
+  * @param n RAM_INT
+  * @param v set to the value, if it fits in 64 bits
+  * @return true if it fits
+  */
+bool ram_int_to_i64(RAM_INT n, int64_t* v);
+
+/**
+  * @brief ram_int_box: the RAM_BIGNUM of a RAM_INT
+  *
+  * @param n RAM_INT
+  * @return pointer to its RAM_BIGNUM, or NULL if n is a small int
+  */
+struct RAM_BIGNUM* ram_int_box(RAM_INT n);
+
+/**
+  * @brief ram_bignum_limbs: the limbs after a RAM_BIGNUM
+  *
+  * @param b Pointer to big int
+  * @return pointer to b->length limbs
+  */
+uint32_t* ram_bignum_limbs(struct RAM_BIGNUM* b);
+
+/**
+  * @brief ram_bignum_bytes: size of a RAM_BIGNUM, limbs included
+  *
+  * @param b Pointer to big int
+  * @return # of bytes
+  */
+long ram_bignum_bytes(struct RAM_BIGNUM* b);
+
+/**
+  * @brief ram_int_from_limbs: a RAM_INT from a sign and magnitude
+  *
+  * Leading zero limbs are allowed; a value that fits in 62 bits
+  * gives a small int.
+  *
+  * @param sign 1 or -1
+  * @param limbs magnitude, least significant limb first
+  * @param length # of limbs
+  * @return RAM_INT
+  */
+RAM_INT ram_int_from_limbs(int sign, const uint32_t* limbs, int length);
+
+/**
+  * @brief ram_int_free: free a RAM_INT from one of these helpers
+  *
+  * @param n RAM_INT; nothing happens if it is a small int
+  * @return void
+  */
+void ram_int_free(RAM_INT n);
+
+/**
+  * @brief ram_int_copy: a copy of a RAM_INT
+  *
+  * @param n RAM_INT
+  * @return n if it is a small int, else a new big int
+  */
+RAM_INT ram_int_copy(RAM_INT n);
+
+/**
+  * @brief ram_int_add: a + b
+  *
+  * @return RAM_INT, allocated only if not small
+  */
+RAM_INT ram_int_add(RAM_INT a, RAM_INT b);
+
+/**
+  * @brief ram_int_sub: a - b
+  *
+  * @return RAM_INT, allocated only if not small
+  */
+RAM_INT ram_int_sub(RAM_INT a, RAM_INT b);
+
+/**
+  * @brief ram_int_mul: a * b
+  *
+  * @return RAM_INT, allocated only if not small
+  */
+RAM_INT ram_int_mul(RAM_INT a, RAM_INT b);
+
+/**
+  * @brief ram_int_neg: -a
+  *
+  * @return RAM_INT, allocated only if not small
+  */
+RAM_INT ram_int_neg(RAM_INT a);
+
+/**
+  * @brief ram_int_cmp: compare two RAM_INTs
+  *
+  * @return < 0 if a < b, 0 if a == b, > 0 if a > b
+  */
+int ram_int_cmp(RAM_INT a, RAM_INT b);
+
+/**
+  * @brief ram_int_parse: a RAM_INT from decimal digits
+  *
+  * @param s optional sign, then one or more digits, then '\0'
+  * @param n set to the value if s is well formed
+  * @return true if s is well formed
+  */
+bool ram_int_parse(const char* s, RAM_INT* n);
+
+/**
+  * @brief ram_int_to_str: decimal digits of a RAM_INT
+  *
+  * You take ownership of the returned string and must free() it.
+  *
+  * @param n RAM_INT
+  * @return '\0'-terminated string, with a '-' if negative
+  */
+char* ram_int_to_str(RAM_INT n);
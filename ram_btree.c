@@ -0,0 +1,576 @@
+/*ram_btree.c*/
+
+/**
+  * @brief B-tree of variable names for nuPython's memory unit
+  *
+  * A classic B-tree of minimum degree 4: every node but the root
+  * holds 3..7 names. Insertion splits full nodes on the way down
+  * and removal fills minimal nodes on the way down, so neither
+  * ever has to walk back up.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <stdint.h>  // uint64_t
+
+#include "ram_btree.h"
+#include "ram_alloc.h"
+
+
+#define MIN_KEYS  3
+#define MAX_KEYS  7   // 2 * MIN_KEYS + 1
+
+//
+// count, leaf and prefix[] make up the first 64 bytes, so a node
+// search reads one cache line plus a name only on prefix ties.
+//
+struct RAM_BNODE
+{
+  int      count;              // # of names in node
+  int      leaf;               // 1 if node has no children
+  uint64_t prefix[MAX_KEYS];   // first 8 chars of names, big-endian
+  char*    names[MAX_KEYS];    // names, in order
+  int      cells[MAX_KEYS];    // cell of each name
+  struct RAM_BNODE* child[MAX_KEYS + 1];
+};
+
+//
+// a name and what the tree knows about it:
+//
+struct BKEY
+{
+  uint64_t prefix;
+  char*    name;
+  int      cell;
+};
+
+
+/**
+ * @brief name_prefix:
+ *
+ * returns the first 8 chars of name as a big-endian integer,
+ * padded with '\0', so prefixes compare like strcmp()
+ */
+static uint64_t name_prefix(const char* name)
+{
+  uint64_t prefix = 0;
+  bool ended = false;
+
+  for (int i = 0; i < 8; i++) {
+    if (!ended && name[i] == '\0')
+      ended = true;
+
+    prefix <<= 8;
+    if (!ended)
+      prefix |= (unsigned char) name[i];
+  }
+
+  return prefix;
+}
+
+/**
+ * @brief key_compare:
+ *
+ * compares key to name i of node, like strcmp()
+ */
+static int key_compare(struct BKEY* key, struct RAM_BNODE* node, int i)
+{
+  if (key->prefix != node->prefix[i])
+    return (key->prefix < node->prefix[i]) ? -1 : 1;
+
+  // same first 8 chars; if one name ended within them, so did the
+  // other (the last byte is '\0'), and the names are equal:
+  if ((key->prefix & 0xff) == 0)
+    return 0;
+
+  return strcmp(key->name + 8, node->names[i] + 8);
+}
+
+/**
+ * @brief find_slot:
+ *
+ * returns the first i such that key <= name i of node (count if
+ * none), and sets *found if they are equal
+ */
+static int find_slot(struct BKEY* key, struct RAM_BNODE* node, bool* found)
+{
+  int i = 0;
+  int c = 1;
+
+  while (i < node->count && (c = key_compare(key, node, i)) > 0)
+    i++;
+
+  *found = (i < node->count && c == 0);
+  return i;
+}
+
+static struct BKEY get_key(struct RAM_BNODE* node, int i)
+{
+  struct BKEY key;
+  key.prefix = node->prefix[i];
+  key.name = node->names[i];
+  key.cell = node->cells[i];
+  return key;
+}
+
+static void set_key(struct RAM_BNODE* node, int i, struct BKEY key)
+{
+  node->prefix[i] = key.prefix;
+  node->names[i] = key.name;
+  node->cells[i] = key.cell;
+}
+
+//
+// moves names from..count-1 of node by delta places (+1 or -1),
+// without changing count
+//
+static void shift_keys(struct RAM_BNODE* node, int from, int delta)
+{
+  int n = node->count - from;
+  if (n <= 0)
+    return;
+
+  memmove(&node->prefix[from + delta], &node->prefix[from], n * sizeof(uint64_t));
+  memmove(&node->names[from + delta], &node->names[from], n * sizeof(char*));
+  memmove(&node->cells[from + delta], &node->cells[from], n * sizeof(int));
+}
+
+//
+// moves children from..count of node by delta places
+//
+static void shift_children(struct RAM_BNODE* node, int from, int delta)
+{
+  int n = node->count + 1 - from;
+  if (n <= 0)
+    return;
+
+  memmove(&node->child[from + delta], &node->child[from], n * sizeof(struct RAM_BNODE*));
+}
+
+static struct RAM_BNODE* new_node(struct RAM_BTREE* tree, bool leaf)
+{
+  struct RAM_BNODE* node = (struct RAM_BNODE*) ram_mem_alloc(tree->arena, sizeof(struct RAM_BNODE));
+  node->count = 0;
+  node->leaf = leaf ? 1 : 0;
+  tree->nodes++;
+  return node;
+}
+
+static void free_node(struct RAM_BTREE* tree, struct RAM_BNODE* node)
+{
+  ram_mem_free(tree->arena, node);
+  tree->nodes--;
+}
+
+static void free_subtree(struct RAM_BTREE* tree, struct RAM_BNODE* node)
+{
+  if (!node->leaf) {
+    for (int i = 0; i <= node->count; i++)
+      free_subtree(tree, node->child[i]);
+  }
+  free_node(tree, node);
+}
+
+
+//
+// Insertion:
+//
+
+/**
+ * @brief split_child:
+ *
+ * splits the full child i of node in two, moving its middle name
+ * up into node, which must not be full
+ */
+static void split_child(struct RAM_BTREE* tree, struct RAM_BNODE* node, int i)
+{
+  struct RAM_BNODE* left = node->child[i];
+  struct RAM_BNODE* right = new_node(tree, left->leaf);
+
+  for (int k = 0; k < MIN_KEYS; k++)
+    set_key(right, k, get_key(left, MIN_KEYS + 1 + k));
+  if (!left->leaf) {
+    for (int k = 0; k <= MIN_KEYS; k++)
+      right->child[k] = left->child[MIN_KEYS + 1 + k];
+  }
+  right->count = MIN_KEYS;
+  left->count = MIN_KEYS;
+
+  shift_keys(node, i, 1);
+  shift_children(node, i + 1, 1);
+  set_key(node, i, get_key(left, MIN_KEYS));
+  node->child[i + 1] = right;
+  node->count++;
+}
+
+static void insert_nonfull(struct RAM_BTREE* tree, struct RAM_BNODE* node, struct BKEY* key)
+{
+  bool found;
+
+  while (!node->leaf) {
+    int i = find_slot(key, node, &found);
+
+    if (node->child[i]->count == MAX_KEYS) {
+      split_child(tree, node, i);
+      if (key_compare(key, node, i) > 0)
+        i++;
+    }
+    node = node->child[i];
+  }
+
+  int i = find_slot(key, node, &found);
+  shift_keys(node, i, 1);
+  set_key(node, i, *key);
+  node->count++;
+}
+
+
+//
+// Removal:
+//
+
+/**
+ * @brief merge_children:
+ *
+ * merges child i+1 of node and name i of node into child i; both
+ * children must be minimal
+ */
+static void merge_children(struct RAM_BTREE* tree, struct RAM_BNODE* node, int i)
+{
+  struct RAM_BNODE* left = node->child[i];
+  struct RAM_BNODE* right = node->child[i + 1];
+
+  set_key(left, left->count, get_key(node, i));
+  for (int k = 0; k < right->count; k++)
+    set_key(left, left->count + 1 + k, get_key(right, k));
+  if (!left->leaf) {
+    for (int k = 0; k <= right->count; k++)
+      left->child[left->count + 1 + k] = right->child[k];
+  }
+  left->count += right->count + 1;
+
+  shift_keys(node, i + 1, -1);
+  shift_children(node, i + 2, -1);
+  node->count--;
+
+  free_node(tree, right);
+}
+
+/**
+ * @brief fill_child:
+ *
+ * makes sure child i of node has more than MIN_KEYS names, by
+ * borrowing from a sibling or merging with one; returns the index
+ * of the child that now covers the old child's range
+ */
+static int fill_child(struct RAM_BTREE* tree, struct RAM_BNODE* node, int i)
+{
+  struct RAM_BNODE* c = node->child[i];
+
+  if (i > 0 && node->child[i - 1]->count > MIN_KEYS) {
+    // rotate right through the parent:
+    struct RAM_BNODE* left = node->child[i - 1];
+
+    shift_keys(c, 0, 1);
+    if (!c->leaf)
+      shift_children(c, 0, 1);
+    set_key(c, 0, get_key(node, i - 1));
+    if (!c->leaf)
+      c->child[0] = left->child[left->count];
+    c->count++;
+
+    set_key(node, i - 1, get_key(left, left->count - 1));
+    left->count--;
+    return i;
+  }
+
+  if (i < node->count && node->child[i + 1]->count > MIN_KEYS) {
+    // rotate left through the parent:
+    struct RAM_BNODE* right = node->child[i + 1];
+
+    set_key(c, c->count, get_key(node, i));
+    if (!c->leaf)
+      c->child[c->count + 1] = right->child[0];
+    c->count++;
+
+    set_key(node, i, get_key(right, 0));
+    shift_keys(right, 1, -1);
+    if (!right->leaf)
+      shift_children(right, 1, -1);
+    right->count--;
+    return i;
+  }
+
+  if (i < node->count) {
+    merge_children(tree, node, i);
+    return i;
+  }
+
+  merge_children(tree, node, i - 1);
+  return i - 1;
+}
+
+/**
+ * @brief remove_key:
+ *
+ * removes key from the subtree rooted at node, which has more than
+ * MIN_KEYS names unless it is the root
+ */
+static bool remove_key(struct RAM_BTREE* tree, struct RAM_BNODE* node, struct BKEY* key)
+{
+  bool found;
+  int i = find_slot(key, node, &found);
+
+  if (found && node->leaf) {
+    shift_keys(node, i + 1, -1);
+    node->count--;
+    return true;
+  }
+
+  if (found) {
+    // replace the name with its predecessor or successor, then
+    // remove that one from the child it came from:
+    struct RAM_BNODE* left = node->child[i];
+    struct RAM_BNODE* right = node->child[i + 1];
+
+    if (left->count > MIN_KEYS) {
+      struct RAM_BNODE* n = left;
+      while (!n->leaf)
+        n = n->child[n->count];
+      struct BKEY pred = get_key(n, n->count - 1);
+      set_key(node, i, pred);
+      return remove_key(tree, left, &pred);
+    }
+
+    if (right->count > MIN_KEYS) {
+      struct RAM_BNODE* n = right;
+      while (!n->leaf)
+        n = n->child[0];
+      struct BKEY succ = get_key(n, 0);
+      set_key(node, i, succ);
+      return remove_key(tree, right, &succ);
+    }
+
+    merge_children(tree, node, i);
+    return remove_key(tree, left, key);
+  }
+
+  if (node->leaf)
+    return false;
+
+  if (node->child[i]->count == MIN_KEYS)
+    i = fill_child(tree, node, i);
+
+  return remove_key(tree, node->child[i], key);
+}
+
+
+static void visit_subtree(struct RAM_BNODE* node, RAM_BTREE_VISITOR visit, void* arg)
+{
+  for (int i = 0; i < node->count; i++) {
+    if (!node->leaf)
+      visit_subtree(node->child[i], visit, arg);
+    visit(node->names[i], node->cells[i], arg);
+  }
+  if (!node->leaf)
+    visit_subtree(node->child[node->count], visit, arg);
+}
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_btree_init: initialize an empty tree
+  *
+  * @param tree Pointer to tree to initialize
+  * @param arena allocation arena for the nodes, NULL for malloc
+  * @return void
+  */
+void ram_btree_init(struct RAM_BTREE* tree, struct RAM_ARENA* arena)
+{
+  tree->arena = arena;
+  tree->root = NULL;
+  tree->count = 0;
+  tree->nodes = 0;
+}
+
+
+/**
+  * @brief ram_btree_clear: remove every name, freeing all nodes
+  *
+  * @param tree Pointer to tree
+  * @return void
+  */
+void ram_btree_clear(struct RAM_BTREE* tree)
+{
+  if (tree->root != NULL)
+    free_subtree(tree, tree->root);
+
+  tree->root = NULL;
+  tree->count = 0;
+}
+
+
+/**
+  * @brief ram_btree_find: cell mapped to a name
+  *
+  * @param tree Pointer to tree
+  * @param name variable name
+  * @return cell mapped to name, or -1 if name is not in the tree
+  */
+int ram_btree_find(struct RAM_BTREE* tree, char* name)
+{
+  struct BKEY key;
+  key.prefix = name_prefix(name);
+  key.name = name;
+
+  struct RAM_BNODE* node = tree->root;
+
+  while (node != NULL) {
+    bool found;
+    int i = find_slot(&key, node, &found);
+
+    if (found)
+      return node->cells[i];
+    if (node->leaf)
+      return -1;
+
+    node = node->child[i];
+  }
+
+  return -1;
+}
+
+
+/**
+  * @brief ram_btree_insert: map a name to a cell
+  *
+  * @param tree Pointer to tree
+  * @param name variable name, not copied
+  * @param cell cell address, >= 0
+  * @return true if inserted, false if name is already in the tree
+  */
+bool ram_btree_insert(struct RAM_BTREE* tree, char* name, int cell)
+{
+  if (ram_btree_find(tree, name) >= 0)
+    return false;
+
+  struct BKEY key;
+  key.prefix = name_prefix(name);
+  key.name = name;
+  key.cell = cell;
+
+  if (tree->root == NULL)
+    tree->root = new_node(tree, true);
+
+  if (tree->root->count == MAX_KEYS) {
+    struct RAM_BNODE* root = new_node(tree, false);
+    root->child[0] = tree->root;
+    tree->root = root;
+    split_child(tree, root, 0);
+  }
+
+  insert_nonfull(tree, tree->root, &key);
+  tree->count++;
+
+  return true;
+}
+
+
+/**
+  * @brief ram_btree_remove: remove a name from the tree
+  *
+  * @param tree Pointer to tree
+  * @param name variable name
+  * @return true if removed, false if name is not in the tree
+  */
+bool ram_btree_remove(struct RAM_BTREE* tree, char* name)
+{
+  if (tree->root == NULL)
+    return false;
+
+  struct BKEY key;
+  key.prefix = name_prefix(name);
+  key.name = name;
+
+  if (!remove_key(tree, tree->root, &key))
+    return false;
+  tree->count--;
+
+  // the root may have been merged away into its only child:
+  struct RAM_BNODE* root = tree->root;
+  if (root->count == 0) {
+    tree->root = root->leaf ? NULL : root->child[0];
+    free_node(tree, root);
+  }
+
+  return true;
+}
+
+
+/**
+  * @brief ram_btree_for_each: visit every name in alphabetical order
+  *
+  * The visitor must not insert into or remove from the tree.
+  *
+  * @param tree Pointer to tree
+  * @param visit function to call for each name
+  * @param arg passed through to visit
+  * @return void
+  */
+void ram_btree_for_each(struct RAM_BTREE* tree, RAM_BTREE_VISITOR visit, void* arg)
+{
+  if (tree->root != NULL)
+    visit_subtree(tree->root, visit, arg);
+}
+
+
+/**
+  * @brief ram_btree_next: the name that comes after a given one
+  *
+  * @param tree Pointer to tree
+  * @param after name to start after, or NULL for the first name
+  * @param name set to the first name greater than after
+  * @param cell set to its cell
+  * @return true if found, false if no name comes after
+  */
+bool ram_btree_next(struct RAM_BTREE* tree, const char* after, char** name, int* cell)
+{
+  bool found = false;
+
+  // each candidate on the way down is smaller than the last:
+  struct RAM_BNODE* node = tree->root;
+  while (node != NULL) {
+    int i = 0;
+    while (i < node->count && after != NULL && strcmp(node->names[i], after) <= 0)
+      i++;
+
+    if (i < node->count) {
+      *name = node->names[i];
+      *cell = node->cells[i];
+      found = true;
+    }
+
+    node = node->leaf ? NULL : node->child[i];
+  }
+
+  return found;
+}
+
+
+/**
+  * @brief ram_btree_bytes: heap bytes used by the tree's nodes
+  *
+  * @param tree Pointer to tree
+  * @return # of bytes allocated for nodes
+  */
+long ram_btree_bytes(struct RAM_BTREE* tree)
+{
+  return tree->nodes * (long) sizeof(struct RAM_BNODE);
+}
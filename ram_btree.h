@@ -0,0 +1,122 @@
+/*ram_btree.h*/
+
+/**
+  * @brief B-tree of variable names for nuPython's memory unit
+  *
+  * Maps variable names to cell addresses, in alphabetical order.
+  * Insertion, lookup and removal are O(log n), and visiting the
+  * names in order is a plain tree walk. Nodes hold up to 7 names;
+  * the node header and the first 8 chars of each name (stored as
+  * big-endian integers) fill one 64-byte cache line, so most of a
+  * node search never touches the strings themselves.
+  *
+  * The tree does not copy names: each name must stay valid, and
+  * unchanged, until it is removed from the tree.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+
+struct RAM_ARENA;   // see ram_alloc.h
+struct RAM_BNODE;   // tree node, private to ram_btree.c
+
+struct RAM_BTREE
+{
+  struct RAM_ARENA* arena;  // where nodes come from, NULL => malloc
+  struct RAM_BNODE* root;   // NULL when the tree is empty
+  int  count;               // # of names in the tree
+  long nodes;               // # of nodes allocated
+};
+
+//
+// Function called for each name by ram_btree_for_each().
+//
+typedef void (*RAM_BTREE_VISITOR)(char* name, int cell, void* arg);
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_btree_init: initialize an empty tree
+  *
+  * @param tree Pointer to tree to initialize
+  * @param arena allocation arena for the nodes, NULL for malloc
+  * @return void
+  */
+void ram_btree_init(struct RAM_BTREE* tree, struct RAM_ARENA* arena);
+
+/**
+  * @brief ram_btree_clear: remove every name, freeing all nodes
+  *
+  * @param tree Pointer to tree
+  * @return void
+  */
+void ram_btree_clear(struct RAM_BTREE* tree);
+
+/**
+  * @brief ram_btree_find: cell mapped to a name
+  *
+  * @param tree Pointer to tree
+  * @param name variable name
+  * @return cell mapped to name, or -1 if name is not in the tree
+  */
+int ram_btree_find(struct RAM_BTREE* tree, char* name);
+
+/**
+  * @brief ram_btree_insert: map a name to a cell
+  *
+  * @param tree Pointer to tree
+  * @param name variable name, not copied
+  * @param cell cell address, >= 0
+  * @return true if inserted, false if name is already in the tree
+  */
+bool ram_btree_insert(struct RAM_BTREE* tree, char* name, int cell);
+
+/**
+  * @brief ram_btree_remove: remove a name from the tree
+  *
+  * @param tree Pointer to tree
+  * @param name variable name
+  * @return true if removed, false if name is not in the tree
+  */
+bool ram_btree_remove(struct RAM_BTREE* tree, char* name);
+
+/**
+  * @brief ram_btree_for_each: visit every name in alphabetical order
+  *
+  * The visitor must not insert into or remove from the tree.
+  *
+  * @param tree Pointer to tree
+  * @param visit function to call for each name
+  * @param arg passed through to visit
+  * @return void
+  */
+void ram_btree_for_each(struct RAM_BTREE* tree, RAM_BTREE_VISITOR visit, void* arg);
+
+/**
+  * @brief ram_btree_next: the name that comes after a given one
+  *
+  * Walks the tree one name at a time in O(log n) per step; after
+  * need not be in the tree.
+  *
+  * @param tree Pointer to tree
+  * @param after name to start after, or NULL for the first name
+  * @param name set to the first name greater than after
+  * @param cell set to its cell
+  * @return true if found, false if no name comes after
+  */
+bool ram_btree_next(struct RAM_BTREE* tree, const char* after, char** name, int* cell);
+
+/**
+  * @brief ram_btree_bytes: heap bytes used by the tree's nodes
+  *
+  * @param tree Pointer to tree
+  * @return # of bytes allocated for nodes
+  */
+long ram_btree_bytes(struct RAM_BTREE* tree);
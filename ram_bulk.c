@@ -0,0 +1,267 @@
+/*ram_bulk.c*/
+
+/**
+  * @brief Loading environment files into nuPython's memory unit
+  *
+  * The file is read whole and parsed into arrays of names and
+  * values, which are then handed to ram_bulk_load() (defined in
+  * ram.c, since it builds the map and cells directly).
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <ctype.h>   // isalpha, isdigit, isspace
+#include <errno.h>
+#include <limits.h>  // INT_MIN, INT_MAX
+
+#include "ram_bulk.h"
+#include "ram_bigint.h"
+
+struct BULK_VARS
+{
+  char** names;
+  struct RAM_VALUE* values;
+  int count;
+  int capacity;
+};
+
+static void free_vars(struct BULK_VARS* vars)
+{
+  for (int i = 0; i < vars->count; i++) {
+    free(vars->names[i]);
+    if (vars->values[i].value_type == RAM_TYPE_STR)
+      free(vars->values[i].types.s);
+    else if (vars->values[i].value_type == RAM_TYPE_BIGINT)
+      ram_int_free(vars->values[i].types.n);
+  }
+  free(vars->names);
+  free(vars->values);
+}
+
+static void add_var(struct BULK_VARS* vars, char* name, struct RAM_VALUE value)
+{
+  if (vars->count >= vars->capacity) {
+    vars->capacity = (vars->capacity == 0) ? 64 : vars->capacity * 2;
+    vars->names = (char**) realloc(vars->names, vars->capacity * sizeof(char*));
+    vars->values = (struct RAM_VALUE*) realloc(vars->values, vars->capacity * sizeof(struct RAM_VALUE));
+  }
+
+  vars->names[vars->count] = name;
+  vars->values[vars->count] = value;
+  vars->count++;
+}
+
+static char* skip_blanks(char* p, char* end)
+{
+  while (p < end && (*p == ' ' || *p == '\t' || *p == '\r'))
+    p++;
+  return p;
+}
+
+//
+// a quoted string starting at p, decoded into a new '\0'-terminated
+// buffer; NULL if it is not closed before end:
+//
+static char* parse_str(char* p, char* end, char** after)
+{
+  char* s = (char*) malloc(end - p + 1);
+  int len = 0;
+
+  p++;  // opening quote
+  while (p < end && *p != '"') {
+    char c = *p++;
+
+    if (c == '\\') {
+      if (p == end)
+        break;
+      c = *p++;
+      if (c == 'n')
+        c = '\n';
+      else if (c == 't')
+        c = '\t';
+      else if (c != '\\' && c != '"') {
+        free(s);
+        return NULL;
+      }
+    }
+    s[len++] = c;
+  }
+
+  if (p == end) {
+    free(s);
+    return NULL;
+  }
+
+  s[len] = '\0';
+  *after = p + 1;
+  return s;
+}
+
+//
+// the value in [p, end); false if it is none of the forms above:
+//
+static bool parse_value(char* p, char* end, struct RAM_VALUE* value)
+{
+  char* after = end;
+
+  if (p < end && *p == '"') {
+    value->value_type = RAM_TYPE_STR;
+    value->types.s = parse_str(p, end, &after);
+    if (value->types.s == NULL)
+      return false;
+  }
+  else {
+    // the value is the rest of the line, less trailing blanks:
+    while (end > p && isspace((unsigned char) end[-1]))
+      end--;
+    int len = (int) (end - p);
+    after = end;
+
+    if (len == 4 && strncmp(p, "True", 4) == 0) {
+      value->value_type = RAM_TYPE_BOOLEAN;
+      value->types.i = 1;
+    }
+    else if (len == 5 && strncmp(p, "False", 5) == 0) {
+      value->value_type = RAM_TYPE_BOOLEAN;
+      value->types.i = 0;
+    }
+    else if (len == 4 && strncmp(p, "None", 4) == 0) {
+      value->value_type = RAM_TYPE_NONE;
+      value->types.i = 0;
+    }
+    else if (len > 0) {
+      // strtol and strtod stop at end, which is a blank or '\n':
+      char c = *end;
+      *end = '\0';
+
+      char* stop;
+      errno = 0;
+      long i = strtol(p, &stop, 10);
+
+      if (stop == end && errno == 0 && i >= INT_MIN && i <= INT_MAX) {
+        value->value_type = RAM_TYPE_INT;
+        value->types.i = (int) i;
+      }
+      else if (ram_int_parse(p, &value->types.n)) {
+        value->value_type = RAM_TYPE_BIGINT;
+        stop = end;
+      }
+      else {
+        value->value_type = RAM_TYPE_REAL;
+        value->types.d = strtod(p, &stop);
+      }
+
+      *end = c;
+      if (stop != end)
+        return false;
+    }
+    else {
+      return false;
+    }
+  }
+
+  after = skip_blanks(after, end);
+  if (after != end) {
+    if (value->value_type == RAM_TYPE_STR)
+      free(value->types.s);
+    else if (value->value_type == RAM_TYPE_BIGINT)
+      ram_int_free(value->types.n);
+    return false;
+  }
+  return true;
+}
+
+//
+// one line, [p, end) without its '\n'; false if malformed:
+//
+static bool parse_line(char* p, char* end, struct BULK_VARS* vars)
+{
+  p = skip_blanks(p, end);
+  if (p == end || *p == '#')
+    return true;
+
+  char* name = p;
+  if (!isalpha((unsigned char) *p) && *p != '_')
+    return false;
+  while (p < end && (isalnum((unsigned char) *p) || *p == '_'))
+    p++;
+  int name_len = (int) (p - name);
+
+  p = skip_blanks(p, end);
+  if (p == end || *p != '=')
+    return false;
+  p = skip_blanks(p + 1, end);
+
+  struct RAM_VALUE value;
+  if (!parse_value(p, end, &value))
+    return false;
+
+  char* s = (char*) malloc(name_len + 1);
+  memcpy(s, name, name_len);
+  s[name_len] = '\0';
+
+  add_var(vars, s, value);
+  return true;
+}
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_bulk_load_file: loads an environment file
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param path file of name=value lines
+  * @param workers Pointer to pool for the sort, or NULL
+  * @return # of variables created, -1 if the file can't be read
+  *         or a line is malformed
+  */
+int ram_bulk_load_file(struct RAM* memory, const char* path, struct RAM_WORKERS* workers)
+{
+  if (memory == NULL || path == NULL)
+    return -1;
+
+  FILE* file = fopen(path, "rb");
+  if (file == NULL)
+    return -1;
+
+  fseek(file, 0, SEEK_END);
+  long bytes = ftell(file);
+  fseek(file, 0, SEEK_SET);
+  if (bytes < 0) {
+    fclose(file);
+    return -1;
+  }
+
+  char* text = (char*) malloc(bytes + 1);
+  bool ok = ((long) fread(text, 1, bytes, file) == bytes);
+  fclose(file);
+  text[ok ? bytes : 0] = '\0';
+
+  struct BULK_VARS vars = { NULL, NULL, 0, 0 };
+  char* p = text;
+  char* end = text + (ok ? bytes : 0);
+
+  while (ok && p < end) {
+    char* eol = (char*) memchr(p, '\n', end - p);
+    if (eol == NULL)
+      eol = end;
+
+    ok = parse_line(p, eol, &vars);
+    p = eol + 1;
+  }
+
+  int created = -1;
+  if (ok)
+    created = ram_bulk_load(memory, vars.names, vars.values, vars.count, workers);
+
+  free_vars(&vars);
+  free(text);
+  return created;
+}
@@ -0,0 +1,75 @@
+/*ram_bulk.h*/
+
+/**
+  * @brief Loading many variables at once into nuPython's memory unit
+  *
+  * Writing n new variables one by one with ram_write_cell_by_name()
+  * inserts each name into the sorted map, moving O(n) entries per
+  * write, and grows the cells log n times. ram_bulk_load() instead
+  * sorts the names once (in parallel if given workers), merges them
+  * into the map in one pass, and grows the cells once to exactly
+  * the size needed.
+  *
+  * The result is the same as writing the variables one by one, in
+  * order: new names get addresses in order of first occurrence,
+  * and if a name appears more than once its last value wins.
+  *
+  * ram_bulk_load_file() reads an environment file of name=value
+  * lines, one variable per line:
+  *
+  *   # comment
+  *   count = 42
+  *   ratio = 0.5
+  *   debug = False
+  *   title = "nuPython\n"
+  *   unset = None
+  *
+  * Strings are in double quotes, with \n, \t, \\ and \" escapes.
+  * Integers too large for an int are loaded as RAM_TYPE_BIGINT.
+  * Blank lines and lines starting with # are skipped.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include "ram.h"
+
+
+struct RAM_WORKERS;  // see ram_parallel.h
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_bulk_load: writes many variables at once
+  *
+  * Same as calling ram_write_cell_by_name(memory, values[i],
+  * names[i]) for i = 0..n-1. Strings and arrays are duplicated.
+  * Inside a transaction the variables are written one by one, so
+  * each write can be rolled back.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param names array of n variable names
+  * @param values array of n values
+  * @param n # of variables
+  * @param workers Pointer to pool for the sort, or NULL
+  * @return # of variables created, -1 if bad arguments
+  */
+int ram_bulk_load(struct RAM* memory, char** names, struct RAM_VALUE* values, int n, struct RAM_WORKERS* workers);
+
+/**
+  * @brief ram_bulk_load_file: loads an environment file
+  *
+  * The whole file is parsed before anything is written, so a
+  * malformed file leaves memory as it was.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param path file of name=value lines
+  * @param workers Pointer to pool for the sort, or NULL
+  * @return # of variables created, -1 if the file can't be read
+  *         or a line is malformed
+  */
+int ram_bulk_load_file(struct RAM* memory, const char* path, struct RAM_WORKERS* workers);
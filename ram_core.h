@@ -0,0 +1,452 @@
+/*ram_core.h*/
+
+/**
+  * @brief Policy-based core of nuPython's memory unit
+  *
+  * BasicRam<IndexPolicy, GrowthPolicy, Allocator> holds memory
+  * cells and the names that map to them, with the three choices
+  * ram.c used to hard-code made template parameters:
+  *
+  *   IndexPolicy   how names are found: SortedArrayIndex,
+  *                 HashIndex or BTreeIndex
+  *   GrowthPolicy  how capacity grows: DoublingGrowth or
+  *                 HalfAgainGrowth
+  *   Allocator     where memory comes from: MallocAllocator or
+  *                 ArenaAllocator (see ram_alloc.h)
+  *
+  * Policies are plain structs passed by type, so each
+  * specialization is compiled with every policy call inlined or
+  * called directly; there are no virtual functions or function
+  * pointers.
+  *
+  * The C API in ram.h does not use BasicRam: it keeps its own
+  * struct RAM, whose fields nuPython reads directly. It shares
+  * two policies with the core: ram.c finds and places names in
+  * its sorted map with SortedArrayIndex::search() and
+  * lower_bound(), and grows its cells by DoublingGrowth.
+  *
+  * BasicRam itself keeps only scalar and string values (big ints
+  * only while small). Its strings are plain NUL-terminated copies,
+  * without the RAM_STR length header of the C API, so they can't
+  * hold '\0' chars. Arrays, transactions, logging and the rest
+  * are only in the C API.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <stdlib.h>
+#include <stdbool.h>  // true, false
+#include <string.h>
+#include <stdint.h>   // uint32_t
+
+#include "ram.h"
+#include "ram_alloc.h"
+#include "ram_bigint.h"
+#include "ram_btree.h"
+
+
+//
+// Allocators: alloc/resize/release like malloc/realloc/free, and
+// the arena (if any) for modules that take one.
+//
+struct MallocAllocator
+{
+  void* alloc(size_t bytes)             { return malloc(bytes); }
+  void* resize(void* ptr, size_t bytes) { return realloc(ptr, bytes); }
+  void  release(void* ptr)              { free(ptr); }
+  struct RAM_ARENA* arena()             { return NULL; }
+};
+
+struct ArenaAllocator
+{
+  struct RAM_ARENA* pool;  // NULL => malloc
+
+  explicit ArenaAllocator(struct RAM_ARENA* arena = NULL) : pool(arena) {}
+
+  void* alloc(size_t bytes)             { return ram_mem_alloc(pool, bytes); }
+  void* resize(void* ptr, size_t bytes) { return ram_mem_realloc(pool, ptr, bytes); }
+  void  release(void* ptr)              { ram_mem_free(pool, ptr); }
+  struct RAM_ARENA* arena()             { return pool; }
+};
+
+
+//
+// Growth policies: the capacity to start with, and the capacity
+// after growing from a full one.
+//
+struct DoublingGrowth
+{
+  static constexpr int initial = 4;
+  static int next_capacity(int capacity) { return capacity * 2; }
+};
+
+struct HalfAgainGrowth
+{
+  static constexpr int initial = 4;
+  static int next_capacity(int capacity) { return capacity + capacity / 2 + 1; }
+};
+
+
+//
+// Index policies: map names to addresses. Each has
+//
+//   void init(A& alloc)
+//   void destroy(A& alloc)
+//   int  find(const char* name)   // address, or -1
+//   void insert<G>(A& alloc, char* name, int address)
+//   long bytes()                  // heap bytes of the index
+//
+// Names are owned by the core and stay valid until destroy();
+// insert() is only called for names not in the index yet, and
+// grows the index with growth policy G.
+//
+
+/**
+  * @brief SortedArrayIndex: names in alphabetical order, binary search
+  *
+  * O(log n) lookups, O(n) inserts; the array is struct RAM's map,
+  * and ram.c uses search() and lower_bound() on memory->map.
+  */
+struct SortedArrayIndex
+{
+  struct RAM_MAP* map = NULL;
+  int count = 0;
+  int capacity = 0;
+
+  /**
+    * @brief lower_bound: where name is, or would be inserted
+    *
+    * @return index of the first entry not less than name
+    */
+  static int lower_bound(const struct RAM_MAP* map, int count, const char* name)
+  {
+    int left = 0;
+    int right = count;
+
+    while (left < right) {
+      int mid = (left + right) / 2;
+      if (strcmp(name, map[mid].varname) > 0)
+        left = mid + 1;
+      else
+        right = mid;
+    }
+
+    return left;
+  }
+
+  /**
+    * @brief search: cell of name
+    *
+    * @return cell of name, or -1 if not found
+    */
+  static int search(const struct RAM_MAP* map, int count, const char* name)
+  {
+    int i = lower_bound(map, count, name);
+    if (i < count && strcmp(name, map[i].varname) == 0)
+      return map[i].cell;
+
+    return -1;
+  }
+
+  template <class A> void init(A& alloc) {}
+
+  template <class A> void destroy(A& alloc)
+  {
+    alloc.release(map);
+    map = NULL;
+    count = capacity = 0;
+  }
+
+  int find(const char* name) { return search(map, count, name); }
+
+  template <class G, class A> void insert(A& alloc, char* name, int address)
+  {
+    if (count >= capacity) {
+      capacity = (capacity == 0) ? G::initial : G::next_capacity(capacity);
+      map = (struct RAM_MAP*) alloc.resize(map, capacity * sizeof(struct RAM_MAP));
+    }
+
+    int i = lower_bound(map, count, name);
+    memmove(&map[i + 1], &map[i], (count - i) * sizeof(struct RAM_MAP));
+    map[i].varname = name;
+    map[i].cell = address;
+    count++;
+  }
+
+  long bytes() { return (long) capacity * sizeof(struct RAM_MAP); }
+};
+
+/**
+  * @brief HashIndex: open addressing with linear probing
+  *
+  * O(1) lookups and inserts, FNV-1a hashes kept next to each name
+  * so most probes don't touch the strings. The table is at most
+  * half full, and always doubles so its size stays a power of 2.
+  */
+struct HashIndex
+{
+  struct SLOT
+  {
+    char*    name;  // NULL => empty
+    uint32_t hash;
+    int      address;
+  };
+
+  struct SLOT* slots = NULL;
+  int num_slots = 0;  // 0 or a power of 2
+  int count = 0;
+
+  static uint32_t hash_of(const char* name)
+  {
+    uint32_t h = 2166136261u;
+    for (const char* p = name; *p != '\0'; p++) {
+      h ^= (unsigned char) *p;
+      h *= 16777619u;
+    }
+    return h;
+  }
+
+  template <class A> void init(A& alloc) {}
+
+  template <class A> void destroy(A& alloc)
+  {
+    alloc.release(slots);
+    slots = NULL;
+    num_slots = count = 0;
+  }
+
+  int find(const char* name)
+  {
+    if (num_slots == 0)
+      return -1;
+
+    uint32_t h = hash_of(name);
+    for (int i = h & (num_slots - 1); slots[i].name != NULL; i = (i + 1) & (num_slots - 1)) {
+      if (slots[i].hash == h && strcmp(slots[i].name, name) == 0)
+        return slots[i].address;
+    }
+
+    return -1;
+  }
+
+  template <class G, class A> void insert(A& alloc, char* name, int address)
+  {
+    if ((count + 1) * 2 > num_slots)
+      rehash(alloc, (num_slots == 0) ? 16 : num_slots * 2);
+
+    put(name, hash_of(name), address);
+    count++;
+  }
+
+  long bytes() { return (long) num_slots * sizeof(struct SLOT); }
+
+private:
+  void put(char* name, uint32_t h, int address)
+  {
+    int i = h & (num_slots - 1);
+    while (slots[i].name != NULL)
+      i = (i + 1) & (num_slots - 1);
+
+    slots[i].name = name;
+    slots[i].hash = h;
+    slots[i].address = address;
+  }
+
+  template <class A> void rehash(A& alloc, int new_slots)
+  {
+    struct SLOT* old = slots;
+    int old_slots = num_slots;
+
+    slots = (struct SLOT*) alloc.alloc(new_slots * sizeof(struct SLOT));
+    memset(slots, 0, new_slots * sizeof(struct SLOT));
+    num_slots = new_slots;
+
+    for (int i = 0; i < old_slots; i++) {
+      if (old[i].name != NULL)
+        put(old[i].name, old[i].hash, old[i].address);
+    }
+
+    alloc.release(old);
+  }
+};
+
+/**
+  * @brief BTreeIndex: names in a B-tree, see ram_btree.h
+  *
+  * O(log n) lookups and inserts, names kept in order. Nodes come
+  * from the allocator's arena.
+  */
+struct BTreeIndex
+{
+  struct RAM_BTREE tree;
+
+  template <class A> void init(A& alloc) { ram_btree_init(&tree, alloc.arena()); }
+
+  template <class A> void destroy(A& alloc) { ram_btree_clear(&tree); }
+
+  int find(const char* name) { return ram_btree_find(&tree, (char*) name); }
+
+  template <class G, class A> void insert(A& alloc, char* name, int address)
+  {
+    ram_btree_insert(&tree, name, address);
+  }
+
+  long bytes() { return ram_btree_bytes(&tree); }
+};
+
+
+/**
+  * @brief BasicRam: memory cells, and an index of their names
+  *
+  * Like the C API, a variable's address is fixed once it is
+  * written, addresses are handed out in order from 0, and string
+  * values are copied in (up to their first '\0').
+  */
+template <class IndexPolicy, class GrowthPolicy, class Allocator = MallocAllocator>
+class BasicRam
+{
+public:
+  explicit BasicRam(Allocator allocator = Allocator())
+    : alloc(allocator), num_cells(0), max_cells(GrowthPolicy::initial)
+  {
+    cells = (struct RAM_VALUE*) alloc.alloc(max_cells * sizeof(struct RAM_VALUE));
+    names = (char**) alloc.alloc(max_cells * sizeof(char*));
+    index.init(alloc);
+  }
+
+  ~BasicRam()
+  {
+    for (int i = 0; i < num_cells; i++) {
+      release_value(cells[i]);
+      alloc.release(names[i]);
+    }
+
+    index.destroy(alloc);
+    alloc.release(cells);
+    alloc.release(names);
+  }
+
+  BasicRam(const BasicRam&) = delete;
+  BasicRam& operator=(const BasicRam&) = delete;
+
+  int size() const     { return num_cells; }
+  int capacity() const { return max_cells; }
+
+  /**
+    * @brief get_addr: address of a variable
+    *
+    * @return address, or -1 if name has not been written
+    */
+  int get_addr(const char* name) { return index.find(name); }
+
+  /**
+    * @brief cell: the value at an address, not a copy
+    *
+    * @return pointer to the cell, or NULL if address is invalid
+    */
+  const struct RAM_VALUE* cell(int address) const
+  {
+    if (address < 0 || address >= num_cells)
+      return NULL;
+
+    return &cells[address];
+  }
+
+  /**
+    * @brief write_by_addr: overwrite the value at an address
+    *
+    * @return true if successful, false if address is invalid or
+    *         value is an array or a boxed big int
+    */
+  bool write_by_addr(const struct RAM_VALUE& value, int address)
+  {
+    if (address < 0 || address >= num_cells || is_unsupported(value))
+      return false;
+
+    store(value, address);
+    return true;
+  }
+
+  /**
+    * @brief write_by_name: write the value of a variable
+    *
+    * A new variable gets the next address.
+    *
+    * @return true if successful, false if value is an array or a
+    *         boxed big int
+    */
+  bool write_by_name(const struct RAM_VALUE& value, const char* name)
+  {
+    if (is_unsupported(value))
+      return false;
+
+    int address = index.find(name);
+    if (address != -1) {
+      store(value, address);
+      return true;
+    }
+
+    if (num_cells >= max_cells)
+      grow();
+
+    address = num_cells++;
+    size_t bytes = strlen(name) + 1;
+    names[address] = (char*) alloc.alloc(bytes);
+    memcpy(names[address], name, bytes);
+
+    index.template insert<GrowthPolicy>(alloc, names[address], address);
+
+    cells[address].value_type = RAM_TYPE_NONE;
+    store(value, address);
+    return true;
+  }
+
+  /**
+    * @brief index_bytes: heap bytes of the name index
+    */
+  long index_bytes() { return index.bytes(); }
+
+private:
+  static bool is_unsupported(const struct RAM_VALUE& value)
+  {
+    return value.value_type == RAM_TYPE_INT_ARRAY || value.value_type == RAM_TYPE_REAL_ARRAY
+      || (value.value_type == RAM_TYPE_BIGINT && ram_int_box(value.types.n) != NULL);
+  }
+
+  void grow()
+  {
+    max_cells = GrowthPolicy::next_capacity(max_cells);
+    cells = (struct RAM_VALUE*) alloc.resize(cells, max_cells * sizeof(struct RAM_VALUE));
+    names = (char**) alloc.resize(names, max_cells * sizeof(char*));
+  }
+
+  void release_value(struct RAM_VALUE& cell)
+  {
+    if (cell.value_type == RAM_TYPE_STR)
+      alloc.release(cell.types.s);
+  }
+
+  void store(const struct RAM_VALUE& value, int address)
+  {
+    struct RAM_VALUE copy = value;
+    if (value.value_type == RAM_TYPE_STR) {
+      size_t bytes = strlen(value.types.s) + 1;
+      copy.types.s = (char*) alloc.alloc(bytes);
+      memcpy(copy.types.s, value.types.s, bytes);
+    }
+
+    release_value(cells[address]);
+    cells[address] = copy;
+  }
+
+  Allocator alloc;
+  IndexPolicy index;
+
+  struct RAM_VALUE* cells;  // values, by address
+  char** names;             // names, by address; the index points into these
+  int num_cells;
+  int max_cells;
+};
+
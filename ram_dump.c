@@ -0,0 +1,463 @@
+/*ram_dump.c*/
+
+/**
+  * @brief Exporting the contents of nuPython's memory unit
+  *
+  * Every format is written through one buffered writer: put_*()
+  * append to a 256KB buffer, which is handed to write() only when
+  * full and at the end. The cursor remembers the last name written
+  * and asks ram_next_sorted() for the one after it.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <stdarg.h>  // va_list
+#include <stdint.h>  // uint8_t, uint32_t
+#include <math.h>    // isfinite
+#include <errno.h>
+#include <unistd.h>  // write
+
+#include "ram_dump.h"
+#include "ram_alloc.h"
+#include "ram_bigint.h"
+#include "ram_spill.h"
+
+#define DUMP_BUFFER  (256 * 1024)
+#define MAX_NUMBER   400  // room for any one put_fmt(), "%lf" of DBL_MAX included
+
+struct RAM_DUMP
+{
+  struct RAM* memory;
+  struct RAM_ARENA* arena;  // memory's, outlives it like a value read
+  int  fd;
+  int  format;
+
+  char*  buffer;
+  size_t used;
+  bool   failed;   // a write() failed, nothing more is written
+
+  bool  started;   // the start of the dump has been written
+  char* last;      // last name written, NULL before the first
+  int   hint;      // where last was, see ram_next_sorted()
+  long  vars;      // # of variables written
+};
+
+//
+// ram_next_sorted() skips a string it can't read back from the
+// spill file, and counts it here:
+//
+static long failed_reads(struct RAM* memory)
+{
+  struct RAM_SPILL_STATS stats;
+  return ram_spill_stats(memory, &stats) ? stats.failed_reads : 0;
+}
+
+//
+// buffered writer:
+//
+static bool flush(struct RAM_DUMP* dump)
+{
+  size_t done = 0;
+  while (!dump->failed && done < dump->used) {
+    ssize_t n = write(dump->fd, dump->buffer + done, dump->used - done);
+    if (n < 0 && errno == EINTR)
+      continue;
+    if (n <= 0)
+      dump->failed = true;
+    else
+      done += n;
+  }
+
+  dump->used = 0;
+  return !dump->failed;
+}
+
+static void put_bytes(struct RAM_DUMP* dump, const void* bytes, size_t n)
+{
+  const char* p = (const char*) bytes;
+
+  while (n > 0 && !dump->failed) {
+    if (dump->used == DUMP_BUFFER)
+      flush(dump);
+
+    size_t chunk = DUMP_BUFFER - dump->used;
+    if (chunk > n)
+      chunk = n;
+    memcpy(dump->buffer + dump->used, p, chunk);
+    dump->used += chunk;
+    p += chunk;
+    n -= chunk;
+  }
+}
+
+static void put_str(struct RAM_DUMP* dump, const char* s)
+{
+  put_bytes(dump, s, strlen(s));
+}
+
+static void put_fmt(struct RAM_DUMP* dump, const char* format, ...)
+{
+  if (DUMP_BUFFER - dump->used < MAX_NUMBER)
+    flush(dump);
+
+  va_list args;
+  va_start(args, format);
+  int n = vsnprintf(dump->buffer + dump->used, MAX_NUMBER, format, args);
+  va_end(args);
+
+  if (n > 0)
+    dump->used += (n < MAX_NUMBER) ? n : MAX_NUMBER - 1;
+}
+
+static void put_u8(struct RAM_DUMP* dump, uint8_t x)
+{
+  put_bytes(dump, &x, sizeof(x));
+}
+
+static void put_u32(struct RAM_DUMP* dump, uint32_t x)
+{
+  put_bytes(dump, &x, sizeof(x));
+}
+
+//
+// writes len chars with JSON escapes, in quotes:
+//
+static void put_json_chars(struct RAM_DUMP* dump, const char* s, int len)
+{
+  put_bytes(dump, "\"", 1);
+
+  int plain = 0;  // chars since the last escape, not yet put
+  for (int i = 0; i < len; i++) {
+    unsigned char c = (unsigned char) s[i];
+    if (c != '"' && c != '\\' && c >= 0x20)
+      continue;
+
+    put_bytes(dump, s + plain, i - plain);
+    if (c == '"' || c == '\\')
+      put_fmt(dump, "\\%c", c);
+    else
+      put_fmt(dump, "\\u%04x", c);
+    plain = i + 1;
+  }
+  put_bytes(dump, s + plain, len - plain);
+
+  put_bytes(dump, "\"", 1);
+}
+
+static void put_bigint(struct RAM_DUMP* dump, RAM_INT n)
+{
+  char* digits = ram_int_to_str(n);
+  put_str(dump, digits);
+  free(digits);
+}
+
+//
+// one variable in each format:
+//
+static void put_text(struct RAM_DUMP* dump, struct RAM_VALUE* cell, char* varname)
+{
+  put_bytes(dump, " ", 1);
+  put_str(dump, varname);
+  put_bytes(dump, ": ", 2);
+
+  switch (cell->value_type) {
+    case RAM_TYPE_INT:
+      put_fmt(dump, "int, %d", cell->types.i);
+      break;
+    case RAM_TYPE_REAL:
+      put_fmt(dump, "real, %lf", cell->types.d);
+      break;
+    case RAM_TYPE_STR:
+      put_str(dump, "str, '");
+      put_bytes(dump, cell->types.s, ram_str_len(cell));
+      put_bytes(dump, "'", 1);
+      break;
+    case RAM_TYPE_PTR:
+      put_fmt(dump, "ptr, %d", cell->types.i);
+      break;
+    case RAM_TYPE_BOOLEAN:
+      put_str(dump, (cell->types.i == 0) ? "boolean, False" : "boolean, True");
+      break;
+    case RAM_TYPE_INT_ARRAY:
+      put_fmt(dump, "int array, length %d", cell->types.a->length);
+      break;
+    case RAM_TYPE_REAL_ARRAY:
+      put_fmt(dump, "real array, length %d", cell->types.a->length);
+      break;
+    case RAM_TYPE_BIGINT:
+      put_str(dump, "bigint, ");
+      put_bigint(dump, cell->types.n);
+      break;
+    default:
+      put_str(dump, "none, None");
+  }
+
+  put_bytes(dump, "\n", 1);
+}
+
+static void put_json_real(struct RAM_DUMP* dump, double d)
+{
+  if (isfinite(d))
+    put_fmt(dump, "%.17g", d);
+  else
+    put_str(dump, "null");
+}
+
+static void put_json(struct RAM_DUMP* dump, struct RAM_VALUE* cell, char* varname)
+{
+  put_str(dump, (dump->vars == 0) ? "\n" : ",\n");
+  put_json_chars(dump, varname, strlen(varname));
+
+  switch (cell->value_type) {
+    case RAM_TYPE_INT:
+      put_fmt(dump, ":{\"type\":\"int\",\"value\":%d}", cell->types.i);
+      break;
+    case RAM_TYPE_REAL:
+      put_str(dump, ":{\"type\":\"real\",\"value\":");
+      put_json_real(dump, cell->types.d);
+      put_bytes(dump, "}", 1);
+      break;
+    case RAM_TYPE_STR:
+      put_str(dump, ":{\"type\":\"str\",\"value\":");
+      put_json_chars(dump, cell->types.s, ram_str_len(cell));
+      put_bytes(dump, "}", 1);
+      break;
+    case RAM_TYPE_PTR:
+      put_fmt(dump, ":{\"type\":\"ptr\",\"value\":%d}", cell->types.i);
+      break;
+    case RAM_TYPE_BOOLEAN:
+      put_str(dump, (cell->types.i == 0) ? ":{\"type\":\"boolean\",\"value\":false}" : ":{\"type\":\"boolean\",\"value\":true}");
+      break;
+    case RAM_TYPE_INT_ARRAY:
+    case RAM_TYPE_REAL_ARRAY: {
+      struct RAM_ARRAY* a = cell->types.a;
+      bool ints = (cell->value_type == RAM_TYPE_INT_ARRAY);
+      put_str(dump, ints ? ":{\"type\":\"int array\",\"value\":[" : ":{\"type\":\"real array\",\"value\":[");
+      for (int i = 0; i < a->length; i++) {
+        if (i > 0)
+          put_bytes(dump, ",", 1);
+        if (ints)
+          put_fmt(dump, "%d", a->elems.i[i]);
+        else
+          put_json_real(dump, a->elems.d[i]);
+      }
+      put_str(dump, "]}");
+      break;
+    }
+    case RAM_TYPE_BIGINT:
+      // digits, as JSON numbers have no size limit:
+      put_str(dump, ":{\"type\":\"bigint\",\"value\":");
+      put_bigint(dump, cell->types.n);
+      put_bytes(dump, "}", 1);
+      break;
+    default:
+      put_str(dump, ":{\"type\":\"none\",\"value\":null}");
+  }
+}
+
+static void put_binary(struct RAM_DUMP* dump, struct RAM_VALUE* cell, char* varname)
+{
+  uint32_t name_len = strlen(varname);
+
+  put_u8(dump, (uint8_t) cell->value_type);
+  put_u32(dump, name_len);
+  put_bytes(dump, varname, name_len);
+
+  switch (cell->value_type) {
+    case RAM_TYPE_INT:
+    case RAM_TYPE_PTR:
+    case RAM_TYPE_BOOLEAN:
+      put_bytes(dump, &cell->types.i, sizeof(int));
+      break;
+    case RAM_TYPE_REAL:
+      put_bytes(dump, &cell->types.d, sizeof(double));
+      break;
+    case RAM_TYPE_STR:
+      put_u32(dump, ram_str_len(cell));
+      put_bytes(dump, cell->types.s, ram_str_len(cell));
+      break;
+    case RAM_TYPE_INT_ARRAY:
+      put_u32(dump, cell->types.a->length);
+      put_bytes(dump, cell->types.a->elems.i, cell->types.a->length * sizeof(int));
+      break;
+    case RAM_TYPE_REAL_ARRAY:
+      put_u32(dump, cell->types.a->length);
+      put_bytes(dump, cell->types.a->elems.d, cell->types.a->length * sizeof(double));
+      break;
+    case RAM_TYPE_BIGINT: {
+      struct RAM_BIGNUM* b = ram_int_box(cell->types.n);
+      int32_t header = (b != NULL) ? b->sign * b->length : 0;
+      put_bytes(dump, &header, sizeof(header));
+      if (b != NULL) {
+        put_bytes(dump, ram_bignum_limbs(b), b->length * sizeof(uint32_t));
+      }
+      else {
+        int64_t v;
+        ram_int_to_i64(cell->types.n, &v);
+        put_bytes(dump, &v, sizeof(v));
+      }
+      break;
+    }
+    default:
+      break;
+  }
+}
+
+static void put_start(struct RAM_DUMP* dump)
+{
+  if (dump->format == RAM_DUMP_TEXT) {
+    put_str(dump, "**MEMORY DUMP**\n");
+  }
+  else if (dump->format == RAM_DUMP_JSON) {
+    put_str(dump, "{");
+  }
+  else {
+    put_bytes(dump, "RAMD", 4);
+    put_u8(dump, RAM_DUMP_VERSION);
+  }
+
+  dump->started = true;
+}
+
+static void put_end(struct RAM_DUMP* dump)
+{
+  if (dump->format == RAM_DUMP_TEXT)
+    put_str(dump, "**END DUMP**\n");
+  else if (dump->format == RAM_DUMP_JSON)
+    put_str(dump, "\n}\n");
+  else
+    put_u8(dump, RAM_DUMP_END);
+}
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_dump_begin: start a dump to be written in steps
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param fd where to write; not closed
+  * @param format one of RAM_DUMP_FORMATS
+  * @return pointer to cursor, or NULL if format is bad
+  */
+struct RAM_DUMP* ram_dump_begin(struct RAM* memory, int fd, int format)
+{
+  if (memory == NULL || format < RAM_DUMP_TEXT || format > RAM_DUMP_BINARY)
+    return NULL;
+
+  struct RAM_DUMP* dump = (struct RAM_DUMP*) ram_mem_alloc(memory->arena, sizeof(struct RAM_DUMP));
+  memset(dump, 0, sizeof(struct RAM_DUMP));
+
+  dump->memory = memory;
+  dump->arena = memory->arena;
+  dump->fd = fd;
+  dump->format = format;
+  dump->hint = -1;
+  dump->buffer = (char*) ram_mem_alloc(memory->arena, DUMP_BUFFER);
+
+  return dump;
+}
+
+
+/**
+  * @brief ram_dump_step: write the next few variables
+  *
+  * @param dump Pointer to cursor
+  * @param max_vars most variables to write in this step
+  * @return # of variables written, 0 once every variable has been
+  *         written, -1 after an I/O error (or a string that can't
+  *         be read back from the spill file)
+  */
+int ram_dump_step(struct RAM_DUMP* dump, int max_vars)
+{
+  if (!dump->started)
+    put_start(dump);
+
+  int written = 0;
+  const char* after = dump->last;
+  char* varname;
+  int address;
+
+  long failed = failed_reads(dump->memory);
+
+  // memory doesn't change during a step, so its names stay valid:
+  while (written < max_vars && !dump->failed) {
+    struct RAM_VALUE* cell = ram_next_sorted(dump->memory, after, &dump->hint, &varname, &address);
+
+    // a dump short a variable is no dump:
+    if (failed_reads(dump->memory) != failed)
+      dump->failed = true;
+    if (cell == NULL || dump->failed)
+      break;
+
+    if (dump->format == RAM_DUMP_TEXT)
+      put_text(dump, cell, varname);
+    else if (dump->format == RAM_DUMP_JSON)
+      put_json(dump, cell, varname);
+    else
+      put_binary(dump, cell, varname);
+
+    after = varname;
+    dump->vars++;
+    written++;
+  }
+
+  // but may not outlive the next change to memory:
+  if (written > 0) {
+    size_t bytes = strlen(after) + 1;
+    dump->last = (char*) ram_mem_realloc(dump->arena, dump->last, bytes);
+    memcpy(dump->last, after, bytes);
+  }
+
+  return dump->failed ? -1 : written;
+}
+
+
+/**
+  * @brief ram_dump_end: finish a dump, and free its cursor
+  *
+  * @param dump Pointer to cursor
+  * @return true if the whole dump was written, false on an I/O error
+  *         or a string that can't be read back from the spill file
+  */
+bool ram_dump_end(struct RAM_DUMP* dump)
+{
+  if (!dump->started)
+    put_start(dump);
+  put_end(dump);
+
+  bool ok = flush(dump);
+
+  ram_mem_free(dump->arena, dump->last);
+  ram_mem_free(dump->arena, dump->buffer);
+  ram_mem_free(dump->arena, dump);
+  return ok;
+}
+
+
+/**
+  * @brief ram_dump: write every variable to a file descriptor
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param fd where to write; not closed
+  * @param format one of RAM_DUMP_FORMATS
+  * @return true if successful, false on an I/O error, a string
+  *         that can't be read back from the spill file, or bad format
+  */
+bool ram_dump(struct RAM* memory, int fd, int format)
+{
+  struct RAM_DUMP* dump = ram_dump_begin(memory, fd, format);
+  if (dump == NULL)
+    return false;
+
+  while (ram_dump_step(dump, memory->size + 1) > 0)
+    ;
+
+  return ram_dump_end(dump);
+}
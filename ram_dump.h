@@ -0,0 +1,109 @@
+/*ram_dump.h*/
+
+/**
+  * @brief Exporting the contents of nuPython's memory unit
+  *
+  * ram_dump() writes every variable, in alphabetical order, to a
+  * file descriptor as text, JSON or a compact binary format. Output
+  * goes through a large buffer, so a dump of any size takes a few
+  * write() calls rather than several printf() calls per variable.
+  *
+  * A dump can also be spread across interpreter steps with a
+  * cursor: ram_dump_begin(), then ram_dump_step() as often as
+  * there is time for, then ram_dump_end(). Memory may change
+  * between steps; the cursor resumes after the last name written
+  * (see ram_next_sorted()), so each variable is written at most
+  * once, with its value at the time of its step.
+  *
+  * Formats:
+  *
+  *   RAM_DUMP_TEXT    the lines of ram_print(), between
+  *                    "**MEMORY DUMP**" and "**END DUMP**"
+  *   RAM_DUMP_JSON    {"name":{"type":"int","value":1},...}, with
+  *                    array elements in full
+  *   RAM_DUMP_BINARY  "RAMD", a version byte, then per variable:
+  *                    type byte, u32 name length, name, value;
+  *                    ended by a 0xff byte. Values: INT, PTR and
+  *                    BOOLEAN as i32, REAL as f64, STR as u32
+  *                    length + chars, arrays as u32 length +
+  *                    elements, BIGINT as i32 0 + i64 if small,
+  *                    else i32 sign x # of limbs + u32 limbs,
+  *                    NONE as nothing. Numbers are in host byte
+  *                    order. Version 2 added BIGINT.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "ram.h"
+
+
+enum RAM_DUMP_FORMATS
+{
+  RAM_DUMP_TEXT = 0,
+  RAM_DUMP_JSON,
+  RAM_DUMP_BINARY
+};
+
+#define RAM_DUMP_VERSION 2     // binary format version
+#define RAM_DUMP_END     0xff  // binary end marker, in place of a type
+
+struct RAM_DUMP;  // cursor and output buffer, private to ram_dump.c
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_dump: write every variable to a file descriptor
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param fd where to write; not closed
+  * @param format one of RAM_DUMP_FORMATS
+  * @return true if successful, false on an I/O error, a string
+  *         that can't be read back from the spill file, or bad format
+  */
+bool ram_dump(struct RAM* memory, int fd, int format);
+
+/**
+  * @brief ram_dump_begin: start a dump to be written in steps
+  *
+  * Nothing is written until the first step.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param fd where to write; not closed
+  * @param format one of RAM_DUMP_FORMATS
+  * @return pointer to cursor, or NULL if format is bad
+  */
+struct RAM_DUMP* ram_dump_begin(struct RAM* memory, int fd, int format);
+
+/**
+  * @brief ram_dump_step: write the next few variables
+  *
+  * Variables are buffered; the buffer is written out whenever it
+  * fills up.
+  *
+  * @param dump Pointer to cursor
+  * @param max_vars most variables to write in this step
+  * @return # of variables written, 0 once every variable has been
+  *         written, -1 after an I/O error (or a string that can't
+  *         be read back from the spill file)
+  */
+int ram_dump_step(struct RAM_DUMP* dump, int max_vars);
+
+/**
+  * @brief ram_dump_end: finish a dump, and free its cursor
+  *
+  * Writes the end of the dump and flushes the buffer. Ending
+  * before every variable has been written leaves a shorter, but
+  * well-formed, dump.
+  *
+  * @param dump Pointer to cursor
+  * @return true if the whole dump was written, false on an I/O error
+  *         or a string that can't be read back from the spill file
+  */
+bool ram_dump_end(struct RAM_DUMP* dump);
@@ -0,0 +1,552 @@
+/*ram_hash.c*/
+
+/**
+  * @brief Content hashing of nuPython's memory unit
+  *
+  * The tree is complete and binary, stored heap-style: node 1 is
+  * the root, node i has children 2i and 2i+1, and the leaves are
+  * nodes 2^levels ... 2^(levels+1) - 1. A name goes in leaf
+  * (name hash >> (64 - levels)), so a node at depth l covers the
+  * names whose hashes start with the same l bits in any tree.
+  * Each node is the sum (mod 2^64) of the hashes of its names'
+  * (name, value) pairs, so changing one value adds the same
+  * difference to each node on its path. The tree gets another
+  * level whenever it holds more than 2 names per leaf.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <stdint.h>  // uint64_t
+
+#include "ram_hash.h"
+#include "ram_alloc.h"
+#include "ram_bigint.h"
+
+#define HASH_MIN_LEVELS 4
+
+struct HASH_ENTRY
+{
+  const char* name;    // NULL if no variable at this address
+  uint64_t name_hash;
+  uint64_t sum;        // what this address adds to its leaf
+  int  next;           // other addresses in the same leaf, -1 at the ends
+  int  prev;
+  bool changed;        // in the changed list
+  int  exposed;        // 1 + index in the exposed list, 0 if not there
+};
+
+struct RAM_HASH
+{
+  struct RAM_ARENA* arena;     // where the arrays come from, NULL => malloc
+
+  int levels;
+  uint64_t* nodes;             // 2^(levels+1), node 0 unused
+  int* heads;                  // first address in each leaf, -1 if empty
+
+  struct HASH_ENTRY* entries;  // per address
+  int capacity;                // # of entries
+  int count;                   // # of names
+
+  int* changed;                // addresses touched since they were set
+  int num_changed;
+  int changed_capacity;
+  bool stale;                  // every address was touched
+
+  int* exposed;                // addresses that may change unseen
+  int num_exposed;
+  int exposed_capacity;
+};
+
+
+//
+// hashing:
+//
+static uint64_t mix64(uint64_t x)
+{
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9ull;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111ebull;
+  x ^= x >> 31;
+  return x;
+}
+
+static uint64_t hash_bytes(uint64_t h, const void* bytes, long n)
+{
+  const char* p = (const char*) bytes;
+
+  while (n >= 8) {
+    uint64_t word;
+    memcpy(&word, p, 8);
+    h = mix64(h ^ word);
+    p += 8;
+    n -= 8;
+  }
+
+  uint64_t tail = 0;
+  memcpy(&tail, p, n);
+  return mix64(h ^ tail ^ ((uint64_t) n << 56));
+}
+
+static uint64_t value_hash(struct RAM_VALUE* value)
+{
+  uint64_t h = mix64(value->value_type + 1);
+
+  if (value->value_type == RAM_TYPE_REAL) {
+    h = hash_bytes(h, &value->types.d, sizeof(double));
+  }
+  else if (value->value_type == RAM_TYPE_STR) {
+    int len = ram_str_len(value);
+    h = hash_bytes(h ^ len, value->types.s, len);
+  }
+  else if (value->value_type == RAM_TYPE_INT_ARRAY) {
+    struct RAM_ARRAY* a = value->types.a;
+    h = hash_bytes(h ^ a->length, a->elems.i, a->length * sizeof(int));
+  }
+  else if (value->value_type == RAM_TYPE_REAL_ARRAY) {
+    struct RAM_ARRAY* a = value->types.a;
+    h = hash_bytes(h ^ a->length, a->elems.d, a->length * sizeof(double));
+  }
+  else if (value->value_type == RAM_TYPE_BIGINT) {
+    // the word if small, else the sign and limbs; each value has one form
+    struct RAM_BIGNUM* b = ram_int_box(value->types.n);
+    if (b == NULL)
+      h = mix64(h ^ (uint64_t) value->types.n);
+    else
+      h = hash_bytes(h ^ (uint64_t) (int64_t) (b->sign * b->length), ram_bignum_limbs(b), b->length * sizeof(uint32_t));
+  }
+  else if (value->value_type != RAM_TYPE_NONE) {
+    h = mix64(h ^ (uint32_t) value->types.i);
+  }
+
+  return h;
+}
+
+
+//
+// the tree:
+//
+static int leaf_of(struct RAM_HASH* hash, uint64_t name_hash)
+{
+  return (int) (name_hash >> (64 - hash->levels));
+}
+
+static void add_to_path(struct RAM_HASH* hash, int leaf, uint64_t delta)
+{
+  for (int i = (1 << hash->levels) + leaf; i >= 1; i >>= 1) {
+    hash->nodes[i] += delta;
+  }
+}
+
+static void link_entry(struct RAM_HASH* hash, int address)
+{
+  struct HASH_ENTRY* e = &hash->entries[address];
+  int leaf = leaf_of(hash, e->name_hash);
+
+  e->prev = -1;
+  e->next = hash->heads[leaf];
+  if (e->next != -1)
+    hash->entries[e->next].prev = address;
+  hash->heads[leaf] = address;
+
+  add_to_path(hash, leaf, e->sum);
+}
+
+static void unlink_entry(struct RAM_HASH* hash, int address)
+{
+  struct HASH_ENTRY* e = &hash->entries[address];
+  int leaf = leaf_of(hash, e->name_hash);
+
+  if (e->prev != -1)
+    hash->entries[e->prev].next = e->next;
+  else
+    hash->heads[leaf] = e->next;
+  if (e->next != -1)
+    hash->entries[e->next].prev = e->prev;
+
+  add_to_path(hash, leaf, -e->sum);
+}
+
+//
+// gives the tree the given # of levels, and puts every name back:
+//
+static void rebuild(struct RAM_HASH* hash, int levels)
+{
+  hash->levels = levels;
+  hash->nodes = (uint64_t*) ram_mem_realloc(hash->arena, hash->nodes, (2L << levels) * sizeof(uint64_t));
+  hash->heads = (int*) ram_mem_realloc(hash->arena, hash->heads, (1L << levels) * sizeof(int));
+
+  memset(hash->nodes, 0, (2L << levels) * sizeof(uint64_t));
+  for (int i = 0; i < (1 << levels); i++) {
+    hash->heads[i] = -1;
+  }
+
+  for (int address = 0; address < hash->capacity; address++) {
+    if (hash->entries[address].name != NULL)
+      link_entry(hash, address);
+  }
+}
+
+static void ensure_entry(struct RAM_HASH* hash, int address)
+{
+  if (address < hash->capacity)
+    return;
+
+  int capacity = (hash->capacity == 0) ? 64 : hash->capacity;
+  while (capacity <= address)
+    capacity *= 2;
+
+  hash->entries = (struct HASH_ENTRY*) ram_mem_realloc(hash->arena, hash->entries, capacity * sizeof(struct HASH_ENTRY));
+  memset(hash->entries + hash->capacity, 0, (capacity - hash->capacity) * sizeof(struct HASH_ENTRY));
+  hash->capacity = capacity;
+}
+
+//
+// takes address out of the exposed list, moving the last one
+// into its place:
+//
+static void unexpose(struct RAM_HASH* hash, int address)
+{
+  int i = hash->entries[address].exposed - 1;
+  if (i < 0)
+    return;
+
+  int last = hash->exposed[--hash->num_exposed];
+  hash->exposed[i] = last;
+  hash->entries[last].exposed = i + 1;
+  hash->entries[address].exposed = 0;
+}
+
+//
+// the entry in hash for the same name as other's entry, or -1;
+// it can only be under node j at depth l, where other is:
+//
+static int find_same(struct RAM_HASH* hash, int l, int j, struct HASH_ENTRY* other)
+{
+  int shift = hash->levels - l;
+
+  for (int leaf = j << shift; leaf < (j + 1) << shift; leaf++) {
+    for (int a = hash->heads[leaf]; a != -1; a = hash->entries[a].next) {
+      struct HASH_ENTRY* e = &hash->entries[a];
+      if (e->name_hash == other->name_hash && strcmp(e->name, other->name) == 0)
+        return a;
+    }
+  }
+
+  return -1;
+}
+
+/**
+ * @brief diff_names:
+ *
+ * compares the names under node j at depth l one by one; l is
+ * the depth of the shallower tree's leaves
+ */
+static int diff_names(struct RAM_HASH* hash1, struct RAM_HASH* hash2, int l, int j, RAM_DIFF_VISITOR visit, void* arg)
+{
+  int differ = 0;
+
+  int shift = hash1->levels - l;
+  for (int leaf = j << shift; leaf < (j + 1) << shift; leaf++) {
+    for (int a1 = hash1->heads[leaf]; a1 != -1; a1 = hash1->entries[a1].next) {
+      struct HASH_ENTRY* e1 = &hash1->entries[a1];
+      int a2 = find_same(hash2, l, j, e1);
+
+      if (a2 == -1 || hash2->entries[a2].sum != e1->sum) {
+        differ++;
+        if (visit != NULL)
+          visit((char*) e1->name, a1, a2, arg);
+      }
+    }
+  }
+
+  // and the names only hash2 has:
+  shift = hash2->levels - l;
+  for (int leaf = j << shift; leaf < (j + 1) << shift; leaf++) {
+    for (int a2 = hash2->heads[leaf]; a2 != -1; a2 = hash2->entries[a2].next) {
+      struct HASH_ENTRY* e2 = &hash2->entries[a2];
+      if (find_same(hash1, l, j, e2) == -1) {
+        differ++;
+        if (visit != NULL)
+          visit((char*) e2->name, -1, a2, arg);
+      }
+    }
+  }
+
+  return differ;
+}
+
+static int diff_node(struct RAM_HASH* hash1, struct RAM_HASH* hash2, int l, int j, RAM_DIFF_VISITOR visit, void* arg)
+{
+  int node = (1 << l) + j;
+  if (hash1->nodes[node] == hash2->nodes[node])
+    return 0;
+
+  int leaves = (hash1->levels < hash2->levels) ? hash1->levels : hash2->levels;
+  if (l == leaves)
+    return diff_names(hash1, hash2, l, j, visit, arg);
+
+  return diff_node(hash1, hash2, l + 1, 2 * j, visit, arg)
+       + diff_node(hash1, hash2, l + 1, 2 * j + 1, visit, arg);
+}
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_hash_create: an empty hash tree
+  *
+  * @param arena allocation arena for the tree, NULL for malloc
+  * @return pointer to tree
+  */
+struct RAM_HASH* ram_hash_create(struct RAM_ARENA* arena)
+{
+  struct RAM_HASH* hash = (struct RAM_HASH*) ram_mem_alloc(arena, sizeof(struct RAM_HASH));
+  memset(hash, 0, sizeof(struct RAM_HASH));
+  hash->arena = arena;
+  rebuild(hash, HASH_MIN_LEVELS);
+  return hash;
+}
+
+
+/**
+  * @brief ram_hash_destroy: free a hash tree
+  *
+  * @param hash Pointer to tree, or NULL
+  * @return void
+  */
+void ram_hash_destroy(struct RAM_HASH* hash)
+{
+  if (hash == NULL)
+    return;
+
+  struct RAM_ARENA* arena = hash->arena;
+  ram_mem_free(arena, hash->nodes);
+  ram_mem_free(arena, hash->heads);
+  ram_mem_free(arena, hash->entries);
+  ram_mem_free(arena, hash->changed);
+  ram_mem_free(arena, hash->exposed);
+  ram_mem_free(arena, hash);
+}
+
+
+/**
+  * @brief ram_hash_insert: a new variable
+  *
+  * @param hash Pointer to tree
+  * @param address its address
+  * @param name its name, which must stay put until removed
+  * @return void
+  */
+void ram_hash_insert(struct RAM_HASH* hash, int address, const char* name)
+{
+  ensure_entry(hash, address);
+
+  struct HASH_ENTRY* e = &hash->entries[address];
+  e->name = name;
+  e->name_hash = hash_bytes(0, name, strlen(name));
+  e->sum = 0;  // until its value is set
+  link_entry(hash, address);
+  hash->count++;
+
+  ram_hash_touch(hash, address);
+
+  if (hash->count > (2 << hash->levels))
+    rebuild(hash, hash->levels + 1);
+}
+
+
+/**
+  * @brief ram_hash_remove: a variable that is gone
+  *
+  * @param hash Pointer to tree
+  * @param address its address
+  * @return void
+  */
+void ram_hash_remove(struct RAM_HASH* hash, int address)
+{
+  if (address >= hash->capacity || hash->entries[address].name == NULL)
+    return;
+
+  unlink_entry(hash, address);
+  unexpose(hash, address);
+  hash->entries[address].name = NULL;
+  hash->count--;
+}
+
+
+/**
+  * @brief ram_hash_clear: every variable is gone
+  *
+  * @param hash Pointer to tree
+  * @return void
+  */
+void ram_hash_clear(struct RAM_HASH* hash)
+{
+  if (hash->capacity > 0)
+    memset(hash->entries, 0, hash->capacity * sizeof(struct HASH_ENTRY));
+  hash->count = 0;
+  hash->num_changed = 0;
+  hash->stale = false;
+  hash->num_exposed = 0;
+  rebuild(hash, hash->levels);
+}
+
+
+/**
+  * @brief ram_hash_touch: the value at address changed
+  *
+  * @param hash Pointer to tree
+  * @param address cell address
+  * @return void
+  */
+void ram_hash_touch(struct RAM_HASH* hash, int address)
+{
+  if (address >= hash->capacity)
+    return;
+
+  struct HASH_ENTRY* e = &hash->entries[address];
+  if (e->name == NULL || e->changed)
+    return;
+
+  if (hash->num_changed >= hash->changed_capacity) {
+    hash->changed_capacity = (hash->changed_capacity == 0) ? 64 : hash->changed_capacity * 2;
+    hash->changed = (int*) ram_mem_realloc(hash->arena, hash->changed, hash->changed_capacity * sizeof(int));
+  }
+
+  e->changed = true;
+  hash->changed[hash->num_changed++] = address;
+}
+
+
+/**
+  * @brief ram_hash_touch_all: every value may have changed
+  *
+  * O(1), and safe to call from several threads at once.
+  *
+  * @param hash Pointer to tree
+  * @return void
+  */
+void ram_hash_touch_all(struct RAM_HASH* hash)
+{
+  __atomic_store_n(&hash->stale, true, __ATOMIC_RELAXED);
+}
+
+
+/**
+  * @brief ram_hash_expose: the value at address may change unseen
+  *
+  * @param hash Pointer to tree
+  * @param address cell address
+  * @return void
+  */
+void ram_hash_expose(struct RAM_HASH* hash, int address)
+{
+  if (address >= hash->capacity)
+    return;
+
+  struct HASH_ENTRY* e = &hash->entries[address];
+  if (e->name == NULL || e->exposed != 0)
+    return;
+
+  if (hash->num_exposed >= hash->exposed_capacity) {
+    hash->exposed_capacity = (hash->exposed_capacity == 0) ? 16 : hash->exposed_capacity * 2;
+    hash->exposed = (int*) ram_mem_realloc(hash->arena, hash->exposed, hash->exposed_capacity * sizeof(int));
+  }
+
+  hash->exposed[hash->num_exposed++] = address;
+  e->exposed = hash->num_exposed;
+}
+
+
+/**
+  * @brief ram_hash_touch_exposed: touch every exposed address
+  *
+  * @param hash Pointer to tree
+  * @return void
+  */
+void ram_hash_touch_exposed(struct RAM_HASH* hash)
+{
+  for (int i = 0; i < hash->num_exposed; i++) {
+    ram_hash_touch(hash, hash->exposed[i]);
+  }
+}
+
+
+/**
+  * @brief ram_hash_next_changed: take an address to rehash
+  *
+  * @param hash Pointer to tree
+  * @return an address touched since it was last set, -1 if none
+  */
+int ram_hash_next_changed(struct RAM_HASH* hash)
+{
+  if (hash->stale) {
+    hash->stale = false;
+    for (int address = 0; address < hash->capacity; address++) {
+      ram_hash_touch(hash, address);
+    }
+  }
+
+  while (hash->num_changed > 0) {
+    int address = hash->changed[--hash->num_changed];
+    hash->entries[address].changed = false;
+
+    // removed since it was touched:
+    if (hash->entries[address].name != NULL)
+      return address;
+  }
+
+  return -1;
+}
+
+
+/**
+  * @brief ram_hash_set: the new value at address
+  *
+  * @param hash Pointer to tree
+  * @param address cell address
+  * @param value the cell, with strings flat and in memory
+  * @return void
+  */
+void ram_hash_set(struct RAM_HASH* hash, int address, struct RAM_VALUE* value)
+{
+  struct HASH_ENTRY* e = &hash->entries[address];
+
+  uint64_t sum = mix64(e->name_hash + mix64(value_hash(value)));
+  add_to_path(hash, leaf_of(hash, e->name_hash), sum - e->sum);
+  e->sum = sum;
+}
+
+
+/**
+  * @brief ram_hash_root: the root hash, once every change is set
+  *
+  * @param hash Pointer to tree
+  * @return root hash
+  */
+uint64_t ram_hash_root(struct RAM_HASH* hash)
+{
+  return hash->nodes[1];
+}
+
+
+/**
+  * @brief ram_hash_diff: visit the names two trees disagree on
+  *
+  * @param hash1 Pointer to a tree
+  * @param hash2 Pointer to another tree
+  * @param visit function to call for each name that differs, or NULL
+  * @param arg passed through to visit
+  * @return # of names that differ
+  */
+int ram_hash_diff(struct RAM_HASH* hash1, struct RAM_HASH* hash2, RAM_DIFF_VISITOR visit, void* arg)
+{
+  return diff_node(hash1, hash2, 0, 0, visit, arg);
+}
@@ -0,0 +1,237 @@
+/*ram_hash.h*/
+
+/**
+  * @brief Content hashing of nuPython's memory unit
+  *
+  * Once hashing is enabled, a memory keeps a hash tree over its
+  * variables, so two memories can be compared without reading
+  * every cell. ram_equal() compares the two root hashes, and
+  * ram_diff() descends only into subtrees whose hashes differ, so
+  * it costs O(changed x log n) rather than O(n).
+  *
+  * The tree is keyed by variable name: the top bits of a name's
+  * hash pick its leaf, and every node holds the sum of the hashes
+  * of the (name, value) pairs below it. Memories holding the same
+  * variables with the same values have the same tree, whatever
+  * order the variables were created in and whatever their
+  * addresses, so a root hash saved with ram_content_hash() can be
+  * compared with a later run's.
+  *
+  * Writes only mark their address as changed; the hashes of
+  * changed addresses are brought up to date the next time a hash
+  * is asked for, so a string appended to many times is hashed
+  * once.
+  *
+  * A visitor may change any cell in place, so every ram_for_each()
+  * style walk marks the whole memory as changed. An array returned
+  * by ram_get_array() may be changed at any time after, so it is
+  * rehashed every time a hash is asked for, until its variable is
+  * gone.
+  *
+  * Limitations: shared constants (see ram_shm.h) and cells at
+  * addresses >= ram_size() are not part of the hash.
+  *
+  * The functions below other than ram_hash_enable(), ram_equal(),
+  * ram_diff() and ram_content_hash() are called by the RAM module.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include <stdint.h>   // uint64_t
+
+#include "ram.h"
+
+
+struct RAM_HASH;  // hash tree, private to ram_hash.c
+
+//
+// called by ram_diff() for each variable that differs, with its
+// address in each memory, or -1 if that memory lacks it:
+//
+typedef void (*RAM_DIFF_VISITOR)(char* varname, int addr1, int addr2, void* arg);
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_hash_enable: keep a content hash of memory
+  *
+  * Hashes every variable already in memory. ram_equal(),
+  * ram_diff() and ram_content_hash() call this for a memory that
+  * isn't hashed yet. Calling this again has no effect.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_hash_enable(struct RAM* memory);
+
+/**
+  * @brief ram_equal: do two memories hold the same variables and values?
+  *
+  * O(1) besides hashing what changed since the last call; equal
+  * hashes are taken to mean equal contents.
+  *
+  * @param memory1 Pointer to a memory unit
+  * @param memory2 Pointer to another memory unit
+  * @return true if every name has the same type and value in both,
+  *         false if not or a string can't be read back from the
+  *         spill file
+  */
+bool ram_equal(struct RAM* memory1, struct RAM* memory2);
+
+/**
+  * @brief ram_diff: visit the variables two memories disagree on
+  *
+  * A variable differs if it is in only one of the memories, or if
+  * its type or value differ. Variables are visited in no
+  * particular order.
+  *
+  * @param memory1 Pointer to a memory unit
+  * @param memory2 Pointer to another memory unit
+  * @param visit function to call for each variable that differs,
+  *        or NULL to just count them
+  * @param arg passed through to visit
+  * @return # of variables that differ, or -1 (and nothing is
+  *         visited) if a string can't be read back from the spill
+  *         file
+  */
+int ram_diff(struct RAM* memory1, struct RAM* memory2, RAM_DIFF_VISITOR visit, void* arg);
+
+/**
+  * @brief ram_content_hash: hash of every variable's name and value
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return root hash, or 0 if a string can't be read back from the
+  *         spill file
+  */
+uint64_t ram_content_hash(struct RAM* memory);
+
+/**
+  * @brief ram_hash_create: an empty hash tree
+  *
+  * @param arena allocation arena for the tree, NULL for malloc
+  * @return pointer to tree
+  */
+struct RAM_HASH* ram_hash_create(struct RAM_ARENA* arena);
+
+/**
+  * @brief ram_hash_destroy: free a hash tree
+  *
+  * @param hash Pointer to tree, or NULL
+  * @return void
+  */
+void ram_hash_destroy(struct RAM_HASH* hash);
+
+/**
+  * @brief ram_hash_insert: a new variable
+  *
+  * @param hash Pointer to tree
+  * @param address its address
+  * @param name its name, which must stay put until removed
+  * @return void
+  */
+void ram_hash_insert(struct RAM_HASH* hash, int address, const char* name);
+
+/**
+  * @brief ram_hash_remove: a variable that is gone
+  *
+  * @param hash Pointer to tree
+  * @param address its address
+  * @return void
+  */
+void ram_hash_remove(struct RAM_HASH* hash, int address);
+
+/**
+  * @brief ram_hash_clear: every variable is gone
+  *
+  * @param hash Pointer to tree
+  * @return void
+  */
+void ram_hash_clear(struct RAM_HASH* hash);
+
+/**
+  * @brief ram_hash_touch: the value at address changed
+  *
+  * O(1); addresses with no variable are ignored.
+  *
+  * @param hash Pointer to tree
+  * @param address cell address
+  * @return void
+  */
+void ram_hash_touch(struct RAM_HASH* hash, int address);
+
+/**
+  * @brief ram_hash_touch_all: every value may have changed
+  *
+  * O(1), and safe to call from several threads at once; the
+  * addresses are touched by the next ram_hash_next_changed().
+  *
+  * @param hash Pointer to tree
+  * @return void
+  */
+void ram_hash_touch_all(struct RAM_HASH* hash);
+
+/**
+  * @brief ram_hash_expose: the value at address may change unseen
+  *
+  * For a value handed out to be changed in place. The address is
+  * touched by every ram_hash_touch_exposed() until its variable is
+  * removed.
+  *
+  * @param hash Pointer to tree
+  * @param address cell address
+  * @return void
+  */
+void ram_hash_expose(struct RAM_HASH* hash, int address);
+
+/**
+  * @brief ram_hash_touch_exposed: touch every exposed address
+  *
+  * @param hash Pointer to tree
+  * @return void
+  */
+void ram_hash_touch_exposed(struct RAM_HASH* hash);
+
+/**
+  * @brief ram_hash_next_changed: take an address to rehash
+  *
+  * @param hash Pointer to tree
+  * @return an address touched since it was last set, -1 if none
+  */
+int ram_hash_next_changed(struct RAM_HASH* hash);
+
+/**
+  * @brief ram_hash_set: the new value at address
+  *
+  * @param hash Pointer to tree
+  * @param address cell address
+  * @param value the cell, with strings flat and in memory
+  * @return void
+  */
+void ram_hash_set(struct RAM_HASH* hash, int address, struct RAM_VALUE* value);
+
+/**
+  * @brief ram_hash_root: the root hash, once every change is set
+  *
+  * @param hash Pointer to tree
+  * @return root hash
+  */
+uint64_t ram_hash_root(struct RAM_HASH* hash);
+
+/**
+  * @brief ram_hash_diff: visit the names two trees disagree on
+  *
+  * Both trees must have every change set.
+  *
+  * @param hash1 Pointer to a tree
+  * @param hash2 Pointer to another tree
+  * @param visit function to call for each name that differs, or NULL
+  * @param arg passed through to visit
+  * @return # of names that differ
+  */
+int ram_hash_diff(struct RAM_HASH* hash1, struct RAM_HASH* hash2, RAM_DIFF_VISITOR visit, void* arg);
@@ -0,0 +1,570 @@
+/*ram_parallel.c*/
+
+/**
+  * @brief Parallel passes over nuPython's memory unit
+  *
+  * A RAM_WORKERS pool keeps a set of threads around so that full
+  * passes over a large memory (serialization, GC marking,
+  * validation) can be split across cores. Work is cut into chunks
+  * of cells; each thread starts on its own share of chunks and
+  * steals from the others once it runs out, so uneven chunks
+  * don't leave threads idle.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <pthread.h>
+
+#include "ram.h"
+#include "ram_parallel.h"
+#include "ram_spill.h"
+#include "ram_alloc.h"
+
+
+//
+// A job is a set of tasks numbered 0..num_tasks-1. Each thread
+// (workers plus the caller) owns a queue holding a contiguous
+// range of task numbers, packed as (next << 32 | end) into one
+// word so that the owner taking from the front and thieves taking
+// from the back can both use a single compare-and-swap.
+//
+struct RAM_PAR_JOB
+{
+  void (*task)(int index, void* arg);  // runs one task
+  void* arg;                           // passed to task
+  int num_queues;                      // workers + caller
+  unsigned long long* queues;          // one packed range per thread
+};
+
+static unsigned long long pack_range(unsigned int next, unsigned int end)
+{
+  return ((unsigned long long) next << 32) | end;
+}
+
+/**
+ * @brief take_task:
+ *
+ * removes one task from a queue, from the front if the queue
+ * belongs to this thread, from the back if stealing
+ *
+ * @param queue packed range
+ * @param steal true => take from the back
+ * @param index returns the task number
+ *
+ * @return true if a task was taken, false if the queue is empty
+ */
+static bool take_task(unsigned long long* queue, bool steal, int* index)
+{
+  unsigned long long old = __atomic_load_n(queue, __ATOMIC_ACQUIRE);
+
+  while (true) {
+    unsigned int next = (unsigned int) (old >> 32);
+    unsigned int end = (unsigned int) old;
+
+    if (next >= end)
+      return false;
+
+    unsigned long long desired;
+    if (steal) {
+      desired = pack_range(next, end - 1);
+      *index = end - 1;
+    }
+    else {
+      desired = pack_range(next + 1, end);
+      *index = next;
+    }
+
+    // on failure old is reloaded with the current value:
+    if (__atomic_compare_exchange_n(queue, &old, desired, false, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+      return true;
+  }
+}
+
+/**
+ * @brief run_job:
+ *
+ * runs tasks from this thread's queue, then steals from the
+ * other queues until every queue is empty
+ *
+ * @param job
+ * @param self index of this thread's queue
+ *
+ * @return void
+ */
+static void run_job(struct RAM_PAR_JOB* job, int self)
+{
+  int index;
+
+  while (take_task(&job->queues[self], false, &index)) {
+    job->task(index, job->arg);
+  }
+
+  bool found = true;
+  while (found) {
+    found = false;
+    for (int k = 1; k < job->num_queues; k++) {
+      int victim = (self + k) % job->num_queues;
+      if (take_task(&job->queues[victim], true, &index)) {
+        job->task(index, job->arg);
+        found = true;
+        break;
+      }
+    }
+  }
+
+  return;
+}
+
+/**
+ * @brief worker_main:
+ *
+ * thread body: waits for a job, helps run it, repeats
+ *
+ * @param arg Pointer to pool
+ *
+ * @return NULL
+ */
+static void* worker_main(void* arg)
+{
+  struct RAM_WORKERS* workers = (struct RAM_WORKERS*) arg;
+
+  pthread_mutex_lock(&workers->lock);
+  int self = -1;
+  for (int i = 0; i < workers->num_threads; i++) {
+    if (pthread_equal(workers->threads[i], pthread_self()))
+      self = i;
+  }
+  long seen = 0;  // jobs posted before this thread ran are still seen
+
+  while (true) {
+    while (!workers->shutdown && workers->generation == seen) {
+      pthread_cond_wait(&workers->start, &workers->lock);
+    }
+    if (workers->shutdown)
+      break;
+
+    seen = workers->generation;
+    struct RAM_PAR_JOB* job = workers->job;
+    pthread_mutex_unlock(&workers->lock);
+
+    run_job(job, self);
+
+    pthread_mutex_lock(&workers->lock);
+    workers->busy--;
+    if (workers->busy == 0)
+      pthread_cond_signal(&workers->done);
+  }
+
+  pthread_mutex_unlock(&workers->lock);
+  return NULL;
+}
+
+/**
+ * @brief run_parallel:
+ *
+ * runs task(0..num_tasks-1) on the pool and the calling thread,
+ * returning once all tasks have finished; the pool has one job
+ * slot, so callers on other threads wait for their turn
+ *
+ * @param workers pool, or NULL to run on the calling thread
+ * @param num_tasks
+ * @param task
+ * @param arg passed to task
+ *
+ * @return void
+ */
+static void run_parallel(struct RAM_WORKERS* workers, int num_tasks, void (*task)(int, void*), void* arg)
+{
+  if (workers == NULL || workers->num_threads == 0 || num_tasks <= 1) {
+    for (int i = 0; i < num_tasks; i++) {
+      task(i, arg);
+    }
+    return;
+  }
+
+  struct RAM_PAR_JOB job;
+  job.task = task;
+  job.arg = arg;
+  job.num_queues = workers->num_threads + 1;
+  job.queues = (unsigned long long*) malloc(job.num_queues * sizeof(unsigned long long));
+
+  // give each thread an equal contiguous share to start with:
+  for (int q = 0; q < job.num_queues; q++) {
+    unsigned int begin = (unsigned int) ((long long) num_tasks * q / job.num_queues);
+    unsigned int end = (unsigned int) ((long long) num_tasks * (q + 1) / job.num_queues);
+    job.queues[q] = pack_range(begin, end);
+  }
+
+  pthread_mutex_lock(&workers->submit);
+  pthread_mutex_lock(&workers->lock);
+  workers->job = &job;
+  workers->busy = workers->num_threads;
+  workers->generation++;
+  pthread_cond_broadcast(&workers->start);
+  pthread_mutex_unlock(&workers->lock);
+
+  // the caller owns the last queue:
+  run_job(&job, workers->num_threads);
+
+  pthread_mutex_lock(&workers->lock);
+  while (workers->busy > 0) {
+    pthread_cond_wait(&workers->done, &workers->lock);
+  }
+  workers->job = NULL;
+  pthread_mutex_unlock(&workers->lock);
+  pthread_mutex_unlock(&workers->submit);
+
+  free(job.queues);
+
+  return;
+}
+
+
+//
+// ram_parallel_for_each: one task per chunk of cells.
+//
+struct FOR_EACH_ARGS
+{
+  struct RAM* memory;
+  RAM_VISITOR visit;
+  void* arg;
+  int chunk;  // # of cells per task
+};
+
+static void for_each_task(int index, void* arg)
+{
+  struct FOR_EACH_ARGS* args = (struct FOR_EACH_ARGS*) arg;
+
+  int begin = index * args->chunk;
+
+  ram_for_each_range(args->memory, begin, begin + args->chunk, args->visit, args->arg);
+}
+
+
+//
+// ram_parallel_sort_names: stable merge sort of indices by name.
+// Segments are sorted in parallel, then merged pairwise in
+// parallel rounds until one run is left.
+//
+struct SORT_ARGS
+{
+  char** names;
+  int n;
+  int* src;     // runs being merged this round
+  int* dst;     // where merged runs go
+  int width;    // length of each input run this round
+};
+
+static bool name_before(char** names, int a, int b)
+{
+  int c = strcmp(names[a], names[b]);
+  return c < 0 || (c == 0 && a < b);
+}
+
+/**
+ * @brief merge_runs:
+ *
+ * merges the sorted runs src[lo..mid) and src[mid..hi) into dst[lo..hi)
+ */
+static void merge_runs(char** names, int* src, int* dst, int lo, int mid, int hi)
+{
+  int i = lo;
+  int j = mid;
+  int k = lo;
+
+  while (i < mid && j < hi) {
+    if (name_before(names, src[j], src[i]))
+      dst[k++] = src[j++];
+    else
+      dst[k++] = src[i++];
+  }
+  while (i < mid)
+    dst[k++] = src[i++];
+  while (j < hi)
+    dst[k++] = src[j++];
+}
+
+/**
+ * @brief merge_sort:
+ *
+ * sorts a[lo..hi) with tmp[lo..hi) as scratch space
+ */
+static void merge_sort(char** names, int* a, int* tmp, int lo, int hi)
+{
+  if (hi - lo <= 16) {
+    // insertion sort for short runs:
+    for (int i = lo + 1; i < hi; i++) {
+      int x = a[i];
+      int j = i - 1;
+      while (j >= lo && name_before(names, x, a[j])) {
+        a[j + 1] = a[j];
+        j--;
+      }
+      a[j + 1] = x;
+    }
+    return;
+  }
+
+  int mid = lo + (hi - lo) / 2;
+  merge_sort(names, a, tmp, lo, mid);
+  merge_sort(names, a, tmp, mid, hi);
+
+  memcpy(tmp + lo, a + lo, (hi - lo) * sizeof(int));
+  merge_runs(names, tmp, a, lo, mid, hi);
+}
+
+static void sort_segment_task(int index, void* arg)
+{
+  struct SORT_ARGS* args = (struct SORT_ARGS*) arg;
+
+  int lo = index * args->width;
+  int hi = lo + args->width;
+  if (hi > args->n)
+    hi = args->n;
+
+  merge_sort(args->names, args->src, args->dst, lo, hi);
+}
+
+static void merge_task(int index, void* arg)
+{
+  struct SORT_ARGS* args = (struct SORT_ARGS*) arg;
+
+  int lo = index * 2 * args->width;
+  int mid = lo + args->width;
+  int hi = mid + args->width;
+  if (mid > args->n)
+    mid = args->n;
+  if (hi > args->n)
+    hi = args->n;
+
+  merge_runs(args->names, args->src, args->dst, lo, mid, hi);
+}
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_workers_init: start a pool of worker threads
+  *
+  * Starts num_threads threads that wait for parallel passes. The
+  * thread calling a parallel function also takes part, so
+  * num_threads = cores - 1 uses every core. You take ownership of
+  * the returned pool and must call ram_workers_destroy() when you
+  * are done.
+  *
+  * @param num_threads # of threads to start (>= 0)
+  * @return pointer to pool, or NULL if num_threads < 0
+  */
+struct RAM_WORKERS* ram_workers_init(int num_threads)
+{
+  if (num_threads < 0)
+    return NULL;
+
+  struct RAM_WORKERS* workers = (struct RAM_WORKERS*) malloc(sizeof(struct RAM_WORKERS));
+  workers->threads = (pthread_t*) malloc((num_threads + 1) * sizeof(pthread_t));
+  workers->num_threads = num_threads;
+  pthread_mutex_init(&workers->submit, NULL);
+  pthread_mutex_init(&workers->lock, NULL);
+  pthread_cond_init(&workers->start, NULL);
+  pthread_cond_init(&workers->done, NULL);
+  workers->generation = 0;
+  workers->busy = 0;
+  workers->shutdown = false;
+  workers->job = NULL;
+
+  // hold the lock so workers see every thread id before looking
+  // up their own:
+  pthread_mutex_lock(&workers->lock);
+  for (int i = 0; i < num_threads; i++) {
+    pthread_create(&workers->threads[i], NULL, worker_main, workers);
+  }
+  pthread_mutex_unlock(&workers->lock);
+
+  return workers;
+}
+
+
+/**
+  * @brief ram_workers_destroy: stops the worker threads
+  *
+  * @param workers Pointer to pool
+  * @return void
+  */
+void ram_workers_destroy(struct RAM_WORKERS* workers)
+{
+  if (workers == NULL)
+    return;
+
+  pthread_mutex_lock(&workers->lock);
+  workers->shutdown = true;
+  pthread_cond_broadcast(&workers->start);
+  pthread_mutex_unlock(&workers->lock);
+
+  for (int i = 0; i < workers->num_threads; i++) {
+    pthread_join(workers->threads[i], NULL);
+  }
+
+  pthread_cond_destroy(&workers->start);
+  pthread_cond_destroy(&workers->done);
+  pthread_mutex_destroy(&workers->lock);
+  pthread_mutex_destroy(&workers->submit);
+  free(workers->threads);
+  free(workers);
+
+  return;
+}
+
+
+/**
+  * @brief ram_parallel_for_each: visit every cell using the worker pool
+  *
+  * Same as ram_for_each(), but the cells are split into chunks
+  * that are visited concurrently by the workers and the calling
+  * thread. Cells are visited exactly once, in no particular
+  * order; the call returns once every cell has been visited. The
+  * visitor must be safe to call from several threads at once. If
+  * workers is NULL, this is the same as ram_for_each().
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param workers Pointer to pool, or NULL
+  * @param visit function to call for each cell
+  * @param arg passed through to visit
+  * @return void
+  */
+void ram_parallel_for_each(struct RAM* memory, struct RAM_WORKERS* workers, RAM_VISITOR visit, void* arg)
+{
+  if (memory == NULL || visit == NULL)
+    return;
+
+  if (workers == NULL || workers->num_threads == 0) {
+    ram_for_each(memory, visit, arg);
+    return;
+  }
+
+  // workers must not flatten strings concurrently:
+  ram_str_flatten_all(memory);
+
+  // ~8 chunks per thread so stealing can even out the load, but
+  // not so small that task overhead dominates:
+  int threads = workers->num_threads + 1;
+  int chunk = memory->size / (threads * 8);
+  if (chunk < 1024)
+    chunk = 1024;
+
+  struct FOR_EACH_ARGS args;
+  args.memory = memory;
+  args.visit = visit;
+  args.arg = arg;
+  args.chunk = chunk;
+
+  int num_tasks = (memory->size + chunk - 1) / chunk;
+  run_parallel(workers, num_tasks, for_each_task, &args);
+
+  // strings read back above go back out to the spill file:
+  ram_spill_enforce(memory);
+
+  return;
+}
+
+
+/**
+  * @brief ram_parallel_sort_names: alphabetical order of a set of names
+  *
+  * Fills order[0..n-1] with the indices 0..n-1 sorted so that
+  * names[order[0]], names[order[1]], ... are in alphabetical order
+  * (strcmp). Equal names keep their original relative order. Runs
+  * a parallel merge sort on the workers; if workers is NULL the
+  * sort runs on the calling thread.
+  *
+  * @param workers Pointer to pool, or NULL
+  * @param names array of n names
+  * @param n # of names
+  * @param order array of n ints to fill in
+  * @return void
+  */
+void ram_parallel_sort_names(struct RAM_WORKERS* workers, char** names, int n, int* order)
+{
+  if (n <= 0)
+    return;
+
+  for (int i = 0; i < n; i++) {
+    order[i] = i;
+  }
+
+  int* tmp = (int*) malloc(n * sizeof(int));
+
+  // one segment per thread, each at least 4096 names:
+  int threads = (workers == NULL) ? 1 : workers->num_threads + 1;
+  int width = (n + threads - 1) / threads;
+  if (width < 4096)
+    width = 4096;
+
+  struct SORT_ARGS args;
+  args.names = names;
+  args.n = n;
+  args.src = order;
+  args.dst = tmp;
+  args.width = width;
+
+  int num_runs = (n + width - 1) / width;
+  run_parallel(workers, num_runs, sort_segment_task, &args);
+
+  // merge pairs of runs until one is left, swapping buffers
+  // each round:
+  while (num_runs > 1) {
+    int num_merges = (num_runs + 1) / 2;
+    run_parallel(workers, num_merges, merge_task, &args);
+
+    int* swap = args.src;
+    args.src = args.dst;
+    args.dst = swap;
+
+    args.width *= 2;
+    num_runs = num_merges;
+  }
+
+  if (args.src != order)
+    memcpy(order, args.src, n * sizeof(int));
+
+  free(tmp);
+
+  return;
+}
+
+
+/**
+  * @brief ram_parallel_sorted_addrs: addresses in alphabetical order
+  *
+  * Fills addrs[0..N-1], where N is the number of vars in memory,
+  * with the cell addresses sorted by variable name. This is
+  * rebuilt from the variable names rather than read from the map,
+  * so validation passes can check the map against it.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param workers Pointer to pool, or NULL
+  * @param addrs array of ram_size(memory) ints to fill in
+  * @return void
+  */
+void ram_parallel_sorted_addrs(struct RAM* memory, struct RAM_WORKERS* workers, int* addrs)
+{
+  if (memory == NULL || memory->size == 0)
+    return;
+
+  // name of the variable at each address:
+  char** names = (char**) ram_mem_alloc(memory->arena, memory->size * sizeof(char*));
+  for (int i = 0; i < memory->size; i++) {
+    names[memory->map[i].cell] = memory->map[i].varname;
+  }
+
+  ram_parallel_sort_names(workers, names, memory->size, addrs);
+
+  ram_mem_free(memory->arena, names);
+
+  return;
+}
@@ -0,0 +1,118 @@
+/*ram_parallel.h*/
+
+/**
+  * @brief Parallel passes over nuPython's memory unit
+  *
+  * A RAM_WORKERS pool keeps a set of threads around so that full
+  * passes over a large memory (serialization, GC marking,
+  * validation) can be split across cores. Work is cut into chunks
+  * of cells; each thread starts on its own share of chunks and
+  * steals from the others once it runs out, so uneven chunks
+  * don't leave threads idle.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <pthread.h>
+
+#include "ram.h"
+
+
+struct RAM_PAR_JOB;  // job being run, private to ram_parallel.c
+
+struct RAM_WORKERS
+{
+  pthread_t* threads;       // worker threads
+  int num_threads;          // # of worker threads
+  pthread_mutex_t submit;   // held while a job runs, so jobs run one at a time
+  pthread_mutex_t lock;     // protects the fields below
+  pthread_cond_t start;     // signalled when a job is posted
+  pthread_cond_t done;      // signalled when the last worker finishes
+  long generation;          // incremented for each job posted
+  int busy;                 // # of workers still running the job
+  bool shutdown;            // true => workers exit
+  struct RAM_PAR_JOB* job;  // current job
+};
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_workers_init: start a pool of worker threads
+  *
+  * Starts num_threads threads that wait for parallel passes. The
+  * thread calling a parallel function also takes part, so
+  * num_threads = cores - 1 uses every core. You take ownership of
+  * the returned pool and must call ram_workers_destroy() when you
+  * are done.
+  *
+  * A pool runs one pass at a time: passes started on the same
+  * pool from several threads wait for each other, and a visitor
+  * must not start another pass on the pool it runs on.
+  *
+  * @param num_threads # of threads to start (>= 0)
+  * @return pointer to pool, or NULL if num_threads < 0
+  */
+struct RAM_WORKERS* ram_workers_init(int num_threads);
+
+/**
+  * @brief ram_workers_destroy: stops the worker threads
+  *
+  * @param workers Pointer to pool
+  * @return void
+  */
+void ram_workers_destroy(struct RAM_WORKERS* workers);
+
+/**
+  * @brief ram_parallel_for_each: visit every cell using the worker pool
+  *
+  * Same as ram_for_each(), but the cells are split into chunks
+  * that are visited concurrently by the workers and the calling
+  * thread. Cells are visited exactly once, in no particular
+  * order; the call returns once every cell has been visited. The
+  * visitor must be safe to call from several threads at once. If
+  * workers is NULL, this is the same as ram_for_each().
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param workers Pointer to pool, or NULL
+  * @param visit function to call for each cell
+  * @param arg passed through to visit
+  * @return void
+  */
+void ram_parallel_for_each(struct RAM* memory, struct RAM_WORKERS* workers, RAM_VISITOR visit, void* arg);
+
+/**
+  * @brief ram_parallel_sort_names: alphabetical order of a set of names
+  *
+  * Fills order[0..n-1] with the indices 0..n-1 sorted so that
+  * names[order[0]], names[order[1]], ... are in alphabetical order
+  * (strcmp). Equal names keep their original relative order. Runs
+  * a parallel merge sort on the workers; if workers is NULL the
+  * sort runs on the calling thread.
+  *
+  * @param workers Pointer to pool, or NULL
+  * @param names array of n names
+  * @param n # of names
+  * @param order array of n ints to fill in
+  * @return void
+  */
+void ram_parallel_sort_names(struct RAM_WORKERS* workers, char** names, int n, int* order);
+
+/**
+  * @brief ram_parallel_sorted_addrs: addresses in alphabetical order
+  *
+  * Fills addrs[0..N-1], where N is the number of vars in memory,
+  * with the cell addresses sorted by variable name. This is
+  * rebuilt from the variable names rather than read from the map,
+  * so validation passes can check the map against it.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param workers Pointer to pool, or NULL
+  * @param addrs array of ram_size(memory) ints to fill in
+  * @return void
+  */
+void ram_parallel_sorted_addrs(struct RAM* memory, struct RAM_WORKERS* workers, int* addrs);
@@ -0,0 +1,168 @@
+/*ram_pool.c*/
+
+/**
+  * @brief Pool of reusable RAM instances for nuPython
+  *
+  * Short-lived interpreters can acquire a memory unit from a pool
+  * instead of calling ram_init(), and release it back instead of
+  * calling ram_destroy(). Released memories are cleared with
+  * ram_recycle() and keep their capacity, so steady-state acquire
+  * and release perform no allocations. The pool is thread-safe.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <pthread.h>
+
+#include "ram.h"
+#include "ram_pool.h"
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_pool_init: create a pool of memory units
+  *
+  * Returns a pointer to a dynamically-allocated pool that caches
+  * up to max_cached released memories. If preallocate is true,
+  * the pool is filled with max_cached fresh memories up front.
+  * You take ownership of the returned pool and must call
+  * ram_pool_destroy() when you are done.
+  *
+  * @param max_cached max # of memories kept for reuse (>= 1)
+  * @param preallocate true => fill the pool now
+  * @return pointer to pool, or NULL if max_cached < 1
+  */
+struct RAM_POOL* ram_pool_init(int max_cached, bool preallocate)
+{
+  if (max_cached < 1)
+    return NULL;
+
+  struct RAM_POOL* pool = (struct RAM_POOL*) malloc(sizeof(struct RAM_POOL));
+  pthread_mutex_init(&pool->lock, NULL);
+  pool->free = (struct RAM**) malloc(max_cached * sizeof(struct RAM*));
+  pool->count = 0;
+  pool->max_cached = max_cached;
+
+  if (preallocate) {
+    for (int i = 0; i < max_cached; i++) {
+      pool->free[i] = ram_init();
+    }
+    pool->count = max_cached;
+  }
+
+  return pool;
+}
+
+
+/**
+  * @brief ram_pool_destroy: frees the pool and all cached memories
+  *
+  * Memories currently acquired from the pool are not affected;
+  * the caller must ram_destroy() them.
+  *
+  * @param pool Pointer to pool
+  * @return void
+  */
+void ram_pool_destroy(struct RAM_POOL* pool)
+{
+  if (pool == NULL)
+    return;
+
+  for (int i = 0; i < pool->count; i++) {
+    ram_destroy(pool->free[i]);
+  }
+  free(pool->free);
+  pthread_mutex_destroy(&pool->lock);
+  free(pool);
+
+  return;
+}
+
+
+/**
+  * @brief ram_pool_acquire: get an empty memory unit from the pool
+  *
+  * Returns a cleared memory from the pool, or a new memory from
+  * ram_init() if the pool is empty. The memory has size 0 and
+  * all cells are None.
+  *
+  * @param pool Pointer to pool
+  * @return pointer to struct denoting memory unit
+  */
+struct RAM* ram_pool_acquire(struct RAM_POOL* pool)
+{
+  struct RAM* memory = NULL;
+
+  pthread_mutex_lock(&pool->lock);
+  if (pool->count > 0) {
+    pool->count--;
+    memory = pool->free[pool->count];
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  // pool was empty, allocate outside the lock:
+  if (memory == NULL)
+    memory = ram_init();
+
+  return memory;
+}
+
+
+/**
+  * @brief ram_pool_release: return a memory unit to the pool
+  *
+  * Clears the memory with ram_recycle() and caches it for reuse,
+  * so the next owner gets it without the log, trace, replication
+  * stream, spill file or other options this owner attached or
+  * enabled. If the pool is already full, the memory is destroyed
+  * instead. After the call returns, you cannot use the memory.
+  *
+  * @param pool Pointer to pool
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_pool_release(struct RAM_POOL* pool, struct RAM* memory)
+{
+  if (memory == NULL)
+    return;
+
+  // clear outside the lock, this frees names and strings:
+  ram_recycle(memory);
+
+  bool cached = false;
+
+  pthread_mutex_lock(&pool->lock);
+  if (pool->count < pool->max_cached) {
+    pool->free[pool->count] = memory;
+    pool->count++;
+    cached = true;
+  }
+  pthread_mutex_unlock(&pool->lock);
+
+  if (!cached)
+    ram_destroy(memory);
+
+  return;
+}
+
+
+/**
+  * @brief ram_pool_count: # of memories cached in the pool
+  *
+  * @param pool Pointer to pool
+  * @return # of cached memories
+  */
+int ram_pool_count(struct RAM_POOL* pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  int count = pool->count;
+  pthread_mutex_unlock(&pool->lock);
+
+  return count;
+}
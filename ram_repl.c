@@ -0,0 +1,772 @@
+/*ram_repl.c*/
+
+/**
+  * @brief Replicating nuPython's memory unit to a standby process
+  *
+  * A batch is a header (payload length, # of deltas, and when the
+  * oldest delta was logged) followed by its deltas. Each delta is
+  * a 1-byte kind, one of RAM_WAL_RECORDS, then:
+  *
+  *   WRITE_NAME  address, name length, name, '\0', value
+  *               (a variable the standby does not have yet)
+  *   WRITE_ADDR  address, value
+  *   APPEND      address, # of chars, chars
+  *
+  * and nothing for the other kinds. Values are a 1-byte type,
+  * then an int, a double, a length-prefixed string, or a
+  * length-prefixed array whose elements start on an 8-byte
+  * boundary of the batch, so the standby can use strings and
+  * arrays right where they are in its batch buffer. Addresses,
+  * lengths and ints are varints (ints zigzag-encoded), everything
+  * else is in host byte order: both ends run on the same host.
+  *
+  * As with the write-ahead log, writers append to an in-memory
+  * buffer under the lock, and the sender thread swaps it with a
+  * second buffer and writes that one without holding the lock.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <stdint.h>  // uint32_t, uint64_t
+#include <time.h>
+#include <errno.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ram_repl.h"
+#include "ram_bigint.h"
+#include "ram_wal.h"   // RAM_WAL_RECORDS
+
+
+struct REPL_HEADER
+{
+  uint32_t bytes;      // # of bytes of deltas that follow
+  uint32_t count;      // # of deltas
+  uint64_t logged_ns;  // when the oldest delta was logged
+};
+
+struct REPL_BUFFER
+{
+  char* bytes;      // header, then deltas
+  long  size;
+  long  capacity;
+  int   count;      // # of deltas
+  uint64_t first_ns;
+};
+
+struct RAM_REPL
+{
+  int  fd;
+  int  batch_us;
+  long batch_bytes;
+
+  pthread_mutex_t lock;
+  pthread_cond_t  wake;  // sender: deltas waiting or closing
+  pthread_cond_t  sent;  // flush / writers: a batch was written
+
+  struct REPL_BUFFER active;   // deltas being appended
+  struct REPL_BUFFER writing;  // batch being written by the sender
+  int  known;                  // # of addresses the standby has a variable at
+  long logged;                 // # of deltas ever logged
+  long delivered;              // # of those written to fd
+  long batches;
+  long bytes;
+  bool sending;                // sender is writing outside the lock
+  bool flush_wanted;           // someone waits in ram_repl_flush()
+  bool failed;                 // a write failed
+  bool closing;
+
+  pthread_t sender;
+};
+
+static uint64_t now_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000ull + ts.tv_nsec;
+}
+
+
+//
+// delta encoding:
+//
+static void buffer_put(struct REPL_BUFFER* buf, const void* bytes, long n)
+{
+  if (buf->size + n > buf->capacity) {
+    buf->capacity = (buf->capacity == 0) ? 4096 : buf->capacity;
+    while (buf->size + n > buf->capacity)
+      buf->capacity *= 2;
+    buf->bytes = (char*) realloc(buf->bytes, buf->capacity);
+  }
+
+  memcpy(buf->bytes + buf->size, bytes, n);
+  buf->size += n;
+}
+
+static void put_u8(struct REPL_BUFFER* buf, int x)
+{
+  unsigned char c = (unsigned char) x;
+  buffer_put(buf, &c, 1);
+}
+
+static void put_varint(struct REPL_BUFFER* buf, uint32_t x)
+{
+  unsigned char bytes[5];
+  int n = 0;
+
+  while (x >= 0x80) {
+    bytes[n++] = (unsigned char) (x | 0x80);
+    x >>= 7;
+  }
+  bytes[n++] = (unsigned char) x;
+
+  buffer_put(buf, bytes, n);
+}
+
+static void put_int(struct REPL_BUFFER* buf, int32_t x)
+{
+  // zigzag, so small negative ints stay short:
+  put_varint(buf, ((uint32_t) x << 1) ^ (uint32_t) (x >> 31));
+}
+
+static void put_int64(struct REPL_BUFFER* buf, int64_t x)
+{
+  uint64_t z = ((uint64_t) x << 1) ^ (uint64_t) (x >> 63);
+  unsigned char bytes[10];
+  int n = 0;
+
+  while (z >= 0x80) {
+    bytes[n++] = (unsigned char) (z | 0x80);
+    z >>= 7;
+  }
+  bytes[n++] = (unsigned char) z;
+
+  buffer_put(buf, bytes, n);
+}
+
+static void put_value(struct REPL_BUFFER* buf, struct RAM_VALUE* value)
+{
+  put_u8(buf, value->value_type);
+
+  if (value->value_type == RAM_TYPE_REAL) {
+    buffer_put(buf, &value->types.d, sizeof(double));
+  }
+  else if (value->value_type == RAM_TYPE_STR) {
+    int len = ram_str_len(value);
+    put_varint(buf, len);
+    buffer_put(buf, value->types.s, len);
+  }
+  else if (value->value_type == RAM_TYPE_INT_ARRAY || value->value_type == RAM_TYPE_REAL_ARRAY) {
+    struct RAM_ARRAY* a = value->types.a;
+    put_varint(buf, a->length);
+
+    static const char zeros[8] = {0};
+    buffer_put(buf, zeros, (8 - buf->size % 8) % 8);
+    if (a->elem_type == RAM_TYPE_INT)
+      buffer_put(buf, a->elems.i, a->length * sizeof(int));
+    else
+      buffer_put(buf, a->elems.d, a->length * sizeof(double));
+  }
+  else if (value->value_type == RAM_TYPE_BIGINT) {
+    // 0 and the value if small, else # of limbs x 2 + negative and
+    // the limbs, 4-byte aligned:
+    struct RAM_BIGNUM* b = ram_int_box(value->types.n);
+    if (b == NULL) {
+      int64_t v;
+      ram_int_to_i64(value->types.n, &v);
+      put_varint(buf, 0);
+      put_int64(buf, v);
+    }
+    else {
+      put_varint(buf, ((uint32_t) b->length << 1) | (b->sign < 0));
+
+      static const char zeros[4] = {0};
+      buffer_put(buf, zeros, (4 - buf->size % 4) % 4);
+      buffer_put(buf, ram_bignum_limbs(b), b->length * sizeof(uint32_t));
+    }
+  }
+  else if (value->value_type != RAM_TYPE_NONE) {
+    put_int(buf, value->types.i);
+  }
+}
+
+
+//
+// delta decoding; a READER never reads past end:
+//
+struct READER
+{
+  const char* base;  // start of the batch, for array alignment
+  const char* p;
+  const char* end;
+  bool ok;
+};
+
+static const char* take(struct READER* r, long n)
+{
+  if (!r->ok || n < 0 || r->end - r->p < n) {
+    r->ok = false;
+    return NULL;
+  }
+
+  const char* bytes = r->p;
+  r->p += n;
+  return bytes;
+}
+
+static uint32_t take_varint(struct READER* r)
+{
+  uint32_t x = 0;
+
+  for (int shift = 0; shift < 35; shift += 7) {
+    const char* byte = take(r, 1);
+    if (byte == NULL)
+      return 0;
+
+    x |= (uint32_t) (*byte & 0x7f) << shift;
+    if ((*byte & 0x80) == 0)
+      return x;
+  }
+
+  r->ok = false;
+  return 0;
+}
+
+static int32_t take_int(struct READER* r)
+{
+  uint32_t x = take_varint(r);
+  return (int32_t) ((x >> 1) ^ (~(x & 1) + 1));
+}
+
+static int64_t take_int64(struct READER* r)
+{
+  uint64_t z = 0;
+
+  for (int shift = 0; shift < 70; shift += 7) {
+    const char* byte = take(r, 1);
+    if (byte == NULL)
+      return 0;
+
+    z |= (uint64_t) (*byte & 0x7f) << shift;
+    if ((*byte & 0x80) == 0)
+      return (int64_t) ((z >> 1) ^ (~(z & 1) + 1));
+  }
+
+  r->ok = false;
+  return 0;
+}
+
+/**
+ * @brief take_value:
+ *
+ * decodes a value into *value, with strings and array elements
+ * pointing into the batch; array must outlive value. A big int
+ * is allocated, see drop_value. Returns the # of chars of a
+ * string value.
+ */
+static int take_value(struct READER* r, struct RAM_VALUE* value, struct RAM_ARRAY* array)
+{
+  int str_len = 0;
+
+  const char* type = take(r, 1);
+  value->value_type = (type != NULL) ? (unsigned char) *type : RAM_TYPE_NONE;
+
+  if (value->value_type == RAM_TYPE_REAL) {
+    const char* bytes = take(r, sizeof(double));
+    if (bytes != NULL)
+      memcpy(&value->types.d, bytes, sizeof(double));
+  }
+  else if (value->value_type == RAM_TYPE_STR) {
+    str_len = (int) take_varint(r);
+    value->types.s = (char*) take(r, str_len);
+  }
+  else if (value->value_type == RAM_TYPE_INT_ARRAY || value->value_type == RAM_TYPE_REAL_ARRAY) {
+    array->elem_type = (value->value_type == RAM_TYPE_INT_ARRAY) ? RAM_TYPE_INT : RAM_TYPE_REAL;
+    array->length = (int) take_varint(r);
+
+    long elem_size = (array->elem_type == RAM_TYPE_INT) ? sizeof(int) : sizeof(double);
+    take(r, (8 - (r->p - r->base) % 8) % 8);
+    array->elems.i = (int*) take(r, array->length * elem_size);
+    value->types.a = array;
+  }
+  else if (value->value_type == RAM_TYPE_BIGINT) {
+    uint32_t header = take_varint(r);
+    value->types.n = ram_int_from_i64(0);
+
+    if (header == 0) {
+      value->types.n = ram_int_from_i64(take_int64(r));
+    }
+    else {
+      take(r, (4 - (r->p - r->base) % 4) % 4);
+      const uint32_t* limbs = (const uint32_t*) take(r, (long) (header >> 1) * sizeof(uint32_t));
+      if (limbs != NULL)
+        value->types.n = ram_int_from_limbs((header & 1) ? -1 : 1, limbs, (int) (header >> 1));
+    }
+  }
+  else if (value->value_type == RAM_TYPE_NONE) {
+    value->types.i = 0;
+  }
+  else if (value->value_type <= RAM_TYPE_REAL_ARRAY) {
+    value->types.i = take_int(r);
+  }
+  else {
+    r->ok = false;
+  }
+
+  return str_len;
+}
+
+//
+// frees what take_value allocated:
+//
+static void drop_value(struct RAM_VALUE* value)
+{
+  if (value->value_type == RAM_TYPE_BIGINT)
+    ram_int_free(value->types.n);
+}
+
+/**
+ * @brief apply_delta:
+ *
+ * applies the delta at r->p to memory; false if it is damaged or
+ * doesn't fit memory's state
+ */
+static bool apply_delta(struct RAM* memory, struct READER* r)
+{
+  const char* kind = take(r, 1);
+  if (kind == NULL)
+    return false;
+
+  struct RAM_VALUE value;
+  struct RAM_ARRAY array;
+
+  switch ((unsigned char) *kind) {
+    case RAM_WAL_WRITE_NAME: {
+      int address = (int) take_varint(r);
+      int name_len = (int) take_varint(r);
+      char* name = (char*) take(r, name_len + 1);
+      int len = take_value(r, &value, &array);
+
+      // a new variable, so it must land where it did on the primary:
+      if (!r->ok || name[name_len] != '\0' || address != ram_size(memory)) {
+        drop_value(&value);
+        return false;
+      }
+
+      if (value.value_type == RAM_TYPE_STR)
+        ram_write_str_by_name(memory, value.types.s, len, name);
+      else
+        ram_write_cell_by_name(memory, value, name);
+      drop_value(&value);
+      return true;
+    }
+
+    case RAM_WAL_WRITE_ADDR: {
+      int address = (int) take_varint(r);
+      int len = take_value(r, &value, &array);
+      if (!r->ok) {
+        drop_value(&value);
+        return false;
+      }
+
+      bool success;
+      if (value.value_type == RAM_TYPE_STR)
+        success = ram_write_str_by_addr(memory, value.types.s, len, address);
+      else
+        success = ram_write_cell_by_addr(memory, value, address);
+      drop_value(&value);
+      return success;
+    }
+
+    case RAM_WAL_APPEND: {
+      int address = (int) take_varint(r);
+      int len = (int) take_varint(r);
+      const char* chars = take(r, len);
+      return r->ok && ram_append_str_by_addr(memory, chars, len, address);
+    }
+
+    case RAM_WAL_RESET:
+      ram_reset(memory);
+      return true;
+
+    case RAM_WAL_TXN_BEGIN:
+      ram_txn_begin(memory);
+      return true;
+
+    case RAM_WAL_TXN_COMMIT:
+      return ram_txn_commit(memory);
+
+    case RAM_WAL_TXN_ROLLBACK:
+      return ram_txn_rollback(memory);
+
+    default:
+      return false;
+  }
+}
+
+static bool write_all(int fd, const char* bytes, long n)
+{
+  while (n > 0) {
+    ssize_t put = write(fd, bytes, n);
+    if (put < 0 && errno == EINTR)
+      continue;
+    if (put <= 0)
+      return false;
+    bytes += put;
+    n -= put;
+  }
+  return true;
+}
+
+//
+// reads exactly n bytes; returns n, 0 at end of file before the
+// first byte, or -1 on an error or end of file part way:
+//
+static long read_all(int fd, char* bytes, long n)
+{
+  long done = 0;
+
+  while (done < n) {
+    ssize_t got = read(fd, bytes + done, n - done);
+    if (got < 0 && errno == EINTR)
+      continue;
+    if (got < 0 || (got == 0 && done > 0))
+      return -1;
+    if (got == 0)
+      return 0;
+    done += got;
+  }
+  return done;
+}
+
+
+//
+// batching:
+//
+
+/**
+ * @brief send_locked:
+ *
+ * writes the active buffer as one batch; called with the lock
+ * held, which it drops while doing I/O
+ */
+static void send_locked(struct RAM_REPL* repl)
+{
+  struct REPL_BUFFER swap = repl->writing;
+  repl->writing = repl->active;
+  repl->active = swap;
+  repl->active.size = 0;
+  repl->active.count = 0;
+
+  struct REPL_HEADER header;
+  header.bytes = (uint32_t) (repl->writing.size - sizeof(header));
+  header.count = repl->writing.count;
+  header.logged_ns = repl->writing.first_ns;
+  memcpy(repl->writing.bytes, &header, sizeof(header));
+
+  long target = repl->logged;
+  repl->sending = true;
+  pthread_mutex_unlock(&repl->lock);
+
+  bool ok = write_all(repl->fd, repl->writing.bytes, repl->writing.size);
+
+  pthread_mutex_lock(&repl->lock);
+  repl->sending = false;
+  if (ok) {
+    repl->delivered = target;
+    repl->batches++;
+    repl->bytes += repl->writing.size;
+  }
+  else {
+    repl->failed = true;
+  }
+  pthread_cond_broadcast(&repl->sent);
+}
+
+static void* sender_thread(void* arg)
+{
+  struct RAM_REPL* repl = (struct RAM_REPL*) arg;
+
+  pthread_mutex_lock(&repl->lock);
+
+  while (!repl->closing) {
+    if (repl->active.count == 0) {
+      pthread_cond_wait(&repl->wake, &repl->lock);
+      continue;
+    }
+
+    // wait out the oldest delta's batch_us, unless the batch
+    // fills up or someone is flushing first:
+    uint64_t due = repl->active.first_ns + (uint64_t) repl->batch_us * 1000;
+    if (repl->active.size < repl->batch_bytes && !repl->flush_wanted && now_ns() < due) {
+      struct timespec deadline;
+      deadline.tv_sec = due / 1000000000ull;
+      deadline.tv_nsec = due % 1000000000ull;
+      pthread_cond_timedwait(&repl->wake, &repl->lock, &deadline);
+      continue;
+    }
+
+    repl->flush_wanted = false;
+    if (!repl->failed)
+      send_locked(repl);
+    else
+      repl->active.count = 0;
+  }
+
+  if (repl->active.count > 0 && !repl->failed)
+    send_locked(repl);
+
+  pthread_mutex_unlock(&repl->lock);
+  return NULL;
+}
+
+//
+// starts a delta in the active buffer, with the lock held:
+//
+static void delta_start(struct RAM_REPL* repl, int kind)
+{
+  // the standby is a whole batch behind, so wait for it:
+  while (repl->sending && repl->active.size >= repl->batch_bytes && !repl->failed)
+    pthread_cond_wait(&repl->sent, &repl->lock);
+
+  if (repl->active.count == 0) {
+    repl->active.size = 0;
+    struct REPL_HEADER header = {0, 0, 0};
+    buffer_put(&repl->active, &header, sizeof(header));
+    repl->active.first_ns = now_ns();
+  }
+
+  put_u8(&repl->active, kind);
+}
+
+//
+// counts a delta just added, with the lock held:
+//
+static void delta_end(struct RAM_REPL* repl)
+{
+  repl->active.count++;
+  repl->logged++;
+
+  if (repl->active.count == 1 || repl->active.size >= repl->batch_bytes)
+    pthread_cond_signal(&repl->wake);
+}
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_repl_open: start a stream to a standby
+  *
+  * @param fd write end of a pipe or socket; not closed
+  * @param batch_us max microseconds a delta waits before it is sent
+  * @param batch_bytes send as soon as this many bytes wait
+  * @return pointer to stream
+  */
+struct RAM_REPL* ram_repl_open(int fd, int batch_us, int batch_bytes)
+{
+  struct RAM_REPL* repl = (struct RAM_REPL*) calloc(1, sizeof(struct RAM_REPL));
+  repl->fd = fd;
+  repl->batch_us = (batch_us > 0) ? batch_us : 1;
+  repl->batch_bytes = (batch_bytes > 0) ? batch_bytes : 1;
+
+  // timed waits are on the clock batches are stamped with:
+  pthread_condattr_t attr;
+  pthread_condattr_init(&attr);
+  pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+
+  pthread_mutex_init(&repl->lock, NULL);
+  pthread_cond_init(&repl->wake, &attr);
+  pthread_cond_init(&repl->sent, NULL);
+  pthread_condattr_destroy(&attr);
+  pthread_create(&repl->sender, NULL, sender_thread, repl);
+
+  return repl;
+}
+
+
+/**
+  * @brief ram_repl_close: send what is left, and stop the stream
+  *
+  * @param repl Pointer to stream
+  * @return void
+  */
+void ram_repl_close(struct RAM_REPL* repl)
+{
+  if (repl == NULL)
+    return;
+
+  pthread_mutex_lock(&repl->lock);
+  repl->closing = true;
+  pthread_cond_signal(&repl->wake);
+  pthread_mutex_unlock(&repl->lock);
+  pthread_join(repl->sender, NULL);
+
+  pthread_mutex_destroy(&repl->lock);
+  pthread_cond_destroy(&repl->wake);
+  pthread_cond_destroy(&repl->sent);
+  free(repl->active.bytes);
+  free(repl->writing.bytes);
+  free(repl);
+}
+
+
+/**
+  * @brief ram_repl_log: add a delta to the stream
+  *
+  * @param repl Pointer to stream
+  * @param kind one of RAM_WAL_RECORDS
+  * @param address cell address, or -1
+  * @param name variable name, or NULL
+  * @param value the cell as written, or NULL
+  * @param size ram_size() of the memory after the change
+  * @return void
+  */
+void ram_repl_log(struct RAM_REPL* repl, int kind, int address, const char* name, struct RAM_VALUE* value, int size)
+{
+  pthread_mutex_lock(&repl->lock);
+
+  // the standby already has the variable, so skip the name:
+  if (kind == RAM_WAL_WRITE_NAME && address < repl->known)
+    kind = RAM_WAL_WRITE_ADDR;
+
+  delta_start(repl, kind);
+
+  if (kind == RAM_WAL_WRITE_NAME) {
+    int len = (int) strlen(name);
+    put_varint(&repl->active, address);
+    put_varint(&repl->active, len);
+    buffer_put(&repl->active, name, len + 1);
+    put_value(&repl->active, value);
+
+    // ram_bulk_load() logs its new variables after creating
+    // them all, so go by address rather than size:
+    repl->known = address + 1;
+  }
+  else if (kind == RAM_WAL_WRITE_ADDR) {
+    put_varint(&repl->active, address);
+    put_value(&repl->active, value);
+  }
+  else {
+    // a reset or rollback may have removed variables:
+    repl->known = size;
+  }
+
+  delta_end(repl);
+
+  pthread_mutex_unlock(&repl->lock);
+}
+
+
+/**
+  * @brief ram_repl_log_append: add a delta of chars appended to a string
+  *
+  * @param repl Pointer to stream
+  * @param address cell address
+  * @param s chars appended
+  * @param len # of chars
+  * @return void
+  */
+void ram_repl_log_append(struct RAM_REPL* repl, int address, const char* s, int len)
+{
+  pthread_mutex_lock(&repl->lock);
+
+  delta_start(repl, RAM_WAL_APPEND);
+  put_varint(&repl->active, address);
+  put_varint(&repl->active, len);
+  buffer_put(&repl->active, s, len);
+  delta_end(repl);
+
+  pthread_mutex_unlock(&repl->lock);
+}
+
+
+/**
+  * @brief ram_repl_flush: wait until every delta logged has been sent
+  *
+  * @param repl Pointer to stream
+  * @return true if successful, false if a write failed
+  */
+bool ram_repl_flush(struct RAM_REPL* repl)
+{
+  pthread_mutex_lock(&repl->lock);
+
+  long target = repl->logged;
+  while (repl->delivered < target && !repl->failed) {
+    repl->flush_wanted = true;
+    pthread_cond_signal(&repl->wake);
+    pthread_cond_wait(&repl->sent, &repl->lock);
+  }
+
+  bool ok = !repl->failed;
+  pthread_mutex_unlock(&repl->lock);
+  return ok;
+}
+
+
+/**
+  * @brief ram_repl_stats: what a stream has sent so far
+  *
+  * @param repl Pointer to stream
+  * @param stats filled in
+  * @return void
+  */
+void ram_repl_stats(struct RAM_REPL* repl, struct RAM_REPL_STATS* stats)
+{
+  pthread_mutex_lock(&repl->lock);
+
+  stats->deltas = repl->logged;
+  stats->batches = repl->batches;
+  stats->bytes = repl->bytes;
+  stats->failed = repl->failed;
+
+  pthread_mutex_unlock(&repl->lock);
+}
+
+
+/**
+  * @brief ram_repl_receive: apply the next batch of deltas
+  *
+  * @param memory Pointer to struct denoting the standby's memory unit
+  * @param fd read end of the pipe or socket
+  * @param logged_ns if not NULL, set to when the oldest delta in
+  *        the batch was logged (CLOCK_MONOTONIC, in ns)
+  * @return # of deltas applied, 0 at the end of the stream, -1 on
+  *         a read error or damaged batch
+  */
+int ram_repl_receive(struct RAM* memory, int fd, uint64_t* logged_ns)
+{
+  if (memory == NULL)
+    return -1;
+
+  struct REPL_HEADER header;
+  long got = read_all(fd, (char*) &header, sizeof(header));
+  if (got <= 0)
+    return (int) got;
+
+  // the deltas go in a buffer of their own, which malloc aligns
+  // as the sender's buffer was, 8 bytes past its header:
+  char* bytes = (char*) malloc(header.bytes > 0 ? header.bytes : 1);
+  if (read_all(fd, bytes, header.bytes) != (long) header.bytes) {
+    free(bytes);
+    return -1;
+  }
+
+  struct READER r = {bytes, bytes, bytes + header.bytes, true};
+  int applied = 0;
+
+  while (applied < (int) header.count && apply_delta(memory, &r))
+    applied++;
+
+  free(bytes);
+
+  if (logged_ns != NULL)
+    *logged_ns = header.logged_ns;
+
+  return (applied == (int) header.count && r.p == r.end) ? applied : -1;
+}
@@ -0,0 +1,159 @@
+/*ram_repl.h*/
+
+/**
+  * @brief Replicating nuPython's memory unit to a standby process
+  *
+  * Once a RAM_REPL stream is attached to a memory unit with
+  * ram_repl_attach(), every change to that memory (the same
+  * writes, appends, resets and transaction begin/commit/rollback
+  * the write-ahead log records) is sent down a pipe or Unix
+  * domain socket as a compact delta. A standby process applies
+  * them to its own memory with ram_repl_receive(), so it mirrors
+  * the primary's variables at the same addresses.
+  *
+  * Deltas are batched: the primary only appends them to a buffer,
+  * and a background thread writes the buffer out every batch_us
+  * microseconds, or as soon as batch_bytes are waiting, whichever
+  * comes first. A write by name to a variable the standby already
+  * has is sent by address, so the standby applies it without a
+  * name lookup; a string append sends only the new chars.
+  *
+  * If the standby falls behind and the pipe fills up, the
+  * background thread blocks, and once another batch is waiting
+  * behind the one being sent the primary does too. Ignore SIGPIPE
+  * in the primary (signal(SIGPIPE, SIG_IGN)) so a standby that
+  * goes away shows up as a failed stream rather than killing it.
+  *
+  * Limitations: as with the write-ahead log, cells at addresses
+  * >= ram_size(), which can only be written by address, are not
+  * part of the snapshot sent on attach, and changes made in place
+  * (to an array from ram_get_array() or by a ram_for_each()
+  * visitor) are only sent once ram_array_changed() is called for
+  * the variable.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+#include <stdint.h>   // uint64_t
+
+#include "ram.h"
+
+
+struct RAM_REPL;  // sending side of a stream, private to ram_repl.c
+
+struct RAM_REPL_STATS
+{
+  long deltas;   // # of deltas logged
+  long batches;  // # of batches written
+  long bytes;    // # of bytes written, batch headers included
+  bool failed;   // a write failed; nothing is sent after that
+};
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_repl_open: start a stream to a standby
+  *
+  * @param fd write end of a pipe or socket; not closed
+  * @param batch_us max microseconds a delta waits before it is sent
+  * @param batch_bytes send as soon as this many bytes wait
+  * @return pointer to stream
+  */
+struct RAM_REPL* ram_repl_open(int fd, int batch_us, int batch_bytes);
+
+/**
+  * @brief ram_repl_close: send what is left, and stop the stream
+  *
+  * Detach the stream from its memory first. The standby sees the
+  * end of the stream once fd is closed.
+  *
+  * @param repl Pointer to stream
+  * @return void
+  */
+void ram_repl_close(struct RAM_REPL* repl);
+
+/**
+  * @brief ram_repl_attach: send a memory's changes to a standby
+  *
+  * First sends a snapshot, a reset followed by every variable in
+  * address order, so the standby starts from memory's current
+  * state whatever it held before. Pass NULL to stop sending.
+  * Attach outside of a transaction: the standby can't roll back
+  * to a state it never had.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param repl Pointer to stream, or NULL
+  * @return true if successful, false (and nothing is sent) if a
+  *         string can't be read back from the spill file
+  */
+bool ram_repl_attach(struct RAM* memory, struct RAM_REPL* repl);
+
+/**
+  * @brief ram_repl_log: add a delta to the stream
+  *
+  * Called by the RAM module, after the change, with the kinds of
+  * ram_wal_log(); name is NULL and value is NULL for deltas that
+  * don't have them.
+  *
+  * @param repl Pointer to stream
+  * @param kind one of RAM_WAL_RECORDS
+  * @param address cell address, or -1
+  * @param name variable name, or NULL
+  * @param value the cell as written, or NULL
+  * @param size ram_size() of the memory after the change
+  * @return void
+  */
+void ram_repl_log(struct RAM_REPL* repl, int kind, int address, const char* name, struct RAM_VALUE* value, int size);
+
+/**
+  * @brief ram_repl_log_append: add a delta of chars appended to a string
+  *
+  * Called by the RAM module.
+  *
+  * @param repl Pointer to stream
+  * @param address cell address
+  * @param s chars appended
+  * @param len # of chars
+  * @return void
+  */
+void ram_repl_log_append(struct RAM_REPL* repl, int address, const char* s, int len);
+
+/**
+  * @brief ram_repl_flush: wait until every delta logged has been sent
+  *
+  * @param repl Pointer to stream
+  * @return true if successful, false if a write failed
+  */
+bool ram_repl_flush(struct RAM_REPL* repl);
+
+/**
+  * @brief ram_repl_stats: what a stream has sent so far
+  *
+  * @param repl Pointer to stream
+  * @param stats filled in
+  * @return void
+  */
+void ram_repl_stats(struct RAM_REPL* repl, struct RAM_REPL_STATS* stats);
+
+/**
+  * @brief ram_repl_receive: apply the next batch of deltas
+  *
+  * Blocks until a whole batch has been read from fd, then applies
+  * it to memory. The standby's memory should not be changed any
+  * other way.
+  *
+  * @param memory Pointer to struct denoting the standby's memory unit
+  * @param fd read end of the pipe or socket
+  * @param logged_ns if not NULL, set to when the oldest delta in
+  *        the batch was logged (CLOCK_MONOTONIC, in ns), so
+  *        now - *logged_ns is the batch's replication lag
+  * @return # of deltas applied, 0 at the end of the stream, -1 on
+  *         a read error or damaged batch
+  */
+int ram_repl_receive(struct RAM* memory, int fd, uint64_t* logged_ns);
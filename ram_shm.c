@@ -0,0 +1,336 @@
+/*ram_shm.c*/
+
+/**
+  * @brief Shared read-only constants for nuPython's memory unit
+  *
+  * A segment is position independent, so each process can map it
+  * anywhere: a header, then one fixed-size entry per variable in
+  * alphabetical order, then the names, string chars and array
+  * elements the entries point to by offset from the start.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <unistd.h>    // ftruncate, close
+#include <fcntl.h>     // O_* constants
+#include <sys/mman.h>  // shm_open, mmap
+#include <sys/stat.h>  // fstat
+
+#include "ram_shm.h"
+#include "ram_bigint.h"
+#include "ram_spill.h"
+
+#define SHM_MAGIC "RAMSHM1"
+
+struct SHM_HEADER
+{
+  char magic[8];  // SHM_MAGIC
+  long bytes;     // size of the segment
+  int  count;     // # of entries
+  int  unused;
+};
+
+struct SHM_ENTRY
+{
+  long name;  // offset of the name, '\0'-terminated
+  long data;  // offset of string chars ('\0'-terminated), array elements or a RAM_BIGNUM
+  int  type;  // enum RAM_VALUE_TYPES
+  int  len;   // # of chars or elements
+
+  union
+  {
+    int     i;  // INT, PTR, BOOLEAN
+    double  d;  // REAL
+    int64_t n;  // BIGINT, if small
+  } scalar;
+};
+
+struct RAM_SHM
+{
+  char* base;  // start of the mapping
+  long  bytes;
+  struct SHM_ENTRY* entries;
+  int   count;
+};
+
+static long align8(long bytes)
+{
+  return (bytes + 7) & ~7L;
+}
+
+//
+// bytes a variable adds after the entries:
+//
+static long data_bytes(struct RAM_VALUE* cell, const char* varname)
+{
+  long bytes = align8(strlen(varname) + 1);
+
+  if (cell->value_type == RAM_TYPE_STR)
+    bytes += align8(ram_str_len(cell) + 1);
+  else if (cell->value_type == RAM_TYPE_INT_ARRAY)
+    bytes += align8(cell->types.a->length * sizeof(int));
+  else if (cell->value_type == RAM_TYPE_REAL_ARRAY)
+    bytes += align8(cell->types.a->length * sizeof(double));
+  else if (cell->value_type == RAM_TYPE_BIGINT && ram_int_box(cell->types.n) != NULL)
+    bytes += align8(ram_bignum_bytes(ram_int_box(cell->types.n)));
+
+  return bytes;
+}
+
+//
+// copies bytes to the segment at *end, returns where they went:
+//
+static long put_data(char* base, long* end, const void* bytes, long n)
+{
+  long offset = *end;
+  memcpy(base + offset, bytes, n);
+  *end += align8(n);
+  return offset;
+}
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_shm_publish: freeze memory's variables into a shared segment
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param name shared memory object name, starting with '/'
+  * @return true if successful, false if the object can't be created
+  *         or a string can't be read back from the spill file
+  */
+bool ram_shm_publish(struct RAM* memory, const char* name)
+{
+  if (memory == NULL || name == NULL)
+    return false;
+
+  // ram_next_sorted() skips a string it can't read back, and
+  // counts it:
+  struct RAM_SPILL_STATS stats;
+  long failed_reads = ram_spill_stats(memory, &stats) ? stats.failed_reads : 0;
+
+  // size it, walking in order (which also flattens strings):
+  int  count = 0;
+  long bytes = 0;
+  int  hint = -1;
+  char* varname = NULL;
+  int  address;
+  struct RAM_VALUE* cell;
+
+  while ((cell = ram_next_sorted(memory, varname, &hint, &varname, &address)) != NULL) {
+    count++;
+    bytes += data_bytes(cell, varname);
+  }
+  if (ram_spill_stats(memory, &stats) && stats.failed_reads != failed_reads)
+    return false;
+  bytes += sizeof(struct SHM_HEADER) + count * sizeof(struct SHM_ENTRY);
+
+  int fd = shm_open(name, O_CREAT | O_RDWR | O_TRUNC, 0644);
+  if (fd < 0)
+    return false;
+
+  if (ftruncate(fd, bytes) != 0) {
+    close(fd);
+    shm_unlink(name);
+    return false;
+  }
+
+  char* base = (char*) mmap(NULL, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED) {
+    shm_unlink(name);
+    return false;
+  }
+
+  struct SHM_HEADER* header = (struct SHM_HEADER*) base;
+  struct SHM_ENTRY* entries = (struct SHM_ENTRY*) (header + 1);
+  long end = sizeof(struct SHM_HEADER) + count * sizeof(struct SHM_ENTRY);
+
+  int n = 0;
+  hint = -1;
+  varname = NULL;
+  while (n < count && (cell = ram_next_sorted(memory, varname, &hint, &varname, &address)) != NULL) {
+    struct SHM_ENTRY* e = &entries[n++];
+    memset(e, 0, sizeof(struct SHM_ENTRY));
+
+    e->name = put_data(base, &end, varname, strlen(varname) + 1);
+    e->type = cell->value_type;
+
+    if (cell->value_type == RAM_TYPE_STR) {
+      e->len = ram_str_len(cell);
+      e->data = put_data(base, &end, cell->types.s, e->len + 1);  // with its '\0'
+    }
+    else if (cell->value_type == RAM_TYPE_INT_ARRAY || cell->value_type == RAM_TYPE_REAL_ARRAY) {
+      long elem = (cell->value_type == RAM_TYPE_INT_ARRAY) ? sizeof(int) : sizeof(double);
+      e->len = cell->types.a->length;
+      e->data = put_data(base, &end, cell->types.a->elems.i, e->len * elem);
+    }
+    else if (cell->value_type == RAM_TYPE_REAL) {
+      e->scalar.d = cell->types.d;
+    }
+    else if (cell->value_type == RAM_TYPE_BIGINT) {
+      struct RAM_BIGNUM* b = ram_int_box(cell->types.n);
+      if (b != NULL)
+        e->data = put_data(base, &end, b, ram_bignum_bytes(b));
+      else
+        e->scalar.n = cell->types.n;
+    }
+    else {
+      e->scalar.i = cell->types.i;
+    }
+  }
+
+  memcpy(header->magic, SHM_MAGIC, sizeof(header->magic));
+  header->bytes = bytes;
+  header->count = n;
+  header->unused = 0;
+
+  munmap(base, bytes);
+  if (ram_spill_stats(memory, &stats) && stats.failed_reads != failed_reads) {
+    shm_unlink(name);
+    return false;
+  }
+  return true;
+}
+
+
+/**
+  * @brief ram_shm_attach: map a published segment read-only
+  *
+  * @param name shared memory object name
+  * @return pointer to segment, or NULL if it doesn't exist or is
+  *         not a published segment
+  */
+struct RAM_SHM* ram_shm_attach(const char* name)
+{
+  int fd = shm_open(name, O_RDONLY, 0);
+  if (fd < 0)
+    return NULL;
+
+  struct stat st;
+  if (fstat(fd, &st) != 0 || st.st_size < (off_t) sizeof(struct SHM_HEADER)) {
+    close(fd);
+    return NULL;
+  }
+
+  char* base = (char*) mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  close(fd);
+  if (base == MAP_FAILED)
+    return NULL;
+
+  struct SHM_HEADER* header = (struct SHM_HEADER*) base;
+  if (memcmp(header->magic, SHM_MAGIC, sizeof(header->magic)) != 0 || header->bytes != st.st_size) {
+    munmap(base, st.st_size);
+    return NULL;
+  }
+
+  struct RAM_SHM* shm = (struct RAM_SHM*) malloc(sizeof(struct RAM_SHM));
+  shm->base = base;
+  shm->bytes = st.st_size;
+  shm->entries = (struct SHM_ENTRY*) (header + 1);
+  shm->count = header->count;
+
+  return shm;
+}
+
+
+/**
+  * @brief ram_shm_detach: unmap a segment
+  *
+  * @param shm Pointer to segment
+  * @return void
+  */
+void ram_shm_detach(struct RAM_SHM* shm)
+{
+  if (shm == NULL)
+    return;
+
+  munmap(shm->base, shm->bytes);
+  free(shm);
+}
+
+
+/**
+  * @brief ram_shm_unlink: remove a published segment's name
+  *
+  * @param name shared memory object name
+  * @return true if successful, false if it doesn't exist
+  */
+bool ram_shm_unlink(const char* name)
+{
+  return shm_unlink(name) == 0;
+}
+
+
+/**
+  * @brief ram_shm_size: # of constants in a segment
+  *
+  * @param shm Pointer to segment
+  * @return # of variables published
+  */
+int ram_shm_size(struct RAM_SHM* shm)
+{
+  return shm->count;
+}
+
+
+/**
+  * @brief ram_shm_find: look up a constant
+  *
+  * @param shm Pointer to segment
+  * @param name variable name
+  * @param cell filled in with the constant, if found
+  * @return true if found, false if not
+  */
+bool ram_shm_find(struct RAM_SHM* shm, const char* name, struct RAM_SHM_CELL* cell)
+{
+  int left = 0;
+  int right = shm->count - 1;
+
+  while (left <= right) {
+    int mid = (left + right) / 2;
+    struct SHM_ENTRY* e = &shm->entries[mid];
+    int c = strcmp(name, shm->base + e->name);
+
+    if (c < 0) {
+      right = mid - 1;
+    }
+    else if (c > 0) {
+      left = mid + 1;
+    }
+    else {
+      cell->value.value_type = e->type;
+      cell->len = 0;
+
+      if (e->type == RAM_TYPE_STR) {
+        cell->value.types.s = shm->base + e->data;
+        cell->len = e->len;
+      }
+      else if (e->type == RAM_TYPE_INT_ARRAY || e->type == RAM_TYPE_REAL_ARRAY) {
+        cell->array.elem_type = (e->type == RAM_TYPE_INT_ARRAY) ? RAM_TYPE_INT : RAM_TYPE_REAL;
+        cell->array.length = e->len;
+        cell->array.elems.i = (int*) (shm->base + e->data);
+        cell->value.types.a = &cell->array;
+      }
+      else if (e->type == RAM_TYPE_REAL) {
+        cell->value.types.d = e->scalar.d;
+      }
+      else if (e->type == RAM_TYPE_BIGINT) {
+        // a boxed big int points at its RAM_BIGNUM in the segment:
+        cell->value.types.n = (e->data != 0) ? (RAM_INT) (intptr_t) (shm->base + e->data) : e->scalar.n;
+      }
+      else {
+        cell->value.types.i = e->scalar.i;
+      }
+      return true;
+    }
+  }
+
+  return false;
+}
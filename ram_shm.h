@@ -0,0 +1,129 @@
+/*ram_shm.h*/
+
+/**
+  * @brief Shared read-only constants for nuPython's memory unit
+  *
+  * Workers forked from one parent often load the same large table
+  * of constant variables. Rather than each worker keeping its own
+  * copy, the table is published once, with ram_shm_publish(), as
+  * a frozen segment in POSIX shared memory; each worker maps it
+  * read-only with ram_shm_attach(), so all of them share one copy
+  * of the pages.
+  *
+  * After ram_shm_use(), a memory unit looks names up in its own
+  * variables first and falls through to the segment, where a
+  * constant is found by binary search right in the mapped pages;
+  * it is copied only as ram_read_cell_by_name() copies any value.
+  * Writing to a constant's name
+  * creates a private variable that hides it from then on;
+  * appending to a constant string, or ram_get_array() of a
+  * constant array, first copies the constant into memory so the
+  * change stays private.
+  *
+  * Constants have no addresses: ram_get_addr() returns -1 for a
+  * name that is only in the segment, and ram_size(), ram_print()
+  * and ram_for_each() see only private variables.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "ram.h"
+
+
+struct RAM_SHM;  // an attached segment, private to ram_shm.c
+
+//
+// A constant, as found in the segment: strings and arrays point
+// into the segment, and must not be written or freed.
+//
+struct RAM_SHM_CELL
+{
+  struct RAM_VALUE value;  // value.types.a points to array below
+  int len;                 // # of chars of a string
+  struct RAM_ARRAY array;  // elems point into the segment
+};
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_shm_publish: freeze memory's variables into a shared segment
+  *
+  * Creates (or replaces) the POSIX shared memory object name and
+  * writes every variable in memory to it. Segments are meant to
+  * be published once, before workers attach; attached segments
+  * are not updated.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param name shared memory object name, starting with '/'
+  * @return true if successful, false if the object can't be created
+  *         or a string can't be read back from the spill file
+  */
+bool ram_shm_publish(struct RAM* memory, const char* name);
+
+/**
+  * @brief ram_shm_attach: map a published segment read-only
+  *
+  * One attachment may be used by any number of memory units in
+  * this process.
+  *
+  * @param name shared memory object name
+  * @return pointer to segment, or NULL if it doesn't exist or is
+  *         not a published segment
+  */
+struct RAM_SHM* ram_shm_attach(const char* name);
+
+/**
+  * @brief ram_shm_detach: unmap a segment
+  *
+  * Stop every memory using it first, with ram_shm_use(memory, NULL).
+  *
+  * @param shm Pointer to segment
+  * @return void
+  */
+void ram_shm_detach(struct RAM_SHM* shm);
+
+/**
+  * @brief ram_shm_unlink: remove a published segment's name
+  *
+  * Processes that have it attached keep their mapping.
+  *
+  * @param name shared memory object name
+  * @return true if successful, false if it doesn't exist
+  */
+bool ram_shm_unlink(const char* name);
+
+/**
+  * @brief ram_shm_use: fall through to a segment for names memory lacks
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param shm Pointer to segment, or NULL to stop
+  * @return void
+  */
+void ram_shm_use(struct RAM* memory, struct RAM_SHM* shm);
+
+/**
+  * @brief ram_shm_size: # of constants in a segment
+  *
+  * @param shm Pointer to segment
+  * @return # of variables published
+  */
+int ram_shm_size(struct RAM_SHM* shm);
+
+/**
+  * @brief ram_shm_find: look up a constant
+  *
+  * Called by the RAM module. O(log n), without copying.
+  *
+  * @param shm Pointer to segment
+  * @param name variable name
+  * @param cell filled in with the constant, if found
+  * @return true if found, false if not
+  */
+bool ram_shm_find(struct RAM_SHM* shm, const char* name, struct RAM_SHM_CELL* cell);
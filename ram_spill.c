@@ -0,0 +1,413 @@
+/*ram_spill.c*/
+
+/**
+  * @brief Spilling cold strings to disk for nuPython's memory unit
+  *
+  * Strings in the heap are kept on a doubly linked LRU list
+  * threaded through per-address arrays, so touching one is O(1).
+  * Space in the file is handed out in 64-byte units, first fit
+  * from a sorted list of free extents that merge with their
+  * neighbors when freed.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <unistd.h>  // pread, pwrite, close, unlink
+#include <fcntl.h>   // open
+
+#include "ram_spill.h"
+#include "ram_alloc.h"
+
+#define SPILL_UNIT  64    // file space is allocated in multiples of this
+#define NOT_LISTED  (-2)  // prev of an address not on the LRU list
+
+struct SPILL_EXTENT
+{
+  long offset;  // start in the file
+  long bytes;   // a multiple of SPILL_UNIT
+};
+
+struct RAM_SPILL
+{
+  struct RAM_ARENA* arena;  // where the arrays come from, NULL => malloc
+
+  int   fd;
+  char* path;
+  long  budget;
+
+  // per address, for addresses 0..capacity-1:
+  int*  prev;    // LRU neighbors, NOT_LISTED if not on the list
+  int*  next;
+  long* offset;  // where the string is in the file, -1 if not spilled
+  int*  len;     // # of chars of a spilled string
+  int   capacity;
+
+  int head;  // most recently used, -1 if the list is empty
+  int tail;  // least recently used
+
+  struct SPILL_EXTENT* free_list;  // free space, in file order
+  int  num_free;
+  int  free_capacity;
+  long end;  // bytes of file in use or free
+
+  struct RAM_SPILL_STATS stats;
+};
+
+static long round_up(long bytes)
+{
+  return (bytes + SPILL_UNIT - 1) / SPILL_UNIT * SPILL_UNIT;
+}
+
+/**
+ * @brief space_alloc:
+ *
+ * first fit from the free list, else grows the file
+ *
+ * @return offset of bytes of free space
+ */
+static long space_alloc(struct RAM_SPILL* spill, long bytes)
+{
+  for (int i = 0; i < spill->num_free; i++) {
+    struct SPILL_EXTENT* e = &spill->free_list[i];
+    if (e->bytes >= bytes) {
+      long offset = e->offset;
+      e->offset += bytes;
+      e->bytes -= bytes;
+      if (e->bytes == 0) {
+        memmove(e, e + 1, (spill->num_free - i - 1) * sizeof(struct SPILL_EXTENT));
+        spill->num_free--;
+      }
+      return offset;
+    }
+  }
+
+  long offset = spill->end;
+  spill->end += bytes;
+  return offset;
+}
+
+/**
+ * @brief space_free:
+ *
+ * returns space to the free list, merging it with its neighbors
+ */
+static void space_free(struct RAM_SPILL* spill, long offset, long bytes)
+{
+  int i = 0;
+  while (i < spill->num_free && spill->free_list[i].offset < offset)
+    i++;
+
+  bool joins_prev = (i > 0 && spill->free_list[i - 1].offset + spill->free_list[i - 1].bytes == offset);
+  bool joins_next = (i < spill->num_free && offset + bytes == spill->free_list[i].offset);
+
+  if (joins_prev && joins_next) {
+    spill->free_list[i - 1].bytes += bytes + spill->free_list[i].bytes;
+    memmove(&spill->free_list[i], &spill->free_list[i + 1], (spill->num_free - i - 1) * sizeof(struct SPILL_EXTENT));
+    spill->num_free--;
+  }
+  else if (joins_prev) {
+    spill->free_list[i - 1].bytes += bytes;
+  }
+  else if (joins_next) {
+    spill->free_list[i].offset = offset;
+    spill->free_list[i].bytes += bytes;
+  }
+  else {
+    if (spill->num_free >= spill->free_capacity) {
+      spill->free_capacity = (spill->free_capacity == 0) ? 16 : spill->free_capacity * 2;
+      spill->free_list = (struct SPILL_EXTENT*) ram_mem_realloc(spill->arena, spill->free_list, spill->free_capacity * sizeof(struct SPILL_EXTENT));
+    }
+    memmove(&spill->free_list[i + 1], &spill->free_list[i], (spill->num_free - i) * sizeof(struct SPILL_EXTENT));
+    spill->free_list[i].offset = offset;
+    spill->free_list[i].bytes = bytes;
+    spill->num_free++;
+  }
+}
+
+static void unlink_address(struct RAM_SPILL* spill, int address)
+{
+  if (spill->prev[address] == NOT_LISTED)
+    return;
+
+  int prev = spill->prev[address];
+  int next = spill->next[address];
+
+  if (prev >= 0)
+    spill->next[prev] = next;
+  else
+    spill->head = next;
+
+  if (next >= 0)
+    spill->prev[next] = prev;
+  else
+    spill->tail = prev;
+
+  spill->prev[address] = NOT_LISTED;
+}
+
+static void release_space(struct RAM_SPILL* spill, int address)
+{
+  if (spill->offset[address] < 0)
+    return;
+
+  space_free(spill, spill->offset[address], round_up(spill->len[address]));
+  spill->stats.spilled_strings--;
+  spill->stats.spilled_bytes -= spill->len[address];
+  spill->offset[address] = -1;
+}
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_spill_create: open a spill file
+  *
+  * @param path spill file, or NULL for a temporary file in /tmp
+  * @param budget bytes of heap memory may use
+  * @param arena allocation arena for the spill state, NULL for malloc
+  * @return pointer to spill state, or NULL if the file can't be created
+  */
+struct RAM_SPILL* ram_spill_create(const char* path, long budget, struct RAM_ARENA* arena)
+{
+  char temp[] = "/tmp/ram_spillXXXXXX";
+  int fd = (path != NULL) ? open(path, O_RDWR | O_CREAT | O_TRUNC, 0600) : mkstemp(temp);
+  if (fd < 0)
+    return NULL;
+
+  struct RAM_SPILL* spill = (struct RAM_SPILL*) ram_mem_alloc(arena, sizeof(struct RAM_SPILL));
+  memset(spill, 0, sizeof(struct RAM_SPILL));
+
+  spill->arena = arena;
+  spill->fd = fd;
+  spill->path = ram_mem_strdup(arena, (path != NULL) ? path : temp);
+  spill->budget = budget;
+  spill->head = -1;
+  spill->tail = -1;
+  spill->stats.budget = budget;
+
+  return spill;
+}
+
+
+/**
+  * @brief ram_spill_destroy: close and remove a spill file
+  *
+  * @param spill Pointer to spill state
+  * @return void
+  */
+void ram_spill_destroy(struct RAM_SPILL* spill)
+{
+  if (spill == NULL)
+    return;
+
+  close(spill->fd);
+  unlink(spill->path);
+
+  struct RAM_ARENA* arena = spill->arena;
+  ram_mem_free(arena, spill->path);
+  ram_mem_free(arena, spill->prev);
+  ram_mem_free(arena, spill->next);
+  ram_mem_free(arena, spill->offset);
+  ram_mem_free(arena, spill->len);
+  ram_mem_free(arena, spill->free_list);
+  ram_mem_free(arena, spill);
+}
+
+
+/**
+  * @brief ram_spill_budget: bytes of heap memory may use
+  *
+  * @param spill Pointer to spill state
+  * @param budget new budget, or -1 to leave it as is
+  * @return the budget
+  */
+long ram_spill_budget(struct RAM_SPILL* spill, long budget)
+{
+  if (budget >= 0) {
+    spill->budget = budget;
+    spill->stats.budget = budget;
+  }
+
+  return spill->budget;
+}
+
+
+/**
+  * @brief ram_spill_resize: track addresses 0..capacity-1
+  *
+  * @param spill Pointer to spill state
+  * @param capacity memory's capacity, never smaller than before
+  * @return void
+  */
+void ram_spill_resize(struct RAM_SPILL* spill, int capacity)
+{
+  if (capacity <= spill->capacity)
+    return;
+
+  spill->prev = (int*) ram_mem_realloc(spill->arena, spill->prev, capacity * sizeof(int));
+  spill->next = (int*) ram_mem_realloc(spill->arena, spill->next, capacity * sizeof(int));
+  spill->offset = (long*) ram_mem_realloc(spill->arena, spill->offset, capacity * sizeof(long));
+  spill->len = (int*) ram_mem_realloc(spill->arena, spill->len, capacity * sizeof(int));
+
+  for (int i = spill->capacity; i < capacity; i++) {
+    spill->prev[i] = NOT_LISTED;
+    spill->next[i] = -1;
+    spill->offset[i] = -1;
+    spill->len[i] = 0;
+  }
+  spill->capacity = capacity;
+}
+
+
+/**
+  * @brief ram_spill_touch: mark the string at address most recently used
+  *
+  * @param spill Pointer to spill state
+  * @param address cell holding a string in the heap
+  * @return void
+  */
+void ram_spill_touch(struct RAM_SPILL* spill, int address)
+{
+  if (spill->head == address)
+    return;
+
+  unlink_address(spill, address);
+
+  spill->prev[address] = -1;
+  spill->next[address] = spill->head;
+  if (spill->head >= 0)
+    spill->prev[spill->head] = address;
+  else
+    spill->tail = address;
+  spill->head = address;
+}
+
+
+/**
+  * @brief ram_spill_forget: stop tracking the cell at address
+  *
+  * @param spill Pointer to spill state
+  * @param address cell address
+  * @return void
+  */
+void ram_spill_forget(struct RAM_SPILL* spill, int address)
+{
+  unlink_address(spill, address);
+  release_space(spill, address);
+}
+
+
+/**
+  * @brief ram_spill_coldest: least recently used string
+  *
+  * @param spill Pointer to spill state
+  * @return address of the string used longest ago, -1 if none
+  */
+int ram_spill_coldest(struct RAM_SPILL* spill)
+{
+  return spill->tail;
+}
+
+
+/**
+  * @brief ram_spill_out: write the string at address to the file
+  *
+  * @param spill Pointer to spill state
+  * @param address cell address
+  * @param s chars of the string
+  * @param len # of chars
+  * @return true if successful, false on an I/O error
+  */
+bool ram_spill_out(struct RAM_SPILL* spill, int address, const char* s, int len)
+{
+  long offset = space_alloc(spill, round_up(len));
+
+  long done = 0;
+  while (done < len) {
+    ssize_t n = pwrite(spill->fd, s + done, len - done, offset + done);
+    if (n <= 0) {
+      space_free(spill, offset, round_up(len));
+      return false;
+    }
+    done += n;
+  }
+
+  unlink_address(spill, address);
+  spill->offset[address] = offset;
+  spill->len[address] = len;
+
+  spill->stats.spills++;
+  spill->stats.spilled_strings++;
+  spill->stats.spilled_bytes += len;
+  return true;
+}
+
+
+/**
+  * @brief ram_spill_len: length of the spilled string at address
+  *
+  * @param spill Pointer to spill state
+  * @param address cell address
+  * @return # of chars, or -1 if the cell's string is not in the file
+  */
+int ram_spill_len(struct RAM_SPILL* spill, int address)
+{
+  if (address >= spill->capacity || spill->offset[address] < 0)
+    return -1;
+
+  return spill->len[address];
+}
+
+
+/**
+  * @brief ram_spill_in: read the string at address back from the file
+  *
+  * @param spill Pointer to spill state
+  * @param address cell whose string is in the file
+  * @param dest where to put its ram_spill_len() chars
+  * @return true if successful, false on an I/O error
+  */
+bool ram_spill_in(struct RAM_SPILL* spill, int address, char* dest)
+{
+  long offset = spill->offset[address];
+  int len = spill->len[address];
+
+  long done = 0;
+  while (done < len) {
+    ssize_t n = pread(spill->fd, dest + done, len - done, offset + done);
+    if (n <= 0) {
+      spill->stats.failed_reads++;
+      return false;
+    }
+    done += n;
+  }
+
+  release_space(spill, address);
+  ram_spill_touch(spill, address);
+  spill->stats.faults++;
+  return true;
+}
+
+
+/**
+  * @brief ram_spill_stats: counters of a memory's spill file
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param stats Pointer to struct to fill in
+  * @return true if spilling is enabled, false if not
+  */
+bool ram_spill_stats(struct RAM* memory, struct RAM_SPILL_STATS* stats)
+{
+  if (memory == NULL || memory->spill == NULL || stats == NULL)
+    return false;
+
+  *stats = memory->spill->stats;
+  stats->file_bytes = memory->spill->end;
+  return true;
+}
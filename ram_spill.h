@@ -0,0 +1,191 @@
+/*ram_spill.h*/
+
+/**
+  * @brief Spilling cold strings to disk for nuPython's memory unit
+  *
+  * Once ram_spill_enable() gives a memory unit a budget, string
+  * values that have not been used for a while are moved out of
+  * the heap into a spill file whenever the memory's total_bytes
+  * (see ram_memory_usage()) goes over the budget. The coldest
+  * strings go first: the memory keeps its strings in least
+  * recently used order, fed by every read, write and append of a
+  * cell. A spilled string is read back in transparently the next
+  * time its cell is read.
+  *
+  * While a string is spilled its cell keeps type RAM_TYPE_STR but
+  * its types.s is NULL; ram_str_flatten() brings it back. Interned
+  * strings are shared, so they are never spilled.
+  *
+  * If a spilled string can't be read back (a short read or an I/O
+  * error), it stays in the file and its cell stays spilled, and
+  * whatever needed it fails instead: reads return NULL, appends
+  * and writes that must save it for a rollback return false,
+  * walks skip the cell, and dumps, checkpoints, snapshots and
+  * comparisons report an error. failed_reads counts these.
+  *
+  * The functions below other than ram_spill_enable() and
+  * ram_spill_stats() are called by the RAM module.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "ram.h"
+
+
+struct RAM_SPILL;  // spill file and LRU order, private to ram_spill.c
+
+struct RAM_SPILL_STATS
+{
+  long budget;           // bytes memory may use before it spills
+  long spills;           // # of strings ever moved to the file
+  long faults;           // # of strings ever read back in
+  long failed_reads;     // # of times a string couldn't be read back
+  long spilled_strings;  // # of strings in the file now
+  long spilled_bytes;    // chars of the strings in the file now
+  long file_bytes;       // size of the file, free space included
+};
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_spill_enable: keep memory under a budget by spilling strings
+  *
+  * Creates the spill file, and spills strings right away if memory
+  * is already over the budget. The file is removed when memory is
+  * destroyed. Calling this again only changes the budget.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param budget bytes of heap memory may use, as ram_memory_usage()
+  *        reports them
+  * @param path spill file, or NULL for a temporary file in /tmp
+  * @return true if successful, false if the file can't be created
+  */
+bool ram_spill_enable(struct RAM* memory, long budget, const char* path);
+
+/**
+  * @brief ram_spill_enforce: spill strings again until memory is within budget
+  *
+  * Writes and ram_for_each() keep memory within its budget
+  * themselves; this is for after ram_str_flatten_all(), which
+  * reads every spilled string back.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @return void
+  */
+void ram_spill_enforce(struct RAM* memory);
+
+/**
+  * @brief ram_spill_stats: counters of a memory's spill file
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param stats Pointer to struct to fill in
+  * @return true if spilling is enabled, false if not
+  */
+bool ram_spill_stats(struct RAM* memory, struct RAM_SPILL_STATS* stats);
+
+/**
+  * @brief ram_spill_create: open a spill file
+  *
+  * @param path spill file, or NULL for a temporary file in /tmp
+  * @param budget bytes of heap memory may use
+  * @param arena allocation arena for the spill state, NULL for malloc
+  * @return pointer to spill state, or NULL if the file can't be created
+  */
+struct RAM_SPILL* ram_spill_create(const char* path, long budget, struct RAM_ARENA* arena);
+
+/**
+  * @brief ram_spill_destroy: close and remove a spill file
+  *
+  * @param spill Pointer to spill state
+  * @return void
+  */
+void ram_spill_destroy(struct RAM_SPILL* spill);
+
+/**
+  * @brief ram_spill_budget: bytes of heap memory may use
+  *
+  * @param spill Pointer to spill state
+  * @param budget new budget, or -1 to leave it as is
+  * @return the budget
+  */
+long ram_spill_budget(struct RAM_SPILL* spill, long budget);
+
+/**
+  * @brief ram_spill_resize: track addresses 0..capacity-1
+  *
+  * @param spill Pointer to spill state
+  * @param capacity memory's capacity, never smaller than before
+  * @return void
+  */
+void ram_spill_resize(struct RAM_SPILL* spill, int capacity);
+
+/**
+  * @brief ram_spill_touch: mark the string at address most recently used
+  *
+  * @param spill Pointer to spill state
+  * @param address cell holding a string in the heap
+  * @return void
+  */
+void ram_spill_touch(struct RAM_SPILL* spill, int address);
+
+/**
+  * @brief ram_spill_forget: stop tracking the cell at address
+  *
+  * Called when the cell no longer holds a string in the heap. If
+  * its string is in the file, the space is freed.
+  *
+  * @param spill Pointer to spill state
+  * @param address cell address
+  * @return void
+  */
+void ram_spill_forget(struct RAM_SPILL* spill, int address);
+
+/**
+  * @brief ram_spill_coldest: least recently used string
+  *
+  * @param spill Pointer to spill state
+  * @return address of the string used longest ago, -1 if none
+  */
+int ram_spill_coldest(struct RAM_SPILL* spill);
+
+/**
+  * @brief ram_spill_out: write the string at address to the file
+  *
+  * On success the caller frees the string and sets the cell's
+  * types.s to NULL.
+  *
+  * @param spill Pointer to spill state
+  * @param address cell address
+  * @param s chars of the string
+  * @param len # of chars
+  * @return true if successful, false on an I/O error
+  */
+bool ram_spill_out(struct RAM_SPILL* spill, int address, const char* s, int len);
+
+/**
+  * @brief ram_spill_len: length of the spilled string at address
+  *
+  * @param spill Pointer to spill state
+  * @param address cell address
+  * @return # of chars, or -1 if the cell's string is not in the file
+  */
+int ram_spill_len(struct RAM_SPILL* spill, int address);
+
+/**
+  * @brief ram_spill_in: read the string at address back from the file
+  *
+  * Frees its space in the file, and marks it most recently used.
+  *
+  * @param spill Pointer to spill state
+  * @param address cell whose string is in the file
+  * @param dest where to put its ram_spill_len() chars
+  * @return true if successful, false on an I/O error
+  */
+bool ram_spill_in(struct RAM_SPILL* spill, int address, char* dest);
@@ -0,0 +1,288 @@
+/*ram_trace.c*/
+
+/**
+  * @brief Tracing of memory operations for nuPython's memory unit
+  *
+  * Writers claim a slot by bumping head, then fill it in between
+  * two stores of its seq field, seqlock style, so the exporter
+  * can tell complete events from ones being overwritten.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <time.h>
+
+#include "ram_trace.h"
+
+
+static uint64_t monotonic_ns(void)
+{
+  struct timespec ts;
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t) ts.tv_sec * 1000000000u + ts.tv_nsec;
+}
+
+//
+// small per-thread ids, handed out on a thread's first event:
+//
+static uint16_t next_thread = 0;
+static __thread uint16_t this_thread = 0;
+
+static uint16_t thread_id(void)
+{
+  if (this_thread == 0)
+    this_thread = __atomic_add_fetch(&next_thread, 1, __ATOMIC_RELAXED);
+
+  return this_thread;
+}
+
+static const char* op_name(int op)
+{
+  switch (op) {
+    case RAM_TRACE_READ_ADDR:  return "read_by_addr";
+    case RAM_TRACE_READ_NAME:  return "read_by_name";
+    case RAM_TRACE_WRITE_ADDR: return "write_by_addr";
+    case RAM_TRACE_WRITE_NAME: return "write_by_name";
+    case RAM_TRACE_GROW:       return "double_memory";
+    case RAM_TRACE_RESET:      return "reset";
+    case RAM_TRACE_APPEND:     return "append";
+    default:                   return "unknown";
+  }
+}
+
+//
+// ram_trace_export_json looks names up by id in a sorted array:
+//
+struct NAME_ID
+{
+  uint32_t id;
+  const char* name;
+};
+
+static int by_id(const void* a, const void* b)
+{
+  uint32_t x = ((const struct NAME_ID*) a)->id;
+  uint32_t y = ((const struct NAME_ID*) b)->id;
+  return (x > y) - (x < y);
+}
+
+static const char* find_name(struct NAME_ID* names, int n, uint32_t id)
+{
+  struct NAME_ID key;
+  key.id = id;
+
+  struct NAME_ID* found = (struct NAME_ID*) bsearch(&key, names, n, sizeof(struct NAME_ID), by_id);
+  return (found != NULL) ? found->name : NULL;
+}
+
+//
+// writes s with JSON escapes, without the quotes:
+//
+static void write_json_chars(FILE* out, const char* s)
+{
+  for (; *s != '\0'; s++) {
+    unsigned char c = (unsigned char) *s;
+    if (c == '"' || c == '\\')
+      fprintf(out, "\\%c", c);
+    else if (c < 0x20)
+      fprintf(out, "\\u%04x", c);
+    else
+      fputc(c, out);
+  }
+}
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_trace_create: allocate a trace buffer
+  *
+  * @param capacity # of events kept, rounded up to a power of 2
+  * @return pointer to new trace
+  */
+struct RAM_TRACE* ram_trace_create(int capacity)
+{
+  uint64_t n = 1;
+  while (n < (uint64_t) capacity)
+    n *= 2;
+
+  struct RAM_TRACE* trace = (struct RAM_TRACE*) malloc(sizeof(struct RAM_TRACE));
+  trace->events = (struct RAM_TRACE_EVENT*) calloc(n, sizeof(struct RAM_TRACE_EVENT));
+  trace->mask = n - 1;
+  trace->head = 0;
+
+  trace->clock_start = ram_trace_clock();
+  trace->ns_start = monotonic_ns();
+
+  return trace;
+}
+
+
+/**
+  * @brief ram_trace_destroy: free a trace buffer
+  *
+  * @param trace Pointer to trace
+  * @return void
+  */
+void ram_trace_destroy(struct RAM_TRACE* trace)
+{
+  if (trace == NULL)
+    return;
+
+  free(trace->events);
+  free(trace);
+}
+
+
+/**
+  * @brief ram_trace_clock: current time in clock ticks
+  *
+  * @return clock ticks
+  */
+uint64_t ram_trace_clock(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __builtin_ia32_rdtsc();
+#else
+  return monotonic_ns();
+#endif
+}
+
+
+/**
+  * @brief ram_trace_name_id: 32-bit id of a variable name
+  *
+  * FNV-1a hash of the name; 0 is reserved for "no name".
+  *
+  * @param name variable name
+  * @return id of name, never 0
+  */
+uint32_t ram_trace_name_id(const char* name)
+{
+  uint32_t h = 2166136261u;
+
+  for (const char* p = name; *p != '\0'; p++) {
+    h ^= (unsigned char) *p;
+    h *= 16777619u;
+  }
+
+  return (h == 0) ? 1 : h;
+}
+
+
+/**
+  * @brief ram_trace_record: add an event to a trace
+  *
+  * @param trace Pointer to trace
+  * @param op one of RAM_TRACE_OPS
+  * @param address cell address, -1 if none
+  * @param name_id id of the name, 0 if none
+  * @param start ram_trace_clock() when the operation started
+  * @return void
+  */
+void ram_trace_record(struct RAM_TRACE* trace, int op, int address, uint32_t name_id, uint64_t start)
+{
+  uint64_t end = ram_trace_clock();
+  uint64_t n = __atomic_fetch_add(&trace->head, 1, __ATOMIC_RELAXED);
+  struct RAM_TRACE_EVENT* e = &trace->events[n & trace->mask];
+
+  __atomic_store_n(&e->seq, 0, __ATOMIC_RELAXED);
+  __atomic_thread_fence(__ATOMIC_RELEASE);
+
+  e->start = start;
+  e->duration = (end - start > UINT32_MAX) ? UINT32_MAX : (uint32_t) (end - start);
+  e->op = (uint16_t) op;
+  e->thread = thread_id();
+  e->address = address;
+  e->name_id = name_id;
+
+  __atomic_store_n(&e->seq, n + 1, __ATOMIC_RELEASE);
+}
+
+
+/**
+  * @brief ram_trace_count: # of events recorded
+  *
+  * @param trace Pointer to trace
+  * @return # of events ever recorded
+  */
+long ram_trace_count(struct RAM_TRACE* trace)
+{
+  return (long) __atomic_load_n(&trace->head, __ATOMIC_RELAXED);
+}
+
+
+/**
+  * @brief ram_trace_export_json: write a trace in Chrome trace format
+  *
+  * Timestamps are in microseconds since the trace was created.
+  *
+  * @param trace Pointer to trace
+  * @param memory memory whose names to use, or NULL
+  * @param out file to write to
+  * @return # of events written
+  */
+int ram_trace_export_json(struct RAM_TRACE* trace, struct RAM* memory, FILE* out)
+{
+  // ticks => ns, measured over at least 1ms since creation:
+  uint64_t ns_now = monotonic_ns();
+  while (ns_now - trace->ns_start < 1000000)
+    ns_now = monotonic_ns();
+  uint64_t clock_now = ram_trace_clock();
+
+  double ns_per_tick = 1.0;
+  if (clock_now > trace->clock_start)
+    ns_per_tick = (double) (ns_now - trace->ns_start) / (double) (clock_now - trace->clock_start);
+
+  int num_names = 0;
+  struct NAME_ID* names = NULL;
+  if (memory != NULL && memory->size > 0) {
+    names = (struct NAME_ID*) malloc(memory->size * sizeof(struct NAME_ID));
+    for (int i = 0; i < memory->size; i++) {
+      names[num_names].id = ram_trace_name_id(memory->map[i].varname);
+      names[num_names].name = memory->map[i].varname;
+      num_names++;
+    }
+    qsort(names, num_names, sizeof(struct NAME_ID), by_id);
+  }
+
+  uint64_t head = __atomic_load_n(&trace->head, __ATOMIC_ACQUIRE);
+  uint64_t first = (head > trace->mask + 1) ? head - (trace->mask + 1) : 0;
+  int written = 0;
+
+  fprintf(out, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+
+  for (uint64_t n = first; n < head; n++) {
+    struct RAM_TRACE_EVENT* slot = &trace->events[n & trace->mask];
+
+    uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+    struct RAM_TRACE_EVENT e = *slot;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (seq != n + 1 || __atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq)
+      continue;  // being written, or already overwritten
+
+    double ts = (double) (int64_t) (e.start - trace->clock_start) * ns_per_tick / 1000.0;
+    double dur = e.duration * ns_per_tick / 1000.0;
+
+    fprintf(out, "%s\n{\"name\":\"%s", (written == 0) ? "" : ",", op_name(e.op));
+    const char* name = (e.name_id != 0) ? find_name(names, num_names, e.name_id) : NULL;
+    if (name != NULL) {
+      fputc(' ', out);
+      write_json_chars(out, name);
+    }
+    fprintf(out, "\",\"cat\":\"ram\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"address\":%d,\"name_id\":%u}}",
+            ts, dur, e.thread, e.address, e.name_id);
+    written++;
+  }
+
+  fprintf(out, "\n]}\n");
+  free(names);
+
+  return written;
+}
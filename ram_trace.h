@@ -0,0 +1,153 @@
+/*ram_trace.h*/
+
+/**
+  * @brief Tracing of memory operations for nuPython's memory unit
+  *
+  * A RAM_TRACE is a fixed-size ring buffer of compact binary
+  * events: what operation ran, on which address and name, when,
+  * and for how long. Once attached to a memory unit with
+  * ram_trace_attach(), every read, write, reset and doubling of
+  * that memory is recorded. When the buffer is full the oldest
+  * events are overwritten. Recording is lock-free, so one trace
+  * can be shared by memories used on different threads.
+  *
+  * ram_trace_export_json() writes the events in the Chrome trace
+  * event format, which chrome://tracing and ui.perfetto.dev open.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <stdio.h>    // FILE
+#include <stdint.h>   // uint64_t
+#include <stdbool.h>  // true, false
+
+#include "ram.h"
+
+
+enum RAM_TRACE_OPS
+{
+  RAM_TRACE_READ_ADDR = 1,
+  RAM_TRACE_READ_NAME,
+  RAM_TRACE_WRITE_ADDR,
+  RAM_TRACE_WRITE_NAME,
+  RAM_TRACE_GROW,        // double_memory, address is the new capacity
+  RAM_TRACE_RESET,
+  RAM_TRACE_APPEND       // ram_append_str functions
+};
+
+//
+// One event, 32 bytes. Times are in clock ticks, see
+// ram_trace_clock().
+//
+struct RAM_TRACE_EVENT
+{
+  uint64_t seq;       // index of the event + 1, 0 while being written
+  uint64_t start;     // clock ticks when the operation started
+  uint32_t duration;  // clock ticks it took
+  uint16_t op;        // one of RAM_TRACE_OPS
+  uint16_t thread;    // small id of the recording thread
+  int32_t  address;   // cell address, -1 if none
+  uint32_t name_id;   // ram_trace_name_id() of the name, 0 if none
+};
+
+struct RAM_TRACE
+{
+  struct RAM_TRACE_EVENT* events;  // ring buffer
+  uint64_t mask;                   // # of events - 1, a power of 2 - 1
+  uint64_t head;                   // # of events ever recorded
+
+  uint64_t clock_start;  // ram_trace_clock() when created
+  uint64_t ns_start;     // CLOCK_MONOTONIC ns when created
+};
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_trace_create: allocate a trace buffer
+  *
+  * @param capacity # of events kept, rounded up to a power of 2
+  * @return pointer to new trace
+  */
+struct RAM_TRACE* ram_trace_create(int capacity);
+
+/**
+  * @brief ram_trace_destroy: free a trace buffer
+  *
+  * Detach it from every memory first.
+  *
+  * @param trace Pointer to trace
+  * @return void
+  */
+void ram_trace_destroy(struct RAM_TRACE* trace);
+
+/**
+  * @brief ram_trace_attach: record a memory's operations into a trace
+  *
+  * Pass NULL to stop tracing the memory.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param trace Pointer to trace, or NULL
+  * @return void
+  */
+void ram_trace_attach(struct RAM* memory, struct RAM_TRACE* trace);
+
+/**
+  * @brief ram_trace_clock: current time in clock ticks
+  *
+  * Uses the CPU's timestamp counter where there is one. Ticks are
+  * converted to nanoseconds when the trace is exported.
+  *
+  * @return clock ticks
+  */
+uint64_t ram_trace_clock(void);
+
+/**
+  * @brief ram_trace_name_id: 32-bit id of a variable name
+  *
+  * @param name variable name
+  * @return id of name, never 0
+  */
+uint32_t ram_trace_name_id(const char* name);
+
+/**
+  * @brief ram_trace_record: add an event to a trace
+  *
+  * @param trace Pointer to trace
+  * @param op one of RAM_TRACE_OPS
+  * @param address cell address, -1 if none
+  * @param name_id id of the name, 0 if none
+  * @param start ram_trace_clock() when the operation started
+  * @return void
+  */
+void ram_trace_record(struct RAM_TRACE* trace, int op, int address, uint32_t name_id, uint64_t start);
+
+/**
+  * @brief ram_trace_count: # of events recorded
+  *
+  * Includes events since overwritten by newer ones.
+  *
+  * @param trace Pointer to trace
+  * @return # of events ever recorded
+  */
+long ram_trace_count(struct RAM_TRACE* trace);
+
+/**
+  * @brief ram_trace_export_json: write a trace in Chrome trace format
+  *
+  * Writes the events still in the buffer, oldest first, as a JSON
+  * object with a "traceEvents" array of complete ("X") events. If
+  * memory is not NULL, name ids are turned back into the names
+  * of its variables. Events being recorded during the export are
+  * skipped.
+  *
+  * @param trace Pointer to trace
+  * @param memory memory whose names to use, or NULL
+  * @param out file to write to
+  * @return # of events written
+  */
+int ram_trace_export_json(struct RAM_TRACE* trace, struct RAM* memory, FILE* out);
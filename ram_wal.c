@@ -0,0 +1,1005 @@
+/*ram_wal.c*/
+
+/**
+  * @brief Write-ahead log for nuPython's memory unit
+  *
+  * Each record is a 4-byte payload length, a 4-byte checksum of
+  * the payload, and the payload: a 1-byte kind, then the fields
+  * of that kind. Values are a 1-byte type followed by the int,
+  * the double, a length-prefixed string, or a length-prefixed
+  * array of elements. All integers are in host byte order.
+  *
+  * Writers append to an in-memory buffer under the lock; the
+  * flusher thread swaps it with a second buffer and writes and
+  * fsyncs that one without holding the lock.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdbool.h> // true, false
+#include <string.h>
+#include <stdint.h>  // uint32_t
+#include <time.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include "ram_wal.h"
+#include "ram_array.h"
+#include "ram_bigint.h"
+
+
+struct WAL_BUFFER
+{
+  char* bytes;
+  long  size;
+  long  capacity;
+};
+
+struct RAM_WAL
+{
+  char* path;
+  int   fd;
+
+  int  commit_ms;
+  int  commit_records;
+  long checkpoint_records;
+
+  pthread_mutex_t lock;
+  pthread_cond_t  wake;       // flusher: records waiting or closing
+  pthread_cond_t  committed;  // sync / checkpoint: a commit finished
+
+  struct WAL_BUFFER active;   // records being appended
+  struct WAL_BUFFER writing;  // records being written by the flusher
+  long pending;               // # of records in active
+  long logged;                // # of records ever logged
+  long durable;               // # of those known to be on disk
+  long since_checkpoint;      // # of records since last checkpoint
+  int32_t generation;         // the log's number
+  bool flushing;              // flusher is writing outside the lock
+  bool sync_wanted;           // someone waits in ram_wal_sync()
+  bool failed;                // a write or fsync failed
+  bool closing;
+
+  pthread_t flusher;
+};
+
+
+//
+// record encoding:
+//
+static uint32_t checksum(const char* bytes, long n)
+{
+  uint32_t h = 2166136261u;
+
+  for (long i = 0; i < n; i++) {
+    h ^= (unsigned char) bytes[i];
+    h *= 16777619u;
+  }
+
+  return h;
+}
+
+static void buffer_put(struct WAL_BUFFER* buf, const void* bytes, long n)
+{
+  if (buf->size + n > buf->capacity) {
+    buf->capacity = (buf->capacity == 0) ? 4096 : buf->capacity;
+    while (buf->size + n > buf->capacity)
+      buf->capacity *= 2;
+    buf->bytes = (char*) realloc(buf->bytes, buf->capacity);
+  }
+
+  memcpy(buf->bytes + buf->size, bytes, n);
+  buf->size += n;
+}
+
+static void put_u8(struct WAL_BUFFER* buf, int x)
+{
+  unsigned char c = (unsigned char) x;
+  buffer_put(buf, &c, 1);
+}
+
+static void put_i32(struct WAL_BUFFER* buf, int32_t x)
+{
+  buffer_put(buf, &x, sizeof(x));
+}
+
+static void put_chars(struct WAL_BUFFER* buf, const char* s, int32_t len)
+{
+  put_i32(buf, len);
+  buffer_put(buf, s, len);
+}
+
+static void put_value(struct WAL_BUFFER* buf, struct RAM_VALUE* value)
+{
+  put_u8(buf, value->value_type);
+
+  if (value->value_type == RAM_TYPE_REAL) {
+    buffer_put(buf, &value->types.d, sizeof(double));
+  }
+  else if (value->value_type == RAM_TYPE_STR) {
+    put_chars(buf, value->types.s, ram_str_len(value));
+  }
+  else if (value->value_type == RAM_TYPE_INT_ARRAY || value->value_type == RAM_TYPE_REAL_ARRAY) {
+    struct RAM_ARRAY* a = value->types.a;
+    put_i32(buf, a->length);
+    if (a->elem_type == RAM_TYPE_INT)
+      buffer_put(buf, a->elems.i, a->length * sizeof(int));
+    else
+      buffer_put(buf, a->elems.d, a->length * sizeof(double));
+  }
+  else if (value->value_type == RAM_TYPE_BIGINT) {
+    // 0 and the value if small, else sign x # of limbs and the limbs:
+    struct RAM_BIGNUM* b = ram_int_box(value->types.n);
+    if (b == NULL) {
+      int64_t v;
+      ram_int_to_i64(value->types.n, &v);
+      put_i32(buf, 0);
+      buffer_put(buf, &v, sizeof(v));
+    }
+    else {
+      put_i32(buf, b->sign * b->length);
+      buffer_put(buf, ram_bignum_limbs(b), b->length * sizeof(uint32_t));
+    }
+  }
+  else {
+    put_i32(buf, value->types.i);
+  }
+}
+
+//
+// a record is its payload's length and checksum, then the
+// payload; record_start() leaves room for the two and returns
+// where they go, record_end() fills them in:
+//
+static long record_start(struct WAL_BUFFER* buf, int kind)
+{
+  long header = buf->size;
+  uint32_t zero[2] = {0, 0};
+  buffer_put(buf, zero, sizeof(zero));
+
+  put_u8(buf, kind);
+  return header;
+}
+
+static void record_end(struct WAL_BUFFER* buf, long header)
+{
+  long payload = header + 2 * sizeof(uint32_t);
+
+  uint32_t fields[2];
+  fields[0] = (uint32_t) (buf->size - payload);
+  fields[1] = checksum(buf->bytes + payload, buf->size - payload);
+  memcpy(buf->bytes + header, fields, sizeof(fields));
+}
+
+/**
+ * @brief put_record:
+ *
+ * appends one complete record, header and all, to buf
+ */
+static void put_record(struct WAL_BUFFER* buf, int kind, int address, const char* name, struct RAM_VALUE* value)
+{
+  long header = record_start(buf, kind);
+
+  if (kind == RAM_WAL_WRITE_NAME) {
+    put_chars(buf, name, (int32_t) strlen(name));
+    put_value(buf, value);
+  }
+  else if (kind == RAM_WAL_WRITE_ADDR) {
+    put_i32(buf, address);
+    put_value(buf, value);
+  }
+  else if (kind == RAM_WAL_GENERATION || kind == RAM_WAL_CHECKPOINT_END) {
+    put_i32(buf, address);  // a log's number
+  }
+
+  record_end(buf, header);
+}
+
+
+//
+// record decoding; a READER never reads past end:
+//
+struct READER
+{
+  const char* p;
+  const char* end;
+  bool ok;
+};
+
+static const char* take(struct READER* r, long n)
+{
+  if (!r->ok || n < 0 || r->end - r->p < n) {
+    r->ok = false;
+    return NULL;
+  }
+
+  const char* bytes = r->p;
+  r->p += n;
+  return bytes;
+}
+
+static int32_t take_i32(struct READER* r)
+{
+  int32_t x = 0;
+  const char* bytes = take(r, sizeof(x));
+  if (bytes != NULL)
+    memcpy(&x, bytes, sizeof(x));
+  return x;
+}
+
+/**
+ * @brief take_value:
+ *
+ * decodes a value into *value; strings and arrays are allocated,
+ * free them with free_taken(). Returns the # of chars of a string
+ * value.
+ */
+static int take_value(struct READER* r, struct RAM_VALUE* value)
+{
+  int str_len = 0;
+
+  const char* type = take(r, 1);
+  value->value_type = (type != NULL) ? (unsigned char) *type : RAM_TYPE_NONE;
+
+  if (value->value_type == RAM_TYPE_REAL) {
+    const char* bytes = take(r, sizeof(double));
+    if (bytes != NULL)
+      memcpy(&value->types.d, bytes, sizeof(double));
+  }
+  else if (value->value_type == RAM_TYPE_STR) {
+    int32_t len = take_i32(r);
+    const char* bytes = take(r, len);
+    value->types.s = (char*) malloc((bytes != NULL ? len : 0) + 1);
+    if (bytes != NULL)
+      memcpy(value->types.s, bytes, len);
+    str_len = (bytes != NULL) ? len : 0;
+    value->types.s[str_len] = '\0';
+  }
+  else if (value->value_type == RAM_TYPE_INT_ARRAY || value->value_type == RAM_TYPE_REAL_ARRAY) {
+    int elem_type = (value->value_type == RAM_TYPE_INT_ARRAY) ? RAM_TYPE_INT : RAM_TYPE_REAL;
+    int elem_size = (elem_type == RAM_TYPE_INT) ? sizeof(int) : sizeof(double);
+    int32_t length = take_i32(r);
+    const char* bytes = take(r, (long) length * elem_size);
+
+    value->types.a = ram_array_new(elem_type, (bytes != NULL) ? length : 0);
+    if (bytes != NULL && elem_type == RAM_TYPE_INT)
+      memcpy(value->types.a->elems.i, bytes, (long) length * elem_size);
+    else if (bytes != NULL)
+      memcpy(value->types.a->elems.d, bytes, (long) length * elem_size);
+  }
+  else if (value->value_type == RAM_TYPE_BIGINT) {
+    int32_t length = take_i32(r);
+    int64_t v = 0;
+    if (length == 0) {
+      const char* bytes = take(r, sizeof(v));
+      if (bytes != NULL)
+        memcpy(&v, bytes, sizeof(v));
+      value->types.n = ram_int_from_i64(v);
+    }
+    else {
+      int32_t limbs = (length < 0) ? -length : length;
+      const char* bytes = take(r, (long) limbs * sizeof(uint32_t));
+      if (bytes != NULL) {
+        uint32_t* copy = (uint32_t*) malloc((long) limbs * sizeof(uint32_t));
+        memcpy(copy, bytes, (long) limbs * sizeof(uint32_t));
+        value->types.n = ram_int_from_limbs((length < 0) ? -1 : 1, copy, limbs);
+        free(copy);
+      }
+      else
+        value->types.n = ram_int_from_i64(0);
+    }
+  }
+  else {
+    value->types.i = take_i32(r);
+  }
+
+  return str_len;
+}
+
+static void free_taken(struct RAM_VALUE* value)
+{
+  if (value->value_type == RAM_TYPE_STR)
+    free(value->types.s);
+  else if (value->value_type == RAM_TYPE_INT_ARRAY || value->value_type == RAM_TYPE_REAL_ARRAY)
+    ram_array_free(value->types.a);
+  else if (value->value_type == RAM_TYPE_BIGINT)
+    ram_int_free(value->types.n);
+}
+
+/**
+ * @brief next_record:
+ *
+ * checks the record at r->p; returns its payload in *payload and
+ * skips it, or returns false at the end or at a damaged record
+ */
+static bool next_record(struct READER* r, struct READER* payload)
+{
+  const char* header = take(r, 2 * sizeof(uint32_t));
+  if (header == NULL)
+    return false;
+
+  uint32_t fields[2];
+  memcpy(fields, header, sizeof(fields));
+
+  const char* bytes = take(r, fields[0]);
+  if (bytes == NULL || fields[0] == 0 || checksum(bytes, fields[0]) != fields[1])
+    return false;
+
+  payload->p = bytes;
+  payload->end = bytes + fields[0];
+  payload->ok = true;
+  return true;
+}
+
+/**
+ * @brief apply_records:
+ *
+ * applies the records in bytes[0..n) to memory; returns the # of
+ * records applied, and in *valid the # of bytes they span
+ */
+static long apply_records(struct RAM* memory, const char* bytes, long n, long* valid)
+{
+  struct READER r = {bytes, bytes + n, true};
+  struct READER payload;
+  long applied = 0;
+
+  *valid = 0;
+
+  while (next_record(&r, &payload)) {
+    int kind = (unsigned char) *take(&payload, 1);
+
+    if (kind == RAM_WAL_WRITE_NAME || kind == RAM_WAL_WRITE_ADDR) {
+      char name[256];
+      char* varname = NULL;
+      int address = -1;
+
+      if (kind == RAM_WAL_WRITE_NAME) {
+        int32_t len = take_i32(&payload);
+        const char* chars = take(&payload, len);
+        if (chars == NULL)
+          break;
+        varname = (len < (int) sizeof(name)) ? name : (char*) malloc(len + 1);
+        memcpy(varname, chars, len);
+        varname[len] = '\0';
+      }
+      else {
+        address = take_i32(&payload);
+      }
+
+      struct RAM_VALUE value;
+      int len = take_value(&payload, &value);
+
+      if (payload.ok && memory != NULL) {
+        if (varname != NULL && value.value_type == RAM_TYPE_STR)
+          ram_write_str_by_name(memory, value.types.s, len, varname);
+        else if (varname != NULL)
+          ram_write_cell_by_name(memory, value, varname);
+        else if (value.value_type == RAM_TYPE_STR)
+          ram_write_str_by_addr(memory, value.types.s, len, address);
+        else
+          ram_write_cell_by_addr(memory, value, address);
+      }
+
+      free_taken(&value);
+      if (varname != NULL && varname != name)
+        free(varname);
+      if (!payload.ok)
+        break;
+    }
+    else if (kind == RAM_WAL_GENERATION) {
+      *valid = r.p - bytes;
+      continue;  // not a change
+    }
+    else if (kind == RAM_WAL_APPEND) {
+      int address = take_i32(&payload);
+      int32_t len = take_i32(&payload);
+      const char* chars = take(&payload, len);
+      if (chars == NULL || !payload.ok)
+        break;
+      if (memory != NULL)
+        ram_append_str_by_addr(memory, chars, len, address);
+    }
+    else if (memory != NULL) {
+      if (kind == RAM_WAL_RESET)
+        ram_reset(memory);
+      else if (kind == RAM_WAL_TXN_BEGIN)
+        ram_txn_begin(memory);
+      else if (kind == RAM_WAL_TXN_COMMIT)
+        ram_txn_commit(memory);
+      else if (kind == RAM_WAL_TXN_ROLLBACK)
+        ram_txn_rollback(memory);
+    }
+
+    applied++;
+    *valid = r.p - bytes;
+  }
+
+  return applied;
+}
+
+/**
+ * @brief scan_log:
+ *
+ * returns the # of transactions still open after the valid
+ * records in bytes[0..n), and in *valid the # of bytes those
+ * records span
+ */
+static int scan_log(const char* bytes, long n, long* valid)
+{
+  struct READER r = {bytes, bytes + n, true};
+  struct READER payload;
+  int depth = 0;
+
+  *valid = 0;
+
+  while (next_record(&r, &payload)) {
+    int kind = (unsigned char) *payload.p;
+
+    if (kind == RAM_WAL_TXN_BEGIN)
+      depth++;
+    else if ((kind == RAM_WAL_TXN_COMMIT || kind == RAM_WAL_TXN_ROLLBACK) && depth > 0)
+      depth--;
+    else if (kind == RAM_WAL_RESET)
+      depth = 0;
+
+    *valid = r.p - bytes;
+  }
+
+  return depth;
+}
+
+//
+// A log starts with a GENERATION record giving its number, and
+// a checkpoint ends with the number of the last log it includes.
+// log_generation() is the number of the log in bytes[0..n), -1 if
+// it has none:
+//
+static int32_t log_generation(const char* bytes, long n)
+{
+  struct READER r = {bytes, bytes + n, true};
+  struct READER payload;
+
+  if (!next_record(&r, &payload) || *payload.p != RAM_WAL_GENERATION)
+    return -1;
+
+  take(&payload, 1);
+  int32_t generation = take_i32(&payload);
+  return payload.ok ? generation : -1;
+}
+
+//
+// checkpoint_generation() is the number of the last log included
+// in the checkpoint in bytes[0..n), -1 if it is not complete or
+// does not say:
+//
+static int32_t checkpoint_generation(const char* bytes, long n)
+{
+  struct READER r = {bytes, bytes + n, true};
+  struct READER payload;
+  int32_t generation = -1;
+
+  while (next_record(&r, &payload)) {
+    generation = -1;
+    if (*take(&payload, 1) == RAM_WAL_CHECKPOINT_END) {
+      int32_t g = take_i32(&payload);
+      generation = payload.ok ? g : -1;
+    }
+  }
+
+  return generation;
+}
+
+static char* read_file(const char* path, long* n)
+{
+  *n = 0;
+
+  int fd = open(path, O_RDONLY);
+  if (fd < 0)
+    return NULL;
+
+  long size = lseek(fd, 0, SEEK_END);
+  lseek(fd, 0, SEEK_SET);
+  char* bytes = (char*) malloc(size > 0 ? size : 1);
+
+  long done = 0;
+  while (done < size) {
+    ssize_t got = read(fd, bytes + done, size - done);
+    if (got <= 0)
+      break;
+    done += got;
+  }
+  close(fd);
+
+  *n = done;
+  return bytes;
+}
+
+static bool write_all(int fd, const char* bytes, long n)
+{
+  while (n > 0) {
+    ssize_t put = write(fd, bytes, n);
+    if (put < 0 && errno == EINTR)
+      continue;
+    if (put <= 0)
+      return false;
+    bytes += put;
+    n -= put;
+  }
+  return true;
+}
+
+static char* checkpoint_path(const char* path, const char* suffix)
+{
+  char* s = (char*) malloc(strlen(path) + strlen(suffix) + 1);
+  strcpy(s, path);
+  strcat(s, suffix);
+  return s;
+}
+
+//
+// the checkpoint_generation() of path's checkpoint file, reading
+// only its CHECKPOINT_END record:
+//
+static int32_t checkpoint_file_generation(const char* path)
+{
+  char end[2 * sizeof(uint32_t) + 1 + sizeof(int32_t)];
+
+  char* ckpt_path = checkpoint_path(path, ".ckpt");
+  int fd = open(ckpt_path, O_RDONLY);
+  free(ckpt_path);
+  if (fd < 0)
+    return -1;
+
+  long size = lseek(fd, 0, SEEK_END);
+  bool ok = (size >= (long) sizeof(end)) && (pread(fd, end, sizeof(end), size - sizeof(end)) == (ssize_t) sizeof(end));
+  close(fd);
+
+  return ok ? checkpoint_generation(end, sizeof(end)) : -1;
+}
+
+
+//
+// group commit:
+//
+
+/**
+ * @brief commit_locked:
+ *
+ * writes and fsyncs the active buffer; called with the lock
+ * held, which it drops while doing I/O
+ */
+static void commit_locked(struct RAM_WAL* wal)
+{
+  struct WAL_BUFFER swap = wal->writing;
+  wal->writing = wal->active;
+  wal->active = swap;
+  wal->active.size = 0;
+
+  long target = wal->logged;
+  wal->pending = 0;
+  wal->flushing = true;
+  pthread_mutex_unlock(&wal->lock);
+
+  bool ok = write_all(wal->fd, wal->writing.bytes, wal->writing.size);
+  ok = ok && (fdatasync(wal->fd) == 0);
+
+  pthread_mutex_lock(&wal->lock);
+  wal->flushing = false;
+  if (ok)
+    wal->durable = target;
+  else
+    wal->failed = true;
+  pthread_cond_broadcast(&wal->committed);
+}
+
+static void* flusher_thread(void* arg)
+{
+  struct RAM_WAL* wal = (struct RAM_WAL*) arg;
+
+  pthread_mutex_lock(&wal->lock);
+
+  while (!wal->closing) {
+    if (wal->pending < wal->commit_records && !wal->sync_wanted) {
+      struct timespec deadline;
+      clock_gettime(CLOCK_REALTIME, &deadline);
+      deadline.tv_nsec += (long) wal->commit_ms * 1000000;
+      deadline.tv_sec += deadline.tv_nsec / 1000000000;
+      deadline.tv_nsec %= 1000000000;
+      pthread_cond_timedwait(&wal->wake, &wal->lock, &deadline);
+    }
+
+    wal->sync_wanted = false;
+    if (wal->pending > 0)
+      commit_locked(wal);
+  }
+
+  if (wal->pending > 0)
+    commit_locked(wal);
+
+  pthread_mutex_unlock(&wal->lock);
+  return NULL;
+}
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_wal_open: open a log file for appending
+  *
+  * @param path log file
+  * @param commit_ms max milliseconds between group commits
+  * @param commit_records commit as soon as this many records wait
+  * @param checkpoint_records checkpoint after this many records, 0 => never
+  * @return pointer to log, or NULL if the file cannot be opened
+  */
+struct RAM_WAL* ram_wal_open(const char* path, int commit_ms, int commit_records, long checkpoint_records)
+{
+  // cut off a torn record left by a crash, so new records follow
+  // the last good one:
+  long n;
+  char* bytes = read_file(path, &n);
+  long valid = 0;
+  int open_txns = 0;
+  int32_t generation = -1;
+  if (bytes != NULL) {
+    open_txns = scan_log(bytes, n, &valid);
+    generation = log_generation(bytes, valid);
+    free(bytes);
+  }
+
+  // a log the checkpoint already includes was left by a crash
+  // before the checkpoint could empty it:
+  int32_t covered = checkpoint_file_generation(path);
+  if (generation != -1 && generation <= covered) {
+    valid = 0;
+    open_txns = 0;
+  }
+
+  int fd = open(path, O_WRONLY | O_CREAT | O_APPEND, 0644);
+  if (fd < 0)
+    return NULL;
+  if (bytes != NULL && valid < n && ftruncate(fd, valid) != 0) {
+    close(fd);
+    return NULL;
+  }
+
+  // an empty log gets the next number:
+  if (valid == 0) {
+    generation = covered + 1;
+
+    struct WAL_BUFFER buf = {NULL, 0, 0};
+    put_record(&buf, RAM_WAL_GENERATION, generation, NULL, NULL);
+    bool ok = write_all(fd, buf.bytes, buf.size);
+    free(buf.bytes);
+    if (!ok) {
+      close(fd);
+      return NULL;
+    }
+  }
+
+  // replay rolled back the transactions the crash interrupted;
+  // say so, or records logged from now on would land inside them:
+  if (open_txns > 0) {
+    struct WAL_BUFFER buf = {NULL, 0, 0};
+    for (int i = 0; i < open_txns; i++)
+      put_record(&buf, RAM_WAL_TXN_ROLLBACK, -1, NULL, NULL);
+
+    bool ok = write_all(fd, buf.bytes, buf.size) && (fdatasync(fd) == 0);
+    free(buf.bytes);
+    if (!ok) {
+      close(fd);
+      return NULL;
+    }
+  }
+
+  struct RAM_WAL* wal = (struct RAM_WAL*) calloc(1, sizeof(struct RAM_WAL));
+  wal->path = strdup(path);
+  wal->fd = fd;
+  wal->commit_ms = (commit_ms > 0) ? commit_ms : 1;
+  wal->commit_records = (commit_records > 0) ? commit_records : 1;
+  wal->checkpoint_records = checkpoint_records;
+  wal->generation = (generation != -1) ? generation : covered + 1;
+
+  pthread_mutex_init(&wal->lock, NULL);
+  pthread_cond_init(&wal->wake, NULL);
+  pthread_cond_init(&wal->committed, NULL);
+  pthread_create(&wal->flusher, NULL, flusher_thread, wal);
+
+  return wal;
+}
+
+
+/**
+  * @brief ram_wal_close: commit what is left, and close the log
+  *
+  * @param wal Pointer to log
+  * @return void
+  */
+void ram_wal_close(struct RAM_WAL* wal)
+{
+  if (wal == NULL)
+    return;
+
+  pthread_mutex_lock(&wal->lock);
+  wal->closing = true;
+  pthread_cond_signal(&wal->wake);
+  pthread_mutex_unlock(&wal->lock);
+  pthread_join(wal->flusher, NULL);
+
+  close(wal->fd);
+  pthread_mutex_destroy(&wal->lock);
+  pthread_cond_destroy(&wal->wake);
+  pthread_cond_destroy(&wal->committed);
+  free(wal->active.bytes);
+  free(wal->writing.bytes);
+  free(wal->path);
+  free(wal);
+}
+
+
+//
+// counts a record just added to the active buffer, with the lock
+// held; returns true if a checkpoint is due:
+//
+static bool record_added(struct RAM_WAL* wal)
+{
+  wal->pending++;
+  wal->logged++;
+  wal->since_checkpoint++;
+
+  if (wal->pending == wal->commit_records)
+    pthread_cond_signal(&wal->wake);
+
+  return (wal->checkpoint_records > 0 && wal->since_checkpoint >= wal->checkpoint_records);
+}
+
+
+/**
+  * @brief ram_wal_log: append a record
+  *
+  * @param wal Pointer to log
+  * @param kind one of RAM_WAL_RECORDS
+  * @param address cell address, or -1
+  * @param name variable name, or NULL
+  * @param value the cell as written, or NULL
+  * @return true if a checkpoint is due
+  */
+bool ram_wal_log(struct RAM_WAL* wal, int kind, int address, const char* name, struct RAM_VALUE* value)
+{
+  pthread_mutex_lock(&wal->lock);
+
+  put_record(&wal->active, kind, address, name, value);
+  bool due = record_added(wal);
+
+  pthread_mutex_unlock(&wal->lock);
+  return due;
+}
+
+
+/**
+  * @brief ram_wal_log_append: append a record of chars appended to a string
+  *
+  * @param wal Pointer to log
+  * @param address cell address
+  * @param s chars appended
+  * @param len # of chars
+  * @return true if a checkpoint is due
+  */
+bool ram_wal_log_append(struct RAM_WAL* wal, int address, const char* s, int len)
+{
+  pthread_mutex_lock(&wal->lock);
+
+  long header = record_start(&wal->active, RAM_WAL_APPEND);
+  put_i32(&wal->active, address);
+  put_chars(&wal->active, s, len);
+  record_end(&wal->active, header);
+
+  bool due = record_added(wal);
+
+  pthread_mutex_unlock(&wal->lock);
+  return due;
+}
+
+
+/**
+  * @brief ram_wal_sync: wait until every record logged is on disk
+  *
+  * @param wal Pointer to log
+  * @return true if successful, false on an I/O error
+  */
+bool ram_wal_sync(struct RAM_WAL* wal)
+{
+  pthread_mutex_lock(&wal->lock);
+
+  long target = wal->logged;
+  while (wal->durable < target && !wal->failed) {
+    wal->sync_wanted = true;
+    pthread_cond_signal(&wal->wake);
+    pthread_cond_wait(&wal->committed, &wal->lock);
+  }
+
+  bool ok = !wal->failed;
+  pthread_mutex_unlock(&wal->lock);
+  return ok;
+}
+
+
+//
+// ram_wal_checkpoint writes one WRITE_NAME record per variable,
+// in address order so replay gives each var its old address. A
+// cell is only valid during its visit, so the visitor writes the
+// record then, and notes where it is:
+//
+struct CHECKPOINT
+{
+  char** names;                // name of each address
+  struct WAL_BUFFER records;   // records in storage order
+  long* start;                 // offset of each address's record
+  long* end;
+};
+
+static void checkpoint_visitor(struct RAM_VALUE* cell, int address, char* varname, void* arg)
+{
+  struct CHECKPOINT* ckpt = (struct CHECKPOINT*) arg;
+
+  ckpt->start[address] = ckpt->records.size;
+  put_record(&ckpt->records, RAM_WAL_WRITE_NAME, address, ckpt->names[address], cell);
+  ckpt->end[address] = ckpt->records.size;
+}
+
+/**
+  * @brief ram_wal_checkpoint: write out memory and restart the log
+  *
+  * Writes the checkpoint to a temporary file, fsyncs it, renames
+  * it over the old checkpoint, and only then empties the log. A
+  * crash in between leaves a log whose records the checkpoint
+  * already includes. Replaying them again is not harmless, since
+  * appends are not idempotent, so the checkpoint ends with the
+  * log's number; replay and ram_wal_open() skip a log with that
+  * number or less.
+  *
+  * @param memory memory the log is attached to
+  * @return true if successful, false if a transaction is open, a
+  *         string can't be read back from the spill file, or on an
+  *         I/O error
+  */
+bool ram_wal_checkpoint(struct RAM* memory)
+{
+  if (memory == NULL || memory->wal == NULL || ram_txn_depth(memory) > 0)
+    return false;
+
+  struct RAM_WAL* wal = memory->wal;
+
+  int n = ram_size(memory);
+  struct CHECKPOINT ckpt = {NULL, {NULL, 0, 0}, NULL, NULL};
+  ckpt.names = (char**) malloc((n > 0 ? n : 1) * sizeof(char*));
+  ckpt.start = (long*) malloc((n > 0 ? n : 1) * sizeof(long));
+  ckpt.end = (long*) malloc((n > 0 ? n : 1) * sizeof(long));
+  for (int i = 0; i < n; i++) {
+    ckpt.names[memory->map[i].cell] = memory->map[i].varname;
+    ckpt.start[i] = -1;
+  }
+  ram_for_each(memory, checkpoint_visitor, &ckpt);
+
+  // ram_for_each() skips a cell whose string can't be read back
+  // from the spill file, and a checkpoint without it is wrong:
+  bool complete = true;
+  struct WAL_BUFFER buf = {NULL, 0, 0};
+  for (int address = 0; address < n && complete; address++) {
+    complete = (ckpt.start[address] >= 0);
+    if (complete)
+      buffer_put(&buf, ckpt.records.bytes + ckpt.start[address], ckpt.end[address] - ckpt.start[address]);
+  }
+  put_record(&buf, RAM_WAL_CHECKPOINT_END, wal->generation, NULL, NULL);
+  free(ckpt.names);
+  free(ckpt.records.bytes);
+  free(ckpt.start);
+  free(ckpt.end);
+
+  if (!complete) {
+    free(buf.bytes);
+    return false;
+  }
+
+  char* tmp = checkpoint_path(wal->path, ".ckpt.tmp");
+  char* final = checkpoint_path(wal->path, ".ckpt");
+
+  int fd = open(tmp, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  bool ok = (fd >= 0);
+  ok = ok && write_all(fd, buf.bytes, buf.size);
+  ok = ok && (fsync(fd) == 0);
+  if (fd >= 0)
+    close(fd);
+  free(buf.bytes);
+
+  pthread_mutex_lock(&wal->lock);
+
+  // the log must not be written while it is emptied:
+  while (wal->flushing)
+    pthread_cond_wait(&wal->committed, &wal->lock);
+
+  ok = ok && (rename(tmp, final) == 0);
+  if (ok) {
+    // records still buffered predate the checkpoint:
+    wal->active.size = 0;
+    wal->pending = 0;
+    wal->durable = wal->logged;
+    wal->since_checkpoint = 0;
+    ok = (ftruncate(wal->fd, 0) == 0);
+
+    // the emptied log is the next one:
+    struct WAL_BUFFER gen = {NULL, 0, 0};
+    put_record(&gen, RAM_WAL_GENERATION, ++wal->generation, NULL, NULL);
+    ok = ok && write_all(wal->fd, gen.bytes, gen.size);
+    free(gen.bytes);
+  }
+
+  pthread_mutex_unlock(&wal->lock);
+
+  free(tmp);
+  free(final);
+  return ok;
+}
+
+
+/**
+  * @brief ram_wal_replay: rebuild memory from a checkpoint and log
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param path log file
+  * @return # of records applied
+  */
+long ram_wal_replay(struct RAM* memory, const char* path)
+{
+  if (memory == NULL || path == NULL)
+    return 0;
+
+  // don't log what is being replayed:
+  struct RAM_WAL* wal = memory->wal;
+  memory->wal = NULL;
+
+  long applied = 0;
+  long n, valid;
+  int32_t covered = -1;  // last log the checkpoint includes
+
+  // a checkpoint counts only if it is complete, i.e. it ends
+  // with a CHECKPOINT_END record:
+  char* ckpt_path = checkpoint_path(path, ".ckpt");
+  char* bytes = read_file(ckpt_path, &n);
+  if (bytes != NULL) {
+    struct READER r = {bytes, bytes + n, true};
+    struct READER payload;
+    bool complete = false;
+    while (next_record(&r, &payload))
+      complete = (*payload.p == RAM_WAL_CHECKPOINT_END);
+
+    if (complete) {
+      applied += apply_records(memory, bytes, n, &valid);
+      covered = checkpoint_generation(bytes, n);
+    }
+    free(bytes);
+  }
+  free(ckpt_path);
+
+  // skip a log the checkpoint already includes:
+  bytes = read_file(path, &n);
+  if (bytes != NULL) {
+    int32_t generation = log_generation(bytes, n);
+    if (generation == -1 || generation > covered)
+      applied += apply_records(memory, bytes, n, &valid);
+    free(bytes);
+  }
+
+  // transactions the crash interrupted never committed:
+  while (ram_txn_depth(memory) > 0)
+    ram_txn_rollback(memory);
+
+  memory->wal = wal;
+  return applied;
+}
@@ -0,0 +1,159 @@
+/*ram_wal.h*/
+
+/**
+  * @brief Write-ahead log for nuPython's memory unit
+  *
+  * Once a RAM_WAL is attached to a memory unit with
+  * ram_wal_attach(), every write, reset and transaction
+  * begin/commit/rollback on that memory is appended to a log
+  * file, so the memory can be rebuilt after a crash with
+  * ram_wal_replay().
+  *
+  * Writes only append a record to an in-memory buffer. A
+  * background thread writes the buffer out and fsyncs it every
+  * commit_ms milliseconds, or as soon as commit_records records
+  * are waiting, whichever comes first (group commit). A crash
+  * can lose at most the records since the last group commit;
+  * ram_wal_sync() waits until everything logged so far is on
+  * disk.
+  *
+  * Every checkpoint_records records, the whole memory is written
+  * to a checkpoint file (path + ".ckpt") and the log starts over,
+  * so replay time stays bounded. Checkpoints are taken on the
+  * thread writing to memory, and are put off while a transaction
+  * is open. Each log is numbered, and a checkpoint records the
+  * number of the last log it includes, so a log left behind by a
+  * crash during a checkpoint is not replayed a second time.
+  *
+  * Limitations: cells at addresses >= ram_size(), which can only
+  * be written by address, are not checkpointed. Changes made in
+  * place, to an array from ram_get_array() or by a ram_for_each()
+  * visitor, are not logged until ram_array_changed() is called
+  * for the variable; until then a replay loses them, unless a
+  * checkpoint has been taken since.
+  *
+  * @note Paulina Jimenez-Gonzalez
+  */
+
+#pragma once
+
+#include <stdbool.h>  // true, false
+
+#include "ram.h"
+
+
+enum RAM_WAL_RECORDS
+{
+  RAM_WAL_WRITE_NAME = 1,
+  RAM_WAL_WRITE_ADDR,
+  RAM_WAL_RESET,
+  RAM_WAL_TXN_BEGIN,
+  RAM_WAL_TXN_COMMIT,
+  RAM_WAL_TXN_ROLLBACK,
+  RAM_WAL_CHECKPOINT_END,  // last record of a complete checkpoint file
+  RAM_WAL_APPEND,          // chars appended to the string at an address
+  RAM_WAL_GENERATION       // first record of a log: the log's number
+};
+
+struct RAM_WAL;  // log state, private to ram_wal.c
+
+
+//
+// Public functions:
+//
+
+/**
+  * @brief ram_wal_open: open a log file for appending
+  *
+  * Creates the log if it does not exist. A partly written record
+  * at the end of an existing log (from a crash) is cut off.
+  *
+  * @param path log file
+  * @param commit_ms max milliseconds between group commits
+  * @param commit_records commit as soon as this many records wait
+  * @param checkpoint_records checkpoint after this many records, 0 => never
+  * @return pointer to log, or NULL if the file cannot be opened
+  */
+struct RAM_WAL* ram_wal_open(const char* path, int commit_ms, int commit_records, long checkpoint_records);
+
+/**
+  * @brief ram_wal_close: commit what is left, and close the log
+  *
+  * Detach the log from its memory first.
+  *
+  * @param wal Pointer to log
+  * @return void
+  */
+void ram_wal_close(struct RAM_WAL* wal);
+
+/**
+  * @brief ram_wal_attach: log a memory's writes
+  *
+  * Pass NULL to stop logging. The memory should already hold the
+  * state the log describes (empty, or just replayed from it).
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param wal Pointer to log, or NULL
+  * @return void
+  */
+void ram_wal_attach(struct RAM* memory, struct RAM_WAL* wal);
+
+/**
+  * @brief ram_wal_log: append a record
+  *
+  * Called by the RAM module; name is NULL and value is NULL for
+  * records that don't have them.
+  *
+  * @param wal Pointer to log
+  * @param kind one of RAM_WAL_RECORDS
+  * @param address cell address, or -1
+  * @param name variable name, or NULL
+  * @param value the cell as written, or NULL
+  * @return true if a checkpoint is due
+  */
+bool ram_wal_log(struct RAM_WAL* wal, int kind, int address, const char* name, struct RAM_VALUE* value);
+
+/**
+  * @brief ram_wal_log_append: append a record of chars appended to a string
+  *
+  * Called by the RAM module, which logs only the new chars rather
+  * than the whole string.
+  *
+  * @param wal Pointer to log
+  * @param address cell address
+  * @param s chars appended
+  * @param len # of chars
+  * @return true if a checkpoint is due
+  */
+bool ram_wal_log_append(struct RAM_WAL* wal, int address, const char* s, int len);
+
+/**
+  * @brief ram_wal_sync: wait until every record logged is on disk
+  *
+  * @param wal Pointer to log
+  * @return true if successful, false on an I/O error
+  */
+bool ram_wal_sync(struct RAM_WAL* wal);
+
+/**
+  * @brief ram_wal_checkpoint: write out memory and restart the log
+  *
+  * @param memory memory the log is attached to
+  * @return true if successful, false if a transaction is open, a
+  *         string can't be read back from the spill file, or on an
+  *         I/O error
+  */
+bool ram_wal_checkpoint(struct RAM* memory);
+
+/**
+  * @brief ram_wal_replay: rebuild memory from a checkpoint and log
+  *
+  * Applies the checkpoint file (if there is a complete one) and
+  * then the log to memory, which should be empty. Replay stops at
+  * the first damaged record. Missing files are not an error.
+  *
+  * @param memory Pointer to struct denoting memory unit
+  * @param path log file
+  * @return # of records applied
+  */
+long ram_wal_replay(struct RAM* memory, const char* path);
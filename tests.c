@@ -15,9 +15,26 @@
 #include <vector>
 #include <algorithm>
 #include <string>
+#include <unistd.h>    // fork, getpid
+#include <sys/wait.h>  // waitpid
 #include <gtest/gtest.h>
 
 #include "ram.h"
+#include "ram_pool.h"
+#include "ram_array.h"
+#include "ram_parallel.h"
+#include "ram_alloc.h"
+#include "ram_btree.h"
+#include "ram_trace.h"
+#include "ram_wal.h"
+#include "ram_spill.h"
+#include "ram_core.h"
+#include "ram_dump.h"
+#include "ram_shm.h"
+#include "ram_bulk.h"
+#include "ram_repl.h"
+#include "ram_hash.h"
+#include "ram_bigint.h"
 
 using namespace std;
 
@@ -26,6 +43,39 @@ using namespace std;
 // private helper functions:
 //
 
+//
+// visitor that adds up int cells into a long long:
+//
+static void sum_visitor(struct RAM_VALUE* cell, int address, char* varname, void* arg)
+{
+  if (cell->value_type == RAM_TYPE_INT)
+    __atomic_fetch_add((long long*) arg, cell->types.i, __ATOMIC_RELAXED);
+}
+
+static void inc_visitor(struct RAM_VALUE* cell, int address, char* varname, void* arg)
+{
+  if (cell->value_type == RAM_TYPE_INT)
+    cell->types.i++;
+}
+
+static void name_visitor(struct RAM_VALUE* cell, int address, char* varname, void* arg)
+{
+  ((vector<string>*) arg)->push_back(varname);
+}
+
+static void str_visitor(struct RAM_VALUE* cell, int address, char* varname, void* arg)
+{
+  string value;
+  if (cell->value_type == RAM_TYPE_STR)
+    value = string(cell->types.s, ram_str_len(cell));
+  ((vector<pair<string, string>>*) arg)->push_back({varname, value});
+}
+
+static void btree_visitor(char* name, int cell, void* arg)
+{
+  ((vector<string>*) arg)->push_back(name);
+}
+
 
 //
 // some provided unit tests to get started:
@@ -566,4 +616,2874 @@ TEST(memory_module, mixed_types)
   ram_free_value(read_s);
   ram_destroy(memory);
 
-}
\ No newline at end of file
+}
+
+TEST(memory_module, reset_keeps_capacity)
+{
+  struct RAM* memory = ram_init();
+
+  vector<string> values = {"pera", "kiwi", "uva", "fresa", "sandia"};
+  vector<string> names = {"s1", "s2", "s3", "s4", "s5"};
+
+  struct RAM_VALUE str;
+
+  for (size_t i = 0; i < names.size(); i++) {
+    str.value_type = RAM_TYPE_STR;
+    str.types.s = (char*) values[i].c_str();
+    ram_write_cell_by_name(memory, str, (char*)names[i].c_str());
+  }
+  ASSERT_EQ(ram_capacity(memory), 8);
+
+  struct RAM_VALUE* old_cells = memory->cells;
+
+  ram_reset(memory);
+
+  // contents are gone but the arrays are kept:
+  ASSERT_EQ(ram_size(memory), 0);
+  ASSERT_EQ(ram_capacity(memory), 8);
+  ASSERT_TRUE(memory->cells == old_cells);
+  ASSERT_EQ(ram_get_addr(memory, "s1"), -1);
+
+  for (int i = 0; i < ram_capacity(memory); i++) {
+    ASSERT_EQ(memory->cells[i].value_type, RAM_TYPE_NONE);
+  }
+
+  // memory is usable again:
+  str.types.s = "mango";
+  ram_write_cell_by_name(memory, str, "m");
+  ASSERT_EQ(ram_size(memory), 1);
+  ASSERT_EQ(ram_get_addr(memory, "m"), 0);
+  ASSERT_STREQ(memory->cells[0].types.s, "mango");
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, pool_reuses_memory)
+{
+  struct RAM_POOL* pool = ram_pool_init(2, true);
+  ASSERT_TRUE(pool != NULL);
+  ASSERT_EQ(ram_pool_count(pool), 2);
+
+  struct RAM* memory = ram_pool_acquire(pool);
+  ASSERT_EQ(ram_pool_count(pool), 1);
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 7;
+  ram_write_cell_by_name(memory, v, "x");
+
+  ram_pool_release(pool, memory);
+  ASSERT_EQ(ram_pool_count(pool), 2);
+
+  // the same memory comes back, cleared:
+  struct RAM* again = ram_pool_acquire(pool);
+  ASSERT_TRUE(again == memory);
+  ASSERT_EQ(ram_size(again), 0);
+  ASSERT_EQ(ram_get_addr(again, "x"), -1);
+
+  // a full pool destroys extra memories on release:
+  struct RAM* a = ram_pool_acquire(pool);
+  struct RAM* b = ram_pool_acquire(pool);  // pool empty => ram_init
+  ASSERT_EQ(ram_pool_count(pool), 0);
+  ram_pool_release(pool, again);
+  ram_pool_release(pool, a);
+  ram_pool_release(pool, b);
+  ASSERT_EQ(ram_pool_count(pool), 2);
+
+  ASSERT_TRUE(ram_pool_init(0, false) == NULL);
+
+  ram_pool_destroy(pool);
+}
+
+TEST(memory_module, pool_recycles_instrumented_memory)
+{
+  char dir[] = "/tmp/ram_walXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != NULL);
+  string path = string(dir) + "/ram.wal";
+
+  struct RAM_POOL* pool = ram_pool_init(1, false);
+  struct RAM* memory = ram_pool_acquire(pool);
+
+  // the first owner turns everything on:
+  struct RAM_TRACE* trace = ram_trace_create(100);
+  ram_trace_attach(memory, trace);
+  struct RAM_WAL* wal = ram_wal_open(path.c_str(), 5, 64, 0);
+  ram_wal_attach(memory, wal);
+  ram_profile_enable(memory);
+  ASSERT_TRUE(ram_map_btree_enable(memory));
+  ram_hash_enable(memory);
+  ASSERT_TRUE(ram_spill_enable(memory, 4000, NULL));
+  ASSERT_TRUE(ram_intern_enable(memory));
+
+  string big(1500, 'x');
+  for (int i = 0; i < 4; i++) {
+    char name[16];
+    sprintf(name, "s%d", i);
+    ram_write_str_by_name(memory, big.c_str(), (int) big.size(), name);
+  }
+  long events = ram_trace_count(trace);
+
+  // ...and closes its sinks once the memory is back in the pool:
+  ram_pool_release(pool, memory);
+  ASSERT_EQ(ram_trace_count(trace), events);
+  ram_wal_close(wal);
+  ram_trace_destroy(trace);
+
+  struct RAM* again = ram_pool_acquire(pool);
+  ASSERT_TRUE(again == memory);
+  ASSERT_TRUE(again->trace == NULL && again->wal == NULL && again->repl == NULL);
+  ASSERT_TRUE(again->intern == NULL && again->spill == NULL && again->hash == NULL);
+  ASSERT_TRUE(again->btree == NULL && again->hits == NULL && again->shared == NULL);
+
+  ram_write_str_by_name(again, "hello", 5, "s");
+  ram_write_str_by_name(again, "hello", 5, "t");
+  ASSERT_TRUE(again->cells[0].types.s != again->cells[1].types.s);
+  ASSERT_EQ(ram_get_addr(again, "t"), 1);
+  ram_reset(again);
+
+  ram_pool_release(pool, again);
+  ram_pool_destroy(pool);
+  remove(path.c_str());
+  rmdir(dir);
+}
+
+TEST(memory_module, pool_threads)
+{
+  struct RAM_POOL* pool = ram_pool_init(4, false);
+
+  vector<pthread_t> threads(8);
+
+  auto worker = [](void* arg) -> void* {
+    struct RAM_POOL* pool = (struct RAM_POOL*) arg;
+    for (int n = 0; n < 200; n++) {
+      struct RAM* memory = ram_pool_acquire(pool);
+      struct RAM_VALUE v;
+      v.value_type = RAM_TYPE_STR;
+      v.types.s = "value";
+      ram_write_cell_by_name(memory, v, "a");
+      ram_write_cell_by_name(memory, v, "b");
+      if (ram_size(memory) != 2)
+        return (void*) 1;
+      ram_pool_release(pool, memory);
+    }
+    return NULL;
+  };
+
+  for (size_t i = 0; i < threads.size(); i++)
+    pthread_create(&threads[i], NULL, worker, pool);
+
+  for (size_t i = 0; i < threads.size(); i++) {
+    void* result;
+    pthread_join(threads[i], &result);
+    ASSERT_TRUE(result == NULL);
+  }
+
+  ASSERT_TRUE(ram_pool_count(pool) <= 4);
+
+  ram_pool_destroy(pool);
+}
+
+TEST(memory_module, intern_shares_strings)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE str;
+  str.value_type = RAM_TYPE_STR;
+  str.types.s = "ok";
+  ram_write_cell_by_name(memory, str, "before");  // stored before enabling
+
+  ram_intern_enable(memory);
+
+  vector<string> names = {"a", "b", "c", "d", "e"};
+  for (size_t i = 0; i < names.size(); i++) {
+    ram_write_cell_by_name(memory, str, (char*)names[i].c_str());
+  }
+
+  // every cell with "ok" shares one buffer:
+  int a = ram_get_addr(memory, "a");
+  int before = ram_get_addr(memory, "before");
+  for (size_t i = 0; i < names.size(); i++) {
+    int addr = ram_get_addr(memory, (char*)names[i].c_str());
+    ASSERT_TRUE(memory->cells[addr].types.s == memory->cells[before].types.s);
+    ASSERT_TRUE(ram_cells_equal(memory, addr, before));
+  }
+
+  str.types.s = "error";
+  ram_write_cell_by_name(memory, str, "a");  // overwrite drops one ref
+  ASSERT_FALSE(ram_cells_equal(memory, a, before));
+  ASSERT_STREQ(memory->cells[before].types.s, "ok");
+
+  struct RAM_INTERN_STATS stats;
+  ASSERT_TRUE(ram_intern_stats(memory, &stats));
+  ASSERT_EQ(stats.lookups, 7);  // "before" moved in + 5 writes + "error"
+  ASSERT_EQ(stats.hits, 5);
+  ASSERT_EQ(stats.unique_strings, 2);
+  ASSERT_EQ(stats.bytes_saved, 5 * 3);
+  ASSERT_DOUBLE_EQ(stats.hit_rate, 5.0 / 7.0);
+
+  // reads are still private copies:
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "b");
+  ASSERT_TRUE(value->types.s != memory->cells[before].types.s);
+  ASSERT_STREQ(value->types.s, "ok");
+  ram_free_value(value);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, intern_many_distinct)
+{
+  struct RAM* memory = ram_init();
+  ram_intern_enable(memory);
+
+  struct RAM_VALUE str;
+  str.value_type = RAM_TYPE_STR;
+
+  // enough distinct strings to grow the table:
+  for (int i = 0; i < 100; i++) {
+    string value = "v" + to_string(i % 40);
+    string name = "x" + to_string(i);
+    str.types.s = (char*) value.c_str();
+    ram_write_cell_by_name(memory, str, (char*)name.c_str());
+  }
+
+  struct RAM_INTERN_STATS stats;
+  ASSERT_TRUE(ram_intern_stats(memory, &stats));
+  ASSERT_EQ(stats.unique_strings, 40);
+  ASSERT_EQ(stats.hits, 60);
+
+  ASSERT_TRUE(ram_cells_equal(memory, ram_get_addr(memory, "x1"), ram_get_addr(memory, "x41")));
+  ASSERT_FALSE(ram_cells_equal(memory, ram_get_addr(memory, "x1"), ram_get_addr(memory, "x2")));
+
+  // all strings released on reset:
+  ram_reset(memory);
+  ASSERT_TRUE(ram_intern_stats(memory, &stats));
+  ASSERT_EQ(stats.unique_strings, 0);
+
+  struct RAM* plain = ram_init();
+  ASSERT_FALSE(ram_intern_stats(plain, &stats));
+  ram_destroy(plain);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, intern_not_in_txn)
+{
+  struct RAM* memory = ram_init();
+  ram_write_str_by_name(memory, "hello", 5, "x");
+
+  // "hello" is in the undo log, where it can't be interned:
+  ram_txn_begin(memory);
+  ram_write_str_by_name(memory, "world", 5, "x");
+  ASSERT_FALSE(ram_intern_enable(memory));
+  ASSERT_TRUE(ram_txn_rollback(memory));
+
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "x");
+  ASSERT_STREQ(value->types.s, "hello");
+  ram_free_value(value);
+
+  ASSERT_TRUE(ram_intern_enable(memory));
+  ASSERT_TRUE(ram_intern_enable(memory));
+  ram_write_str_by_name(memory, "hello", 5, "y");
+  ASSERT_EQ(memory->cells[0].types.s, memory->cells[1].types.s);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, array_write_read)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_ARRAY* nums = ram_array_new(RAM_TYPE_INT, 5);
+  for (int i = 0; i < 5; i++)
+    nums->elems.i[i] = i * 10;
+
+  struct RAM_VALUE v;
+  v.value_type = ram_array_value_type(nums);
+  v.types.a = nums;
+  ASSERT_EQ(v.value_type, RAM_TYPE_INT_ARRAY);
+
+  bool success = ram_write_cell_by_name(memory, v, "nums");
+  ASSERT_TRUE(success);
+  ram_array_free(nums);  // memory keeps its own copy
+
+  // in-place access by name:
+  struct RAM_ARRAY* stored = ram_get_array(memory, "nums");
+  ASSERT_TRUE(stored != NULL);
+  ASSERT_EQ(stored->length, 5);
+  ASSERT_EQ(stored->elems.i[4], 40);
+
+  // reads return a copy:
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "nums");
+  ASSERT_EQ(value->value_type, RAM_TYPE_INT_ARRAY);
+  ASSERT_TRUE(value->types.a != stored);
+  value->types.a->elems.i[0] = 99;
+  ASSERT_EQ(stored->elems.i[0], 0);
+  ram_free_value(value);
+
+  value = ram_read_cell_by_addr(memory, 0);
+  ASSERT_EQ(value->value_type, RAM_TYPE_INT_ARRAY);
+  ASSERT_EQ(value->types.a->elems.i[3], 30);
+  ram_free_value(value);
+
+  // overwrite with a scalar frees the array:
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 1;
+  ram_write_cell_by_name(memory, v, "nums");
+  ASSERT_TRUE(ram_get_array(memory, "nums") == NULL);
+
+  ASSERT_TRUE(ram_array_new(RAM_TYPE_STR, 3) == NULL);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, array_kernels)
+{
+  // odd lengths exercise the scalar tails of the vector loops:
+  vector<int> lengths = {0, 1, 7, 33, 1000};
+
+  for (int level = RAM_SIMD_AVX2; level >= RAM_SIMD_SCALAR; level--) {
+    ram_array_set_simd(level);
+
+    for (int n : lengths) {
+      struct RAM_ARRAY* xi = ram_array_new(RAM_TYPE_INT, n);
+      struct RAM_ARRAY* yi = ram_array_new(RAM_TYPE_INT, n);
+      struct RAM_ARRAY* xd = ram_array_new(RAM_TYPE_REAL, n);
+      struct RAM_ARRAY* yd = ram_array_new(RAM_TYPE_REAL, n);
+
+      long long sum = 0, dot = 0;
+      double sumd = 0.0, dotd = 0.0;
+      for (int i = 0; i < n; i++) {
+        xi->elems.i[i] = (i * 7919) % 1001 - 500;
+        yi->elems.i[i] = i % 13 - 6;
+        xd->elems.d[i] = xi->elems.i[i] * 0.5;
+        yd->elems.d[i] = yi->elems.i[i] * 0.25;
+        sum += xi->elems.i[i];
+        dot += (long long) xi->elems.i[i] * yi->elems.i[i];
+        sumd += xd->elems.d[i];
+        dotd += xd->elems.d[i] * yd->elems.d[i];
+      }
+
+      ASSERT_EQ(ram_array_sum_int(xi), sum);
+      ASSERT_EQ(ram_array_dot_int(xi, yi), dot);
+      ASSERT_NEAR(ram_array_sum_real(xd), sumd, 1e-6);
+      ASSERT_NEAR(ram_array_dot_real(xd, yd), dotd, 1e-6);
+
+      struct RAM_VALUE lo, hi;
+      if (n == 0) {
+        ASSERT_FALSE(ram_array_min(xi, &lo));
+      }
+      else {
+        ASSERT_TRUE(ram_array_min(xi, &lo));
+        ASSERT_TRUE(ram_array_max(xi, &hi));
+        ASSERT_EQ(lo.types.i, *min_element(xi->elems.i, xi->elems.i + n));
+        ASSERT_EQ(hi.types.i, *max_element(xi->elems.i, xi->elems.i + n));
+        ASSERT_TRUE(ram_array_min(xd, &lo));
+        ASSERT_TRUE(ram_array_max(xd, &hi));
+        ASSERT_EQ(lo.value_type, RAM_TYPE_REAL);
+        ASSERT_DOUBLE_EQ(lo.types.d, *min_element(xd->elems.d, xd->elems.d + n));
+        ASSERT_DOUBLE_EQ(hi.types.d, *max_element(xd->elems.d, xd->elems.d + n));
+      }
+
+      // xi = xi + yi, then xi = xi * yi, then xi *= 3:
+      struct RAM_ARRAY* expect = ram_array_copy(xi);
+      for (int i = 0; i < n; i++)
+        expect->elems.i[i] = (expect->elems.i[i] + yi->elems.i[i]) * yi->elems.i[i] * 3;
+
+      struct RAM_VALUE three;
+      three.value_type = RAM_TYPE_INT;
+      three.types.i = 3;
+      ASSERT_TRUE(ram_array_add(xi, xi, yi));
+      ASSERT_TRUE(ram_array_mul(xi, xi, yi));
+      ASSERT_TRUE(ram_array_scale(xi, three));
+      for (int i = 0; i < n; i++)
+        ASSERT_EQ(xi->elems.i[i], expect->elems.i[i]);
+
+      struct RAM_VALUE half;
+      half.value_type = RAM_TYPE_REAL;
+      half.types.d = 0.5;
+      struct RAM_ARRAY* zd = ram_array_new(RAM_TYPE_REAL, n);
+      ASSERT_TRUE(ram_array_add(zd, xd, yd));
+      ASSERT_TRUE(ram_array_mul(zd, zd, yd));
+      ASSERT_TRUE(ram_array_scale(zd, half));
+      for (int i = 0; i < n; i++)
+        ASSERT_DOUBLE_EQ(zd->elems.d[i], (xd->elems.d[i] + yd->elems.d[i]) * yd->elems.d[i] * 0.5);
+
+      // mismatched types are rejected:
+      ASSERT_FALSE(ram_array_add(xi, xi, xd));
+      ASSERT_FALSE(ram_array_scale(xd, three));
+
+      ram_array_free(expect);
+      ram_array_free(zd);
+      ram_array_free(xi);
+      ram_array_free(yi);
+      ram_array_free(xd);
+      ram_array_free(yd);
+    }
+  }
+
+  ram_array_set_simd(RAM_SIMD_AVX2);
+}
+
+TEST(memory_module, for_each_orders)
+{
+  struct RAM* memory = ram_init();
+
+  vector<string> names = {"z", "b", "e", "a"};
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+
+  for (size_t i = 0; i < names.size(); i++) {
+    v.types.i = (int) i;
+    ram_write_cell_by_name(memory, v, (char*)names[i].c_str());
+  }
+
+  vector<int> by_addr;
+  auto collect_addr = [](struct RAM_VALUE* cell, int address, char* varname, void* arg) {
+    ((vector<int>*) arg)->push_back(address);
+  };
+  ram_for_each(memory, collect_addr, &by_addr);
+  ASSERT_EQ(by_addr, vector<int>({0, 1, 2, 3}));
+
+  vector<string> by_name;
+  auto collect_name = [](struct RAM_VALUE* cell, int address, char* varname, void* arg) {
+    ((vector<string>*) arg)->push_back(varname);
+  };
+  ram_for_each_sorted(memory, collect_name, &by_name);
+  ASSERT_EQ(by_name, vector<string>({"a", "b", "e", "z"}));
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, parallel_for_each)
+{
+  struct RAM* memory = ram_init();
+  struct RAM_WORKERS* workers = ram_workers_init(3);
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+
+  long long expected = 0;
+  for (int i = 0; i < 6000; i++) {
+    string name = "v" + to_string(i);
+    v.types.i = i;
+    ram_write_cell_by_name(memory, v, (char*)name.c_str());
+    expected += i;
+  }
+
+  // run a few passes to reuse the same threads:
+  for (int pass = 0; pass < 3; pass++) {
+    long long sum = 0;
+    ram_parallel_for_each(memory, workers, sum_visitor, &sum);
+    ASSERT_EQ(sum, expected);
+  }
+
+  long long sum = 0;
+  ram_parallel_for_each(memory, NULL, sum_visitor, &sum);
+  ASSERT_EQ(sum, expected);
+
+  // sorted addresses rebuilt from names match the map:
+  vector<int> addrs(ram_size(memory));
+  ram_parallel_sorted_addrs(memory, workers, addrs.data());
+  for (int i = 0; i < ram_size(memory); i++) {
+    ASSERT_EQ(addrs[i], memory->map[i].cell);
+  }
+
+  ram_workers_destroy(workers);
+  ram_destroy(memory);
+}
+
+TEST(memory_module, parallel_sort_names_stable)
+{
+  struct RAM_WORKERS* workers = ram_workers_init(2);
+
+  // lots of duplicates to check equal names keep their order:
+  vector<string> strs;
+  for (int i = 0; i < 30000; i++)
+    strs.push_back("n" + to_string((i * 7919) % 5000));
+
+  vector<char*> names;
+  for (size_t i = 0; i < strs.size(); i++)
+    names.push_back((char*) strs[i].c_str());
+
+  vector<int> order(names.size());
+  ram_parallel_sort_names(workers, names.data(), (int) names.size(), order.data());
+
+  vector<int> expected(names.size());
+  for (size_t i = 0; i < expected.size(); i++)
+    expected[i] = (int) i;
+  stable_sort(expected.begin(), expected.end(), [&](int a, int b) { return strs[a] < strs[b]; });
+
+  ASSERT_EQ(order, expected);
+
+  ram_workers_destroy(workers);
+}
+
+struct SORTER
+{
+  struct RAM_WORKERS* workers;
+  vector<char*>* names;
+  vector<int>* expected;
+  bool ok;
+};
+
+static void* sorter_thread(void* arg)
+{
+  struct SORTER* sorter = (struct SORTER*) arg;
+  vector<int> order(sorter->names->size());
+
+  sorter->ok = true;
+  for (int round = 0; round < 20; round++) {
+    ram_parallel_sort_names(sorter->workers, sorter->names->data(), (int) order.size(), order.data());
+    sorter->ok = sorter->ok && (order == *sorter->expected);
+  }
+  return NULL;
+}
+
+TEST(memory_module, parallel_pool_shared_by_threads)
+{
+  // two threads sorting different names on one pool at once:
+  struct RAM_WORKERS* workers = ram_workers_init(2);
+
+  vector<string> strs[2];
+  vector<char*> names[2];
+  vector<int> expected[2];
+  struct SORTER sorters[2];
+  pthread_t threads[2];
+
+  for (int t = 0; t < 2; t++) {
+    for (int i = 0; i < 5000 + 1000 * t; i++)
+      strs[t].push_back("t" + to_string(t) + "_" + to_string((i * 7919) % 3001));
+    for (size_t i = 0; i < strs[t].size(); i++)
+      names[t].push_back((char*) strs[t][i].c_str());
+
+    for (size_t i = 0; i < strs[t].size(); i++)
+      expected[t].push_back((int) i);
+    vector<string>& st = strs[t];
+    stable_sort(expected[t].begin(), expected[t].end(), [&](int a, int b) { return st[a] < st[b]; });
+
+    sorters[t] = {workers, &names[t], &expected[t], false};
+  }
+
+  for (int t = 0; t < 2; t++)
+    pthread_create(&threads[t], NULL, sorter_thread, &sorters[t]);
+  for (int t = 0; t < 2; t++)
+    pthread_join(threads[t], NULL);
+
+  ASSERT_TRUE(sorters[0].ok);
+  ASSERT_TRUE(sorters[1].ok);
+
+  ram_workers_destroy(workers);
+}
+
+TEST(memory_module, memory_usage)
+{
+  struct RAM* memory = ram_init();
+  struct RAM_MEMORY_USAGE usage;
+
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.cell_bytes, 0);
+  ASSERT_EQ(usage.unused_bytes, (long) (4 * (sizeof(struct RAM_VALUE) + sizeof(struct RAM_MAP))));
+  ASSERT_EQ(usage.string_bytes, 0);
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_STR;
+  v.types.s = "short";  // 5 chars => bucket 0
+  ram_write_cell_by_name(memory, v, "a");
+
+  string longer(100, 'x');  // bucket 2
+  v.types.s = (char*) longer.c_str();
+  ram_write_cell_by_name(memory, v, "bb");
+
+  struct RAM_ARRAY* arr = ram_array_new(RAM_TYPE_REAL, 10);
+  v.value_type = RAM_TYPE_REAL_ARRAY;
+  v.types.a = arr;
+  ram_write_cell_by_name(memory, v, "ccc");
+  ram_array_free(arr);
+
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.cell_bytes, (long) (3 * sizeof(struct RAM_VALUE)));
+  ASSERT_EQ(usage.map_bytes, (long) (3 * sizeof(struct RAM_MAP)));
+  ASSERT_EQ(usage.unused_bytes, (long) (1 * (sizeof(struct RAM_VALUE) + sizeof(struct RAM_MAP))));
+  ASSERT_EQ(usage.name_bytes, 2 + 3 + 4);
+  ASSERT_EQ(usage.str_count[0], 1);
+  ASSERT_EQ(usage.str_bytes[0], 16);   // length header + chars, in 16-byte steps
+  ASSERT_EQ(usage.str_count[2], 1);
+  ASSERT_EQ(usage.str_bytes[2], 112);
+  ASSERT_EQ(usage.string_bytes, 128);
+  ASSERT_EQ(usage.array_bytes, (long) (sizeof(struct RAM_ARRAY) + 10 * sizeof(double)));
+
+  // overwriting a string with an int releases its bytes:
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 1;
+  ram_write_cell_by_name(memory, v, "bb");
+  ram_write_cell_by_name(memory, v, "ccc");
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.str_count[2], 0);
+  ASSERT_EQ(usage.string_bytes, 16);
+  ASSERT_EQ(usage.array_bytes, 0);
+
+  ram_reset(memory);
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.name_bytes, 0);
+  ASSERT_EQ(usage.string_bytes, 0);
+  ASSERT_EQ(usage.total_bytes, usage.ram_bytes + usage.unused_bytes);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, memory_usage_interned)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_STR;
+  v.types.s = "same";
+  ram_write_cell_by_name(memory, v, "a");
+  ram_write_cell_by_name(memory, v, "b");
+
+  struct RAM_MEMORY_USAGE usage;
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.str_count[0], 2);
+  ASSERT_EQ(usage.string_bytes, 32);
+  ASSERT_EQ(usage.intern_bytes, 0);
+
+  // the two copies collapse into one shared buffer:
+  ram_intern_enable(memory);
+  ram_write_cell_by_name(memory, v, "c");
+
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.str_count[0], 1);
+  ASSERT_TRUE(usage.string_bytes > 5);  // one buffer plus refcount header
+  ASSERT_TRUE(usage.intern_bytes > 0);
+
+  ram_reset(memory);
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.string_bytes, 0);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, txn_rollback)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_STR;
+  v.types.s = "before";
+  ram_write_cell_by_name(memory, v, "s");
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 1;
+  ram_write_cell_by_name(memory, v, "x");
+
+  struct RAM_MEMORY_USAGE before;
+  ram_memory_usage(memory, &before);
+
+  ram_txn_begin(memory);
+  ASSERT_EQ(ram_txn_depth(memory), 1);
+
+  // overwrite the same cell many times, add new vars to force
+  // a doubling and map shifts:
+  for (int i = 0; i < 10; i++) {
+    v.types.i = 100 + i;
+    ram_write_cell_by_name(memory, v, "x");
+  }
+  v.value_type = RAM_TYPE_STR;
+  v.types.s = "after";
+  ram_write_cell_by_name(memory, v, "s");
+  vector<string> names = {"m", "a", "z", "b"};
+  for (size_t i = 0; i < names.size(); i++)
+    ram_write_cell_by_name(memory, v, (char*)names[i].c_str());
+  ASSERT_EQ(ram_size(memory), 6);
+
+  ASSERT_TRUE(ram_txn_rollback(memory));
+  ASSERT_EQ(ram_txn_depth(memory), 0);
+
+  ASSERT_EQ(ram_size(memory), 2);
+  ASSERT_STREQ(memory->map[0].varname, "s");
+  ASSERT_STREQ(memory->map[1].varname, "x");
+  ASSERT_EQ(ram_get_addr(memory, "m"), -1);
+
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "x");
+  ASSERT_EQ(value->types.i, 1);
+  ram_free_value(value);
+  value = ram_read_cell_by_name(memory, "s");
+  ASSERT_STREQ(value->types.s, "before");
+  ram_free_value(value);
+
+  struct RAM_MEMORY_USAGE after;
+  ram_memory_usage(memory, &after);
+  ASSERT_EQ(after.name_bytes, before.name_bytes);
+  ASSERT_EQ(after.string_bytes, before.string_bytes);
+
+  ASSERT_FALSE(ram_txn_rollback(memory));
+  ASSERT_FALSE(ram_txn_commit(memory));
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, txn_nested_commit)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 1;
+  ram_write_cell_by_name(memory, v, "x");
+
+  ram_txn_begin(memory);
+  v.types.i = 2;
+  ram_write_cell_by_name(memory, v, "x");
+
+  // inner try block fails:
+  ram_txn_begin(memory);
+  v.types.i = 3;
+  ram_write_cell_by_name(memory, v, "x");
+  ram_write_cell_by_name(memory, v, "y");
+  ASSERT_TRUE(ram_txn_rollback(memory));
+
+  ASSERT_EQ(memory->cells[ram_get_addr(memory, "x")].types.i, 2);
+  ASSERT_EQ(ram_get_addr(memory, "y"), -1);
+
+  // inner block succeeds, outer fails => everything undone:
+  ram_txn_begin(memory);
+  v.types.i = 4;
+  ram_write_cell_by_name(memory, v, "x");
+  v.value_type = RAM_TYPE_STR;
+  v.types.s = "kept?";
+  ram_write_cell_by_name(memory, v, "z");
+  ASSERT_TRUE(ram_txn_commit(memory));
+  ASSERT_EQ(ram_txn_depth(memory), 1);
+  ASSERT_TRUE(ram_txn_rollback(memory));
+
+  ASSERT_EQ(ram_size(memory), 1);
+  ASSERT_EQ(memory->cells[0].value_type, RAM_TYPE_INT);
+  ASSERT_EQ(memory->cells[0].types.i, 1);
+
+  // committed writes stay:
+  ram_txn_begin(memory);
+  ram_write_cell_by_name(memory, v, "z");
+  ASSERT_TRUE(ram_txn_commit(memory));
+  ASSERT_EQ(ram_size(memory), 2);
+  ASSERT_STREQ(memory->cells[ram_get_addr(memory, "z")].types.s, "kept?");
+
+  // an open transaction is dropped by destroy without leaks:
+  ram_txn_begin(memory);
+  ram_write_cell_by_name(memory, v, "x");
+  ram_destroy(memory);
+}
+
+TEST(memory_module, arena_memory)
+{
+  struct RAM* memory = ram_init_arena(4096);  // small chunks => several chunks
+  ASSERT_TRUE(memory->arena != NULL);
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_STR;
+
+  for (int i = 0; i < 200; i++) {
+    string name = "v" + to_string(i);
+    string value = "value " + to_string(i);
+    v.types.s = (char*) value.c_str();
+    ram_write_cell_by_name(memory, v, (char*)name.c_str());
+  }
+
+  // freed strings recycle blocks through the free lists (the int
+  // in between stops the new string reusing the old one in place):
+  for (int i = 0; i < 200; i++) {
+    string name = "v" + to_string(i);
+    struct RAM_VALUE n;
+    n.value_type = RAM_TYPE_INT;
+    n.types.i = i;
+    ram_write_cell_by_name(memory, n, (char*)name.c_str());
+
+    string value = "fresh " + to_string(i);
+    v.types.s = (char*) value.c_str();
+    ram_write_cell_by_name(memory, v, (char*)name.c_str());
+  }
+
+  struct RAM_ARENA_STATS stats;
+  ram_arena_stats(memory->arena, &stats);
+  ASSERT_TRUE(stats.reused >= 190);
+  ASSERT_TRUE(stats.num_chunks > 1);
+  ASSERT_TRUE(stats.large_allocs > 0);  // cells/map outgrew 4KB
+
+  for (int i = 0; i < 200; i++) {
+    string name = "v" + to_string(i);
+    struct RAM_VALUE* value = ram_read_cell_by_name(memory, (char*)name.c_str());
+    ASSERT_STREQ(value->types.s, ("fresh " + to_string(i)).c_str());
+    ram_free_value(value);
+  }
+
+  // a value read from memory may outlive it:
+  struct RAM_VALUE* kept = ram_read_cell_by_name(memory, "v7");
+  ram_destroy(memory);
+  ASSERT_STREQ(kept->types.s, "fresh 7");
+  ram_free_value(kept);  // frees the arena too
+}
+
+TEST(memory_module, arena_features)
+{
+  // the other features work the same on an arena memory:
+  struct RAM* memory = ram_init_arena(0);
+  ram_intern_enable(memory);
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_STR;
+  v.types.s = "shared";
+  ram_write_cell_by_name(memory, v, "a");
+
+  ram_txn_begin(memory);
+  ram_write_cell_by_name(memory, v, "b");
+  struct RAM_ARRAY* arr = ram_array_new(RAM_TYPE_INT, 100);
+  v.value_type = RAM_TYPE_INT_ARRAY;
+  v.types.a = arr;
+  ram_write_cell_by_name(memory, v, "a");
+  ram_array_free(arr);
+  ASSERT_TRUE(ram_txn_rollback(memory));
+
+  ASSERT_EQ(ram_size(memory), 1);
+  ASSERT_STREQ(memory->cells[0].types.s, "shared");
+
+  ram_reset(memory);
+  ram_destroy(memory);
+}
+
+TEST(memory_module, profile_counts)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 1;
+  ram_write_cell_by_name(memory, v, "x");
+  ASSERT_EQ(ram_access_count(memory, 0), 0);  // not profiling yet
+
+  ram_profile_enable(memory);
+  ram_write_cell_by_name(memory, v, "x");
+  ram_write_cell_by_addr(memory, v, 0);
+
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "x");
+  ram_free_value(value);
+  value = ram_read_cell_by_addr(memory, 0);
+  ram_free_value(value);
+  ASSERT_EQ(ram_access_count(memory, 0), 4);
+
+  // failed lookups don't count:
+  value = ram_read_cell_by_name(memory, "y");
+  ASSERT_TRUE(value == NULL);
+  ASSERT_EQ(ram_access_count(memory, 0), 4);
+  ASSERT_EQ(ram_access_count(memory, 1), 0);
+  ASSERT_EQ(ram_access_count(memory, -1), 0);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, optimize_layout)
+{
+  struct RAM* memory = ram_init();
+  ASSERT_FALSE(ram_optimize_layout(memory));  // profiling is off
+
+  ram_profile_enable(memory);
+
+  char name[16];
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  for (int i = 0; i < 20; i++) {
+    sprintf(name, "v%02d", i);
+    v.types.i = i;
+    ram_write_cell_by_name(memory, v, name);
+  }
+
+  // make addresses 17 and 5 hot, 17 the hottest:
+  for (int k = 0; k < 10; k++) {
+    struct RAM_VALUE* value = ram_read_cell_by_addr(memory, 17);
+    ram_free_value(value);
+    if (k < 5) {
+      value = ram_read_cell_by_addr(memory, 5);
+      ram_free_value(value);
+    }
+  }
+
+  ASSERT_TRUE(ram_optimize_layout(memory));
+  ASSERT_EQ(memory->cells[0].types.i, 17);
+  ASSERT_EQ(memory->cells[1].types.i, 5);
+  ASSERT_EQ(ram_access_count(memory, 17), 5);  // halved
+
+  // names and addresses still lead to the same values:
+  for (int i = 0; i < 20; i++) {
+    sprintf(name, "v%02d", i);
+    ASSERT_EQ(ram_get_addr(memory, name), i);
+
+    struct RAM_VALUE* value = ram_read_cell_by_name(memory, name);
+    ASSERT_EQ(value->types.i, i);
+    ram_free_value(value);
+  }
+
+  v.types.i = 500;
+  ram_write_cell_by_addr(memory, v, 5);
+  ASSERT_EQ(memory->cells[1].types.i, 500);
+
+  // cells added after the relayout go where they always would:
+  for (int i = 20; i < 40; i++) {
+    sprintf(name, "v%02d", i);
+    v.types.i = i;
+    ram_write_cell_by_name(memory, v, name);
+  }
+  ASSERT_EQ(memory->cells[30].types.i, 30);
+
+  long long sum = 0;
+  ram_for_each(memory, sum_visitor, &sum);
+  ASSERT_EQ(sum, 39 * 40 / 2 - 5 + 500);
+
+  // a second pass permutes the whole range again:
+  ASSERT_TRUE(ram_optimize_layout(memory));
+  for (int i = 0; i < 40; i++) {
+    struct RAM_VALUE* value = ram_read_cell_by_addr(memory, i);
+    ASSERT_EQ(value->types.i, (i == 5) ? 500 : i);
+    ram_free_value(value);
+  }
+
+  ram_print(memory);
+  ram_destroy(memory);
+}
+
+TEST(memory_module, name_index)
+{
+  struct RAM* memory = ram_init();
+
+  // long shared prefixes so lookups have to compare past the
+  // first 8 chars, plus short names:
+  vector<string> names;
+  for (int i = 0; i < 300; i++) {
+    if (i % 3 == 0)
+      names.push_back("variable_" + to_string(i));
+    else if (i % 3 == 1)
+      names.push_back("variabl" + to_string(i));
+    else
+      names.push_back("v" + to_string(i));
+  }
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  for (int i = 0; i < 300; i++) {
+    v.types.i = i;
+    ASSERT_TRUE(ram_write_cell_by_name(memory, v, (char*) names[i].c_str()));
+  }
+
+  // enough lookups to build the index, then check every name:
+  for (int round = 0; round < 2; round++) {
+    for (int i = 0; i < 300; i++) {
+      ASSERT_EQ(ram_get_addr(memory, (char*) names[i].c_str()), i);
+    }
+  }
+
+  struct RAM_MEMORY_USAGE usage;
+  ram_memory_usage(memory, &usage);
+  ASSERT_TRUE(usage.index_bytes > 0);
+
+  ASSERT_EQ(ram_get_addr(memory, (char*) "variable_"), -1);
+  ASSERT_EQ(ram_get_addr(memory, (char*) "variable_00"), -1);
+  ASSERT_EQ(ram_get_addr(memory, (char*) "variabl"), -1);
+  ASSERT_EQ(ram_get_addr(memory, (char*) ""), -1);
+  ASSERT_EQ(ram_get_addr(memory, (char*) "a"), -1);
+  ASSERT_EQ(ram_get_addr(memory, (char*) "zzz"), -1);
+
+  // inserts and rollbacks keep lookups right:
+  ram_txn_begin(memory);
+  v.types.i = -1;
+  ram_write_cell_by_name(memory, v, (char*) "variable_new");
+  ASSERT_EQ(ram_get_addr(memory, (char*) "variable_new"), 300);
+  ASSERT_TRUE(ram_txn_rollback(memory));
+
+  for (int i = 0; i < 300; i++) {
+    ASSERT_EQ(ram_get_addr(memory, (char*) names[i].c_str()), i);
+  }
+  ASSERT_EQ(ram_get_addr(memory, (char*) "variable_new"), -1);
+
+  // the map is still in alphabetical order:
+  vector<string> sorted_names;
+  for (int i = 0; i < ram_size(memory); i++) {
+    sorted_names.push_back(memory->map[i].varname);
+  }
+  ASSERT_TRUE(is_sorted(sorted_names.begin(), sorted_names.end()));
+
+  ram_reset(memory);
+  ASSERT_EQ(ram_get_addr(memory, (char*) names[0].c_str()), -1);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, btree_insert_remove)
+{
+  struct RAM_BTREE tree;
+  ram_btree_init(&tree, NULL);
+
+  // names with long shared prefixes, in a scrambled order:
+  vector<string> names;
+  for (int i = 0; i < 1000; i++)
+    names.push_back("name_" + to_string((i * 7919) % 1000));
+
+  for (int i = 0; i < 1000; i++) {
+    ASSERT_TRUE(ram_btree_insert(&tree, (char*) names[i].c_str(), i));
+  }
+  ASSERT_FALSE(ram_btree_insert(&tree, (char*) names[10].c_str(), 0));
+  ASSERT_EQ(tree.count, 1000);
+
+  vector<string> visited;
+  ram_btree_for_each(&tree, btree_visitor, &visited);
+  ASSERT_EQ(visited.size(), 1000u);
+  ASSERT_TRUE(is_sorted(visited.begin(), visited.end()));
+
+  // remove every other name, in another order:
+  for (int i = 0; i < 1000; i += 2) {
+    int k = (i * 31) % 1000;
+    ASSERT_TRUE(ram_btree_remove(&tree, (char*) names[k].c_str()));
+    ASSERT_FALSE(ram_btree_remove(&tree, (char*) names[k].c_str()));
+  }
+  ASSERT_EQ(tree.count, 500);
+
+  for (int i = 0; i < 1000; i++) {
+    int expected = (i % 2 == 0) ? -1 : i;
+    ASSERT_EQ(ram_btree_find(&tree, (char*) names[i].c_str()), expected);
+  }
+  ASSERT_EQ(ram_btree_find(&tree, (char*) "name_"), -1);
+  ASSERT_EQ(ram_btree_find(&tree, (char*) "n"), -1);
+
+  visited.clear();
+  ram_btree_for_each(&tree, btree_visitor, &visited);
+  ASSERT_EQ(visited.size(), 500u);
+  ASSERT_TRUE(is_sorted(visited.begin(), visited.end()));
+
+  for (int i = 1; i < 1000; i += 2) {
+    ASSERT_TRUE(ram_btree_remove(&tree, (char*) names[i].c_str()));
+  }
+  ASSERT_EQ(tree.count, 0);
+  ASSERT_EQ(ram_btree_bytes(&tree), 0);
+
+  ram_btree_clear(&tree);
+}
+
+TEST(memory_module, btree_map)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 100;
+  ram_write_cell_by_name(memory, v, "m");
+  v.types.i = 101;
+  ram_write_cell_by_name(memory, v, "c");
+
+  ASSERT_TRUE(ram_map_btree_enable(memory));
+  ASSERT_EQ(ram_get_addr(memory, "m"), 0);
+  ASSERT_EQ(ram_get_addr(memory, "c"), 1);
+  ASSERT_STREQ(memory->map[1].varname, "c");  // address order now
+
+  // reverse alphabetical order was the worst case for the map:
+  char name[16];
+  for (int i = 2000; i > 0; i--) {
+    sprintf(name, "var%04d", i);
+    v.types.i = i;
+    ram_write_cell_by_name(memory, v, name);
+  }
+  ASSERT_EQ(ram_size(memory), 2002);
+  ASSERT_EQ(ram_get_addr(memory, "var2000"), 2);
+  ASSERT_EQ(ram_get_addr(memory, "var0001"), 2001);
+
+  vector<string> visited;
+  ram_for_each_sorted(memory, name_visitor, &visited);
+  ASSERT_EQ(visited.size(), 2002u);
+  ASSERT_TRUE(is_sorted(visited.begin(), visited.end()));
+
+  ram_txn_begin(memory);
+  ram_write_cell_by_name(memory, v, "a");
+  ram_write_cell_by_name(memory, v, "var0500x");
+  ASSERT_EQ(ram_get_addr(memory, "a"), 2002);
+  ASSERT_TRUE(ram_txn_rollback(memory));
+  ASSERT_EQ(ram_get_addr(memory, "a"), -1);
+  ASSERT_EQ(ram_get_addr(memory, "var0500x"), -1);
+  ASSERT_EQ(ram_get_addr(memory, "var0500"), 2002 - 500);
+
+  struct RAM_MEMORY_USAGE usage;
+  ram_memory_usage(memory, &usage);
+  ASSERT_TRUE(usage.index_bytes > 0);
+
+  ram_reset(memory);
+  ASSERT_EQ(ram_get_addr(memory, "m"), -1);
+  ram_write_cell_by_name(memory, v, "z");
+  ASSERT_EQ(ram_get_addr(memory, "z"), 0);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, trace_events)
+{
+  struct RAM* memory = ram_init();
+  struct RAM_TRACE* trace = ram_trace_create(100);  // => 128 events
+  ram_trace_attach(memory, trace);
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 1;
+  char name[16];
+  for (int i = 0; i < 5; i++) {
+    sprintf(name, "v%d", i);
+    ram_write_cell_by_name(memory, v, name);  // 5th write doubles memory
+  }
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "v3");
+  ram_free_value(value);
+  ram_write_cell_by_addr(memory, v, 1);
+  ASSERT_EQ(ram_trace_count(trace), 8);
+
+  ASSERT_EQ(trace->events[4].op, RAM_TRACE_GROW);
+  ASSERT_EQ(trace->events[4].address, 8);
+  ASSERT_EQ(trace->events[5].op, RAM_TRACE_WRITE_NAME);
+  ASSERT_EQ(trace->events[5].name_id, ram_trace_name_id("v4"));
+  ASSERT_EQ(trace->events[6].op, RAM_TRACE_READ_NAME);
+  ASSERT_EQ(trace->events[6].address, 3);
+  ASSERT_EQ(trace->events[7].name_id, 0u);
+
+  FILE* out = tmpfile();
+  ASSERT_EQ(ram_trace_export_json(trace, memory, out), 8);
+  rewind(out);
+  string json;
+  char buf[256];
+  while (fgets(buf, sizeof(buf), out) != NULL)
+    json += buf;
+  fclose(out);
+
+  ASSERT_EQ(json.find("{\"displayTimeUnit\":\"ns\",\"traceEvents\":["), 0u);
+  ASSERT_NE(json.find("\"name\":\"double_memory\""), string::npos);
+  ASSERT_NE(json.find("\"name\":\"read_by_name v3\""), string::npos);
+  ASSERT_NE(json.find("\"ph\":\"X\""), string::npos);
+
+  // the buffer keeps only the newest events:
+  for (int i = 0; i < 1000; i++)
+    ram_write_cell_by_addr(memory, v, 0);
+  ASSERT_EQ(ram_trace_count(trace), 1008);
+
+  out = tmpfile();
+  ASSERT_EQ(ram_trace_export_json(trace, NULL, out), 128);
+  fclose(out);
+
+  ram_trace_attach(memory, NULL);
+  ram_write_cell_by_addr(memory, v, 0);
+  ASSERT_EQ(ram_trace_count(trace), 1008);
+
+  ram_destroy(memory);
+  ram_trace_destroy(trace);
+}
+
+TEST(memory_module, wal_replay)
+{
+  char dir[] = "/tmp/ram_walXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != NULL);
+  string path = string(dir) + "/ram.wal";
+
+  struct RAM* memory = ram_init();
+  struct RAM_WAL* wal = ram_wal_open(path.c_str(), 5, 64, 0);
+  ASSERT_TRUE(wal != NULL);
+  ram_wal_attach(memory, wal);
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 7;
+  ram_write_cell_by_name(memory, v, "i");
+  v.value_type = RAM_TYPE_REAL;
+  v.types.d = 2.5;
+  ram_write_cell_by_name(memory, v, "d");
+  v.value_type = RAM_TYPE_STR;
+  v.types.s = "hello";
+  ram_write_cell_by_name(memory, v, "s");
+  struct RAM_ARRAY* arr = ram_array_new(RAM_TYPE_REAL, 3);
+  arr->elems.d[0] = 1.0;
+  arr->elems.d[1] = 2.0;
+  arr->elems.d[2] = 3.0;
+  v.value_type = RAM_TYPE_REAL_ARRAY;
+  v.types.a = arr;
+  ram_write_cell_by_name(memory, v, "a");
+  ram_array_free(arr);
+
+  // rolled back changes must not come back:
+  ram_txn_begin(memory);
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 99;
+  ram_write_cell_by_addr(memory, v, 0);
+  ram_write_cell_by_name(memory, v, "gone");
+  ram_txn_rollback(memory);
+
+  // nor must an unfinished transaction:
+  v.types.i = 8;
+  ram_write_cell_by_addr(memory, v, 0);
+  ram_txn_begin(memory);
+  ram_write_cell_by_name(memory, v, "unfinished");
+
+  ASSERT_TRUE(ram_wal_sync(memory->wal));
+  ram_wal_attach(memory, NULL);
+  ram_wal_close(wal);
+
+  struct RAM* copy = ram_init();
+  ASSERT_EQ(ram_wal_replay(copy, path.c_str()), 11);
+  ASSERT_EQ(ram_size(copy), 4);
+  ASSERT_EQ(ram_txn_depth(copy), 0);
+  ASSERT_EQ(ram_get_addr(copy, "gone"), -1);
+  ASSERT_EQ(ram_get_addr(copy, "unfinished"), -1);
+
+  struct RAM_VALUE* value = ram_read_cell_by_addr(copy, 0);
+  ASSERT_EQ(value->types.i, 8);
+  ram_free_value(value);
+  value = ram_read_cell_by_name(copy, "d");
+  ASSERT_EQ(value->types.d, 2.5);
+  ram_free_value(value);
+  value = ram_read_cell_by_name(copy, "s");
+  ASSERT_STREQ(value->types.s, "hello");
+  ram_free_value(value);
+  ASSERT_EQ(ram_get_array(copy, "a")->elems.d[2], 3.0);
+
+  // a torn record at the end is ignored, and cut off on open:
+  FILE* f = fopen(path.c_str(), "ab");
+  fwrite("\x20\x00\x00\x00garbage", 1, 11, f);
+  fclose(f);
+
+  struct RAM* again = ram_init();
+  ASSERT_EQ(ram_wal_replay(again, path.c_str()), 11);
+  wal = ram_wal_open(path.c_str(), 5, 64, 0);
+  ram_wal_attach(again, wal);
+  v.types.i = 1;
+  ram_write_cell_by_name(again, v, "more");
+  ram_wal_attach(again, NULL);
+  ram_wal_close(wal);
+
+  struct RAM* third = ram_init();
+  ASSERT_EQ(ram_wal_replay(third, path.c_str()), 13);  // + rollback + write
+  ASSERT_EQ(ram_get_addr(third, "more"), 4);
+
+  ram_destroy(memory);
+  ram_destroy(copy);
+  ram_destroy(again);
+  ram_destroy(third);
+  remove(path.c_str());
+  rmdir(dir);
+}
+
+TEST(memory_module, wal_checkpoint)
+{
+  char dir[] = "/tmp/ram_walXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != NULL);
+  string path = string(dir) + "/ram.wal";
+  string ckpt = path + ".ckpt";
+
+  struct RAM* memory = ram_init();
+  struct RAM_WAL* wal = ram_wal_open(path.c_str(), 5, 16, 100);
+  ram_wal_attach(memory, wal);
+
+  // relayout first, so cells are stored out of address order:
+  ram_profile_enable(memory);
+
+  char name[16];
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  for (int i = 0; i < 250; i++) {
+    sprintf(name, "v%d", i % 60);
+    v.types.i = i;
+    ram_write_cell_by_name(memory, v, name);
+    if (i == 30)
+      ram_optimize_layout(memory);
+  }
+  ASSERT_TRUE(ram_wal_sync(wal));
+
+  // two checkpoints were taken, so the log holds only the last 50:
+  FILE* f = fopen(ckpt.c_str(), "rb");
+  ASSERT_TRUE(f != NULL);
+  fclose(f);
+
+  struct RAM* copy = ram_init();
+  ASSERT_EQ(ram_wal_replay(copy, path.c_str()), 60 + 1 + 50);
+  ASSERT_EQ(ram_size(copy), 60);
+  for (int i = 0; i < 60; i++) {
+    sprintf(name, "v%d", i);
+    ASSERT_EQ(ram_get_addr(copy, name), i);
+
+    struct RAM_VALUE* value = ram_read_cell_by_addr(copy, i);
+    ASSERT_EQ(value->types.i, (i < 10) ? 240 + i : 180 + i);
+    ram_free_value(value);
+  }
+
+  ram_wal_attach(memory, NULL);
+  ram_wal_close(wal);
+  ram_destroy(memory);
+  ram_destroy(copy);
+  remove(path.c_str());
+  remove(ckpt.c_str());
+  rmdir(dir);
+}
+
+static string read_whole_file(const string& path)
+{
+  string bytes;
+  FILE* f = fopen(path.c_str(), "rb");
+  if (f == NULL)
+    return bytes;
+
+  char buf[4096];
+  size_t n;
+  while ((n = fread(buf, 1, sizeof(buf), f)) > 0)
+    bytes.append(buf, n);
+  fclose(f);
+  return bytes;
+}
+
+TEST(memory_module, wal_crash_during_checkpoint)
+{
+  char dir[] = "/tmp/ram_walXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != NULL);
+  string path = string(dir) + "/ram.wal";
+  string ckpt = path + ".ckpt";
+
+  struct RAM* memory = ram_init();
+  struct RAM_WAL* wal = ram_wal_open(path.c_str(), 5, 64, 0);
+  ram_wal_attach(memory, wal);
+
+  ram_write_str_by_name(memory, "ab", 2, "s");
+  ASSERT_TRUE(ram_wal_checkpoint(memory));
+  ram_append_str_by_name(memory, "cd", 2, "s");
+  ASSERT_TRUE(ram_wal_sync(wal));
+  string log = read_whole_file(path);
+
+  // a crash after the checkpoint's rename, before the log was
+  // emptied, leaves the old log beside the new checkpoint:
+  ASSERT_TRUE(ram_wal_checkpoint(memory));
+  ram_wal_attach(memory, NULL);
+  ram_wal_close(wal);
+  FILE* f = fopen(path.c_str(), "wb");
+  fwrite(log.data(), 1, log.size(), f);
+  fclose(f);
+
+  struct RAM* copy = ram_init();
+  ram_wal_replay(copy, path.c_str());
+  struct RAM_VALUE* value = ram_read_cell_by_name(copy, "s");
+  ASSERT_EQ(string(value->types.s, ram_str_len(value)), "abcd");
+  ram_free_value(value);
+
+  // reopening drops the old log, and logs after the checkpoint:
+  wal = ram_wal_open(path.c_str(), 5, 64, 0);
+  ram_wal_attach(copy, wal);
+  ram_append_str_by_name(copy, "ef", 2, "s");
+  ASSERT_TRUE(ram_wal_sync(wal));
+  ram_wal_attach(copy, NULL);
+  ram_wal_close(wal);
+
+  struct RAM* again = ram_init();
+  ram_wal_replay(again, path.c_str());
+  value = ram_read_cell_by_name(again, "s");
+  ASSERT_EQ(string(value->types.s, ram_str_len(value)), "abcdef");
+  ram_free_value(value);
+
+  ram_destroy(memory);
+  ram_destroy(copy);
+  ram_destroy(again);
+  remove(path.c_str());
+  remove(ckpt.c_str());
+  rmdir(dir);
+}
+
+TEST(memory_module, wal_changes_in_place)
+{
+  char dir[] = "/tmp/ram_walXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != NULL);
+  string path = string(dir) + "/ram.wal";
+
+  struct RAM* memory = ram_init();
+  struct RAM_WAL* wal = ram_wal_open(path.c_str(), 5, 64, 0);
+  ram_wal_attach(memory, wal);
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 7;
+  ram_write_cell_by_name(memory, v, "i");
+  struct RAM_ARRAY* arr = ram_array_new(RAM_TYPE_INT, 3);
+  for (int k = 0; k < 3; k++) {
+    arr->elems.i[k] = k;
+  }
+  v.value_type = RAM_TYPE_INT_ARRAY;
+  v.types.a = arr;
+  ram_write_cell_by_name(memory, v, "a");
+  ram_array_free(arr);
+
+  // changed through the array, and by a visitor:
+  ram_get_array(memory, "a")->elems.i[1] = 10;
+  ASSERT_TRUE(ram_array_changed(memory, "a"));
+  ram_for_each(memory, inc_visitor, NULL);
+  ASSERT_TRUE(ram_array_changed(memory, "i"));
+  ASSERT_FALSE(ram_array_changed(memory, "missing"));
+
+  // a rollback puts back an array changed in the transaction:
+  ram_txn_begin(memory);
+  struct RAM_ARRAY* a = ram_get_array(memory, "a");
+  a->elems.i[0] = 100;
+  ASSERT_EQ(ram_get_array(memory, "a"), a);
+  a->elems.i[2] = 200;
+  ASSERT_TRUE(ram_array_changed(memory, "a"));
+  ram_txn_rollback(memory);
+  a = ram_get_array(memory, "a");
+  ASSERT_EQ(a->elems.i[0], 0);
+  ASSERT_EQ(a->elems.i[1], 10);
+  ASSERT_EQ(a->elems.i[2], 2);
+
+  ASSERT_TRUE(ram_wal_sync(wal));
+  ram_wal_attach(memory, NULL);
+  ram_wal_close(wal);
+
+  struct RAM* copy = ram_init();
+  ram_wal_replay(copy, path.c_str());
+  ASSERT_TRUE(ram_equal(memory, copy));
+  struct RAM_VALUE* value = ram_read_cell_by_name(copy, "i");
+  ASSERT_EQ(value->types.i, 8);
+  ram_free_value(value);
+
+  ram_destroy(memory);
+  ram_destroy(copy);
+  remove(path.c_str());
+  rmdir(dir);
+}
+
+TEST(memory_module, str_reuse_in_place)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_STR;
+  v.types.s = "hello";
+  ram_write_cell_by_name(memory, v, "s");
+
+  char* buffer = memory->cells[0].types.s;
+  ASSERT_EQ(ram_str_len(&memory->cells[0]), 5);
+
+  // about the same length => same buffer:
+  v.types.s = "goodbye";
+  ram_write_cell_by_name(memory, v, "s");
+  ASSERT_TRUE(memory->cells[0].types.s == buffer);
+  ASSERT_STREQ(memory->cells[0].types.s, "goodbye");
+  ASSERT_EQ(ram_str_len(&memory->cells[0]), 7);
+
+  // writing a cell's own string back to it:
+  v.types.s = memory->cells[0].types.s + 4;
+  ram_write_cell_by_addr(memory, v, 0);
+  ASSERT_TRUE(memory->cells[0].types.s == buffer);
+  ASSERT_STREQ(memory->cells[0].types.s, "bye");
+
+  // too long => new buffer, and the footprint follows:
+  string longer(200, 'x');
+  v.types.s = (char*) longer.c_str();
+  ram_write_cell_by_name(memory, v, "s");
+  ASSERT_STREQ(memory->cells[0].types.s, longer.c_str());
+
+  struct RAM_MEMORY_USAGE usage;
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.str_count[0], 0);
+  ASSERT_EQ(usage.str_count[2], 1);
+
+  // a rolled back in-place write gets the old string back:
+  ram_txn_begin(memory);
+  v.types.s = "short";
+  ram_write_cell_by_name(memory, v, "s");
+  ram_txn_rollback(memory);
+  ASSERT_STREQ(memory->cells[0].types.s, longer.c_str());
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, str_embedded_nul)
+{
+  char dir[] = "/tmp/ram_walXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != NULL);
+  string path = string(dir) + "/ram.wal";
+
+  struct RAM* memory = ram_init();
+  struct RAM_WAL* wal = ram_wal_open(path.c_str(), 5, 16, 0);
+  ram_wal_attach(memory, wal);
+
+  const char bytes[] = {'a', '\0', 'b', '\0', 'c'};
+  ASSERT_TRUE(ram_write_str_by_name(memory, bytes, 5, "s"));
+  ASSERT_TRUE(ram_write_str_by_name(memory, "ab", 2, "t"));
+  ASSERT_FALSE(ram_write_str_by_addr(memory, "x", 1, -1));
+
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "s");
+  ASSERT_EQ(ram_str_len(value), 5);
+  ASSERT_EQ(memcmp(value->types.s, bytes, 5), 0);
+  ASSERT_EQ(value->types.s[5], '\0');
+  ram_free_value(value);
+
+  // same C string prefix, different values:
+  ASSERT_FALSE(ram_cells_equal(memory, 0, 1));
+  ASSERT_TRUE(ram_write_str_by_addr(memory, bytes, 5, 1));
+  ASSERT_TRUE(ram_cells_equal(memory, 0, 1));
+
+  // lengths survive interning and the log:
+  ram_intern_enable(memory);
+  ASSERT_EQ(ram_str_len(&memory->cells[0]), 5);
+  ASSERT_TRUE(memory->cells[0].types.s == memory->cells[1].types.s);
+  ASSERT_TRUE(ram_wal_sync(wal));
+
+  struct RAM* copy = ram_init();
+  ASSERT_EQ(ram_wal_replay(copy, path.c_str()), 3);
+  value = ram_read_cell_by_name(copy, "t");
+  ASSERT_EQ(ram_str_len(value), 5);
+  ASSERT_EQ(memcmp(value->types.s, bytes, 5), 0);
+  ram_free_value(value);
+
+  struct RAM_VALUE i;
+  i.value_type = RAM_TYPE_INT;
+  i.types.i = 5;
+  ASSERT_EQ(ram_str_len(&i), -1);
+
+  ram_wal_attach(memory, NULL);
+  ram_wal_close(wal);
+  ram_destroy(memory);
+  ram_destroy(copy);
+  remove(path.c_str());
+  rmdir(dir);
+}
+
+TEST(memory_module, str_append)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_STR;
+  v.types.s = "ab";
+  ram_write_cell_by_name(memory, v, "s");
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 1;
+  ram_write_cell_by_name(memory, v, "i");
+
+  ASSERT_FALSE(ram_append_str_by_name(memory, "x", 1, "i"));
+  ASSERT_FALSE(ram_append_str_by_name(memory, "x", 1, "missing"));
+
+  // fits in the buffer => in place:
+  char* buffer = memory->cells[0].types.s;
+  ASSERT_TRUE(ram_append_str_by_name(memory, "cd", 2, "s"));
+  ASSERT_TRUE(memory->cells[0].types.s == buffer);
+  ASSERT_STREQ(buffer, "abcd");
+
+  // s = s + s, then enough pieces to need several chunks:
+  ASSERT_TRUE(ram_append_str_by_addr(memory, buffer, 4, 0));
+  string expected = "abcdabcd";
+  for (int i = 0; i < 1000; i++) {
+    string piece = to_string(i) + ",";
+    ASSERT_TRUE(ram_append_str_by_name(memory, piece.c_str(), (int) piece.size(), "s"));
+    expected += piece;
+  }
+
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "s");
+  ASSERT_STREQ(value->types.s, expected.c_str());
+  ASSERT_EQ(ram_str_len(value), (int) expected.size());
+  ram_free_value(value);
+  ASSERT_EQ(ram_str_len(&memory->cells[0]), (int) expected.size());
+
+  // a rolled back append leaves the string as it was:
+  ram_txn_begin(memory);
+  ram_append_str_by_name(memory, "!", 1, "s");
+  ram_append_str_by_name(memory, "?", 1, "s");
+  ASSERT_STREQ(ram_str_flatten(memory, 0), (expected + "!?").c_str());
+  ram_txn_rollback(memory);
+  ASSERT_STREQ(ram_str_flatten(memory, 0), expected.c_str());
+  ASSERT_TRUE(ram_str_flatten(memory, 1) == NULL);
+
+  // interned strings are not changed in place:
+  ram_write_cell_by_name(memory, v, "i");
+  v.value_type = RAM_TYPE_STR;
+  v.types.s = "ab";
+  ram_write_cell_by_name(memory, v, "t");
+  ram_write_cell_by_name(memory, v, "u");
+  ram_intern_enable(memory);
+  ram_append_str_by_name(memory, "c", 1, "t");
+  ASSERT_STREQ(memory->cells[2].types.s, "abc");
+  ASSERT_STREQ(memory->cells[3].types.s, "ab");
+
+  // overwriting drops pending appends, and reset frees every chunk:
+  ram_reset(memory);
+  struct RAM_MEMORY_USAGE usage;
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.string_bytes, 0);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, str_append_wal)
+{
+  char dir[] = "/tmp/ram_walXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != NULL);
+  string path = string(dir) + "/ram.wal";
+
+  struct RAM* memory = ram_init();
+  struct RAM_WAL* wal = ram_wal_open(path.c_str(), 5, 16, 0);
+  ram_wal_attach(memory, wal);
+
+  ram_write_str_by_name(memory, "", 0, "s");
+  string expected;
+  for (int i = 0; i < 300; i++) {
+    string piece = "piece " + to_string(i) + "\n";
+    ram_append_str_by_name(memory, piece.c_str(), (int) piece.size(), "s");
+    expected += piece;
+  }
+
+  // before flattening, cells hold a prefix of the string:
+  ASSERT_TRUE(ram_str_len(&memory->cells[0]) < (int) expected.size());
+  ASSERT_TRUE(ram_wal_sync(wal));
+
+  struct RAM* copy = ram_init();
+  ASSERT_EQ(ram_wal_replay(copy, path.c_str()), 301);
+  struct RAM_VALUE* value = ram_read_cell_by_name(copy, "s");
+  ASSERT_STREQ(value->types.s, expected.c_str());
+  ram_free_value(value);
+
+  // ram_for_each sees whole strings:
+  ram_append_str_by_name(copy, "end", 3, "s");
+  auto collect_str = [](struct RAM_VALUE* cell, int address, char* varname, void* arg) {
+    ((vector<string>*) arg)->push_back(cell->types.s);
+  };
+  vector<string> seen;
+  ram_for_each(copy, collect_str, &seen);
+  ASSERT_EQ(seen.size(), 1u);
+  ASSERT_EQ(seen[0], expected + "end");
+
+  ram_wal_attach(memory, NULL);
+  ram_wal_close(wal);
+  ram_destroy(memory);
+  ram_destroy(copy);
+  remove(path.c_str());
+  rmdir(dir);
+}
+
+TEST(memory_module, spill_cold_strings)
+{
+  struct RAM* memory = ram_init();
+  struct RAM_SPILL_STATS stats;
+  ASSERT_FALSE(ram_spill_stats(memory, &stats));
+
+  // 20 strings of 1000 chars, then a budget of about 5 of them
+  // (each takes 1024 bytes, the rest of memory about 1400):
+  char name[16];
+  for (int i = 0; i < 20; i++) {
+    string value(1000, 'a' + i);
+    sprintf(name, "s%d", i);
+    ram_write_str_by_name(memory, value.c_str(), (int) value.size(), name);
+  }
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 7;
+  ram_write_cell_by_name(memory, v, "n");
+
+  ASSERT_TRUE(ram_spill_enable(memory, 7000, NULL));
+  ASSERT_TRUE(ram_spill_stats(memory, &stats));
+  ASSERT_EQ(stats.spilled_strings, 15);
+  ASSERT_EQ(stats.spilled_bytes, 15000);
+
+  struct RAM_MEMORY_USAGE usage;
+  ram_memory_usage(memory, &usage);
+  ASSERT_TRUE(usage.total_bytes <= 7000);
+
+  // the oldest went first; reading one brings it back:
+  ASSERT_TRUE(memory->cells[0].types.s == NULL);
+  ASSERT_TRUE(memory->cells[19].types.s != NULL);
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "s0");
+  ASSERT_EQ(ram_str_len(value), 1000);
+  ASSERT_EQ(value->types.s[999], 'a');
+  ram_free_value(value);
+
+  ram_spill_stats(memory, &stats);
+  ASSERT_EQ(stats.faults, 1);
+  ASSERT_EQ(stats.spills, 16);  // s0 came in, s15 went out
+  ASSERT_TRUE(memory->cells[0].types.s != NULL);
+  ASSERT_TRUE(memory->cells[15].types.s == NULL);
+
+  // ints are never spilled, overwrites free file space:
+  value = ram_read_cell_by_name(memory, "n");
+  ASSERT_EQ(value->types.i, 7);
+  ram_free_value(value);
+  ram_write_cell_by_name(memory, v, "s1");
+  ram_spill_stats(memory, &stats);
+  ASSERT_EQ(stats.spilled_strings, 14);
+
+  // everything comes back for a full scan, one string at a time:
+  vector<pair<string, string>> values;
+  ram_for_each_sorted(memory, str_visitor, &values);
+  ASSERT_EQ(values.size(), 21u);
+  for (auto& [varname, value] : values) {
+    int i = atoi(varname.c_str() + 1);
+    if (varname[0] == 's' && i != 1) {
+      ASSERT_EQ(value, string(1000, 'a' + i));
+    }
+  }
+  ASSERT_TRUE(ram_cells_equal(memory, 2, 2));
+  ram_memory_usage(memory, &usage);
+  ASSERT_TRUE(usage.total_bytes <= 7000);
+
+  // ...and writes still keep memory within the budget:
+  ram_write_cell_by_name(memory, v, "m");
+  ram_memory_usage(memory, &usage);
+  ASSERT_TRUE(usage.total_bytes <= 7000);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, spill_budget_kept_by_traversal)
+{
+  struct RAM* memory = ram_init();
+  long budget = 64 * 1024;
+  ASSERT_TRUE(ram_spill_enable(memory, budget, NULL));
+
+  char name[16];
+  for (int i = 0; i < 100; i++) {
+    string value(10 * 1024, 'a' + i % 26);
+    sprintf(name, "s%02d", i);
+    ram_write_str_by_name(memory, value.c_str(), (int) value.size(), name);
+  }
+  struct RAM_SPILL_STATS stats;
+  ram_spill_stats(memory, &stats);
+  int spilled = stats.spilled_strings;
+  ASSERT_TRUE(spilled >= 90);
+
+  // a walk reads each spilled string back only for its visit:
+  struct RAM_MEMORY_USAGE usage;
+  long long sum = 0;
+  ram_for_each(memory, sum_visitor, &sum);
+  ram_memory_usage(memory, &usage);
+  ASSERT_TRUE(usage.total_bytes <= budget);
+
+  vector<pair<string, string>> values;
+  ram_for_each_sorted(memory, str_visitor, &values);
+  ASSERT_EQ(values.size(), 100u);
+  for (int i = 0; i < 100; i++) {
+    sprintf(name, "s%02d", i);
+    ASSERT_EQ(values[i].first, string(name));
+    ASSERT_EQ(values[i].second, string(10 * 1024, 'a' + i % 26));
+  }
+  ram_memory_usage(memory, &usage);
+  ASSERT_TRUE(usage.total_bytes <= budget);
+
+  // a parallel pass reads them all back first, and spills after:
+  struct RAM_WORKERS* workers = ram_workers_init(2);
+  ram_parallel_for_each(memory, workers, sum_visitor, &sum);
+  ram_workers_destroy(workers);
+  ram_memory_usage(memory, &usage);
+  ASSERT_TRUE(usage.total_bytes <= budget);
+
+  ram_spill_stats(memory, &stats);
+  ASSERT_EQ(stats.spilled_strings, spilled);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, spill_txn_and_append)
+{
+  struct RAM* memory = ram_init();
+  ASSERT_TRUE(ram_spill_enable(memory, 3000, NULL));
+
+  string big(1500, 'x');
+  ram_write_str_by_name(memory, big.c_str(), 1500, "a");
+  ram_write_str_by_name(memory, big.c_str(), 1500, "b");
+
+  struct RAM_SPILL_STATS stats;
+  ram_spill_stats(memory, &stats);
+  ASSERT_EQ(stats.spilled_strings, 1);
+  ASSERT_TRUE(memory->cells[0].types.s == NULL);
+
+  // an append to a spilled string faults it in first:
+  ASSERT_TRUE(ram_append_str_by_name(memory, "yz", 2, "a"));
+  char* a = ram_str_flatten(memory, 0);
+  ASSERT_EQ(ram_str_len(&memory->cells[0]), 1502);
+  ASSERT_EQ(string(a), big + "yz");
+
+  // a transaction saves a spilled string before overwriting it:
+  ram_spill_stats(memory, &stats);
+  ASSERT_TRUE(memory->cells[1].types.s == NULL);
+  ram_txn_begin(memory);
+  ram_write_str_by_name(memory, "short", 5, "b");
+  ram_txn_rollback(memory);
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "b");
+  ASSERT_EQ(string(value->types.s), big);
+  ram_free_value(value);
+
+  // reset frees the file:
+  ram_reset(memory);
+  ram_spill_stats(memory, &stats);
+  ASSERT_EQ(stats.spilled_strings, 0);
+  ASSERT_EQ(stats.spilled_bytes, 0);
+
+  ram_destroy(memory);
+}
+
+TEST(memory_module, spill_read_error)
+{
+  char dir[] = "/tmp/ram_spillXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != NULL);
+  string path = string(dir) + "/ram.spill";
+
+  struct RAM* memory = ram_init();
+  ASSERT_TRUE(ram_spill_enable(memory, 3000, path.c_str()));
+
+  string big(1500, 'x');
+  ram_write_str_by_name(memory, big.c_str(), 1500, "a");
+  ram_write_str_by_name(memory, big.c_str(), 1500, "b");
+  ASSERT_TRUE(memory->cells[0].types.s == NULL);
+
+  // the file loses its contents:
+  string saved(1500, '\0');
+  FILE* f = fopen(path.c_str(), "r");
+  ASSERT_EQ(fread(&saved[0], 1, saved.size(), f), saved.size());
+  fclose(f);
+  ASSERT_EQ(truncate(path.c_str(), 0), 0);
+
+  // what needs the string fails, and it stays in the file:
+  ASSERT_TRUE(ram_read_cell_by_name(memory, "a") == NULL);
+  ASSERT_FALSE(ram_append_str_by_name(memory, "yz", 2, "a"));
+  ASSERT_TRUE(ram_str_flatten(memory, 0) == NULL);
+  ram_txn_begin(memory);
+  ASSERT_FALSE(ram_write_str_by_name(memory, "short", 5, "a"));
+  ram_txn_rollback(memory);
+  FILE* null = fopen("/dev/null", "w");
+  ASSERT_FALSE(ram_dump(memory, fileno(null), RAM_DUMP_TEXT));
+  fclose(null);
+
+  struct RAM_SPILL_STATS stats;
+  ram_spill_stats(memory, &stats);
+  ASSERT_EQ(stats.failed_reads, 5);
+  ASSERT_EQ(stats.spilled_strings, 1);
+  ASSERT_TRUE(memory->cells[0].types.s == NULL);
+
+  // ...so it's all there once the file is back:
+  f = fopen(path.c_str(), "w");
+  ASSERT_EQ(fwrite(saved.data(), 1, saved.size(), f), saved.size());
+  fclose(f);
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "a");
+  ASSERT_TRUE(value != NULL);
+  ASSERT_EQ(string(value->types.s), big);
+  ram_free_value(value);
+  ASSERT_TRUE(ram_append_str_by_name(memory, "yz", 2, "a"));
+
+  ram_destroy(memory);
+  rmdir(dir);
+}
+
+template <class CORE>
+static void check_core(CORE& core)
+{
+  char name[16];
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+
+  // addresses are handed out in order, whatever the index:
+  for (int i = 0; i < 100; i++) {
+    snprintf(name, sizeof(name), "x%d", (i * 37) % 100);
+    v.types.i = i;
+    ASSERT_TRUE(core.write_by_name(v, name));
+  }
+  ASSERT_EQ(core.size(), 100);
+  ASSERT_TRUE(core.capacity() >= 100);
+  ASSERT_EQ(core.get_addr("x37"), 1);
+  ASSERT_EQ(core.get_addr("x0"), 0);
+  ASSERT_EQ(core.get_addr("y"), -1);
+  ASSERT_EQ(core.cell(1)->types.i, 1);
+  ASSERT_TRUE(core.cell(100) == NULL);
+
+  // strings are copied in, overwrites keep the address:
+  char text[] = "abc";
+  v.value_type = RAM_TYPE_STR;
+  v.types.s = text;
+  ASSERT_TRUE(core.write_by_name(v, "x37"));
+  text[0] = 'z';
+  ASSERT_EQ(core.size(), 100);
+  ASSERT_STREQ(core.cell(1)->types.s, "abc");
+  ASSERT_TRUE(core.write_by_addr(v, 2));
+  ASSERT_STREQ(core.cell(2)->types.s, "zbc");
+  ASSERT_FALSE(core.write_by_addr(v, 100));
+
+  v.value_type = RAM_TYPE_INT_ARRAY;
+  ASSERT_FALSE(core.write_by_name(v, "arr"));
+  ASSERT_EQ(core.get_addr("arr"), -1);
+}
+
+TEST(memory_module, core_variants)
+{
+  BasicRam<SortedArrayIndex, DoublingGrowth> sorted;
+  check_core(sorted);
+
+  BasicRam<HashIndex, HalfAgainGrowth> hash;
+  check_core(hash);
+
+  struct RAM_ARENA* arena = ram_arena_create(0);
+  {
+    BasicRam<BTreeIndex, DoublingGrowth, ArenaAllocator> btree((ArenaAllocator(arena)));
+    check_core(btree);
+  }
+  ram_arena_release(arena);
+}
+
+static string read_dump(FILE* f)
+{
+  fflush(f);
+  long n = ftell(f);
+  rewind(f);
+  string s(n, '\0');
+  size_t got = fread(&s[0], 1, n, f);
+  s.resize(got);
+  return s;
+}
+
+TEST(memory_module, dump_formats)
+{
+  struct RAM* memory = ram_init();
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 42;
+  ram_write_cell_by_name(memory, v, "b");
+  v.value_type = RAM_TYPE_REAL;
+  v.types.d = 2.5;
+  ram_write_cell_by_name(memory, v, "a");
+  ram_write_str_by_name(memory, "say \"hi\"\n", 9, "c");
+  ram_append_str_by_name(memory, "!", 1, "c");
+  v.value_type = RAM_TYPE_INT_ARRAY;
+  v.types.a = ram_array_new(RAM_TYPE_INT, 3);
+  ram_write_cell_by_name(memory, v, "d");
+  ram_array_free(v.types.a);
+
+  FILE* f = tmpfile();
+  ASSERT_TRUE(ram_dump(memory, fileno(f), RAM_DUMP_TEXT));
+  ASSERT_EQ(read_dump(f),
+            "**MEMORY DUMP**\n"
+            " a: real, 2.500000\n"
+            " b: int, 42\n"
+            " c: str, 'say \"hi\"\n!'\n"
+            " d: int array, length 3\n"
+            "**END DUMP**\n");
+  fclose(f);
+
+  f = tmpfile();
+  ASSERT_TRUE(ram_dump(memory, fileno(f), RAM_DUMP_JSON));
+  ASSERT_EQ(read_dump(f),
+            "{\n"
+            "\"a\":{\"type\":\"real\",\"value\":2.5},\n"
+            "\"b\":{\"type\":\"int\",\"value\":42},\n"
+            "\"c\":{\"type\":\"str\",\"value\":\"say \\\"hi\\\"\\u000a!\"},\n"
+            "\"d\":{\"type\":\"int array\",\"value\":[0,0,0]}\n"
+            "}\n");
+  fclose(f);
+
+  f = tmpfile();
+  ASSERT_TRUE(ram_dump(memory, fileno(f), RAM_DUMP_BINARY));
+  string bin = read_dump(f);
+  fclose(f);
+  ASSERT_EQ(bin.substr(0, 4), "RAMD");
+  ASSERT_EQ(bin[4], RAM_DUMP_VERSION);
+  ASSERT_EQ(bin[5], RAM_TYPE_REAL);
+  ASSERT_EQ((unsigned char) bin.back(), RAM_DUMP_END);
+  // header, then type + name length + name + value per variable:
+  ASSERT_EQ(bin.size(), 5 + (6 + 8) + (6 + 4) + (6 + 4 + 10) + (6 + 4 + 12) + 1);
+
+  ASSERT_FALSE(ram_dump(memory, fileno(stdout), 99));
+  ram_destroy(memory);
+}
+
+TEST(memory_module, dump_in_steps)
+{
+  char name[16];
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+
+  for (int btree = 0; btree <= 1; btree++) {
+    struct RAM* memory = ram_init();
+    if (btree)
+      ram_map_btree_enable(memory);
+
+    for (int i = 0; i < 100; i += 2) {
+      snprintf(name, sizeof(name), "x%03d", i);
+      v.types.i = i;
+      ram_write_cell_by_name(memory, v, name);
+    }
+
+    FILE* f = tmpfile();
+    struct RAM_DUMP* dump = ram_dump_begin(memory, fileno(f), RAM_DUMP_TEXT);
+    ASSERT_EQ(ram_dump_step(dump, 10), 10);  // x000..x018
+
+    // between steps: a new name after the cursor is dumped, one
+    // before it is not, and an overwrite shows its new value
+    v.types.i = -1;
+    ram_write_cell_by_name(memory, v, "x001");
+    ram_write_cell_by_name(memory, v, "x051");
+    ram_write_cell_by_name(memory, v, "x098");
+
+    int steps = 0;
+    while (ram_dump_step(dump, 7) > 0)
+      steps++;
+    ASSERT_EQ(steps, 6);  // 41 more variables
+    ASSERT_TRUE(ram_dump_end(dump));
+
+    string text = read_dump(f);
+    fclose(f);
+    ASSERT_EQ(text.find("x001"), string::npos);
+    ASSERT_NE(text.find(" x051: int, -1\n"), string::npos);
+    ASSERT_NE(text.find(" x098: int, -1\n"), string::npos);
+    ASSERT_EQ(std::count(text.begin(), text.end(), '\n'), 2 + 51);
+
+    ram_destroy(memory);
+  }
+}
+
+TEST(memory_module, shm_constants)
+{
+  char shm_name[64];
+  snprintf(shm_name, sizeof(shm_name), "/ram_test_%d", (int) getpid());
+
+  struct RAM* constants = ram_init();
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_REAL;
+  v.types.d = 3.14159;
+  ram_write_cell_by_name(constants, v, "pi");
+  ram_write_str_by_name(constants, "hello", 5, "greeting");
+  v.value_type = RAM_TYPE_INT_ARRAY;
+  v.types.a = ram_array_new(RAM_TYPE_INT, 4);
+  v.types.a->elems.i[2] = 7;
+  ram_write_cell_by_name(constants, v, "table");
+  ram_array_free(v.types.a);
+
+  ASSERT_TRUE(ram_shm_publish(constants, shm_name));
+  ram_destroy(constants);
+
+  struct RAM_SHM* shm = ram_shm_attach(shm_name);
+  ASSERT_TRUE(shm != NULL);
+  ASSERT_EQ(ram_shm_size(shm), 3);
+
+  // a worker process sees the same constants:
+  pid_t child = fork();
+  if (child == 0) {
+    struct RAM_SHM* mine = ram_shm_attach(shm_name);
+    struct RAM_SHM_CELL cell;
+    bool ok = mine != NULL && ram_shm_find(mine, "greeting", &cell) && strcmp(cell.value.types.s, "hello") == 0;
+    _exit(ok ? 0 : 1);
+  }
+  int status;
+  waitpid(child, &status, 0);
+  ASSERT_TRUE(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+
+  struct RAM* memory = ram_init();
+  ram_shm_use(memory, shm);
+
+  // reads fall through, but constants have no address:
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "pi");
+  ASSERT_EQ(value->types.d, 3.14159);
+  ram_free_value(value);
+  ASSERT_EQ(ram_get_addr(memory, "pi"), -1);
+  ASSERT_TRUE(ram_read_cell_by_name(memory, "e") == NULL);
+  ASSERT_EQ(ram_size(memory), 0);
+
+  // a write hides the constant:
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = 3;
+  ram_write_cell_by_name(memory, v, "pi");
+  value = ram_read_cell_by_name(memory, "pi");
+  ASSERT_EQ(value->types.i, 3);
+  ram_free_value(value);
+
+  // changing a constant in place copies it in first:
+  ASSERT_TRUE(ram_append_str_by_name(memory, " world", 6, "greeting"));
+  value = ram_read_cell_by_name(memory, "greeting");
+  ASSERT_STREQ(value->types.s, "hello world");
+  ram_free_value(value);
+
+  struct RAM_ARRAY* table = ram_get_array(memory, "table");
+  ASSERT_EQ(table->length, 4);
+  ASSERT_EQ(table->elems.i[2], 7);
+  table->elems.i[2] = 8;
+  ASSERT_EQ(ram_size(memory), 3);
+
+  // ... and the segment is unchanged for others:
+  struct RAM* other = ram_init();
+  ram_shm_use(other, shm);
+  value = ram_read_cell_by_name(other, "greeting");
+  ASSERT_STREQ(value->types.s, "hello");
+  ram_free_value(value);
+  value = ram_read_cell_by_name(other, "table");
+  ASSERT_EQ(value->types.a->elems.i[2], 7);
+  ram_free_value(value);
+
+  ram_destroy(other);
+  ram_destroy(memory);
+  ram_shm_detach(shm);
+  ASSERT_TRUE(ram_shm_unlink(shm_name));
+  ASSERT_TRUE(ram_shm_attach(shm_name) == NULL);
+}
+
+struct COUNTING
+{
+  long blocks;  // outstanding
+  long bytes;
+  long calls;
+};
+
+static void* counting_alloc(void* context, size_t bytes)
+{
+  struct COUNTING* c = (struct COUNTING*) context;
+  c->blocks++;
+  c->bytes += bytes;
+  c->calls++;
+  return malloc(bytes);
+}
+
+static void* counting_realloc(void* context, void* ptr, size_t old_bytes, size_t bytes)
+{
+  struct COUNTING* c = (struct COUNTING*) context;
+  c->bytes += bytes - old_bytes;
+  c->calls++;
+  return realloc(ptr, bytes);
+}
+
+static void counting_free(void* context, void* ptr, size_t bytes)
+{
+  struct COUNTING* c = (struct COUNTING*) context;
+  c->blocks--;
+  c->bytes -= bytes;
+  c->calls++;
+  free(ptr);
+}
+
+TEST(memory_module, custom_allocator)
+{
+  struct COUNTING counts = {0, 0, 0};
+  struct RAM_ALLOCATOR hooks = {counting_alloc, counting_realloc, counting_free, &counts};
+
+  struct RAM* memory = ram_init_with_allocator(&hooks);
+  ASSERT_TRUE(memory != NULL);
+  ASSERT_EQ(counts.blocks, 2);  // arena, memory with its inline cells and map
+
+  char name[16];
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  for (int i = 0; i < 100; i++) {
+    snprintf(name, sizeof(name), "x%d", i);
+    v.types.i = i;
+    ram_write_cell_by_name(memory, v, name);
+  }
+  ram_write_str_by_name(memory, "abc", 3, "s");
+  ram_append_str_by_name(memory, "def", 3, "s");
+  v.value_type = RAM_TYPE_REAL_ARRAY;
+  v.types.a = ram_array_new(RAM_TYPE_REAL, 10);
+  ram_write_cell_by_name(memory, v, "a");
+  ram_array_free(v.types.a);
+  ram_txn_begin(memory);
+  ram_write_str_by_name(memory, "xyz", 3, "s");
+  ram_txn_rollback(memory);
+
+  // a value read from memory comes from the hooks too, and may
+  // outlive memory:
+  long before = counts.calls;
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "s");
+  ASSERT_STREQ(value->types.s, "abcdef");
+  ASSERT_EQ(counts.calls, before + 2);  // box and string
+
+  ram_destroy(memory);
+  ASSERT_TRUE(counts.blocks > 0);
+  ram_free_value(value);
+  ASSERT_EQ(counts.blocks, 0);
+  ASSERT_EQ(counts.bytes, 0);
+}
+
+TEST(memory_module, custom_allocator_helpers)
+{
+  struct COUNTING counts = {0, 0, 0};
+  struct RAM_ALLOCATOR hooks = {counting_alloc, counting_realloc, counting_free, &counts};
+  struct RAM* memory = ram_init_with_allocator(&hooks);
+
+  char name[16];
+  vector<string> names(200);
+  vector<char*> name_ptrs(200);
+  vector<struct RAM_VALUE> values(200);
+  for (int i = 0; i < 200; i++) {
+    snprintf(name, sizeof(name), "x%d", i % 150);
+    names[i] = name;
+    name_ptrs[i] = &names[i][0];
+    values[i].value_type = RAM_TYPE_INT;
+    values[i].types.i = i;
+  }
+  ASSERT_EQ(ram_bulk_load(memory, name_ptrs.data(), values.data(), 200, NULL), 150);
+  ram_write_str_by_name(memory, string(2000, 'a').c_str(), 2000, "s");
+
+  // the hash tree, spill state and a dump cursor are memory's, so
+  // they come from its hooks too:
+  long before = counts.calls;
+  ram_content_hash(memory);
+  ASSERT_TRUE(counts.calls > before);
+
+  before = counts.blocks;
+  FILE* null = fopen("/dev/null", "w");
+  struct RAM_DUMP* dump = ram_dump_begin(memory, fileno(null), RAM_DUMP_JSON);
+  ASSERT_EQ(counts.blocks, before + 2);  // cursor and buffer
+  ASSERT_TRUE(ram_dump_step(dump, 10) > 0);
+  ASSERT_TRUE(ram_dump_end(dump));
+  fclose(null);
+  ASSERT_EQ(counts.blocks, before);
+
+  before = counts.calls;
+  ASSERT_TRUE(ram_spill_enable(memory, 1000, NULL));
+  ASSERT_TRUE(counts.calls > before);
+
+  ram_destroy(memory);
+  ASSERT_EQ(counts.blocks, 0);
+  ASSERT_EQ(counts.bytes, 0);
+}
+
+struct BUMP
+{
+  char*  region;
+  size_t used;
+  size_t size;
+};
+
+static void* bump_alloc(void* context, size_t bytes)
+{
+  struct BUMP* bump = (struct BUMP*) context;
+  bytes = (bytes + 15) & ~(size_t) 15;
+  if (bump->used + bytes > bump->size)
+    return NULL;
+  void* p = bump->region + bump->used;
+  bump->used += bytes;
+  return p;
+}
+
+TEST(memory_module, bump_allocator)
+{
+  // no realloc or free: everything goes when the region does
+  struct BUMP bump = {(char*) aligned_alloc(16, 1 << 20), 0, 1 << 20};
+  struct RAM_ALLOCATOR hooks = {bump_alloc, NULL, NULL, &bump};
+
+  struct RAM* memory = ram_init_with_allocator(&hooks);
+  char name[16];
+  for (int i = 0; i < 50; i++) {
+    snprintf(name, sizeof(name), "s%d", i);
+    ram_write_str_by_name(memory, name, strlen(name), name);
+  }
+  ASSERT_EQ(ram_size(memory), 50);
+  ASSERT_EQ(ram_capacity(memory), 64);
+
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "s42");
+  ASSERT_STREQ(value->types.s, "s42");
+  ram_free_value(value);
+
+  ram_destroy(memory);
+  ASSERT_TRUE(bump.used > 0);
+  free(bump.region);
+}
+
+//
+// the same variables, at the same addresses, in the same order:
+//
+static void check_same_vars(struct RAM* expected, struct RAM* memory)
+{
+  ASSERT_EQ(ram_size(memory), ram_size(expected));
+
+  int hint1 = -1, hint2 = -1;
+  char* name1 = NULL;
+  char* name2 = NULL;
+  int addr1, addr2;
+  struct RAM_VALUE* cell1;
+
+  while ((cell1 = ram_next_sorted(expected, name1, &hint1, &name1, &addr1)) != NULL) {
+    struct RAM_VALUE* cell2 = ram_next_sorted(memory, name2, &hint2, &name2, &addr2);
+    ASSERT_TRUE(cell2 != NULL);
+    ASSERT_STREQ(name2, name1);
+    ASSERT_EQ(addr2, addr1);
+    ASSERT_EQ(ram_get_addr(memory, name1), addr1);
+    ASSERT_EQ(cell2->value_type, cell1->value_type);
+    if (cell1->value_type == RAM_TYPE_STR)
+      ASSERT_STREQ(cell2->types.s, cell1->types.s);
+    else if (cell1->value_type == RAM_TYPE_REAL)
+      ASSERT_EQ(cell2->types.d, cell1->types.d);
+    else if (cell1->value_type == RAM_TYPE_INT_ARRAY || cell1->value_type == RAM_TYPE_REAL_ARRAY) {
+      struct RAM_ARRAY* a1 = cell1->types.a;
+      struct RAM_ARRAY* a2 = cell2->types.a;
+      int elem = (a1->elem_type == RAM_TYPE_INT) ? sizeof(int) : sizeof(double);
+      ASSERT_EQ(a2->length, a1->length);
+      ASSERT_EQ(memcmp(a2->elems.i, a1->elems.i, a1->length * elem), 0);
+    }
+    else
+      ASSERT_EQ(cell2->types.i, cell1->types.i);
+  }
+  ASSERT_TRUE(ram_next_sorted(memory, name2, &hint2, &name2, &addr2) == NULL);
+}
+
+TEST(memory_module, bulk_load_matches_sequential)
+{
+  // duplicates and names already in memory, in a random order:
+  srand(46);
+  vector<string> names;
+  vector<struct RAM_VALUE> values;
+  names.reserve(10000);  // strings point into names
+  for (int i = 0; i < 10000; i++) {
+    names.push_back("v" + to_string(rand() % 6000));
+
+    struct RAM_VALUE v;
+    if (i % 3 == 0) {
+      v.value_type = RAM_TYPE_STR;
+      v.types.s = (char*) names.back().c_str();
+    }
+    else {
+      v.value_type = RAM_TYPE_INT;
+      v.types.i = i;
+    }
+    values.push_back(v);
+  }
+  vector<char*> ptrs;
+  for (string& name : names)
+    ptrs.push_back((char*) name.c_str());
+
+  struct RAM_WORKERS* workers = ram_workers_init(2);
+
+  for (int btree = 0; btree <= 1; btree++) {
+    struct RAM* expected = ram_init();
+    struct RAM* memory = ram_init();
+    if (btree) {
+      ram_map_btree_enable(expected);
+      ram_map_btree_enable(memory);
+    }
+
+    struct RAM_VALUE v;
+    v.value_type = RAM_TYPE_INT;
+    for (int i = 0; i < 100; i++) {
+      string name = "v" + to_string(i * 97);
+      v.types.i = -i;
+      ram_write_cell_by_name(expected, v, (char*) name.c_str());
+      ram_write_cell_by_name(memory, v, (char*) name.c_str());
+    }
+
+    for (int i = 0; i < (int) ptrs.size(); i++)
+      ram_write_cell_by_name(expected, values[i], ptrs[i]);
+
+    int created = ram_bulk_load(memory, ptrs.data(), values.data(), (int) ptrs.size(), workers);
+    ASSERT_EQ(created, ram_size(expected) - 100);
+    ASSERT_EQ(ram_capacity(memory), ram_size(memory));  // one exact-size allocation
+
+    check_same_vars(expected, memory);
+
+    ram_destroy(expected);
+    ram_destroy(memory);
+  }
+
+  ram_workers_destroy(workers);
+}
+
+TEST(memory_module, bulk_load_file)
+{
+  char path[] = "/tmp/ram_bulkXXXXXX";
+  int fd = mkstemp(path);
+  ASSERT_TRUE(fd >= 0);
+
+  const char* text =
+    "# settings\n"
+    "count = 42\n"
+    "\n"
+    "ratio=0.5\n"
+    "  debug = False\n"
+    "title = \"nu\\\"Py\\\"\\n\"\n"
+    "unset = None\n"
+    "count = 43\n";
+  ASSERT_EQ(write(fd, text, strlen(text)), (ssize_t) strlen(text));
+  close(fd);
+
+  struct RAM* memory = ram_init();
+  ASSERT_EQ(ram_bulk_load_file(memory, path, NULL), 5);
+
+  struct RAM_VALUE* value = ram_read_cell_by_addr(memory, 0);
+  ASSERT_EQ(value->value_type, RAM_TYPE_INT);
+  ASSERT_EQ(value->types.i, 43);
+  ram_free_value(value);
+
+  value = ram_read_cell_by_name(memory, "ratio");
+  ASSERT_EQ(value->value_type, RAM_TYPE_REAL);
+  ASSERT_DOUBLE_EQ(value->types.d, 0.5);
+  ram_free_value(value);
+
+  value = ram_read_cell_by_name(memory, "debug");
+  ASSERT_EQ(value->value_type, RAM_TYPE_BOOLEAN);
+  ASSERT_EQ(value->types.i, 0);
+  ram_free_value(value);
+
+  value = ram_read_cell_by_name(memory, "title");
+  ASSERT_STREQ(value->types.s, "nu\"Py\"\n");
+  ram_free_value(value);
+
+  ASSERT_EQ(ram_get_addr(memory, "unset"), 4);
+
+  // a bad line anywhere, and nothing is written:
+  FILE* file = fopen(path, "w");
+  fputs("more = 1\nbroken = \"no end\n", file);
+  fclose(file);
+  ASSERT_EQ(ram_bulk_load_file(memory, path, NULL), -1);
+  ASSERT_EQ(ram_get_addr(memory, "more"), -1);
+  ASSERT_EQ(ram_size(memory), 5);
+
+  ram_destroy(memory);
+  unlink(path);
+}
+
+//
+// the standby side of a replication stream, on its own thread:
+//
+struct STANDBY
+{
+  struct RAM* memory;
+  int fd;
+  long deltas;
+  bool damaged;
+};
+
+static void* standby_thread(void* arg)
+{
+  struct STANDBY* standby = (struct STANDBY*) arg;
+  int applied;
+
+  while ((applied = ram_repl_receive(standby->memory, standby->fd, NULL)) > 0)
+    standby->deltas += applied;
+
+  standby->damaged = (applied < 0);
+  return NULL;
+}
+
+TEST(memory_module, repl_standby_mirrors)
+{
+  int fds[2];
+  ASSERT_EQ(pipe(fds), 0);
+
+  struct STANDBY standby = {ram_init(), fds[0], 0, false};
+  pthread_t thread;
+  pthread_create(&thread, NULL, standby_thread, &standby);
+
+  // the snapshot sent on attach replaces what the standby held:
+  struct RAM* memory = ram_init();
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = -5;
+  ram_write_cell_by_name(memory, v, "before");
+  ram_write_str_by_name(standby.memory, "stale", 5, "stale");
+
+  struct RAM_REPL* repl = ram_repl_open(fds[1], 200, 1024);
+  ram_repl_attach(memory, repl);
+
+  char name[16];
+  for (int i = 0; i < 300; i++) {
+    snprintf(name, sizeof(name), "x%d", i % 120);
+    v.value_type = RAM_TYPE_INT;
+    v.types.i = i * 1000;
+    ram_write_cell_by_name(memory, v, name);
+  }
+
+  v.value_type = RAM_TYPE_REAL;
+  v.types.d = 2.5;
+  ram_write_cell_by_addr(memory, v, 3);
+  ram_write_str_by_name(memory, "ab\0c", 4, "s");
+  ram_append_str_by_name(memory, "def", 3, "s");
+
+  struct RAM_ARRAY* arr = ram_array_new(RAM_TYPE_REAL, 3);
+  arr->elems.d[0] = 1.0;
+  arr->elems.d[1] = 2.0;
+  arr->elems.d[2] = 3.0;
+  v.value_type = RAM_TYPE_REAL_ARRAY;
+  v.types.a = arr;
+  ram_write_cell_by_name(memory, v, "a");
+  ram_array_free(arr);
+
+  // a change in place is sent once it is reported:
+  ram_get_array(memory, "a")->elems.d[1] = 5.0;
+  ASSERT_TRUE(ram_array_changed(memory, "a"));
+
+  // a rolled back insert frees its address for the next one:
+  v.value_type = RAM_TYPE_BOOLEAN;
+  v.types.i = 1;
+  ram_txn_begin(memory);
+  ram_write_cell_by_name(memory, v, "gone");
+  ram_write_cell_by_name(memory, v, "x0");
+  ram_txn_rollback(memory);
+  ram_write_cell_by_name(memory, v, "kept");
+
+  char* names[] = {"x5", "b1", "b2", "b1"};
+  struct RAM_VALUE values[4];
+  for (int i = 0; i < 4; i++) {
+    values[i].value_type = RAM_TYPE_INT;
+    values[i].types.i = 7 * i;
+  }
+  ram_bulk_load(memory, names, values, 4, NULL);
+
+  ASSERT_TRUE(ram_repl_flush(repl));
+  ram_repl_attach(memory, NULL);
+
+  struct RAM_REPL_STATS stats;
+  ram_repl_stats(repl, &stats);
+  ASSERT_FALSE(stats.failed);
+  ASSERT_TRUE(stats.batches >= 1 && stats.batches < stats.deltas);
+
+  ram_repl_close(repl);
+  close(fds[1]);
+  pthread_join(thread, NULL);
+  close(fds[0]);
+
+  ASSERT_FALSE(standby.damaged);
+  ASSERT_EQ(standby.deltas, stats.deltas);
+  ASSERT_EQ(ram_get_addr(standby.memory, "stale"), -1);
+  check_same_vars(memory, standby.memory);
+
+  ram_destroy(memory);
+  ram_destroy(standby.memory);
+}
+
+static void collect_diff(char* varname, int addr1, int addr2, void* arg)
+{
+  vector<string>* names = (vector<string>*) arg;
+  names->push_back(string(varname) + ":" + to_string(addr1) + ":" + to_string(addr2));
+}
+
+TEST(memory_module, hash_equal_and_diff)
+{
+  // the same variables, created in opposite orders:
+  struct RAM* memory1 = ram_init();
+  struct RAM* memory2 = ram_init();
+  ram_map_btree_enable(memory2);
+  ram_hash_enable(memory1);
+
+  const int n = 3000;
+  char name[16];
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  for (int i = 0; i < n; i++) {
+    snprintf(name, sizeof(name), "v%d", i);
+    v.types.i = i;
+    ram_write_cell_by_name(memory1, v, name);
+
+    snprintf(name, sizeof(name), "v%d", n - 1 - i);
+    v.types.i = n - 1 - i;
+    ram_write_cell_by_name(memory2, v, name);
+  }
+  ram_write_str_by_name(memory1, "ab", 2, "s");
+  ram_write_str_by_name(memory2, "ab", 2, "s");
+
+  ASSERT_TRUE(ram_equal(memory1, memory2));
+  ASSERT_EQ(ram_content_hash(memory1), ram_content_hash(memory2));
+  ASSERT_EQ(ram_diff(memory1, memory2, NULL, NULL), 0);
+
+  // a value, a type, an append, an array changed in place, and a
+  // name only one side has:
+  v.types.i = -1;
+  ram_write_cell_by_name(memory1, v, "v10");
+  v.value_type = RAM_TYPE_REAL;
+  v.types.d = 20.0;
+  ram_write_cell_by_name(memory2, v, "v20");
+  ram_append_str_by_name(memory1, "c", 1, "s");
+  ram_write_str_by_name(memory1, "x", 1, "only1");
+
+  struct RAM_ARRAY* arr = ram_array_new(RAM_TYPE_INT, 2);
+  arr->elems.i[0] = 1;
+  arr->elems.i[1] = 2;
+  v.value_type = RAM_TYPE_INT_ARRAY;
+  v.types.a = arr;
+  ram_write_cell_by_name(memory1, v, "a");
+  ram_write_cell_by_name(memory2, v, "a");
+  ram_array_free(arr);
+  ASSERT_EQ(ram_diff(memory1, memory2, NULL, NULL), 4);
+  ram_get_array(memory2, "a")->elems.i[1] = 3;
+
+  vector<string> diffs;
+  ASSERT_EQ(ram_diff(memory1, memory2, collect_diff, &diffs), 5);
+  sort(diffs.begin(), diffs.end());
+  vector<string> expected = {
+    "a:" + to_string(n + 2) + ":" + to_string(n + 1),
+    "only1:" + to_string(n + 1) + ":-1",
+    "s:" + to_string(n) + ":" + to_string(n),
+    "v10:10:" + to_string(n - 11),
+    "v20:20:" + to_string(n - 21)
+  };
+  ASSERT_EQ(diffs, expected);
+  ASSERT_FALSE(ram_equal(memory1, memory2));
+
+  // undo it all on one side or the other, with a rolled back
+  // transaction for the name:
+  ram_txn_begin(memory2);
+  ram_write_str_by_name(memory2, "x", 1, "only1");
+  ASSERT_EQ(ram_diff(memory1, memory2, NULL, NULL), 4);
+  ram_txn_rollback(memory2);
+  ASSERT_EQ(ram_diff(memory1, memory2, NULL, NULL), 5);
+
+  ram_write_str_by_name(memory2, "x", 1, "only1");
+  ram_write_str_by_name(memory2, "abc", 3, "s");
+  v.value_type = RAM_TYPE_INT;
+  v.types.i = -1;
+  ram_write_cell_by_name(memory2, v, "v10");
+  v.types.i = 20;
+  ram_write_cell_by_name(memory2, v, "v20");
+  ram_get_array(memory1, "a")->elems.i[1] = 3;
+  ASSERT_TRUE(ram_equal(memory1, memory2));
+
+  ram_reset(memory1);
+  ASSERT_EQ(ram_diff(memory1, memory2, NULL, NULL), n + 3);
+  ram_reset(memory2);
+  ASSERT_TRUE(ram_equal(memory1, memory2));
+
+  ram_destroy(memory1);
+  ram_destroy(memory2);
+}
+
+TEST(memory_module, hash_sees_in_place_changes)
+{
+  struct RAM* memory1 = ram_init();
+  struct RAM* memory2 = ram_init();
+  ram_hash_enable(memory1);
+  ram_hash_enable(memory2);
+
+  char name[16];
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  for (int i = 0; i < 100; i++) {
+    snprintf(name, sizeof(name), "v%d", i);
+    v.types.i = i;
+    ram_write_cell_by_name(memory1, v, name);
+    ram_write_cell_by_name(memory2, v, name);
+  }
+  struct RAM_ARRAY* arr = ram_array_new(RAM_TYPE_INT, 2);
+  arr->elems.i[0] = 1;
+  arr->elems.i[1] = 2;
+  v.value_type = RAM_TYPE_INT_ARRAY;
+  v.types.a = arr;
+  ram_write_cell_by_name(memory1, v, "a");
+  ram_write_cell_by_name(memory2, v, "a");
+  ram_array_free(arr);
+  ASSERT_TRUE(ram_equal(memory1, memory2));
+
+  // visitors change cells in place, one walk of each kind:
+  ram_for_each(memory1, inc_visitor, NULL);
+  ASSERT_EQ(ram_diff(memory1, memory2, NULL, NULL), 100);
+  ram_for_each_sorted(memory2, inc_visitor, NULL);
+  ASSERT_TRUE(ram_equal(memory1, memory2));
+
+  struct RAM_WORKERS* workers = ram_workers_init(2);
+  ram_parallel_for_each(memory1, workers, inc_visitor, NULL);
+  ram_workers_destroy(workers);
+  ASSERT_FALSE(ram_equal(memory1, memory2));
+  ram_for_each(memory2, inc_visitor, NULL);
+  ASSERT_TRUE(ram_equal(memory1, memory2));
+
+  // an array is changed after the hash was last asked for, and
+  // again later through the same pointer:
+  struct RAM_ARRAY* a1 = ram_get_array(memory1, "a");
+  ASSERT_TRUE(ram_equal(memory1, memory2));
+  a1->elems.i[0] = 9;
+  ASSERT_EQ(ram_diff(memory1, memory2, NULL, NULL), 1);
+  ram_get_array(memory2, "a")->elems.i[0] = 9;
+  ASSERT_TRUE(ram_equal(memory1, memory2));
+  a1->elems.i[1] = 9;
+  ASSERT_FALSE(ram_equal(memory1, memory2));
+
+  // ...or handed out before hashing was enabled:
+  struct RAM* memory3 = ram_init();
+  v.types.a = a1;
+  ram_write_cell_by_name(memory3, v, "a");
+  struct RAM_ARRAY* a3 = ram_get_array(memory3, "a");
+  uint64_t before = ram_content_hash(memory3);
+  a3->elems.i[1] = 7;
+  ASSERT_NE(ram_content_hash(memory3), before);
+
+  ram_destroy(memory1);
+  ram_destroy(memory2);
+  ram_destroy(memory3);
+}
+
+TEST(memory_module, bigint_arithmetic)
+{
+  // small ints stay in the word, a step past either end promotes:
+  RAM_INT max = ram_int_from_i64(RAM_INT_SMALL_MAX);
+  RAM_INT min = ram_int_from_i64(RAM_INT_SMALL_MIN);
+  RAM_INT one = ram_int_from_i64(1);
+  ASSERT_TRUE(ram_int_box(max) == NULL);
+  ASSERT_TRUE(ram_int_box(min) == NULL);
+
+  RAM_INT above = ram_int_add(max, one);
+  RAM_INT below = ram_int_sub(min, one);
+  ASSERT_TRUE(ram_int_box(above) != NULL);
+  ASSERT_TRUE(ram_int_box(below) != NULL);
+  ASSERT_GT(ram_int_cmp(above, max), 0);
+  ASSERT_LT(ram_int_cmp(below, min), 0);
+  ASSERT_LT(ram_int_cmp(below, above), 0);
+
+  // and coming back demotes:
+  RAM_INT back = ram_int_sub(above, one);
+  ASSERT_EQ(back, max);
+  RAM_INT neg = ram_int_neg(min);  // 2^61, boxed
+  ASSERT_EQ(ram_int_cmp(neg, above), 0);
+  ASSERT_EQ(ram_int_neg(neg), min);
+  ram_int_free(neg);
+
+  int64_t v;
+  ASSERT_TRUE(ram_int_to_i64(above, &v));
+  ASSERT_EQ(v, RAM_INT_SMALL_MAX + 1);
+  ASSERT_TRUE(ram_int_to_i64(ram_int_from_i64(-7), &v));
+  ASSERT_EQ(v, -7);
+
+  // 30! needs 4 limbs:
+  RAM_INT f = ram_int_from_i64(1);
+  for (int i = 2; i <= 30; i++) {
+    RAM_INT next = ram_int_mul(f, ram_int_from_i64(i));
+    ram_int_free(f);
+    f = next;
+  }
+  char* digits = ram_int_to_str(f);
+  ASSERT_STREQ(digits, "265252859812191058636308480000000");
+  free(digits);
+  ASSERT_FALSE(ram_int_to_i64(f, &v));
+
+  RAM_INT parsed;
+  ASSERT_TRUE(ram_int_parse("-265252859812191058636308480000000", &parsed));
+  RAM_INT sum = ram_int_add(f, parsed);
+  ASSERT_EQ(sum, ram_int_from_i64(0));
+  RAM_INT square = ram_int_mul(parsed, parsed);
+  RAM_INT product = ram_int_mul(f, f);
+  ASSERT_EQ(ram_int_cmp(square, product), 0);
+  ASSERT_GT(ram_int_cmp(square, f), 0);
+  ASSERT_LT(ram_int_cmp(parsed, ram_int_from_i64(0)), 0);
+
+  ASSERT_TRUE(ram_int_parse("4611686018427387903", &back));  // 2^62 - 1
+  ASSERT_TRUE(ram_int_box(back) != NULL);
+  digits = ram_int_to_str(back);
+  ASSERT_STREQ(digits, "4611686018427387903");
+  free(digits);
+  ram_int_free(back);
+  ASSERT_FALSE(ram_int_parse("12a", &back));
+  ASSERT_FALSE(ram_int_parse("-", &back));
+
+  ram_int_free(above);
+  ram_int_free(below);
+  ram_int_free(f);
+  ram_int_free(parsed);
+  ram_int_free(square);
+  ram_int_free(product);
+}
+
+TEST(memory_module, bigint_in_memory)
+{
+  char dir[] = "/tmp/ram_bigXXXXXX";
+  ASSERT_TRUE(mkdtemp(dir) != NULL);
+  string path = string(dir) + "/ram.wal";
+
+  struct RAM* memory = ram_init();
+  struct RAM_WAL* wal = ram_wal_open(path.c_str(), 5, 64, 0);
+  ASSERT_TRUE(wal != NULL);
+  ram_wal_attach(memory, wal);
+
+  RAM_INT big;
+  ASSERT_TRUE(ram_int_parse("-123456789012345678901234567890", &big));
+
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_BIGINT;
+  v.types.n = big;
+  ram_write_cell_by_name(memory, v, "big");
+  v.types.n = ram_int_from_i64(-5);
+  ram_write_cell_by_name(memory, v, "small");
+  ram_int_free(big);
+
+  // memory keeps its own copy; a small one costs nothing extra:
+  struct RAM_MEMORY_USAGE usage;
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.bigint_bytes, (long) sizeof(struct RAM_BIGNUM) + 4 * (long) sizeof(uint32_t));
+
+  struct RAM_VALUE* value = ram_read_cell_by_name(memory, "big");
+  ASSERT_EQ(value->value_type, RAM_TYPE_BIGINT);
+  char* digits = ram_int_to_str(value->types.n);
+  ASSERT_STREQ(digits, "-123456789012345678901234567890");
+  free(digits);
+
+  // writing a cell's own value back to it:
+  ram_write_cell_by_name(memory, *value, "big");
+  ram_free_value(value);
+
+  ASSERT_TRUE(ram_wal_sync(memory->wal));
+  ram_wal_attach(memory, NULL);
+  ram_wal_close(wal);
+
+  struct RAM* copy = ram_init();
+  ASSERT_EQ(ram_wal_replay(copy, path.c_str()), 3);
+  ASSERT_TRUE(ram_equal(memory, copy));
+  value = ram_read_cell_by_name(copy, "small");
+  ASSERT_TRUE(ram_int_to_i64(value->types.n, &v.types.n));
+  ASSERT_EQ(v.types.n, -5);
+  ram_free_value(value);
+
+  // a different big int with the same limb count differs:
+  ASSERT_TRUE(ram_int_parse("-123456789012345678901234567891", &big));
+  v.types.n = big;
+  ram_write_cell_by_name(copy, v, "big");
+  ram_int_free(big);
+  ASSERT_EQ(ram_diff(memory, copy, NULL, NULL), 1);
+
+  // overwriting with a small one frees the box:
+  v.types.n = ram_int_from_i64(1);
+  ram_write_cell_by_name(memory, v, "big");
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.bigint_bytes, 0);
+
+  ram_destroy(memory);
+  ram_destroy(copy);
+  remove(path.c_str());
+  rmdir(dir);
+}
+
+TEST(memory_module, inline_cells)
+{
+  // placed on the stack, cells and map start out inside it:
+  struct RAM storage;
+  struct RAM* memory = ram_init_at(&storage);
+  ASSERT_TRUE(memory == &storage);
+  ASSERT_TRUE(memory->cells == memory->inline_cells);
+  ASSERT_TRUE(memory->map == memory->inline_map);
+
+  struct RAM_MEMORY_USAGE usage;
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.total_bytes, (long) sizeof(struct RAM));
+
+  // growing up to RAM_INLINE_CELLS moves nothing:
+  char name[16];
+  struct RAM_VALUE v;
+  v.value_type = RAM_TYPE_INT;
+  for (int i = 0; i < RAM_INLINE_CELLS; i++) {
+    snprintf(name, sizeof(name), "x%02d", RAM_INLINE_CELLS - i);
+    v.types.i = i;
+    ram_write_cell_by_name(memory, v, name);
+  }
+  ASSERT_EQ(ram_capacity(memory), RAM_INLINE_CELLS);
+  ASSERT_TRUE(memory->cells == memory->inline_cells);
+  ASSERT_TRUE(memory->map == memory->inline_map);
+
+  // and the map stays put when it is rebuilt for the B-tree:
+  ASSERT_TRUE(ram_map_btree_enable(memory));
+  ASSERT_TRUE(memory->map == memory->inline_map);
+  ASSERT_EQ(ram_get_addr(memory, "x03"), RAM_INLINE_CELLS - 3);
+
+  // one more spills both to the heap:
+  v.types.i = 99;
+  ram_write_cell_by_name(memory, v, "y");
+  ASSERT_TRUE(memory->cells != memory->inline_cells);
+  ASSERT_TRUE(memory->map != memory->inline_map);
+  for (int i = 0; i < RAM_INLINE_CELLS; i++) {
+    snprintf(name, sizeof(name), "x%02d", RAM_INLINE_CELLS - i);
+    ASSERT_EQ(ram_get_addr(memory, name), i);
+    struct RAM_VALUE* value = ram_read_cell_by_addr(memory, i);
+    ASSERT_EQ(value->types.i, i);
+    ram_free_value(value);
+  }
+  ASSERT_EQ(ram_get_addr(memory, "y"), RAM_INLINE_CELLS);
+
+  ram_destroy(memory);
+
+  // a heap memory is a single block until it grows past them:
+  memory = ram_init();
+  ASSERT_TRUE(memory->cells == memory->inline_cells);
+  ram_memory_usage(memory, &usage);
+  ASSERT_EQ(usage.total_bytes, (long) sizeof(struct RAM));
+  ram_destroy(memory);
+}